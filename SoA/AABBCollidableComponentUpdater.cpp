@@ -7,6 +7,9 @@
 
 #include "VoxelSpaceConversions.h"
 
+// Extra voxels cached past the box, so small moves don't rebuild
+#define COLLISION_CACHE_PADDING 2
+
 void AABBCollidableComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceSystem) {
     for (auto& it : gameSystem->aabbCollidable) {
         collideWithVoxels(it.second, gameSystem, spaceSystem);
@@ -14,158 +17,95 @@ void AABBCollidableComponentUpdater::update(GameSystem* gameSystem, SpaceSystem*
 }
 
 void AABBCollidableComponentUpdater::collideWithVoxels(AabbCollidableComponent& cmp, GameSystem* gameSystem, SpaceSystem* spaceSystem) {
-    // Clear old data
-    cmp.voxelCollisions.clear();
+    VoxelCollisionCache& cache = cmp.voxelCache;
     // Get needed components
     auto& physics = gameSystem->physics.get(cmp.physics);
     auto& position = gameSystem->voxelPosition.get(physics.voxelPosition);
-    if (position.parentVoxel == 0) return;
+    if (position.parentVoxel == 0) {
+        cache.boxDims = i32v3(0);
+        return;
+    }
     auto& sphericalVoxel = spaceSystem->sphericalVoxel.get(position.parentVoxel);
     f64v3 vpos = position.gridPosition.pos + f64v3(cmp.offset - cmp.box * 0.5f);
-    i32v3 vp(vmath::floor(vpos));
-    
-    i32v3 bounds(vmath::ceil(f64v3(cmp.box) + vmath::fract(vpos)));
-    ChunkGrid& grid = sphericalVoxel.chunkGrids[position.gridPosition.face];
-    const BlockPack* bp = sphericalVoxel.blockPack;
+    cache.boxPos = i32v3(vmath::floor(vpos));
+    cache.boxDims = i32v3(vmath::ceil(f64v3(cmp.box) + vmath::fract(vpos)));
 
-    std::map<ChunkID, std::vector<ui16>> boundedVoxels;
+    ChunkGrid& grid = sphericalVoxel.chunkGrids[position.gridPosition.face];
 
-    // Get bounded voxels
-    for (int yi = 0; yi < bounds.y; yi++) {
-        for (int zi = 0; zi < bounds.z; zi++) {
-            for (int xi = 0; xi < bounds.x; xi++) {
-                i32v3 p = vp + i32v3(xi, yi, zi);
-                i32v3 cpos = VoxelSpaceConversions::voxelToChunk(p);
-                // TODO(Ben): Negative numbers?
-                ChunkID chunkID(cpos);
-                i32v3 cp = p - cpos * CHUNK_WIDTH;
-                boundedVoxels[chunkID].push_back(cp.y * CHUNK_LAYER + cp.z * CHUNK_WIDTH + cp.x);
-            }
-        }
+    // The box and its neighbors, which resolution checks for open faces
+    i32v3 needMin = cache.boxPos - 1;
+    i32v3 needMax = cache.boxPos + cache.boxDims + 1;
+    bool isInside = true;
+    for (int i = 0; i < 3; i++) {
+        if (needMin[i] < cache.origin[i] || needMax[i] > cache.origin[i] + cache.dims[i]) isInside = false;
     }
+    if (isInside && cache.parentVoxel == position.parentVoxel &&
+        cache.face == position.gridPosition.face && !isCacheStale(cache, grid)) return;
 
-    // Find Collidable voxels
-    for (auto& it : boundedVoxels) {
-        ChunkHandle chunk = grid.accessor.acquire(it.first);
-        if (chunk->genLevel == GEN_DONE) {
-            std::lock_guard<std::mutex> l(chunk->dataMutex);
-            for (auto& i : it.second) {
-                BlockID id = chunk->blocks.get(i);
-                if (bp->operator[](id).collide) {
-                    // TODO(Ben): Don't need to look up every time.
-                    cmp.voxelCollisions[it.first].emplace_back(id, i);
-                }
-            }
-        }
+    cache.parentVoxel = position.parentVoxel;
+    cache.face = position.gridPosition.face;
+    cache.origin = needMin - COLLISION_CACHE_PADDING;
+    cache.dims = needMax - needMin + COLLISION_CACHE_PADDING * 2;
+    buildCache(cache, grid, sphericalVoxel.blockPack->getHotTable());
+}
+
+bool AABBCollidableComponentUpdater::isCacheStale(const VoxelCollisionCache& cache, ChunkGrid& grid) {
+    for (size_t i = 0; i < cache.chunkIDs.size(); i++) {
+        ChunkHandle chunk = grid.accessor.acquire(cache.chunkIDs[i]);
+        ui32 version = (chunk->genLevel == GEN_DONE) ? chunk->updateVersion : 0;
         chunk.release();
+        if (version != cache.chunkVersions[i]) return true;
     }
+    return false;
+}
 
-    // Helper macro for below code
-#define CHECK_CODE(dir) \
-    /* Acquire new chunk if needed */ \
-    if (id != currentID) { \
-        /* Release current chunk */ \
-        if (chunk.isAquired()) { \
-            chunk->dataMutex.unlock(); \
-            chunk.release(); \
-        } \
-        chunk = grid.accessor.acquire(id); \
-        if (chunk->genLevel != GEN_DONE) { \
-            chunk.release(); \
-            currentID = ChunkID(0xffffffffffffffffu); \
-        } else { \
-            chunk->dataMutex.lock(); \
-            currentID = id; \
-            /* Check the voxel */ \
-            if (chunk->genLevel == GEN_DONE && bp->operator[](chunk->blocks.get(index)).collide) { \
-                cd.##dir = true; \
-            } \
-        } \
-    } else {\
-        /* Check the voxel */ \
-        if (chunk->genLevel == GEN_DONE && bp->operator[](chunk->blocks.get(index)).collide) { \
-            cd.##dir = true; \
-        } \
-    }
+void AABBCollidableComponentUpdater::buildCache(VoxelCollisionCache& cache, ChunkGrid& grid, const BlockHotTable& blocks) {
+    cache.bits.assign((cache.dims.x * cache.dims.y * cache.dims.z + 63) / 64, 0);
+    cache.chunkIDs.clear();
+    cache.chunkVersions.clear();
 
-    // Set neighbor collide flags
-    // TODO(Ben): More than top
-    ChunkID currentID(0xffffffffffffffffu);
-    ChunkHandle chunk;
-    for (auto& it : cmp.voxelCollisions) {
-        for (auto& cd : it.second) {
-            { // Left
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if ((index & 0x1f) == 0) {
-                    index += CHUNK_WIDTH_M1;
-                    id.x--;
-                } else {
-                    index--;
-                }
-                CHECK_CODE(left);
-            }
-            { // Right
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if ((index & 0x1f) == CHUNK_WIDTH_M1) {
-                    index -= CHUNK_WIDTH_M1;
-                    id.x++;
-                } else {
-                    index++;
-                }
-                CHECK_CODE(right);
-            }
-            { // Bottom
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if (index < CHUNK_LAYER) {
-                    index += (CHUNK_SIZE - CHUNK_LAYER);
-                    id.y--;
-                } else {
-                    index -= CHUNK_LAYER;
-                }
-                CHECK_CODE(bottom);
-            }
-            { // Top
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if (index >= CHUNK_SIZE - CHUNK_LAYER) {
-                    index -= (CHUNK_SIZE - CHUNK_LAYER);
-                    id.y++;
-                } else {
-                    index += CHUNK_LAYER;
+    i32v3 end = cache.origin + cache.dims;
+    i32v3 minChunk = VoxelSpaceConversions::voxelToChunk(cache.origin);
+    i32v3 maxChunk = VoxelSpaceConversions::voxelToChunk(end - 1);
+    for (int cy = minChunk.y; cy <= maxChunk.y; cy++) {
+        for (int cz = minChunk.z; cz <= maxChunk.z; cz++) {
+            for (int cx = minChunk.x; cx <= maxChunk.x; cx++) {
+                i32v3 cpos(cx, cy, cz);
+                ChunkID id(cpos);
+                ChunkHandle chunk = grid.accessor.acquire(id);
+                cache.chunkIDs.push_back(id);
+                if (chunk->genLevel != GEN_DONE) {
+                    // Nothing to collide with until it's generated
+                    cache.chunkVersions.push_back(0);
+                    chunk.release();
+                    continue;
                 }
-                CHECK_CODE(top);
-            }
-            { // Back
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if ((index & 0x3ff) / CHUNK_WIDTH == 0) {
-                    index += (CHUNK_LAYER - CHUNK_WIDTH);
-                    id.z--;
-                } else {
-                    index -= CHUNK_WIDTH_M1;
+
+                // Part of the cache inside this chunk
+                i32v3 chunkStart = cpos * CHUNK_WIDTH;
+                i32v3 lo, hi;
+                for (int i = 0; i < 3; i++) {
+                    lo[i] = std::max(cache.origin[i], chunkStart[i]);
+                    hi[i] = std::min(end[i], chunkStart[i] + CHUNK_WIDTH);
                 }
-                CHECK_CODE(back);
-            }
-            { // Front
-                ChunkID id = it.first;
-                int index = (int)cd.index;
-                if ((index & 0x3ff) / CHUNK_WIDTH == CHUNK_WIDTH_M1) {
-                    index -= (CHUNK_LAYER - CHUNK_WIDTH);
-                    id.z++;
-                } else {
-                    index += CHUNK_WIDTH_M1;
+                {
+                    std::lock_guard<std::mutex> l(chunk->dataMutex);
+                    cache.chunkVersions.push_back(chunk->updateVersion);
+                    for (int y = lo.y; y < hi.y; y++) {
+                        for (int z = lo.z; z < hi.z; z++) {
+                            int blockRow = (y - chunkStart.y) * CHUNK_LAYER + (z - chunkStart.z) * CHUNK_WIDTH - chunkStart.x;
+                            ui32 bitRow = (ui32)(((y - cache.origin.y) * cache.dims.z + (z - cache.origin.z)) * cache.dims.x - cache.origin.x);
+                            for (int x = lo.x; x < hi.x; x++) {
+                                if (blocks.isCollidable(chunk->blocks.get(blockRow + x))) {
+                                    ui32 b = bitRow + x;
+                                    cache.bits[b >> 6] |= 1ull << (b & 63);
+                                }
+                            }
+                        }
+                    }
                 }
-                CHECK_CODE(front);
+                chunk.release();
             }
         }
     }
-    // Release chunk if needed
-    if (chunk.isAquired()) {
-        chunk->dataMutex.unlock();
-        chunk.release();
-    }
-#undef CHECK_CODE
 }
@@ -17,9 +17,12 @@
 
 #include <Vorb/ecs/Entity.h>
 
+class ChunkGrid;
 class GameSystem;
 class SpaceSystem;
 struct AabbCollidableComponent;
+class BlockHotTable;
+struct VoxelCollisionCache;
 
 class AABBCollidableComponentUpdater {
 public:
@@ -27,6 +30,10 @@ class AABBCollidableComponentUpdater {
 
 private:
     void collideWithVoxels(AabbCollidableComponent& cmp, GameSystem* gameSystem, SpaceSystem* spaceSystem);
+    /// @return true if a chunk the cache was read from has changed
+    bool isCacheStale(const VoxelCollisionCache& cache, ChunkGrid& grid);
+    /// Reads the collidable voxels in the cache's bounds
+    void buildCache(VoxelCollisionCache& cache, ChunkGrid& grid, const BlockHotTable& blocks);
 };
 
 #endif // AABBCollidableComponentUpdater_h__
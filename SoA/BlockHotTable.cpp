@@ -0,0 +1,30 @@
+#include "stdafx.h"
+#include "BlockHotTable.h"
+
+BlockHotTable::BlockHotTable() :
+    m_collide(NUM_BLOCK_IDS / 64, 0),
+    m_lightBlocking(NUM_BLOCK_IDS / 64, 0),
+    m_allowLight(NUM_BLOCK_IDS / 64, 0),
+    m_lightColors(NUM_BLOCK_IDS, 0),
+    m_meshTypes(NUM_BLOCK_IDS, (ui8)MeshType::NONE),
+    m_occlusion(NUM_BLOCK_IDS, (ui8)BlockOcclusion::NONE) {
+    // Empty
+}
+
+void BlockHotTable::set(BlockID id, const Block& block) {
+    setBit(m_collide, id, block.collide);
+    setBit(m_lightBlocking, id, block.blockLight);
+    setBit(m_allowLight, id, block.allowLight);
+    m_lightColors[id] = block.lightColorPacked;
+    m_meshTypes[id] = (ui8)block.meshType;
+    m_occlusion[id] = (ui8)block.occlude;
+}
+
+void BlockHotTable::setBit(std::vector<ui64>& bits, BlockID id, bool value) {
+    ui64 mask = (ui64)1 << (id & 63);
+    if (value) {
+        bits[id >> 6] |= mask;
+    } else {
+        bits[id >> 6] &= ~mask;
+    }
+}
@@ -0,0 +1,59 @@
+///
+/// BlockHotTable.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Structure of arrays copy of the Block properties that meshing, collision,
+/// lighting and ray picking look up per voxel, so those lookups don't pull whole
+/// Blocks into cache. Covers every BlockID, so lookups need no bounds check.
+///
+
+#pragma once
+
+#ifndef BlockHotTable_h__
+#define BlockHotTable_h__
+
+#include "BlockData.h"
+
+const size_t NUM_BLOCK_IDS = 1 << (sizeof(BlockID) * 8);
+
+class BlockHotTable {
+public:
+    BlockHotTable();
+
+    /// Copies the hot properties of block into row id
+    void set(BlockID id, const Block& block);
+
+    bool isCollidable(BlockID id) const { return getBit(m_collide, id); }
+    /// Scatters full strength sunlight, Block::blockLight
+    bool isLightBlocking(BlockID id) const { return getBit(m_lightBlocking, id); }
+    /// Lets light through, Block::allowLight
+    bool allowsLight(BlockID id) const { return getBit(m_allowLight, id); }
+    /// Packed color of the light the block emits, 0 if it emits none
+    ui16 getLightColor(BlockID id) const { return m_lightColors[id]; }
+    MeshType getMeshType(BlockID id) const { return (MeshType)m_meshTypes[id]; }
+    BlockOcclusion getOcclusion(BlockID id) const { return (BlockOcclusion)m_occlusion[id]; }
+    /// Whether id hides the faces of neighbor next to it
+    bool occludes(BlockID id, BlockID neighbor) const {
+        BlockOcclusion o = getOcclusion(id);
+        return o == BlockOcclusion::ALL || (o == BlockOcclusion::SELF && id == neighbor);
+    }
+private:
+    static bool getBit(const std::vector<ui64>& bits, BlockID id) {
+        return ((bits[id >> 6] >> (id & 63)) & 1) != 0;
+    }
+    static void setBit(std::vector<ui64>& bits, BlockID id, bool value);
+
+    std::vector<ui64> m_collide;
+    std::vector<ui64> m_lightBlocking;
+    std::vector<ui64> m_allowLight;
+    std::vector<ui16> m_lightColors;
+    std::vector<ui8> m_meshTypes;
+    std::vector<ui8> m_occlusion;
+};
+
+#endif // BlockHotTable_h__
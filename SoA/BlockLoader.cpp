@@ -12,31 +12,20 @@
 
 #define BLOCK_MAPPING_PATH "BlockMapping.ini"
 #define BLOCK_DATA_PATH "BlockData.yml"
-#define BINARY_CACHE_PATH "BlockCache.bin"
 
-bool BlockLoader::loadBlocks(const vio::IOManager& iom, BlockPack* pack) {
+bool BlockLoader::loadBlocks(const vio::IOManager& iom, BlockPack* pack,
+                             const ui8* binary /*= nullptr*/, size_t binarySize /*= 0*/) {
     // Load existing mapping if there is one
     tryLoadMapping(iom, BLOCK_MAPPING_PATH, pack);
 
-    // Check for binary cache
-    vio::Path binPath;
-    bool useCache = false;
-    if (iom.resolvePath(BINARY_CACHE_PATH, binPath)) {
-        vio::Path dataPath;
-        if (!iom.resolvePath(BLOCK_DATA_PATH, dataPath)) return false;
-        if (binPath.getLastModTime() >= dataPath.getLastModTime()) {
-            useCache = true;
-        }
-    }
-   
     // Clear CA physics cache
     CaPhysicsType::clearTypes();
 
     GameBlockPostProcess bpp(&iom, &CaPhysicsType::typesCache);
     pack->onBlockAddition += bpp.del;
-    if (useCache) {
-        if (!BlockLoader::loadBinary(iom, BINARY_CACHE_PATH, pack)) {
-            printf("Failed to load binary cache %s\n", BINARY_CACHE_PATH);
+    if (binary) {
+        if (!BlockLoader::loadBinary(binary, binarySize, pack)) {
+            printf("Failed to load cached block table, parsing %s\n", BLOCK_DATA_PATH);
             if (!BlockLoader::load(iom, BLOCK_DATA_PATH, pack)) {
                 pack->onBlockAddition -= bpp.del;
                 return false;
@@ -51,9 +40,6 @@ bool BlockLoader::loadBlocks(const vio::IOManager& iom, BlockPack* pack) {
     pack->onBlockAddition -= bpp.del;
 
     saveMapping(iom, BLOCK_MAPPING_PATH, pack);
-    if (!useCache) {
-   //     saveBinary(iom, BINARY_CACHE_PATH, pack);
-    }
 
     return true;
 }
@@ -270,68 +256,115 @@ bool BlockLoader::tryLoadMapping(const vio::IOManager& iom, const cString filePa
     return true;
 }
 
-bool BlockLoader::saveBinary(const vio::IOManager& iom, const cString filePath, BlockPack* pack) {
-    vio::FileStream fs = iom.openFile(filePath, vio::FileOpenFlags::WRITE_ONLY_CREATE | vio::FileOpenFlags::BINARY);
-    if (!fs.isOpened()) return false;
+template <typename T>
+void writeBin(std::vector<ui8>& data, const T& value) {
+    const ui8* bytes = (const ui8*)&value;
+    data.insert(data.end(), bytes, bytes + sizeof(T));
+}
 
-    ui32 size = pack->getBlockMap().size();
-    ui32 blockSize = sizeof(Block);
-    // Write sizes
-    fs.write(1, sizeof(ui32), &size);
-    fs.write(1, sizeof(ui32), &blockSize);
+void writeBinStr(std::vector<ui8>& data, const nString& str) {
+    writeBin(data, (ui32)str.size());
+    data.insert(data.end(), str.begin(), str.end());
+}
 
-    // TODO(Ben): This isn't complete.
-    const std::vector<Block>& blockList = pack->getBlockList();
-    for (auto& b : pack->getBlockMap()) {
-        const Block& block = blockList[b.second];
-        fs.write("%s", block.name.c_str()); fs.write(1, 1, "\0");
-        fs.write(1, sizeof(bool), &block.powderMove);
-        fs.write(1, sizeof(bool), &block.collide);
-        fs.write(1, sizeof(bool), &block.waterBreak);
-        fs.write(1, sizeof(bool), &block.blockLight);
-        fs.write(1, sizeof(bool), &block.useable);
-        fs.write(1, sizeof(bool), &block.allowLight);
-        fs.write(1, sizeof(bool), &block.isCrushable);
-        fs.write(1, sizeof(bool), &block.isSupportive);
+/// Bounds checked reads from a binary block table
+struct BinReader {
+    template <typename T>
+    bool read(T& value) {
+        if (size - pos < sizeof(T)) return false;
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
     }
-    return true;
-}
+    bool readStr(nString& str) {
+        ui32 length;
+        if (!read(length) || size - pos < length) return false;
+        str.assign((const char*)data + pos, length);
+        pos += length;
+        return true;
+    }
+
+    const ui8* data;
+    size_t size;
+    size_t pos;
+};
 
-void readStr(vio::FileStream& fs, char* buf) {
-    int i = 0;
-    do {
-        fs.read(1, sizeof(char), buf + i);
-    } while (buf[i++] != 0);
+void BlockLoader::saveBinary(const BlockPack* pack, std::vector<ui8>& data) {
+    // Only what the .yml sets. The rest comes from post processing and textures.
+    const std::vector<Block>& blockList = pack->getBlockList();
+    ui32 size = 0;
+    for (auto& b : blockList) {
+        if (b.active) size++;
+    }
+    writeBin(data, size);
+    // In ID order, so unmapped blocks get the same IDs again
+    for (auto& b : blockList) {
+        if (!b.active) continue;
+        writeBinStr(data, b.sID);
+        writeBinStr(data, b.name);
+        writeBinStr(data, b.burnTransformID);
+        writeBinStr(data, b.spawnerID);
+        writeBinStr(data, b.sinkID);
+        writeBinStr(data, b.caFilePath);
+        writeBinStr(data, b.emitterName);
+        writeBin(data, b.temp);
+        writeBin(data, b.waveEffect);
+        writeBin(data, b.waterMeshLevel);
+        writeBin(data, b.floatingAction);
+        writeBin(data, b.explosionRays);
+        writeBin(data, (ui32)b.occlude);
+        writeBin(data, (ui32)b.meshType);
+        writeBin(data, b.moveMod);
+        writeBin(data, b.explosionResistance);
+        writeBin(data, b.explosivePower);
+        writeBin(data, b.flammability);
+        writeBin(data, b.explosionPowerLoss);
+        writeBin(data, b.colorFilter.x);
+        writeBin(data, b.colorFilter.y);
+        writeBin(data, b.colorFilter.z);
+        writeBin(data, b.lightColor.r);
+        writeBin(data, b.lightColor.g);
+        writeBin(data, b.lightColor.b);
+        writeBin(data, b.powderMove);
+        writeBin(data, b.collide);
+        writeBin(data, b.waterBreak);
+        writeBin(data, b.blockLight);
+        writeBin(data, b.useable);
+        writeBin(data, b.allowLight);
+        writeBin(data, b.isCrushable);
+        writeBin(data, b.isSupportive);
+    }
 }
 
-bool BlockLoader::loadBinary(const vio::IOManager& iom, const cString filePath, BlockPack* pack) {
-    vio::FileStream fs = iom.openFile(filePath, vio::FileOpenFlags::READ_ONLY_EXISTING | vio::FileOpenFlags::BINARY);
-    if (!fs.isOpened()) return false;
+bool BlockLoader::loadBinary(const ui8* data, size_t dataSize, BlockPack* pack) {
+    BinReader r = { data, dataSize, 0 };
 
     ui32 size;
-    ui32 blockSize;
-    // Read sizes
-    fs.read(1, sizeof(ui32), &size);
-    fs.read(1, sizeof(ui32), &blockSize);
-    // Make sure block size didn't change. DEBUG MODE CHANGES THE SIZE!!!
-    //if (blockSize != sizeof(Block)) return false;
-
-    char buf[512];
-
-    // TODO(Ben): This isn't complete.
-    for (ui32 i = 0; i < size; i++) {
-        Block b;
-        readStr(fs, buf);
-        b.name = buf;
-        fs.read(1, sizeof(bool), &b.powderMove);
-        fs.read(1, sizeof(bool), &b.collide);
-        fs.read(1, sizeof(bool), &b.waterBreak);
-        fs.read(1, sizeof(bool), &b.blockLight);
-        fs.read(1, sizeof(bool), &b.useable);
-        fs.read(1, sizeof(bool), &b.allowLight);
-        fs.read(1, sizeof(bool), &b.isCrushable);
-        fs.read(1, sizeof(bool), &b.isSupportive);
+    if (!r.read(size)) return false;
+
+    // Read everything before adding any, so a bad table leaves the pack untouched
+    std::vector<Block> blocks(size);
+    for (auto& b : blocks) {
+        ui32 occlude, meshType;
+        bool ok = r.readStr(b.sID) && r.readStr(b.name) && r.readStr(b.burnTransformID) &&
+            r.readStr(b.spawnerID) && r.readStr(b.sinkID) && r.readStr(b.caFilePath) &&
+            r.readStr(b.emitterName) &&
+            r.read(b.temp) && r.read(b.waveEffect) && r.read(b.waterMeshLevel) &&
+            r.read(b.floatingAction) && r.read(b.explosionRays) && r.read(occlude) && r.read(meshType) &&
+            r.read(b.moveMod) && r.read(b.explosionResistance) && r.read(b.explosivePower) &&
+            r.read(b.flammability) && r.read(b.explosionPowerLoss) &&
+            r.read(b.colorFilter.x) && r.read(b.colorFilter.y) && r.read(b.colorFilter.z) &&
+            r.read(b.lightColor.r) && r.read(b.lightColor.g) && r.read(b.lightColor.b) &&
+            r.read(b.powderMove) && r.read(b.collide) && r.read(b.waterBreak) && r.read(b.blockLight) &&
+            r.read(b.useable) && r.read(b.allowLight) && r.read(b.isCrushable) && r.read(b.isSupportive);
+        if (!ok) return false;
+        b.occlude = (BlockOcclusion)occlude;
+        b.meshType = (MeshType)meshType;
+    }
+    if (r.pos != dataSize) return false;
+
+    for (auto& b : blocks) {
         pack->append(b);
     }
     return true;
-}
\ No newline at end of file
+}
@@ -26,9 +26,11 @@ class GameBlockPostProcess {
 class BlockLoader
 {
 public:
-    /// Loads blocks from a .yml file
+    /// Loads blocks from a .yml file, or from a block table written by saveBinary
+    /// @param binary: Cached block table, nullptr to parse the .yml
     /// @return true on success, false on failure
-    static bool loadBlocks(const vio::IOManager& iom, BlockPack* pack);
+    static bool loadBlocks(const vio::IOManager& iom, BlockPack* pack,
+                           const ui8* binary = nullptr, size_t binarySize = 0);
 
     /// Loads blocks from a .yml file
     /// @param iom: IO workspace
@@ -42,6 +44,9 @@ class BlockLoader
     /// @param pack: Source of block data
     /// @return true on success, false on failure
     static bool saveBlocks(const nString& filePath, BlockPack* pack);
+
+    /// Appends the loaded blocks to data as a binary block table
+    static void saveBinary(const BlockPack* pack, std::vector<ui8>& data);
 private:
     /// Sets up the water blocks. This is temporary
     /// @param blocks: Output list for blocks
@@ -53,10 +58,8 @@ class BlockLoader
     /// Tries to load an existing block mapping scheme
     static bool tryLoadMapping(const vio::IOManager& iom, const cString filePath, BlockPack* pack);
 
-    /// Caches blocks in binary
-    static bool saveBinary(const vio::IOManager& iom, const cString filePath, BlockPack* pack);
-
-    /// Tries to load an existing block mapping scheme
-    static bool loadBinary(const vio::IOManager& iom, const cString filePath, BlockPack* pack);
+    /// Adds the blocks of a table written by saveBinary
+    /// @return false if the table is corrupt, without adding any blocks
+    static bool loadBinary(const ui8* data, size_t dataSize, BlockPack* pack);
 };
 
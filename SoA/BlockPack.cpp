@@ -43,11 +43,19 @@ BlockID BlockPack::append(Block& block) {
         m_blockMap[block.sID] = rv;
     }
     onBlockAddition(block.ID);
+    // After the handlers, since post processing fills in fields like the packed light color
+    m_hotTable.set(rv, m_blockList[rv]);
     return rv;
 }
 
 void BlockPack::reserveID(const BlockIdentifier& sid, const BlockID& id) {
-    if (id >= m_blockList.size()) m_blockList.resize(id + 1);
+    if (id >= m_blockList.size()) {
+        size_t oldSize = m_blockList.size();
+        m_blockList.resize(id + 1);
+        for (size_t i = oldSize; i < m_blockList.size(); i++) {
+            m_hotTable.set((BlockID)i, m_blockList[i]);
+        }
+    }
     m_blockMap[sid] = id;
     m_blockList[id].ID = id;
 }
@@ -19,6 +19,7 @@
 #include <Vorb/graphics/Texture.h>
 
 #include "BlockData.h"
+#include "BlockHotTable.h"
 
 /// A container for blocks
 class BlockPack {
@@ -58,6 +59,7 @@ class BlockPack {
     /************************************************************************/
     /* Block accessors                                                      */
     /************************************************************************/
+    /// Hot properties changed through these aren't seen by getHotTable until the block is appended again
     Block& operator[](const size_t& index) {
         return m_blockList[index];
     }
@@ -76,11 +78,14 @@ class BlockPack {
 
     const std::unordered_map<BlockIdentifier, ui16>& getBlockMap() const { return m_blockMap; }
     const std::vector<Block>& getBlockList() const { return m_blockList; }
+    /// Compact copy of the properties looked up per voxel. The reference stays valid for the pack's lifetime.
+    const BlockHotTable& getHotTable() const { return m_hotTable; }
 
     Event<ui16> onBlockAddition; ///< Signaled when a block is loaded
 private:
     std::unordered_map<BlockIdentifier, ui16> m_blockMap; ///< Blocks indices organized by identifiers
     std::vector<Block> m_blockList; ///< Block data list
+    BlockHotTable m_hotTable;
 };
 
 #endif // BlockPack_h__
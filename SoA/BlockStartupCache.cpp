@@ -0,0 +1,268 @@
+#include "stdafx.h"
+#include "BlockStartupCache.h"
+
+#include "BlockLoader.h"
+#include "BlockPack.h"
+#include "BlockTextureLoader.h"
+#include "BlockTexturePack.h"
+#include "ModPathResolver.h"
+
+#define BLOCK_CACHE_MAGIC 0x43424F53 // "SOBC"
+// Bump when the layout of anything in the cache changes
+#define BLOCK_CACHE_VERSION 1
+#define BLOCK_DATA_PATH "BlockData.yml"
+// Pages start on this boundary in the file
+#define PAGE_ALIGNMENT 4096
+#define HASH_READ_SIZE 65536
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+namespace {
+    // FNV-1a, so the hash doesn't depend on the platform's std::hash
+    void hashBytes(ui64& hash, const void* data, size_t size) {
+        const ui8* bytes = (const ui8*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        }
+    }
+    template <typename T>
+    void hashValue(ui64& hash, const T& v) {
+        hashBytes(hash, &v, sizeof(T));
+    }
+    void hashString(ui64& hash, const nString& s) {
+        hashValue(hash, (ui32)s.size());
+        hashBytes(hash, s.c_str(), s.size());
+    }
+    /// Hashes where a file resolved to and what is in it
+    void hashFile(ui64& hash, const nString& path, bool isResolved, const vio::Path& absPath) {
+        hashString(hash, path);
+        if (!isResolved) {
+            hashValue(hash, (ui8)0);
+            return;
+        }
+        hashString(hash, absPath.getString());
+        std::ifstream file(absPath.getCString(), std::ios::binary);
+        std::vector<char> buffer(HASH_READ_SIZE);
+        while (file) {
+            file.read(buffer.data(), buffer.size());
+            hashBytes(hash, buffer.data(), (size_t)file.gcount());
+        }
+    }
+
+    template <typename T>
+    void writeValue(std::vector<ui8>& data, const T& value) {
+        const ui8* bytes = (const ui8*)&value;
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+    void writeString(std::vector<ui8>& data, const nString& s) {
+        writeValue(data, (ui32)s.size());
+        data.insert(data.end(), s.begin(), s.end());
+    }
+
+    /// Bounds checked reads from a cache section
+    struct SectionReader {
+        template <typename T>
+        bool read(T& value) {
+            if (size - pos < sizeof(T)) return false;
+            memcpy(&value, data + pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+        bool readString(nString& s) {
+            ui32 length;
+            if (!read(length) || size - pos < length) return false;
+            s.assign((const char*)data + pos, length);
+            pos += length;
+            return true;
+        }
+
+        const ui8* data;
+        size_t size;
+        size_t pos;
+    };
+
+    /// Bytes of one page and its mipmaps
+    ui64 getPageBytes(const BlockTexturePack* texturePack) {
+        return ((ui64)texturePack->getPageWidth() * texturePack->getPageWidth() + texturePack->getMipPixelCount()) * sizeof(color4);
+    }
+}
+
+BlockStartupCache::~BlockStartupCache() {
+    close();
+}
+
+ui64 BlockStartupCache::hashSources(const vio::IOManager& blockIom, const BlockTextureLoader& loader) {
+    ui64 hash = FNV_OFFSET_BASIS;
+    hashValue(hash, (ui32)BLOCK_CACHE_VERSION);
+    hashValue(hash, loader.getTexturePack()->getResolution());
+
+    vio::Path absPath;
+    bool isResolved = blockIom.resolvePath(BLOCK_DATA_PATH, absPath);
+    hashFile(hash, BLOCK_DATA_PATH, isResolved, absPath);
+
+    // The resolved paths say whether the mod or the default pack provides each file
+    std::vector<nString> paths;
+    loader.getSourcePaths(paths);
+    const ModPathResolver* resolver = loader.getTexturePathResolver();
+    for (auto& path : paths) {
+        isResolved = resolver->resolvePath(path, absPath);
+        hashFile(hash, path, isResolved, absPath);
+    }
+    return hash;
+}
+
+bool BlockStartupCache::open(const nString& filePath, ui64 sourceHash, const BlockTexturePack* texturePack) {
+    close();
+
+    m_file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart < sizeof(BlockStartupCacheHeader)) {
+        close();
+        return false;
+    }
+    m_size = (ui64)fileSize.QuadPart;
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping) m_view = (const ui8*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_view) {
+        close();
+        return false;
+    }
+
+    const BlockStartupCacheHeader* header = getHeader();
+    bool isValid = header->magic == BLOCK_CACHE_MAGIC &&
+        header->version == BLOCK_CACHE_VERSION &&
+        header->sourceHash == sourceHash &&
+        header->pageWidth == texturePack->getPageWidth() &&
+        header->mipLevels == texturePack->getMipLevels() &&
+        header->blocksOffset <= m_size && header->blocksSize <= m_size - header->blocksOffset &&
+        header->layersOffset <= m_size && header->layersSize <= m_size - header->layersOffset &&
+        header->pagesOffset <= m_size &&
+        header->numPages * getPageBytes(texturePack) <= m_size - header->pagesOffset;
+    if (!isValid) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool BlockStartupCache::restoreAtlas(BlockTexturePack* texturePack) {
+    const BlockStartupCacheHeader* header = getHeader();
+
+    // Read every layer before mapping any
+    std::vector<nString> paths(header->numLayers);
+    std::vector<BlockTextureLayer> layers(header->numLayers);
+    SectionReader r = { m_view + header->layersOffset, (size_t)header->layersSize, 0 };
+    for (ui32 i = 0; i < header->numLayers; i++) {
+        BlockTextureLayer& layer = layers[i];
+        ui32 method;
+        bool ok = r.readString(paths[i]) && r.read(method) && r.read(layer.size.x) && r.read(layer.size.y) &&
+            r.read(layer.numTiles) && r.read(layer.totalWeight) &&
+            r.read(layer.index) && r.read(layer.normalIndex) && r.read(layer.dispIndex);
+        if (!ok) return false;
+        layer.method = (ConnectedTextureMethods)method;
+    }
+    if (r.pos != r.size) return false;
+
+    for (ui32 i = 0; i < header->numLayers; i++) {
+        if (!texturePack->restoreLayer(paths[i], layers[i])) {
+            printf("Block startup cache doesn't match the atlas, rebuilding it\n");
+            texturePack->resetAtlas();
+            return false;
+        }
+    }
+
+    ui64 pageBytes = getPageBytes(texturePack);
+    size_t pagePixels = texturePack->getPageWidth() * texturePack->getPageWidth();
+    for (ui32 i = 0; i < header->numPages; i++) {
+        const color4* pixels = (const color4*)(m_view + header->pagesOffset + i * pageBytes);
+        texturePack->restorePage(i, pixels, pixels + pagePixels);
+    }
+    return true;
+}
+
+void BlockStartupCache::close() {
+    if (m_view) {
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
+
+bool BlockStartupCache::save(const nString& filePath, ui64 sourceHash, const BlockPack* blocks, BlockTexturePack* texturePack) {
+    texturePack->generateMipmaps();
+
+    std::vector<ui8> blockData;
+    BlockLoader::saveBinary(blocks, blockData);
+
+    std::vector<ui8> layerData;
+    const std::vector<nString>& layerOrder = texturePack->getLayerOrder();
+    for (auto& path : layerOrder) {
+        AtlasTextureDescription desc = texturePack->findLayer(path);
+        const BlockTextureLayer& layer = desc.temp;
+        writeString(layerData, path);
+        writeValue(layerData, (ui32)layer.method);
+        writeValue(layerData, layer.size.x);
+        writeValue(layerData, layer.size.y);
+        writeValue(layerData, layer.numTiles);
+        writeValue(layerData, layer.totalWeight);
+        // The index this path was mapped to, which is a normal or disp map's own
+        writeValue(layerData, desc.index);
+        writeValue(layerData, layer.normalIndex);
+        writeValue(layerData, layer.dispIndex);
+    }
+
+    BlockStartupCacheHeader header = {};
+    header.magic = BLOCK_CACHE_MAGIC;
+    header.version = BLOCK_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.blocksOffset = sizeof(BlockStartupCacheHeader);
+    header.blocksSize = blockData.size();
+    header.layersOffset = header.blocksOffset + header.blocksSize;
+    header.layersSize = layerData.size();
+    header.pagesOffset = (header.layersOffset + header.layersSize + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT;
+    header.numPages = texturePack->getNumPages();
+    header.pageWidth = texturePack->getPageWidth();
+    header.mipLevels = texturePack->getMipLevels();
+    header.numLayers = layerOrder.size();
+
+    // Write next to it and swap it in, so nobody maps a half written cache
+    nString tmpPath = filePath + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (file.fail()) return false;
+        file.write((const char*)&header, sizeof(header));
+        if (blockData.size()) file.write((const char*)blockData.data(), blockData.size());
+        if (layerData.size()) file.write((const char*)layerData.data(), layerData.size());
+        std::vector<char> padding((size_t)(header.pagesOffset - header.layersOffset - header.layersSize), 0);
+        if (padding.size()) file.write(padding.data(), padding.size());
+        size_t pagePixels = header.pageWidth * header.pageWidth;
+        for (ui32 i = 0; i < header.numPages; i++) {
+            file.write((const char*)texturePack->getPagePixels(i), pagePixels * sizeof(color4));
+            file.write((const char*)texturePack->getPageMips(i), texturePack->getMipPixelCount() * sizeof(color4));
+        }
+        file.flush();
+        if (file.fail()) {
+            file.close();
+            DeleteFileA(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (!MoveFileExA(tmpPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        // Another process has the old one mapped. It gets replaced next time.
+        DeleteFileA(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
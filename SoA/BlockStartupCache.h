@@ -0,0 +1,80 @@
+///
+/// BlockStartupCache.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Single file cache of the loaded block table, the atlas layer mapping
+/// and the stitched atlas pages with their mipmaps. It is mapped into
+/// memory on startup, and only used while the hashes of the block data,
+/// the texture pack files and the active mod paths still match.
+///
+
+#pragma once
+
+#ifndef BlockStartupCache_h__
+#define BlockStartupCache_h__
+
+#include <Windows.h>
+#include <Vorb/io/IOManager.h>
+
+class BlockPack;
+class BlockTextureLoader;
+class BlockTexturePack;
+
+#define BLOCK_STARTUP_CACHE_PATH "Data/Blocks/StartupCache.bin"
+
+/// Start of the cache file. Sections are byte offsets from the start of the file.
+struct BlockStartupCacheHeader {
+    ui32 magic;
+    ui32 version;
+    ui64 sourceHash;
+    ui64 blocksOffset;
+    ui64 blocksSize;
+    ui64 layersOffset;
+    ui64 layersSize;
+    ui64 pagesOffset; ///< Each page is level 0 followed by its mipmaps
+    ui32 numPages;
+    ui32 pageWidth;
+    ui32 mipLevels;
+    ui32 numLayers;
+};
+
+class BlockStartupCache {
+public:
+    ~BlockStartupCache();
+
+    /// Hashes every file the blocks and their textures are loaded from, and where
+    /// they resolved to, so switching texture packs or mods misses the cache.
+    /// Call after BlockTextureLoader::loadTextureData.
+    /// @param blockIom: IO workspace of the block data
+    static ui64 hashSources(const vio::IOManager& blockIom, const BlockTextureLoader& loader);
+
+    /// Maps the cache file
+    /// @return false if there is no cache for sourceHash
+    bool open(const nString& filePath, ui64 sourceHash, const BlockTexturePack* texturePack);
+    /// Fills the atlas from the open cache. BlockTextureLoader::loadBlockTextures
+    /// then only finds cached layers and decodes nothing.
+    /// @return false if the atlas couldn't be restored, which leaves it empty
+    bool restoreAtlas(BlockTexturePack* texturePack);
+    /// Block table for BlockLoader::loadBlocks, valid until close
+    const ui8* getBlockData() const { return m_view + getHeader()->blocksOffset; }
+    size_t getBlockDataSize() const { return (size_t)getHeader()->blocksSize; }
+    /// Unmaps the cache file
+    void close();
+
+    /// Writes the loaded blocks and atlas. Generates missing mipmaps.
+    static bool save(const nString& filePath, ui64 sourceHash, const BlockPack* blocks, BlockTexturePack* texturePack);
+private:
+    const BlockStartupCacheHeader* getHeader() const { return (const BlockStartupCacheHeader*)m_view; }
+
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    const ui8* m_view = nullptr;
+    ui64 m_size = 0;
+};
+
+#endif // BlockStartupCache_h__
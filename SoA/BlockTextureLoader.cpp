@@ -1,10 +1,14 @@
 #include "stdafx.h"
 #include "BlockTextureLoader.h"
 #include "ModPathResolver.h"
+#include "BlockPack.h"
 #include "BlockTexturePack.h"
 #include "BlockData.h"
 #include "Errors.h"
 
+#include <atomic>
+#include <set>
+#include <thread>
 #include <Vorb/graphics/ImageIO.h>
 
 // Used for error checking
@@ -14,6 +18,8 @@
 #define GRASS_HEIGHT 3
 #define HORIZONTAL_WIDTH 4
 #define HORIZONTAL_HEIGHT 1
+// Most threads decoding images at once, the load task's included
+#define MAX_DECODE_THREADS 8
 
 void BlockTextureLoader::init(ModPathResolver* texturePathResolver, BlockTexturePack* texturePack) {
     m_texturePathResolver = texturePathResolver;
@@ -26,6 +32,79 @@ void BlockTextureLoader::loadTextureData() {
     if (!loadBlockTextureMapping()) pError("Failed to load BlockTextureMapping.yml");
 }
 
+void BlockTextureLoader::preloadImages(const BlockPack& blocks) {
+    // Images loadBlockTextures will decode, in the order it needs them
+    std::vector<nString> paths;
+    std::set<nString> found;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const Block& block = blocks[i];
+        if (!block.active) continue;
+        auto& it = m_blockMappings.find(block.sID);
+        if (it == m_blockMappings.end()) continue;
+        for (int f = 0; f < 6; f++) {
+            BlockTexture* texture = m_texturePack->findTexture(it->second.names[f]);
+            if (!texture) break;
+            for (int l = 0; l < 2; l++) {
+                const BlockTextureLayer& layer = texture->layers[l];
+                const nString* layerPaths[3] = { &layer.path, &layer.normalPath, &layer.dispPath };
+                for (int p = 0; p < 3; p++) {
+                    const nString& path = *layerPaths[p];
+                    if (path.empty() || m_texturePack->findLayer(path).size.x != 0) continue;
+                    if (found.insert(path).second) paths.push_back(path);
+                }
+            }
+        }
+    }
+    if (paths.empty()) return;
+
+    // Decoding is independent per image. Stitching stays in order on this thread.
+    std::vector<vg::BitmapResource> bitmaps(paths.size());
+    std::atomic<size_t> nextPath(0);
+    auto decode = [&]() {
+        vg::ImageIO imageIO;
+        vio::Path path;
+        size_t i;
+        while ((i = nextPath++) < paths.size()) {
+            if (m_texturePathResolver->resolvePath(paths[i], path)) {
+                bitmaps[i] = imageIO.load(path, vg::ImageIOFormat::RGBA_UI8);
+            }
+        }
+    };
+    size_t numThreads = std::min((size_t)std::max(std::thread::hardware_concurrency(), 1u), (size_t)MAX_DECODE_THREADS);
+    numThreads = std::min(numThreads, paths.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; i++) {
+        threads.emplace_back(decode);
+    }
+    decode();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (bitmaps[i].data) m_preloadedImages[paths[i]] = bitmaps[i];
+    }
+}
+
+void BlockTextureLoader::clearPreloadedImages() {
+    for (auto& it : m_preloadedImages) {
+        vg::ImageIO::free(it.second);
+    }
+    m_preloadedImages.clear();
+}
+
+void BlockTextureLoader::getSourcePaths(std::vector<nString>& paths) const {
+    paths.push_back("LayerProperties.yml");
+    paths.push_back("Textures.yml");
+    paths.push_back("BlockTextureMapping.yml");
+    for (auto& it : m_layers) {
+        const BlockTextureLayer& layer = it.second;
+        if (layer.path.size()) paths.push_back(layer.path);
+        if (layer.normalPath.size()) paths.push_back(layer.normalPath);
+        if (layer.dispPath.size()) paths.push_back(layer.dispPath);
+    }
+}
+
 void BlockTextureLoader::loadBlockTextures(Block& block) {
     // Check for block mapping
     auto& it = m_blockMappings.find(block.sID);
@@ -367,11 +446,17 @@ bool BlockTextureLoader::loadLayer(BlockTextureLayer& layer) {
         // TODO(Ben): Worry about different methods using same file?
         layer.size = desc.size;
         layer.index = desc.index;
+        // What postProcessLayer and the maps would have set
+        layer.numTiles = desc.temp.numTiles;
+        layer.totalWeight = desc.temp.totalWeight;
+        layer.normalIndex = desc.temp.normalIndex;
+        layer.dispIndex = desc.temp.dispIndex;
+        layer.initBlockTextureFunc();
     } else {
         vio::Path path;
         if (!m_texturePathResolver->resolvePath(layer.path, path)) return nullptr;
         { // Get pixels for the base texture
-            vg::ScopedBitmapResource rs = vg::ImageIO().load(path, vg::ImageIOFormat::RGBA_UI8);
+            vg::ScopedBitmapResource rs = loadImage(layer.path, path);
             // Do post processing on the layer
             if (!postProcessLayer(rs, layer)) return false;
         
@@ -379,7 +464,7 @@ bool BlockTextureLoader::loadLayer(BlockTextureLayer& layer) {
         }
         // Normal map
         if (layer.normalPath.size() && m_texturePathResolver->resolvePath(layer.normalPath, path)) {
-            vg::ScopedBitmapResource rs = vg::ImageIO().load(path, vg::ImageIOFormat::RGBA_UI8);
+            vg::ScopedBitmapResource rs = loadImage(layer.normalPath, path);
             // Do post processing on the layer
             if (rs.data) {
                 layer.normalIndex = m_texturePack->addLayer(layer, layer.normalPath, (color4*)rs.bytesUI8v4);
@@ -387,16 +472,27 @@ bool BlockTextureLoader::loadLayer(BlockTextureLayer& layer) {
         }
         // disp map
         if (layer.dispPath.size() && m_texturePathResolver->resolvePath(layer.dispPath, path)) {
-            vg::ScopedBitmapResource rs = vg::ImageIO().load(path, vg::ImageIOFormat::RGBA_UI8);
+            vg::ScopedBitmapResource rs = loadImage(layer.dispPath, path);
             // Do post processing on the layer
             if (rs.data) {
                 layer.dispIndex = m_texturePack->addLayer(layer, layer.dispPath, (color4*)rs.bytesUI8v4);
             }
         }
+        m_texturePack->updateLayer(layer);
     }
     return true;
 }
 
+vg::BitmapResource BlockTextureLoader::loadImage(const nString& filePath, const vio::Path& path) {
+    auto& it = m_preloadedImages.find(filePath);
+    if (it != m_preloadedImages.end()) {
+        vg::BitmapResource rs = it->second;
+        m_preloadedImages.erase(it);
+        return rs;
+    }
+    return vg::ImageIO().load(path, vg::ImageIOFormat::RGBA_UI8);
+}
+
 bool BlockTextureLoader::postProcessLayer(vg::ScopedBitmapResource& bitmap, BlockTextureLayer& layer) {
 
     ui32 floraRows;
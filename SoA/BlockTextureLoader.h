@@ -15,6 +15,7 @@
 #ifndef BlockTextureLoader_h__
 #define BlockTextureLoader_h__
 
+#include <Vorb/graphics/ImageIO.h>
 #include <Vorb/io/IOManager.h>
 #include <Vorb/VorbPreDecl.inl>
 
@@ -23,6 +24,7 @@
 DECL_VG(class ScopedBitmapResource)
 
 class Block;
+class BlockPack;
 class BlockTexturePack;
 class ModPathResolver;
 class BlockTextureLayer;
@@ -38,20 +40,33 @@ class BlockTextureLoader {
 
     void loadTextureData();
 
+    /// Decodes the images that loadBlockTextures will need on several threads.
+    /// Call after the blocks are loaded.
+    void preloadImages(const BlockPack& blocks);
+    /// Frees preloaded images that weren't used
+    void clearPreloadedImages();
+
     void loadBlockTextures(Block& block);
 
     void dispose();
 
+    /// Gets the texture pack files that loaded textures come from. Call after loadTextureData.
+    void getSourcePaths(std::vector<nString>& paths) const;
+
     BlockTexturePack* getTexturePack() const { return m_texturePack; }
+    ModPathResolver* getTexturePathResolver() const { return m_texturePathResolver; }
 private:
     bool loadLayerProperties();
     bool loadTextureProperties();
     bool loadBlockTextureMapping();
     bool loadLayer(BlockTextureLayer& layer);
     bool postProcessLayer(vg::ScopedBitmapResource& bitmap, BlockTextureLayer& layer);
+    /// Takes a preloaded image, or decodes it now
+    vg::BitmapResource loadImage(const nString& filePath, const vio::Path& path);
 
     std::map<nString, BlockTextureLayer> m_layers;
     std::map<BlockIdentifier, BlockTextureNames> m_blockMappings;
+    std::map<nString, vg::BitmapResource> m_preloadedImages; ///< Decoded by preloadImages, keyed by layer path
 
     ModPathResolver* m_texturePathResolver = nullptr;
     BlockTexturePack* m_texturePack = nullptr;
@@ -47,47 +47,7 @@ void BlockTexturePack::init(ui32 resolution, ui32 maxTextures) {
 
 // TODO(Ben): Lock?
 BlockTextureIndex BlockTexturePack::addLayer(const BlockTextureLayer& layer, const nString& path, color4* pixels) {
-    BlockTextureIndex rv = 0;
-    // Map the texture
-    int firstPageIndex;
-    int lastPageIndex;
-    switch (layer.method) {
-        case ConnectedTextureMethods::CONNECTED:
-            rv = m_stitcher.mapContiguous(CONNECTED_TILES);
-            lastPageIndex = (rv + CONNECTED_TILES) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::RANDOM:
-            rv = m_stitcher.mapContiguous(layer.numTiles);
-            lastPageIndex = (rv + layer.numTiles) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::REPEAT:
-            rv = m_stitcher.mapBox(layer.size.x, layer.size.y);
-            lastPageIndex = (rv + (layer.size.y - 1) * m_stitcher.getTilesPerRow() + (layer.size.x - 1)) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::GRASS:
-            rv = m_stitcher.mapContiguous(GRASS_TILES);
-            lastPageIndex = (rv + GRASS_TILES) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::HORIZONTAL:
-            rv = m_stitcher.mapContiguous(HORIZONTAL_TILES);
-            lastPageIndex = (rv + HORIZONTAL_TILES) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::VERTICAL:
-            rv = m_stitcher.mapContiguous(VERTICAL_TILES);
-            lastPageIndex = (rv + VERTICAL_TILES) / m_stitcher.getTilesPerPage();
-            break;
-        case ConnectedTextureMethods::FLORA:
-            rv = m_stitcher.mapContiguous(layer.numTiles);
-            lastPageIndex = (rv + layer.numTiles) / m_stitcher.getTilesPerPage();
-            break;
-        default:
-            rv = m_stitcher.mapSingle();
-            lastPageIndex = (rv + 1) / m_stitcher.getTilesPerPage();
-            break;
-    }
-    firstPageIndex = rv / m_stitcher.getTilesPerPage();
-    flagDirtyPage(firstPageIndex);
-    if (lastPageIndex != firstPageIndex) flagDirtyPage(lastPageIndex);
+    BlockTextureIndex rv = mapLayer(layer);
 
     // Copy data
     switch (layer.method) {
@@ -123,9 +83,90 @@ BlockTextureIndex BlockTexturePack::addLayer(const BlockTextureLayer& layer, con
     tex.size = layer.size;
     tex.temp = layer;
     m_descLookup[path] = tex;
+    m_layerOrder.push_back(path);
     return rv;
 }
 
+void BlockTexturePack::updateLayer(const BlockTextureLayer& layer) {
+    auto& it = m_descLookup.find(layer.path);
+    if (it != m_descLookup.end()) it->second.temp = layer;
+}
+
+bool BlockTexturePack::restoreLayer(const nString& path, const BlockTextureLayer& layer) {
+    // Same mapping calls in the same order land on the same tiles
+    if (mapLayer(layer) != layer.index) return false;
+    AtlasTextureDescription tex;
+    tex.index = layer.index;
+    tex.size = layer.size;
+    tex.temp = layer;
+    m_descLookup[path] = tex;
+    m_layerOrder.push_back(path);
+    return true;
+}
+
+void BlockTexturePack::restorePage(ui32 pageIndex, const color4* pixels, const color4* mips) {
+    flagDirtyPage(pageIndex);
+    AtlasPage& page = m_pages[pageIndex];
+    memcpy(page.pixels, pixels, m_pageWidthPixels * m_pageWidthPixels * sizeof(color4));
+    page.mips = new color4[getMipPixelCount()];
+    memcpy(page.mips, mips, getMipPixelCount() * sizeof(color4));
+}
+
+void BlockTexturePack::resetAtlas() {
+    for (auto& p : m_pages) {
+        delete[] p.pixels;
+        delete[] p.mips;
+    }
+    std::vector<AtlasPage>().swap(m_pages);
+    std::vector<int>().swap(m_dirtyPages);
+    m_stitcher.dispose();
+    m_descLookup.clear();
+    m_layerOrder.clear();
+    flagDirtyPage(0);
+}
+
+void BlockTexturePack::generateMipmaps() {
+    for (auto& page : m_pages) {
+        if (page.mips) continue;
+        page.mips = new color4[getMipPixelCount()];
+        // Box filter each level from the one above it
+        const color4* src = page.pixels;
+        color4* dst = page.mips;
+        ui32 width = m_pageWidthPixels;
+        for (ui32 i = 1; i < m_mipLevels; i++) {
+            ui32 srcWidth = width;
+            width >>= 1;
+            for (ui32 y = 0; y < width; y++) {
+                const color4* row0 = src + (y * 2) * srcWidth;
+                const color4* row1 = row0 + srcWidth;
+                for (ui32 x = 0; x < width; x++) {
+                    const color4& p0 = row0[x * 2];
+                    const color4& p1 = row0[x * 2 + 1];
+                    const color4& p2 = row1[x * 2];
+                    const color4& p3 = row1[x * 2 + 1];
+                    color4& d = dst[y * width + x];
+                    d.r = (ui8)((p0.r + p1.r + p2.r + p3.r + 2) >> 2);
+                    d.g = (ui8)((p0.g + p1.g + p2.g + p3.g + 2) >> 2);
+                    d.b = (ui8)((p0.b + p1.b + p2.b + p3.b + 2) >> 2);
+                    d.a = (ui8)((p0.a + p1.a + p2.a + p3.a + 2) >> 2);
+                }
+            }
+            src = dst;
+            dst += width * width;
+        }
+    }
+}
+
+size_t BlockTexturePack::getMipPixelCount() const {
+    size_t count = 0;
+    ui32 width = m_pageWidthPixels;
+    for (ui32 i = 1; i < m_mipLevels; i++) {
+        width >>= 1;
+        count += width * width;
+    }
+    return count;
+}
+
 AtlasTextureDescription BlockTexturePack::findLayer(const nString& filePath) {
     auto& it = m_descLookup.find(filePath);
     if (it != m_descLookup.end()) {
@@ -183,27 +224,25 @@ void BlockTexturePack::update() {
     if (m_needsRealloc) {
         allocatePages();
         m_needsRealloc = false;
-        needsMipmapGen = true;
         // Upload all pages
         glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture);
         for (size_t i = 0; i < m_pages.size(); i++) {
-            uploadPage(i);
+            if (!uploadPage(i)) needsMipmapGen = true;
         }
         std::vector<int>().swap(m_dirtyPages);
     } else if (m_dirtyPages.size()) {
-        needsMipmapGen = true;
         // Upload dirty pages
         glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture);
         for (auto& i : m_dirtyPages) {
-            uploadPage(i);
+            if (!uploadPage(i)) needsMipmapGen = true;
         }
         std::vector<int>().swap(m_dirtyPages);
     }
 
     if (needsMipmapGen) {
         glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
     }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
 void BlockTexturePack::writeDebugAtlases() {
@@ -229,9 +268,12 @@ void BlockTexturePack::dispose() {
     m_atlasTexture = 0;
     for (auto& p : m_pages) {
         delete[] p.pixels;
+        delete[] p.mips;
     }
     std::vector<AtlasPage>().swap(m_pages);
     m_stitcher.dispose();
+    m_descLookup.clear();
+    m_layerOrder.clear();
     std::map<nString, ui32>().swap(m_textureLookup);
     m_nextFree = 0;
     delete[] m_textures;
@@ -260,7 +302,11 @@ void BlockTexturePack::flagDirtyPage(ui32 pageIndex) {
         }
         m_needsRealloc = true;    
     }
-    m_pages[pageIndex].dirty = true;
+    AtlasPage& page = m_pages[pageIndex];
+    page.dirty = true;
+    // Changed pixels make the mipmaps stale
+    delete[] page.mips;
+    page.mips = nullptr;
 }
 
 void BlockTexturePack::allocatePages() {
@@ -277,8 +323,9 @@ void BlockTexturePack::allocatePages() {
     }
 
     // Set up tex parameters
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int)m_mipLevels);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LOD, (int)m_mipLevels);
+    // Only the allocated levels, so uploaded mipmaps make the texture complete
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int)m_mipLevels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LOD, (int)m_mipLevels - 1);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
     
@@ -301,8 +348,63 @@ void BlockTexturePack::allocatePages() {
     checkGlError("BlockTexturePack::allocatePages");
 }
 
-void BlockTexturePack::uploadPage(ui32 pageIndex) {
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, pageIndex, m_pageWidthPixels, m_pageWidthPixels, 1, GL_RGBA, GL_UNSIGNED_BYTE, m_pages[pageIndex].pixels);
+bool BlockTexturePack::uploadPage(ui32 pageIndex) {
+    const AtlasPage& page = m_pages[pageIndex];
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, pageIndex, m_pageWidthPixels, m_pageWidthPixels, 1, GL_RGBA, GL_UNSIGNED_BYTE, page.pixels);
+    if (!page.mips) return false;
+    const color4* mip = page.mips;
+    ui32 width = m_pageWidthPixels;
+    for (ui32 i = 1; i < m_mipLevels; i++) {
+        width >>= 1;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, pageIndex, width, width, 1, GL_RGBA, GL_UNSIGNED_BYTE, mip);
+        mip += width * width;
+    }
+    return true;
+}
+
+BlockTextureIndex BlockTexturePack::mapLayer(const BlockTextureLayer& layer) {
+    BlockTextureIndex rv = 0;
+    // Map the texture
+    int firstPageIndex;
+    int lastPageIndex;
+    switch (layer.method) {
+        case ConnectedTextureMethods::CONNECTED:
+            rv = m_stitcher.mapContiguous(CONNECTED_TILES);
+            lastPageIndex = (rv + CONNECTED_TILES) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::RANDOM:
+            rv = m_stitcher.mapContiguous(layer.numTiles);
+            lastPageIndex = (rv + layer.numTiles) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::REPEAT:
+            rv = m_stitcher.mapBox(layer.size.x, layer.size.y);
+            lastPageIndex = (rv + (layer.size.y - 1) * m_stitcher.getTilesPerRow() + (layer.size.x - 1)) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::GRASS:
+            rv = m_stitcher.mapContiguous(GRASS_TILES);
+            lastPageIndex = (rv + GRASS_TILES) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::HORIZONTAL:
+            rv = m_stitcher.mapContiguous(HORIZONTAL_TILES);
+            lastPageIndex = (rv + HORIZONTAL_TILES) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::VERTICAL:
+            rv = m_stitcher.mapContiguous(VERTICAL_TILES);
+            lastPageIndex = (rv + VERTICAL_TILES) / m_stitcher.getTilesPerPage();
+            break;
+        case ConnectedTextureMethods::FLORA:
+            rv = m_stitcher.mapContiguous(layer.numTiles);
+            lastPageIndex = (rv + layer.numTiles) / m_stitcher.getTilesPerPage();
+            break;
+        default:
+            rv = m_stitcher.mapSingle();
+            lastPageIndex = (rv + 1) / m_stitcher.getTilesPerPage();
+            break;
+    }
+    firstPageIndex = rv / m_stitcher.getTilesPerPage();
+    flagDirtyPage(firstPageIndex);
+    if (lastPageIndex != firstPageIndex) flagDirtyPage(lastPageIndex);
+    return rv;
 }
 
 void BlockTexturePack::writeToAtlas(BlockTextureIndex texIndex, color4* pixels, ui32 pixelWidth, ui32 pixelHeight, ui32 tileWidth) {
@@ -50,6 +50,19 @@ class BlockTexturePack {
     BlockTextureIndex addLayer(const BlockTextureLayer& layer, const nString& path, color4* pixels);
     // Tries to find the texture index. Returns empty description on fail.
     AtlasTextureDescription findLayer(const nString& filePath);
+    // Stores the layer's final state, once its normal and disp maps are added
+    void updateLayer(const BlockTextureLayer& layer);
+
+    // Maps a layer from a startup cache without writing pixels. Layers must be
+    // restored in the order they were added.
+    // Returns false if the layer doesn't land on its cached index.
+    bool restoreLayer(const nString& path, const BlockTextureLayer& layer);
+    // Copies a cached page and its mipmaps
+    void restorePage(ui32 pageIndex, const color4* pixels, const color4* mips);
+    // Drops every layer and page, but keeps the block textures
+    void resetAtlas();
+    // Builds mipmaps on the CPU for pages that don't have them
+    void generateMipmaps();
 
     BlockTexture* findTexture(const nString& filePath);
     // Returns a pointer to the next free block texture and increments internal counter.
@@ -73,6 +86,16 @@ class BlockTexturePack {
 
     const VGTexture& getAtlasTexture() const { return m_atlasTexture; }
     const ui32& getResolution() const { return m_resolution; }
+    ui32 getPageWidth() const { return m_pageWidthPixels; }
+    ui32 getMipLevels() const { return m_mipLevels; }
+    ui32 getNumPages() const { return m_pages.size(); }
+    const color4* getPagePixels(ui32 pageIndex) const { return m_pages[pageIndex].pixels; }
+    // Levels 1 and up back to back, or nullptr before generateMipmaps
+    const color4* getPageMips(ui32 pageIndex) const { return m_pages[pageIndex].mips; }
+    // Pixels in levels 1 and up of one page
+    size_t getMipPixelCount() const;
+    // Paths of the layers in the order they were added
+    const std::vector<nString>& getLayerOrder() const { return m_layerOrder; }
 private:
     VORB_NON_COPYABLE(BlockTexturePack);
 
@@ -80,7 +103,10 @@ class BlockTexturePack {
 
     void allocatePages();
 
-    void uploadPage(ui32 pageIndex);
+    // Returns false if the page has no mipmaps to upload
+    bool uploadPage(ui32 pageIndex);
+
+    BlockTextureIndex mapLayer(const BlockTextureLayer& layer);
 
     void writeToAtlas(BlockTextureIndex texIndex, color4* pixels, ui32 pixelWidth, ui32 pixelHeight, ui32 tileWidth);
 
@@ -93,6 +119,7 @@ class BlockTexturePack {
 
     struct AtlasPage {
         color4* pixels = nullptr;
+        color4* mips = nullptr; ///< Levels 1 and up, nullptr when stale
         bool dirty = true;
     };
 
@@ -102,6 +129,7 @@ class BlockTexturePack {
     std::vector<AtlasPage> m_pages; ///< Cached pixel data
     std::vector<int> m_dirtyPages; ///< List of dirty pages TODO(Ben): Maybe bad for multithreading
     std::unordered_map<nString, AtlasTextureDescription> m_descLookup;
+    std::vector<nString> m_layerOrder;
     ui32 m_resolution = 0;
     ui32 m_pageWidthPixels = 0;
     ui32 m_mipLevels = 0;
@@ -8,14 +8,13 @@
 
 DECL_VIO(class IOManager)
 
-class ChunkManager;
+class Block;
+class BlockPack;
 class Chunk;
-class PhysicsEngine;
+struct CAChunkJob;
 
 /// Resolution of CA updates in frames
 #define CA_TICK_RES 4
-/// Should be half of CA_TICK_RES
-#define HALF_CA_TICK_RES 2
 
 class CaPhysicsData {
 public:
@@ -31,9 +30,12 @@ typedef std::vector<CaPhysicsType*> CaPhysicsTypeList;
 class CaPhysicsType {
 public:
 
-    /// Updates the type.
-    /// @return true if it this physics type should simulate
-    bool update();
+    /// @param tick: Ticks of the CAScheduler
+    /// @return true if this physics type should simulate this tick
+    bool isDue(ui32 tick) const {
+        ui32 period = (_data.updateRate ? _data.updateRate : 1) * CA_TICK_RES;
+        return tick % period == 0;
+    }
 
     /// Loads the data from a yml file
     /// @param filePath: path of the yml file
@@ -45,7 +47,6 @@ class CaPhysicsType {
     const int& getCaIndex() const { return _caIndex; }
     const ui32& getUpdateRate() const { return _data.updateRate; }
     const CAAlgorithm& getCaAlg() const { return _data.alg; }
-    const bool& getIsEven() const { return _isEven; }
 
     // Static functions
     /// Gets the number of CA types currently cached
@@ -59,31 +60,52 @@ class CaPhysicsType {
 
     CaPhysicsData _data; ///< The algorithm specific data
     int _caIndex; ///< index into typesArray
-    bool _isEven = false;  ///< Used for optimization, only update odd or even chunks at any time
-
-    ui32 _ticks = 0; ///< Counts the ticks
 };
 
+/// Steps the active cells of one chunk. Only one dataMutex is held at a
+/// time, and cells only reach one voxel into the face neighbors.
 class CAEngine {
 public:
-    CAEngine(ChunkManager* chunkManager, PhysicsEngine* physicsEngine);
-    void setChunk(Chunk* chunk) { _chunk = chunk; }
-    void updateSpawnerBlocks(bool powders);
-    void updateLiquidBlocks(int caIndex);
-    void updatePowderBlocks(int caIndex);
+    CAEngine();
+    /// Steps the queued cells of chunk whose type is due.
+    /// Call with nothing locked.
+    void updateChunk(CAChunkJob& job, const BlockPack* blockPack, const std::vector<bool>& dueTypes);
 private:
-    
-    void liquidPhysics(i32 startBlockIndex, i32 b);
-    void powderPhysics(i32 c);
+    /// A voxel of the chunk being updated or one of its face neighbors
+    struct CAVoxel {
+        Chunk* chunk;
+        i32 index;
+        i32 owner; ///< Neighbor index, or CA_OWNER_SELF
+    };
+
+    /// Finds the voxel at pos, in voxels relative to the chunk being updated
+    /// @return false if it isn't in a generated chunk we hold
+    bool getVoxel(const i32v3& pos, CAVoxel& voxel);
+    /// Locks the voxel's chunk, unlocking whichever chunk was locked
+    ui16 getBlockID(const CAVoxel& voxel);
+    void setBlockID(const CAVoxel& voxel, ui16 id);
+    /// Queues the voxel if it is simulated
+    void wake(const i32v3& pos);
+    /// Queues the CA neighbors of pos, and pos itself
+    void wakeAround(const i32v3& pos);
+    void lockChunk(Chunk* chunk);
+
+    void liquidPhysics(const i32v3& pos, ui16 id);
+    void powderPhysics(const i32v3& pos, ui16 id);
+
+    /// Whether a liquid can flow into a voxel holding id
+    bool isLiquidOpen(ui16 id) const;
+    /// Whether a powder can fall into a voxel holding id
+    bool isPowderOpen(ui16 id) const;
+    i32 getLiquidLevel(ui16 id, const Block& liquid) const;
 
     i32 _dirIndex = 0;
-    i32 _lowIndex;
-    i32 _range;
-    i32 _highIndex;
+    std::vector<ui16> _cells; ///< Cells being stepped
     std::vector<ui16> _usedUpdateFlagList;
-    bool _blockUpdateFlagList[CHUNK_SIZE];
+    bool _blockUpdateFlagList[CHUNK_SIZE]; ///< Cells that already moved this step
     Chunk* _chunk = nullptr;
     Chunk* _lockedChunk = nullptr;
-    ChunkManager* m_chunkManager = nullptr;
-    PhysicsEngine* m_physicsEngine = nullptr;
-};
\ No newline at end of file
+    CAChunkJob* _job = nullptr;
+    ui32 _changedChunks = 0; ///< Bit per neighbor, and CA_OWNER_SELF
+    const BlockPack* _blockPack = nullptr;
+};
@@ -0,0 +1,135 @@
+#include "stdafx.h"
+#include "CAScheduler.h"
+
+#include <thread>
+
+#include "Chunk.h"
+#include "ChunkGrid.h"
+#include "CellularAutomataTask.h"
+
+#define CA_MAX_TASKS 8
+
+void CAScheduler::init(ChunkGrid* grid, OPT VoxPool* threadPool) {
+    m_grid = grid;
+    m_threadPool = threadPool;
+    Chunk::DataChange += makeDelegate(*this, &CAScheduler::onDataChange);
+}
+
+void CAScheduler::dispose() {
+    Chunk::DataChange -= makeDelegate(*this, &CAScheduler::onDataChange);
+    for (auto& it : m_activeChunks) {
+        it.second.release();
+    }
+    m_activeChunks.clear();
+    std::lock_guard<std::mutex> l(m_lckPending);
+    for (auto& it : m_pendingChunks) {
+        it.second.release();
+    }
+    m_pendingChunks.clear();
+}
+
+void CAScheduler::update() {
+    m_tick++;
+
+    { // Track chunks that were edited
+        std::lock_guard<std::mutex> l(m_lckPending);
+        for (auto& it : m_pendingChunks) {
+            ChunkHandle& h = m_activeChunks[it.first];
+            if (h.isAquired()) {
+                it.second.release();
+            } else {
+                h = std::move(it.second);
+            }
+        }
+        m_pendingChunks.clear();
+    }
+    if (m_activeChunks.empty() || !m_grid->blockPack) return;
+
+    // Find the types that step this tick
+    bool isAnyDue = false;
+    m_dueTypes.resize(CaPhysicsType::typesArray.size());
+    for (size_t i = 0; i < m_dueTypes.size(); i++) {
+        m_dueTypes[i] = CaPhysicsType::typesArray[i]->isDue(m_tick);
+        if (m_dueTypes[i]) isAnyDue = true;
+    }
+    if (!isAnyDue) return;
+
+    // Color the chunks, and stop tracking the ones with nothing left to do
+    for (auto it = m_activeChunks.begin(); it != m_activeChunks.end();) {
+        ChunkHandle& h = it->second;
+        bool isEmpty;
+        {
+            std::lock_guard<std::mutex> l(h->dataMutex);
+            isEmpty = h->caCells.empty();
+        }
+        if (isEmpty || h->genLevel != GEN_DONE) {
+            h.release();
+            it = m_activeChunks.erase(it);
+            continue;
+        }
+        const i32v3& pos = h->getChunkPosition().pos;
+        m_colors[(pos.x & 1) | ((pos.y & 1) << 1) | ((pos.z & 1) << 2)].push_back(&h);
+        it++;
+    }
+
+    // Colors step one after another, so neighbors never step together
+    for (int i = 0; i < CA_NUM_COLORS; i++) {
+        if (m_colors[i].size()) runPhase(m_colors[i]);
+        m_colors[i].clear();
+    }
+}
+
+void CAScheduler::onDataChange(Sender s, ChunkHandle& chunk) {
+    if (chunk->accessor != &m_grid->accessor) return;
+    {
+        std::lock_guard<std::mutex> l(chunk->dataMutex);
+        if (chunk->caCells.empty()) return;
+    }
+    std::lock_guard<std::mutex> l(m_lckPending);
+    ChunkHandle& h = m_pendingChunks[chunk.getID()];
+    if (!h.isAquired()) h = chunk.acquire();
+}
+
+void CAScheduler::runPhase(std::vector<ChunkHandle*>& chunks) {
+    std::shared_ptr<CellularAutomataDispatch> dispatch(new CellularAutomataDispatch);
+    dispatch->blockPack = m_grid->blockPack;
+    dispatch->dueTypes = m_dueTypes;
+    dispatch->nextJob = 0;
+    dispatch->numDone = 0;
+    // Sized once so the handles are never copied
+    dispatch->jobs.resize(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        CAChunkJob& job = dispatch->jobs[i];
+        ChunkHandle& h = *chunks[i];
+        job.chunk = h.acquire();
+        // Neighbor handles only change on this thread, so hold our own for the workers
+        for (int n = 0; n < 6; n++) {
+            if (h->neighbors[n].isAquired()) job.neighbors[n] = h->neighbors[n].acquire();
+        }
+    }
+
+    ui32 numJobs = (ui32)dispatch->jobs.size();
+    if (m_threadPool) {
+        size_t numTasks = std::min((size_t)numJobs - 1, (size_t)CA_MAX_TASKS);
+        for (size_t t = 0; t < numTasks; t++) {
+            m_threadPool->addTask(new CellularAutomataTask(dispatch));
+        }
+    }
+    // Work alongside the pool so a busy pool can't stall us, then wait for jobs in flight
+    dispatch->run(&m_engine);
+    while (dispatch->numDone < numJobs) {
+        std::this_thread::yield();
+    }
+
+    for (auto& job : dispatch->jobs) {
+        for (int n = 0; n < 6; n++) {
+            // Track neighbors that cells spilled into
+            if (job.wokenNeighbors & (1 << n)) {
+                ChunkHandle& h = m_activeChunks[job.neighbors[n].getID()];
+                if (!h.isAquired()) h = job.neighbors[n].acquire();
+            }
+            if (job.neighbors[n].isAquired()) job.neighbors[n].release();
+        }
+        job.chunk.release();
+    }
+}
@@ -0,0 +1,55 @@
+///
+/// CAScheduler.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Steps the cellular automata of a ChunkGrid. Only chunks with queued
+/// cells are tracked. They are split into a 2x2x2 checkerboard, and each
+/// color steps in parallel, since none of its chunks are neighbors.
+///
+
+#pragma once
+
+#ifndef CAScheduler_h__
+#define CAScheduler_h__
+
+#include <map>
+#include <Vorb/Events.hpp>
+
+#include "CAEngine.h"
+#include "ChunkHandle.h"
+#include "VoxPool.h"
+
+class ChunkGrid;
+
+#define CA_NUM_COLORS 8
+
+class CAScheduler {
+public:
+    void init(ChunkGrid* grid, OPT VoxPool* threadPool);
+    void dispose();
+
+    /// Steps the cells of the types that are due. Call on the update thread.
+    void update();
+private:
+    /// Tracks chunks that got cells queued
+    void onDataChange(Sender s, ChunkHandle& chunk);
+    void runPhase(std::vector<ChunkHandle*>& chunks);
+
+    ChunkGrid* m_grid = nullptr;
+    VoxPool* m_threadPool = nullptr;
+    CAEngine m_engine; ///< For stepping on the update thread
+    ui32 m_tick = 0;
+
+    std::map<ChunkID, ChunkHandle> m_activeChunks;
+    std::mutex m_lckPending;
+    std::map<ChunkID, ChunkHandle> m_pendingChunks; ///< Woken by edits on any thread
+    std::vector<ChunkHandle*> m_colors[CA_NUM_COLORS];
+    std::vector<bool> m_dueTypes;
+};
+
+#endif // CAScheduler_h__
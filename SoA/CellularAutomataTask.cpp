@@ -2,50 +2,23 @@
 #include "CellularAutomataTask.h"
 
 #include "CAEngine.h"
-#include "Chunk.h"
-#include "ChunkMeshManager.h"
 #include "VoxPool.h"
 
-CellularAutomataTask::CellularAutomataTask(ChunkManager* chunkManager,
-                                           PhysicsEngine* physicsEngine,
-                                           Chunk* chunk,
-                                           OPT ChunkMeshManager* meshManager) :
-                                           IThreadPoolTask(CA_TASK_ID),
-                                           m_chunkManager(chunkManager),
-                                           m_physicsEngine(physicsEngine),
-                                           _chunk(chunk) {
-
-    //return;
-
-    //typesToUpdate.reserve(2);
-
-    //if (meshManager) {
-    //    chunk->queuedForMesh = true;
-    //    renderTask = new RenderTask();
-    //    renderTask->init(_chunk, RenderTaskType::DEFAULT, meshManager);
-    //}
+void CellularAutomataDispatch::run(CAEngine* engine) {
+    ui32 job;
+    while ((job = nextJob++) < jobs.size()) {
+        engine->updateChunk(jobs[job], blockPack, dueTypes);
+        numDone++;
+    }
 }
 
 void CellularAutomataTask::execute(WorkerData* workerData) {
-   // if (workerData->caEngine == nullptr) {
-   //     workerData->caEngine = new CAEngine(m_chunkManager, m_physicsEngine);
-   // }
-   // workerData->caEngine->setChunk(_chunk);
-   // for (auto& type : typesToUpdate) {
-   //     switch (type->getCaAlg()) {
-   //         case CA_ALGORITHM::LIQUID:
-   ////             workerData->caEngine->updateLiquidBlocks(type->getCaIndex());
-   //             break;
-   //         case CA_ALGORITHM::POWDER:
-   ////             workerData->caEngine->updatePowderBlocks(type->getCaIndex());
-   //             break;
-   //         default:
-   //             break;
-   //     }
-   // }
+    if (workerData->caEngine == nullptr) {
+        workerData->caEngine = new CAEngine();
+    }
+    m_dispatch->run(workerData->caEngine);
+}
 
-   // if (renderTask) {
-   //     renderTask->execute(workerData);
-   // }
-   //// updateSpawnerBlocks(frameCounter == 0);
+void CellularAutomataTask::cleanup() {
+    delete this;
 }
@@ -15,51 +15,61 @@
 #ifndef CellularAutomataTask_h__
 #define CellularAutomataTask_h__
 
+#include <atomic>
+#include <memory>
 #include <Vorb/IThreadPoolTask.h>
 
+#include "ChunkHandle.h"
 #include "VoxPool.h"
 
-class CaPhysicsType;
-class Chunk;
-class ChunkManager;
-class ChunkMeshManager;
-class PhysicsEngine;
-class ChunkMeshTask;
+class BlockPack;
+class CAEngine;
 
 #define CA_TASK_ID 3
 
+/// Neighbor index of cells in the chunk being updated
+#define CA_OWNER_SELF 6
+
 enum class CAAlgorithm {
     NONE = 0,
     LIQUID = 1,
     POWDER = 2 
 };
 
+/// A chunk to step, and the face neighbors its cells can reach
+struct CAChunkJob {
+    ChunkHandle chunk;
+    ChunkHandle neighbors[6]; ///< left, right, bottom, top, back, front. May be unacquired.
+    ui32 wokenNeighbors = 0; ///< Bit per neighbor that got cells queued
+};
+
+/// Chunks of one color of the checkerboard. None of them are neighbors,
+/// so they can step at the same time. Jobs are claimed by whoever gets
+/// to them first.
+struct CellularAutomataDispatch {
+    void run(CAEngine* engine);
+
+    std::vector<CAChunkJob> jobs;
+    const BlockPack* blockPack = nullptr;
+    std::vector<bool> dueTypes; ///< Whether each CA type steps this tick, by caIndex
+    std::atomic<ui32> nextJob;
+    std::atomic<ui32> numDone;
+};
+
 class CellularAutomataTask : public vcore::IThreadPoolTask<WorkerData> {
 public:
-    friend class ChunkManager;
-    friend class SphericalVoxelComponentUpdater;
-    /// Constructs the task
-    CellularAutomataTask(ChunkManager* chunkManager,
-                         PhysicsEngine* physicsEngine,
-                         Chunk* chunk,
-                         OPT ChunkMeshManager* meshManager);
-
-    /// Adds a caPhysicsType for update
-    void addCaTypeToUpdate(CaPhysicsType* caType) {
-        typesToUpdate.push_back(caType);
+    CellularAutomataTask(std::shared_ptr<CellularAutomataDispatch> dispatch) :
+        vcore::IThreadPoolTask<WorkerData>(CA_TASK_ID),
+        m_dispatch(dispatch) {
+        // Empty
     }
 
     /// Executes the task
     void execute(WorkerData* workerData) override;
 
-    ChunkMeshTask* renderTask = nullptr; ///< A nested to force re-mesh
-
+    void cleanup() override;
 private:
-    std::vector<CaPhysicsType*> typesToUpdate; ///< All the CA types that will be updated by this task
-    Chunk* _chunk = nullptr; ///< The chunk we are updating
-    ChunkManager* m_chunkManager = nullptr;
-    PhysicsEngine* m_physicsEngine = nullptr;
-    ChunkMeshManager* meshManager = nullptr;
+    std::shared_ptr<CellularAutomataDispatch> m_dispatch;
 };
 
-#endif // CellularAutomataTask_h__
\ No newline at end of file
+#endif // CellularAutomataTask_h__
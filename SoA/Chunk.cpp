@@ -10,6 +10,19 @@ void Chunk::init(WorldCubeFace face) {
     m_chunkPosition.pos = i32v3(m_id.x, m_id.y, m_id.z);
     m_chunkPosition.face = face;
     m_voxelPosition = VoxelSpaceConversions::chunkToVoxel(m_chunkPosition);
+    dirtyMeshRegions = 0;
+    isDirty = false;
+    isFromSave = false;
+    isLit = false;
+    lightUpdates.clear();
+    caCells.clear();
+    // Light starts out dark until the VoxelLightEngine gets to it
+    IntervalTree<ui16>::LNode lampNode;
+    IntervalTree<ui8>::LNode sunlightNode;
+    lampNode.set(0, CHUNK_SIZE, 0);
+    sunlightNode.set(0, CHUNK_SIZE, 0);
+    lamp.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &lampNode, 1);
+    sunlight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &sunlightNode, 1);
 }
 
 void Chunk::initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState /*= vvox::VoxelStorageState::INTERVAL_TREE*/) {
@@ -22,12 +35,17 @@ void Chunk::initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState /*= vvo
     tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &tertiaryNode, 1);
 }
 
-void Chunk::setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler) {
+void Chunk::setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler,
+                         vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui8>* byteRecycler) {
     blocks.setArrayRecycler(shortRecycler);
     tertiary.setArrayRecycler(shortRecycler);
+    lamp.setArrayRecycler(shortRecycler);
+    sunlight.setArrayRecycler(byteRecycler);
 }
 
 void Chunk::updateContainers() {
     blocks.update(dataMutex);
     tertiary.update(dataMutex);
+    lamp.update(dataMutex);
+    sunlight.update(dataMutex);
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include "ChunkGenerator.h"
 #include "ChunkID.h"
 #include <Vorb/FixedSizeArrayRecycler.hpp>
+#include <atomic>
 
 class Chunk;
 typedef Chunk* ChunkPtr;
@@ -61,7 +62,8 @@ class Chunk {
     void init(WorldCubeFace face);
     // Initializes the chunk and sets all voxel data to 0
     void initAndFillEmpty(WorldCubeFace face, vvox::VoxelStorageState = vvox::VoxelStorageState::INTERVAL_TREE);
-    void setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler);
+    void setRecyclers(vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui16>* shortRecycler,
+                      vcore::FixedSizeArrayRecycler<CHUNK_SIZE, ui8>* byteRecycler);
     void updateContainers();
 
     /************************************************************************/
@@ -79,10 +81,35 @@ class Chunk {
     }
     void setBlock(int x, int y, int z, ui16 id) {
         blocks.set(x + y * CHUNK_LAYER + z * CHUNK_WIDTH, id);
+        flagDirtyMeshRegion(x + y * CHUNK_LAYER + z * CHUNK_WIDTH);
+        queueLightUpdate(x + y * CHUNK_LAYER + z * CHUNK_WIDTH);
+        queueCaUpdate(x + y * CHUNK_LAYER + z * CHUNK_WIDTH);
+        updateVersion++;
     }
 
-    // Marks the chunks as dirty and flags for a re-mesh
+    // Marks the chunk as edited since it was generated, so it gets saved.
+    // Call with dataMutex locked.
     void flagDirty() { isDirty = true; }
+    // Flags the mesh regions whose faces can change when the voxel at blockIndex changes.
+    // Call with dataMutex locked.
+    void flagDirtyMeshRegion(int blockIndex) {
+        int y = blockIndex / CHUNK_LAYER;
+        dirtyMeshRegions |= 1u << (y / MESH_REGION_HEIGHT);
+        // Faces of the voxels above and below can be in neighboring regions
+        if (y > 0) dirtyMeshRegions |= 1u << ((y - 1) / MESH_REGION_HEIGHT);
+        if (y < CHUNK_WIDTH - 1) dirtyMeshRegions |= 1u << ((y + 1) / MESH_REGION_HEIGHT);
+    }
+    // Queues the voxel at blockIndex to be relit by the next mesh task.
+    // Call with dataMutex locked.
+    void queueLightUpdate(int blockIndex) {
+        // Unlit chunks pick up the change when they are first lit
+        if (isLit) lightUpdates.push_back((BlockIndex)blockIndex);
+    }
+    // Queues the voxel for the cellular automata, which also wakes its neighbors.
+    // Call with dataMutex locked.
+    void queueCaUpdate(int blockIndex) {
+        caCells.push_back((BlockIndex)blockIndex);
+    }
 
     /************************************************************************/
     /* Members                                                              */
@@ -101,7 +128,8 @@ class Chunk {
     };
     volatile ChunkGenLevel genLevel = ChunkGenLevel::GEN_NONE;
     ChunkGenLevel pendingGenLevel = ChunkGenLevel::GEN_NONE;
-    bool isDirty;
+    bool isDirty; ///< Edited since it was generated or loaded. Guarded by dataMutex.
+    bool isFromSave; ///< Loaded from a save, which already holds its flora. Set before genLevel.
     f32 distance2; //< Squared distance
     int numBlocks;
     // TODO(Ben): reader/writer lock
@@ -112,9 +140,20 @@ class Chunk {
     // TODO(Ben): Think about data locality.
     vvox::SmartVoxelContainer<ui16> blocks;
     vvox::SmartVoxelContainer<ui16> tertiary;
+    vvox::SmartVoxelContainer<ui16> lamp; ///< Packed RGB lamp light
+    vvox::SmartVoxelContainer<ui8> sunlight;
     // Block indexes where flora must be generated.
     std::vector<ui16> floraToGenerate;
+    // Bumped whenever blocks change after generation. Written with dataMutex locked.
     volatile ui32 updateVersion;
+    // Mesh regions edited since the last mesh task. Guarded by dataMutex.
+    ui32 dirtyMeshRegions = 0;
+    // Set once the VoxelLightEngine has done the initial light pass. Guarded by dataMutex.
+    bool isLit = false;
+    // Voxels that changed since the last light update. Guarded by dataMutex.
+    std::vector<BlockIndex> lightUpdates;
+    // Voxels the cellular automata steps next. Guarded by dataMutex.
+    std::vector<BlockIndex> caCells;
 
     ChunkAccessor* accessor = nullptr;
 
@@ -135,9 +174,7 @@ class Chunk {
     /************************************************************************/
     /* Chunk Handle Data                                                    */
     /************************************************************************/
-    std::mutex m_handleMutex;
-    __declspec(align(4)) volatile ui32 m_handleState = 0;
-    __declspec(align(4)) volatile ui32 m_handleRefCount = 0;
+    std::atomic<ui32> m_handleRefCount; ///< Set by ChunkAccessor when the chunk is allocated
 };
 
 #endif // NChunk_h__
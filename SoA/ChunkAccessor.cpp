@@ -3,10 +3,9 @@
 
 #include "ChunkAllocator.h"
 
-const ui32 HANDLE_STATE_DEAD = 0;
-const ui32 HANDLE_STATE_ACQUIRING = 1;
-const ui32 HANDLE_STATE_ALIVE = 2;
-const ui32 HANDLE_STATE_FREEING = 3;
+#define SHARD_MIN_SLOTS 64
+#define SHARD_MAX_LOAD_NUM 3 ///< Grow at 3/4 full
+#define SHARD_MAX_LOAD_DEN 4
 
 ChunkHandle::ChunkHandle(const ChunkHandle& other) :
     m_acquired(false),
@@ -23,7 +22,7 @@ ChunkHandle& ChunkHandle::operator= (const ChunkHandle& other) {
 }
 
 void ChunkHandle::acquireSelf() {
-    if (!m_acquired) m_chunk->accessor->acquire(*this);
+    if (!m_acquired) *this = m_chunk->accessor->acquire(*this);
 }
 ChunkHandle ChunkHandle::acquire() {
     if (m_acquired) {
@@ -41,156 +40,158 @@ void ChunkHandle::release() {
 
 void ChunkAccessor::init(PagedChunkAllocator* allocator) {
     m_allocator = allocator;
+    m_countAlive = 0;
 }
 void ChunkAccessor::destroy() {
-    std::unordered_map<ChunkID, ChunkHandle>().swap(m_chunkLookup);
+    for (int i = 0; i < NUM_CHUNK_ACCESSOR_SHARDS; i++) {
+        std::lock_guard<std::mutex> l(m_shards[i].lock);
+        m_shards[i].clear();
+    }
+    m_countAlive = 0;
 }
 
-#ifdef FAST_CHUNK_ACCESS
-
 ChunkHandle ChunkAccessor::acquire(ChunkID id) {
-    std::unique_lock<std::mutex> lMap(m_lckLookup);
-    auto& it = m_chunkLookup.find(id);
-    if (it == m_chunkLookup.end()) {
-        ChunkHandle& h = m_chunkLookup[id];
-        h.m_chunk = m_allocator->alloc();
-        h->m_handleRefCount = 1;
-        h->m_id = id;
-        h->accessor = this;
-        h->m_handleState = HANDLE_STATE_ALIVE;
-        lMap.unlock();
-        onAdd(ChunkHandle(h));
-        return h;
-    } else {
-        InterlockedIncrement(&it->second->m_handleRefCount);
-        it->second->m_handleState = HANDLE_STATE_ALIVE;
-        return it->second;
+    ui64 hash = hashID(id);
+    Shard& shard = getShard(hash);
+
+    ChunkHandle h;
+    h.m_id = id;
+    h.m_acquired = true;
+
+    std::unique_lock<std::mutex> l(shard.lock);
+    h.m_chunk = shard.find(id, hash);
+    if (h.m_chunk) {
+        // This can bring back a chunk whose last handle was just released.
+        // tryRemove checks the count under this lock, so it won't free it.
+        h->m_handleRefCount++;
+        return std::move(h);
     }
+
+    h.m_chunk = m_allocator->alloc();
+    h->m_id = id;
+    h->accessor = this;
+    h->m_handleRefCount = 1;
+    shard.insert(id, hash, h.m_chunk);
+    m_countAlive++;
+    l.unlock();
+
+    ChunkHandle tmp;
+    tmp.m_chunk = h.m_chunk;
+    tmp.m_id = id;
+    onAdd(tmp);
+    return std::move(h);
 }
 ChunkHandle ChunkAccessor::acquire(ChunkHandle& chunk) {
-    switch (InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_ACQUIRING, HANDLE_STATE_ALIVE)) {
-    case HANDLE_STATE_FREEING:
-        return acquire(chunk->m_id);
-    case HANDLE_STATE_ACQUIRING:
-        InterlockedIncrement(&chunk->m_handleRefCount);
-        return chunk;
-    case HANDLE_STATE_ALIVE:
-        InterlockedIncrement(&chunk->m_handleRefCount);
-        InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_ALIVE, HANDLE_STATE_ACQUIRING);
-        return chunk;
-    default:
-        throw std::invalid_argument("INVALID CHUNK HANDLE STATE");
+    // Only add a reference while there still is one. At zero the chunk
+    // may be getting freed, so go through the table instead.
+    ui32 count = chunk->m_handleRefCount;
+    while (count != 0) {
+        if (chunk->m_handleRefCount.compare_exchange_weak(count, count + 1)) {
+            ChunkHandle h;
+            h.m_chunk = chunk.m_chunk;
+            h.m_id = chunk.m_id;
+            h.m_acquired = true;
+            return std::move(h);
+        }
     }
+    return std::move(acquire(chunk.m_id));
 }
 void ChunkAccessor::release(ChunkHandle& chunk) {
-    ui32 retries = 0;
-
-    // TODO(Cristian): Heavy thread-safety
-    ui32 currentCount = InterlockedDecrement(&chunk->m_handleRefCount);
-RETEST_CHUNK_LIVELINESS:
-    if (currentCount == 0) {
-        // If the chunk is alive, set it to zombie mode. Otherwise, it's being birthed or already dead.
-        switch (InterlockedCompareExchange(&chunk->m_handleState, HANDLE_STATE_FREEING, HANDLE_STATE_ALIVE)) {
-        case HANDLE_STATE_ALIVE:
-        { // Highlander... there can only be one... killer of chunks
-            std::lock_guard<std::mutex> chunkLock(chunk->m_handleMutex);
-            currentCount = InterlockedDecrement(&chunk->m_handleRefCount);
-            if (chunk->m_handleState == HANDLE_STATE_FREEING) {
-                // We are able to kill this chunk
-                safeRemove(chunk);
-            }
-        }
-        case HANDLE_STATE_FREEING:
-            // Let the other thread do the work
-            break;
-        case HANDLE_STATE_ACQUIRING:
-            // Need to retry
-            std::this_thread::yield();
-            currentCount = chunk->m_handleRefCount;
-            retries++;
-            goto RETEST_CHUNK_LIVELINESS;
-        }
-    }
-
-    // Invalidate the handle
-    chunk.m_chunk = nullptr;
-    if (retries > 2) {
-        printf("A lot of release retries occurred: %d\n", retries);
-        fflush(stdout);
+    if (--chunk->m_handleRefCount == 0) {
+        tryRemove(chunk.m_id, chunk.m_chunk);
     }
+    chunk.m_acquired = false;
+    chunk.m_accessor = this;
 }
 
-#else
-
-ChunkHandle ChunkAccessor::acquire(ChunkID id) {
-    bool wasOld;
-    ChunkHandle chunk = std::move(safeAdd(id, wasOld));
+void ChunkAccessor::tryRemove(ChunkID id, Chunk* chunk) {
+    ui64 hash = hashID(id);
+    Shard& shard = getShard(hash);
+    {
+        std::lock_guard<std::mutex> l(shard.lock);
+        // Another release may have removed it first, or an acquire revived it
+        if (shard.find(id, hash) != chunk || chunk->m_handleRefCount != 0) return;
 
-    if (wasOld) return std::move(acquire(chunk));
+        // Make sure it can't be accessed until acquired again
+        chunk->accessor = nullptr;
+        shard.erase(id, hash);
+        m_countAlive--;
+    }
+    // Fire event before deallocating
+    ChunkHandle tmp;
+    tmp.m_chunk = chunk;
+    tmp.m_id = id;
+    onRemove(tmp);
+    m_allocator->free(chunk);
+}
 
-    chunk.m_acquired = true;
-    return std::move(chunk);
+ui64 ChunkAccessor::hashID(ChunkID id) {
+    // splitmix64 finalizer, neighboring IDs spread across shards and slots
+    ui64 h = id.id;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
 }
-ChunkHandle ChunkAccessor::acquire(ChunkHandle& chunk) {
-    std::lock_guard<std::mutex> lChunk(chunk->m_handleMutex);
-    if (chunk->m_handleRefCount == 0) {
-        // We need to re-add the chunk
-        bool wasOld = false;
-        chunk.m_acquired = true;
-        return std::move(safeAdd(chunk.m_id, wasOld));
-    } else {
-        ChunkHandle retValue = {};
-        memcpy(&retValue, &chunk, sizeof(ChunkHandle));
-        retValue->m_handleRefCount++;
-        retValue.m_acquired = true;
-        return std::move(retValue);
+
+/************************************************************************/
+/* Shard                                                                */
+/************************************************************************/
+
+Chunk* ChunkAccessor::Shard::find(ChunkID id, ui64 hash) const {
+    if (m_slots.empty()) return nullptr;
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = m_slots[i];
+        if (!slot.chunk) return nullptr;
+        if (slot.id == id.id) return slot.chunk;
     }
 }
-void ChunkAccessor::release(ChunkHandle& chunk) {
-    std::lock_guard<std::mutex> lChunk(chunk->m_handleMutex);
-    chunk->m_handleRefCount--;
-    if (chunk->m_handleRefCount == 0) {
-        // We need to remove the chunk
-        safeRemove(chunk);
-    }
-    chunk.m_acquired = false;
-    chunk.m_accessor = this;
+
+void ChunkAccessor::Shard::insert(ChunkID id, ui64 hash, Chunk* chunk) {
+    if ((m_size + 1) * SHARD_MAX_LOAD_DEN > m_slots.size() * SHARD_MAX_LOAD_NUM) grow();
+    size_t mask = m_slots.size() - 1;
+    size_t i = (size_t)hash & mask;
+    while (m_slots[i].chunk) i = (i + 1) & mask;
+    m_slots[i].id = id.id;
+    m_slots[i].chunk = chunk;
+    m_size++;
 }
 
-#endif
-
-ChunkHandle ChunkAccessor::safeAdd(ChunkID id, bool& wasOld) {
-    std::unique_lock<std::mutex> l(m_lckLookup);
-    auto& it = m_chunkLookup.find(id);
-    if (it == m_chunkLookup.end()) {
-        wasOld = false;
-        ChunkHandle& h = m_chunkLookup[id];
-        h.m_chunk = m_allocator->alloc();
-        h.m_id = id;
-        h->m_id = id;
-        h->accessor = this;
-        h->m_handleState = HANDLE_STATE_ALIVE;
-        h->m_handleRefCount = 1;
-        ChunkHandle tmp(h);
-        l.unlock();
-        onAdd(tmp);
-        return h;
-    } else {
-        wasOld = true;
-        return it->second;
+void ChunkAccessor::Shard::erase(ChunkID id, ui64 hash) {
+    size_t mask = m_slots.size() - 1;
+    size_t i = (size_t)hash & mask;
+    while (m_slots[i].id != id.id || !m_slots[i].chunk) {
+        if (!m_slots[i].chunk) return;
+        i = (i + 1) & mask;
+    }
+    // Shift the rest of the probe run back so lookups don't need tombstones
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; m_slots[j].chunk; j = (j + 1) & mask) {
+        size_t home = (size_t)hashID(m_slots[j].id) & mask;
+        // Move j into the hole unless its home lies cyclically in (hole, j]
+        bool stays = (hole <= j) ? (hole < home && home <= j) : (hole < home || home <= j);
+        if (!stays) {
+            m_slots[hole] = m_slots[j];
+            hole = j;
+        }
     }
+    m_slots[hole].chunk = nullptr;
+    m_size--;
 }
-void ChunkAccessor::safeRemove(ChunkHandle& chunk) {
-    { // TODO(Cristian): This needs to be added to a free-list?
-        std::lock_guard<std::mutex> l(m_lckLookup);
 
-        // Make sure it can't be accessed until acquired again
-        chunk->accessor = nullptr;
+void ChunkAccessor::Shard::clear() {
+    std::vector<Slot>().swap(m_slots);
+    m_size = 0;
+}
 
-        // TODO(Ben): Time based free?
-        m_chunkLookup.erase(chunk.m_id);
+void ChunkAccessor::Shard::grow() {
+    std::vector<Slot> old;
+    old.swap(m_slots);
+    size_t size = old.empty() ? SHARD_MIN_SLOTS : old.size() * 2;
+    Slot empty = { 0, nullptr };
+    m_slots.resize(size, empty);
+    m_size = 0;
+    for (auto& slot : old) {
+        if (slot.chunk) insert(slot.id, hashID(slot.id), slot.chunk);
     }
-    // Fire event before deallocating
-    onRemove(chunk);
-    m_allocator->free(chunk.m_chunk);
 }
@@ -20,6 +20,9 @@
 
 #include <Vorb/Events.hpp>
 
+#define CHUNK_ACCESSOR_SHARD_BITS 6
+#define NUM_CHUNK_ACCESSOR_SHARDS (1 << CHUNK_ACCESSOR_SHARD_BITS)
+
 class ChunkAccessor {
     friend class ChunkHandle;
 public:
@@ -29,20 +32,44 @@ class ChunkAccessor {
     ChunkHandle acquire(ChunkID id);
 
     size_t getCountAlive() const {
-        return m_chunkLookup.size();
+        return m_countAlive;
     }
 
     Event<ChunkHandle&> onAdd; ///< Called when a handle is added
     Event<ChunkHandle&> onRemove; ///< Called when a handle is removed
 private:
+    /// Open addressing hash table of live chunks. Lookups only lock
+    /// the shard the ID hashes to, so threads rarely wait on each other.
+    class Shard {
+    public:
+        Chunk* find(ChunkID id, ui64 hash) const;
+        void insert(ChunkID id, ui64 hash, Chunk* chunk);
+        void erase(ChunkID id, ui64 hash);
+        void clear();
+
+        std::mutex lock;
+    private:
+        struct Slot {
+            ui64 id;
+            Chunk* chunk; ///< nullptr when the slot is empty
+        };
+        void grow();
+
+        std::vector<Slot> m_slots; ///< Size is zero or a power of two
+        size_t m_size = 0;
+    };
+
     ChunkHandle acquire(ChunkHandle& chunk);
     void release(ChunkHandle& chunk);
 
-    ChunkHandle safeAdd(ChunkID id, bool& wasOld);
-    void safeRemove(ChunkHandle& chunk);
+    /// Removes the chunk if it's still in the table and nothing acquired it since
+    void tryRemove(ChunkID id, Chunk* chunk);
+
+    static ui64 hashID(ChunkID id);
+    Shard& getShard(ui64 hash) { return m_shards[hash >> (64 - CHUNK_ACCESSOR_SHARD_BITS)]; }
 
-    std::mutex m_lckLookup;
-    std::unordered_map<ChunkID, ChunkHandle> m_chunkLookup;
+    Shard m_shards[NUM_CHUNK_ACCESSOR_SHARDS];
+    std::atomic<size_t> m_countAlive;
     PagedChunkAllocator* m_allocator = nullptr;
 };
 
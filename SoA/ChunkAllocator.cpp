@@ -9,7 +9,8 @@
 #define INITIAL_UPDATE_VERSION 1
 
 PagedChunkAllocator::PagedChunkAllocator() :
-m_shortFixedSizeArrayRecycler(MAX_VOXEL_ARRAYS_TO_CACHE * NUM_SHORT_VOXEL_ARRAYS) {
+m_shortFixedSizeArrayRecycler(MAX_VOXEL_ARRAYS_TO_CACHE * NUM_SHORT_VOXEL_ARRAYS),
+m_byteFixedSizeArrayRecycler(MAX_VOXEL_ARRAYS_TO_CACHE * NUM_BYTE_VOXEL_ARRAYS) {
     // Empty
 }
 
@@ -30,7 +31,7 @@ Chunk* PagedChunkAllocator::alloc() {
         // Add chunks to free chunks lists
         for (int i = 0; i < CHUNK_PAGE_SIZE; i++) {
             Chunk* chunk = &page->chunks[CHUNK_PAGE_SIZE - i - 1];
-            chunk->setRecyclers(&m_shortFixedSizeArrayRecycler);
+            chunk->setRecyclers(&m_shortFixedSizeArrayRecycler, &m_byteFixedSizeArrayRecycler);
             m_freeChunks.push_back(chunk);
         }
     }
@@ -60,5 +61,7 @@ void PagedChunkAllocator::free(Chunk* chunk) {
     // Free data
     chunk->blocks.clear();
     chunk->tertiary.clear();
+    chunk->lamp.clear();
+    chunk->sunlight.clear();
     std::vector<ChunkQuery*>().swap(chunk->m_genQueryData.pending);
 }
@@ -0,0 +1,94 @@
+#include "stdafx.h"
+#include "ChunkCodec.h"
+
+#include <deque>
+
+#include <ZLIB/zlib.h>
+
+#include "LZ4Block.h"
+#include "RegionFileManager.h"
+
+namespace {
+    ui32 compressNone(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity) {
+        if (srcSize > dstCapacity) return 0;
+        memcpy(dst, src, srcSize);
+        return srcSize;
+    }
+    bool decompressNone(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, ui32& dstSize) {
+        if (srcSize > dstCapacity) return false;
+        memcpy(dst, src, srcSize);
+        dstSize = srcSize;
+        return true;
+    }
+
+    ui32 compressZlib(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, int level) {
+        uLongf size = dstCapacity;
+        if (compress2(dst, &size, src, srcSize, level) != Z_OK) return 0;
+        return (ui32)size;
+    }
+    ui32 compressZlibDefault(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity) {
+        return compressZlib(src, srcSize, dst, dstCapacity, 6);
+    }
+    ui32 compressZlibMax(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity) {
+        return compressZlib(src, srcSize, dst, dstCapacity, Z_BEST_COMPRESSION);
+    }
+    // Any zlib level reads back the same way
+    bool decompressZlib(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, ui32& dstSize) {
+        uLongf size = dstCapacity;
+        if (uncompress(dst, &size, src, srcSize) != Z_OK) return false;
+        dstSize = (ui32)size;
+        return true;
+    }
+
+    std::deque<ChunkCodec> createBuiltinCodecs() {
+        std::deque<ChunkCodec> codecs(4);
+        codecs[0].id = COMPRESSION_NONE;
+        codecs[0].name = "none";
+        codecs[0].compress = compressNone;
+        codecs[0].decompress = decompressNone;
+        // Fast to write, for autosaves of many dirty chunks
+        codecs[1].id = COMPRESSION_LZ4;
+        codecs[1].name = "lz4";
+        codecs[1].compress = lz4::compressBlock;
+        codecs[1].decompress = lz4::decompressBlock;
+        // The original region format
+        codecs[2].id = COMPRESSION_ZLIB;
+        codecs[2].name = "zlib";
+        codecs[2].compress = compressZlibDefault;
+        codecs[2].decompress = decompressZlib;
+        // Smallest files, for archiving or sharing worlds
+        codecs[3].id = COMPRESSION_ZLIB_MAX;
+        codecs[3].name = "zlib-max";
+        codecs[3].compress = compressZlibMax;
+        codecs[3].decompress = decompressZlib;
+        return codecs;
+    }
+
+    // Deque so codec pointers stay valid when more are registered
+    std::deque<ChunkCodec> codecs = createBuiltinCodecs();
+}
+
+bool ChunkCodecs::registerCodec(const ChunkCodec& codec) {
+    if (codec.id & ~COMPRESSION_CODEC_MASK) return false;
+    if (getCodec(codec.id) || getCodec(codec.name)) return false;
+    codecs.push_back(codec);
+    return true;
+}
+
+const ChunkCodec* ChunkCodecs::getCodec(ui32 id) {
+    for (size_t i = 0; i < codecs.size(); i++) {
+        if (codecs[i].id == id) return &codecs[i];
+    }
+    return nullptr;
+}
+
+const ChunkCodec* ChunkCodecs::getCodec(const nString& name) {
+    for (size_t i = 0; i < codecs.size(); i++) {
+        if (codecs[i].name == name) return &codecs[i];
+    }
+    return nullptr;
+}
+
+const ChunkCodec* ChunkCodecs::getDefaultCodec() {
+    return getCodec(COMPRESSION_LZ4);
+}
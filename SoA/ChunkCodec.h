@@ -0,0 +1,46 @@
+///
+/// ChunkCodec.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Registry of the byte codecs that compress chunk data in region files.
+/// A codec's ID is stored in the codec bits of ChunkHeader::compression.
+///
+
+#pragma once
+
+#ifndef ChunkCodec_h__
+#define ChunkCodec_h__
+
+/// Compresses src into dst
+/// @return Compressed size, or 0 on failure
+typedef ui32 (*ChunkCompressFunc)(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity);
+/// Decompresses src into dst and sets dstSize
+/// @return false on failure
+typedef bool (*ChunkDecompressFunc)(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, ui32& dstSize);
+
+struct ChunkCodec {
+    ui32 id; ///< Must fit in COMPRESSION_CODEC_MASK and be unique
+    nString name; ///< Name used to select the codec for a save
+    ChunkCompressFunc compress;
+    ChunkDecompressFunc decompress;
+};
+
+namespace ChunkCodecs {
+    /// Adds a codec. Register codecs before any I/O workers start.
+    /// @return false if the ID or name is taken
+    bool registerCodec(const ChunkCodec& codec);
+
+    /// @return The codec, or nullptr if there is none
+    const ChunkCodec* getCodec(ui32 id);
+    const ChunkCodec* getCodec(const nString& name);
+
+    /// Codec for saves that don't pick one
+    const ChunkCodec* getDefaultCodec();
+}
+
+#endif // ChunkCodec_h__
@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "ChunkGenBenchmark.h"
+
+#include <algorithm>
+#include <Vorb/io/IOManager.h>
+#include <Vorb/Timing.h>
+
+#include "BlockLoader.h"
+#include "BlockPack.h"
+#include "BlockTextureLoader.h"
+#include "BlockTexturePack.h"
+#include "ChunkAccessor.h"
+#include "ChunkAllocator.h"
+#include "ChunkMesh.h"
+#include "ChunkMeshDataPool.h"
+#include "ChunkMesher.h"
+#include "FloraGenerator.h"
+#include "ModPathResolver.h"
+#include "PlanetGenData.h"
+#include "PlanetGenLoader.h"
+#include "ProceduralChunkGenerator.h"
+#include "RegionFileManager.h"
+#include "SoaEngine.h"
+#include "SoaOptions.h"
+#include "SphericalHeightmapGenerator.h"
+
+#define BENCHMARK_COLUMN_HEIGHT 8
+#define BENCHMARK_PLANET_RADIUS 4500.0
+#define BENCHMARK_SAVE_DIR "Benchmark"
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+namespace {
+    enum BenchmarkStage {
+        STAGE_HEIGHTMAP,
+        STAGE_GENERATE,
+        STAGE_FLORA,
+        STAGE_MESH,
+        STAGE_SAVE,
+        STAGE_LOAD,
+        NUM_STAGES
+    };
+    const cString STAGE_NAMES[NUM_STAGES] = { "Heightmap", "Generate", "Flora", "Mesh", "Save", "Load" };
+
+    struct StageStats {
+        std::vector<f64> times; ///< ms per item
+        f64 totalMs = 0.0;
+        size_t outputBytes = 0; ///< Size of what the stage produced. Not bytes allocated.
+    };
+
+    // FNV-1a, so the checksum doesn't depend on the platform's std::hash
+    void hashBytes(ui64& hash, const void* data, size_t size) {
+        const ui8* bytes = (const ui8*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+        }
+    }
+    template <typename T>
+    void hashValue(ui64& hash, const T& v) {
+        hashBytes(hash, &v, sizeof(T));
+    }
+
+    /// Hashes the runs of a voxel container
+    /// @return Number of runs
+    template <typename T>
+    size_t hashRuns(ui64& hash, const vvox::SmartVoxelContainer<T>& container) {
+        size_t numRuns = 0;
+        container.forEachRun(0, CHUNK_SIZE, [&](size_t start, size_t length, T v) {
+            hashValue(hash, (ui32)start);
+            hashValue(hash, (ui32)length);
+            hashValue(hash, v);
+            numRuns++;
+        });
+        return numRuns;
+    }
+
+    // Padding and mesher flags aren't always written, so only the used fields are hashed
+    void hashQuads(ui64& hash, const std::vector<VoxelQuad>& quads) {
+        for (auto& q : quads) {
+            for (int i = 0; i < 4; i++) {
+                const BlockVertex& v = q.verts[i];
+                hashValue(hash, v.position);
+                hashValue(hash, v.face);
+                hashValue(hash, v.tex);
+                hashValue(hash, v.color);
+                hashValue(hash, v.overlayColor);
+            }
+        }
+    }
+
+    void printStage(const cString name, StageStats& stats) {
+        if (stats.times.empty()) return;
+        std::sort(stats.times.begin(), stats.times.end());
+        size_t n = stats.times.size();
+        f64 p50 = stats.times[std::min(n - 1, n / 2)];
+        f64 p99 = stats.times[std::min(n - 1, (n * 99) / 100)];
+        printf("  %-10s %10.4lf %10.4lf %12.2lf %14llu\n", name, p50, p99, stats.totalMs, (unsigned long long)stats.outputBytes);
+    }
+
+    /// Same as LoadTaskBlockData, minus the texture upload
+    bool loadBlocks(BlockPack& blocks, BlockTextureLoader& textureLoader) {
+        textureLoader.loadTextureData();
+
+        vio::IOManager iom;
+        iom.setSearchDirectory("Data/Blocks/");
+        if (!BlockLoader::loadBlocks(iom, &blocks)) {
+            pError("Failed to load Data/Blocks/BlockData.yml");
+            return false;
+        }
+        for (size_t i = 0; i < blocks.size(); i++) {
+            Block& b = blocks[i];
+            if (b.active) textureLoader.loadBlockTextures(b);
+        }
+        Block& b = blocks["none"];
+        for (int i = 0; i < 6; i++) {
+            b.textures[i] = textureLoader.getTexturePack()->getDefaultTexture();
+        }
+        return true;
+    }
+}
+
+ui64 runChunkGenBenchmark(ui32 numChunks) {
+    // Whole columns in a square, so meshes have neighbors on most sides
+    const i32 numColumns = (i32)((numChunks + BENCHMARK_COLUMN_HEIGHT - 1) / BENCHMARK_COLUMN_HEIGHT);
+    i32 gridWidth = 1;
+    while (gridWidth * gridWidth < numColumns) gridWidth++;
+    const size_t totalChunks = (size_t)numColumns * BENCHMARK_COLUMN_HEIGHT;
+
+    SoaEngine::initOptions(soaOptions);
+
+    // Blocks. Textures are only mapped into the atlas pages, which never get uploaded.
+    ModPathResolver texturePathResolver;
+    texturePathResolver.init("Textures/TexturePacks/" + soaOptions.getStringOption("Texture Pack").defaultValue + "/",
+                             "Textures/TexturePacks/" + soaOptions.getStringOption("Texture Pack").defaultValue + "/");
+    BlockTexturePack blockTextures;
+    blockTextures.init(32, 4096);
+    BlockTextureLoader textureLoader;
+    textureLoader.init(&texturePathResolver, &blockTextures);
+    BlockPack blocks;
+    if (!loadBlocks(blocks, textureLoader)) {
+        blockTextures.dispose();
+        return 0;
+    }
+
+    // Planet
+    vio::IOManager planetIom;
+    planetIom.setSearchDirectory("StarSystems/Trinity/");
+    PlanetGenLoader planetLoader;
+    planetLoader.init(&planetIom);
+    PlanetGenData* genData = planetLoader.loadPlanetGenData("Planets/Aldrin/terrain_gen.yml");
+    if (!genData) {
+        pError("Failed to load Planets/Aldrin/terrain_gen.yml");
+        blockTextures.dispose();
+        return 0;
+    }
+    genData->radius = BENCHMARK_PLANET_RADIUS;
+    SoaEngine::initVoxelGen(genData, blocks);
+
+    SphericalHeightmapGenerator heightGenerator;
+    heightGenerator.init(genData);
+    ProceduralChunkGenerator chunkGenerator;
+    chunkGenerator.init(genData);
+    FloraGenerator floraGenerator;
+    // Too big for the stack
+    ChunkMesher* mesher = new ChunkMesher;
+    mesher->init(&blocks);
+    ChunkMeshDataPool meshDataPool;
+    mesher->meshDataPool = &meshDataPool;
+    RegionIOBuffers* ioBuffers = new RegionIOBuffers;
+
+    vio::IOManager saveIom;
+    saveIom.makeDirectory(BENCHMARK_SAVE_DIR);
+    saveIom.makeDirectory(BENCHMARK_SAVE_DIR "/Region");
+    RegionFileManager regionManager(BENCHMARK_SAVE_DIR);
+
+    PagedChunkAllocator allocator;
+    ChunkAccessor accessor;
+    accessor.init(&allocator);
+
+    StageStats stages[NUM_STAGES];
+    ui64 checksum = FNV_OFFSET_BASIS;
+    PreciseTimer totalTimer;
+    PreciseTimer timer;
+    totalTimer.start();
+
+    // Heightmaps, one per column, centered on the face origin
+    std::vector<ChunkGridData> columns(numColumns);
+    VoxelPosition2D positions[CHUNK_LAYER];
+    for (i32 c = 0; c < numColumns; c++) {
+        ChunkGridData& column = columns[c];
+        column.gridPosition.face = WorldCubeFace::FACE_TOP;
+        column.gridPosition.pos.x = c % gridWidth - gridWidth / 2;
+        column.gridPosition.pos.y = c / gridWidth - gridWidth / 2;
+        for (int z = 0; z < CHUNK_WIDTH; z++) {
+            for (int x = 0; x < CHUNK_WIDTH; x++) {
+                VoxelPosition2D& pos = positions[z * CHUNK_WIDTH + x];
+                pos.face = WorldCubeFace::FACE_TOP;
+                pos.pos.x = column.gridPosition.pos.x * CHUNK_WIDTH + x;
+                pos.pos.y = column.gridPosition.pos.y * CHUNK_WIDTH + z;
+            }
+        }
+        timer.start();
+        heightGenerator.generateHeightData(column.heightData, positions, CHUNK_LAYER);
+        stages[STAGE_HEIGHTMAP].times.push_back(timer.stop());
+        stages[STAGE_HEIGHTMAP].outputBytes += sizeof(column.heightData);
+        // Biomes are pointers, so they only show up through the voxels
+        for (auto& hd : column.heightData) {
+            hashValue(checksum, hd.height);
+            hashValue(checksum, hd.flora);
+            hashValue(checksum, hd.temperature);
+            hashValue(checksum, hd.humidity);
+        }
+    }
+
+    // Put the surface in the middle of the columns
+    const i32 baseY = fastFloor(columns[0].heightData[CHUNK_LAYER / 2].height / (f32)CHUNK_WIDTH) - BENCHMARK_COLUMN_HEIGHT / 2;
+
+    // Chunks are column major, bottom to top
+    std::vector<ChunkHandle> chunks(totalChunks);
+    for (size_t i = 0; i < totalChunks; i++) {
+        ChunkGridData& column = columns[i / BENCHMARK_COLUMN_HEIGHT];
+        ChunkID id(column.gridPosition.pos.x, baseY + (i32)(i % BENCHMARK_COLUMN_HEIGHT), column.gridPosition.pos.y);
+        chunks[i] = accessor.acquire(id);
+        Chunk* chunk = chunks[i];
+        chunk->init(WorldCubeFace::FACE_TOP);
+        chunk->gridData = &column;
+
+        timer.start();
+        chunkGenerator.generateChunk(chunk, column.heightData);
+        stages[STAGE_GENERATE].times.push_back(timer.stop());
+    }
+
+    /// @return Index of the chunk at a grid position, -1 if it's outside the grid
+    auto getIndex = [&](const i32v3& gridPos) -> i32 {
+        if (gridPos.x < 0 || gridPos.x >= gridWidth || gridPos.y < 0 || gridPos.y >= BENCHMARK_COLUMN_HEIGHT ||
+            gridPos.z < 0 || gridPos.z >= gridWidth) return -1;
+        i32 c = gridPos.z * gridWidth + gridPos.x;
+        if (c >= numColumns) return -1;
+        return c * BENCHMARK_COLUMN_HEIGHT + gridPos.y;
+    };
+    auto getOffsetChunk = [&](const i32v3& gridPos, ui32 chunkOffset) -> Chunk* {
+        i32 n = getIndex(gridPos + i32v3(FloraGenerator::getChunkXOffset(chunkOffset),
+                                         FloraGenerator::getChunkYOffset(chunkOffset),
+                                         FloraGenerator::getChunkZOffset(chunkOffset)));
+        return n >= 0 ? (Chunk*)chunks[n] : nullptr;
+    };
+    auto getGridPos = [&](size_t i) -> i32v3 {
+        i32 c = (i32)(i / BENCHMARK_COLUMN_HEIGHT);
+        return i32v3(c % gridWidth, (i32)(i % BENCHMARK_COLUMN_HEIGHT), c / gridWidth);
+    };
+
+    // Flora. Nodes that leave the grid are dropped.
+    std::vector<FloraNode> lNodes;
+    std::vector<FloraNode> wNodes;
+    for (size_t i = 0; i < totalChunks; i++) {
+        Chunk* chunk = chunks[i];
+        i32v3 gridPos = getGridPos(i);
+
+        timer.start();
+        floraGenerator.generateChunkFlora(chunk, chunk->gridData->heightData, lNodes, wNodes);
+        for (auto& node : wNodes) {
+            Chunk* owner = getOffsetChunk(gridPos, node.chunkOffset);
+            if (owner) owner->blocks.set(node.blockIndex, node.blockID);
+        }
+        for (auto& node : lNodes) {
+            Chunk* owner = getOffsetChunk(gridPos, node.chunkOffset);
+            if (owner && owner->blocks.get(node.blockIndex) == 0) owner->blocks.set(node.blockIndex, node.blockID);
+        }
+        stages[STAGE_FLORA].times.push_back(timer.stop());
+        std::vector<ui16>().swap(chunk->floraToGenerate);
+        lNodes.clear();
+        wNodes.clear();
+    }
+
+    // Voxels are final now
+    std::vector<ui64> voxelHashes(totalChunks);
+    for (size_t i = 0; i < totalChunks; i++) {
+        Chunk* chunk = chunks[i];
+        ui64 hash = FNV_OFFSET_BASIS;
+        size_t numRuns = hashRuns(hash, chunk->blocks);
+        numRuns += hashRuns(hash, chunk->tertiary);
+        stages[STAGE_GENERATE].outputBytes += numRuns * sizeof(IntervalTree<ui16>::LNode);
+        voxelHashes[i] = hash;
+        hashValue(checksum, hash);
+    }
+
+    // Neighbors for meshing, in the order of Chunk::neighbors
+    const i32v3 NEIGHBOR_OFFSETS[6] = { i32v3(-1, 0, 0), i32v3(1, 0, 0), i32v3(0, -1, 0),
+                                        i32v3(0, 1, 0), i32v3(0, 0, -1), i32v3(0, 0, 1) };
+    for (size_t i = 0; i < totalChunks; i++) {
+        Chunk* chunk = chunks[i];
+        i32v3 gridPos = getGridPos(i);
+        for (int j = 0; j < 6; j++) {
+            i32 n = getIndex(gridPos + NEIGHBOR_OFFSETS[j]);
+            if (n >= 0) chunk->neighbors[j] = chunks[n].acquire();
+        }
+    }
+
+    // Meshes
+    for (size_t i = 0; i < totalChunks; i++) {
+        Chunk* chunk = chunks[i];
+        timer.start();
+        mesher->prepareData(chunk);
+        ChunkMeshData* meshData = mesher->createChunkMeshData(MeshTaskType::DEFAULT);
+        stages[STAGE_MESH].times.push_back(timer.stop());
+        stages[STAGE_MESH].outputBytes += meshData->getCapacityBytes();
+        hashQuads(checksum, meshData->opaqueQuads);
+        hashQuads(checksum, meshData->transQuads);
+        hashQuads(checksum, meshData->cutoutQuads);
+        for (auto& v : meshData->waterVertices) {
+            hashValue(checksum, v.position);
+            hashValue(checksum, v.color);
+        }
+        meshDataPool.recycle(meshData);
+    }
+
+    // Region round trip
+    for (size_t i = 0; i < totalChunks; i++) {
+        timer.start();
+        bool saved = regionManager.saveChunk(chunks[i], *ioBuffers);
+        stages[STAGE_SAVE].times.push_back(timer.stop());
+        if (!saved) continue;
+        stages[STAGE_SAVE].outputBytes += ioBuffers->compressedBufferSize;
+        hashBytes(checksum, ioBuffers->compressedBuffer, ioBuffers->compressedBufferSize);
+    }
+    regionManager.flush();
+    size_t numMismatches = 0;
+    for (size_t i = 0; i < totalChunks; i++) {
+        Chunk* chunk = chunks[i];
+        timer.start();
+        bool loaded = regionManager.tryLoadChunk(chunk, *ioBuffers);
+        stages[STAGE_LOAD].times.push_back(timer.stop());
+        ui64 hash = FNV_OFFSET_BASIS;
+        hashRuns(hash, chunk->blocks);
+        hashRuns(hash, chunk->tertiary);
+        if (!loaded || hash != voxelHashes[i]) numMismatches++;
+    }
+    f64 totalMs = totalTimer.stop();
+
+    for (int i = 0; i < NUM_STAGES; i++) {
+        for (auto& t : stages[i].times) stages[i].totalMs += t;
+    }
+    printf("Chunk benchmark: %d chunks in %d columns\n", (int)totalChunks, numColumns);
+    printf("  %-10s %10s %10s %12s %14s\n", "Stage", "p50 ms", "p99 ms", "total ms", "output bytes");
+    for (int i = 0; i < NUM_STAGES; i++) {
+        printStage(STAGE_NAMES[i], stages[i]);
+    }
+    printf("  Total %lf ms, %lf chunks/s\n", totalMs, totalChunks / (totalMs / 1000.0));
+    ChunkMeshDataPoolStats poolStats = meshDataPool.getStats();
+    printf("  Mesh data pool hit rate %.1f%%, peak pooled %llu bytes, peak mesher %llu bytes\n",
+           poolStats.getHitRate() * 100.0f, (unsigned long long)poolStats.peakPooledBytes,
+           (unsigned long long)poolStats.peakMesherBytes);
+    printf("  Round trip mismatches: %d\n", (int)numMismatches);
+    printf("  Checksum: %016llx\n", (unsigned long long)checksum);
+
+    // Clean up
+    for (auto& c : chunks) {
+        Chunk* chunk = c;
+        for (int i = 0; i < 6; i++) {
+            if (chunk->neighbors[i].isAquired()) chunk->neighbors[i].release();
+        }
+    }
+    for (auto& c : chunks) c.release();
+    regionManager.clear();
+    delete ioBuffers;
+    delete mesher;
+    delete genData;
+    blockTextures.dispose();
+
+    return checksum;
+}
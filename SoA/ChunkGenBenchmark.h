@@ -0,0 +1,28 @@
+///
+/// ChunkGenBenchmark.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Headless benchmark of the chunk pipeline. Generates, meshes and
+/// round trips chunks through the region files without a GL context.
+///
+
+#pragma once
+
+#ifndef ChunkGenBenchmark_h__
+#define ChunkGenBenchmark_h__
+
+#define DEFAULT_BENCHMARK_CHUNKS 512
+
+/// Runs every stage of the pipeline over a fixed grid of chunks and prints
+/// chunks/s, p50/p99 per stage, the size of each stage's output and a checksum
+/// of the output. Output size is not the same as bytes allocated.
+/// @param numChunks: Chunks to generate, rounded up to whole columns
+/// @return Checksum of the output. Runs on the same data must match.
+ui64 runChunkGenBenchmark(ui32 numChunks);
+
+#endif // ChunkGenBenchmark_h__
@@ -5,6 +5,7 @@
 #include "Chunk.h"
 #include "ChunkHandle.h"
 #include "ChunkGrid.h"
+#include "VoxelLightTask.h"
 
 void ChunkGenerator::init(vcore::ThreadPool<WorkerData>* threadPool,
                           PlanetGenData* genData,
@@ -32,6 +33,12 @@ void ChunkGenerator::submitQuery(ChunkQuery* query) {
     if (!chunk.gridData->isLoaded) {
         // If this heightmap isn't already loading, send it
         if (!chunk.gridData->isLoading) {
+            // Another generator may have cached it since the grid data was made
+            if (m_proceduralGenerator.getCachedHeightmap(chunk.gridData->gridPosition, chunk.gridData->heightData)) {
+                chunk.gridData->isLoaded = true;
+                submitQuery(query);
+                return;
+            }
             // Send heightmap gen query
             chunk.gridData->isLoading = true;
             m_threadPool->addTask(&query->genTask);
@@ -85,6 +92,10 @@ void ChunkGenerator::update() {
                 if (q2->shouldRelease) q2->release();
             }
             std::vector<ChunkQuery*>().swap(chunk.m_genQueryData.pending);
+            // Voxels are final so the chunk can be lit
+            VoxelLightTask* lightTask = new VoxelLightTask;
+            lightTask->init(q->chunk, m_grid->blockPack);
+            m_threadPool->addTask(lightTask);
             // Notify listeners that this chunk is finished
             onGenFinish(q->chunk, q->genLevel);
             q->chunk.release();
@@ -15,6 +15,7 @@
 #ifndef ChunkGenerator_h__
 #define ChunkGenerator_h__
 
+#include <unordered_map>
 #include <Vorb/ThreadPool.h>
 
 #include "VoxPool.h"
@@ -53,7 +54,7 @@ class ChunkGenerator {
     void flagMeshbleNeighbor(ChunkHandle& n, ui32 bit);
 
     moodycamel::ConcurrentQueue<ChunkQuery*> m_finishedQueries;
-    std::map < ChunkGridData*, std::vector<ChunkQuery*> >m_pendingQueries; ///< Queries waiting on height map
+    std::unordered_map<ChunkGridData*, std::vector<ChunkQuery*> > m_pendingQueries; ///< Queries waiting on height map
 
     ChunkGrid* m_grid = nullptr;
     ProceduralChunkGenerator m_proceduralGenerator;
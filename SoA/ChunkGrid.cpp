@@ -2,6 +2,7 @@
 #include "ChunkGrid.h"
 #include "Chunk.h"
 #include "ChunkAllocator.h"
+#include "ChunkIOManager.h"
 #include "soaUtils.h"
 
 #include <Vorb/utils.h>
@@ -12,7 +13,8 @@ void ChunkGrid::init(WorldCubeFace face,
                       PlanetGenData* genData,
                       PagedChunkAllocator* allocator) {
     m_face = face;
-    generatorsPerRow = generatorsPerRow;
+    m_genData = genData;
+    this->generatorsPerRow = generatorsPerRow;
     numGenerators = generatorsPerRow * generatorsPerRow;
     generators = new ChunkGenerator[numGenerators];
     for (ui32 i = 0; i < numGenerators; i++) {
@@ -23,9 +25,11 @@ void ChunkGrid::init(WorldCubeFace face,
     accessor.onRemove += makeDelegate(*this, &ChunkGrid::onAccessorRemove);
     nodeSetter.grid = this;
     nodeSetter.threadPool = threadPool;
+    caScheduler.init(this, threadPool);
 }
 
 void ChunkGrid::dispose() {
+    caScheduler.dispose();
     accessor.onAdd -= makeDelegate(*this, &ChunkGrid::onAccessorAdd);
     accessor.onRemove -= makeDelegate(*this, &ChunkGrid::onAccessorRemove);
     delete[] generators;
@@ -70,8 +74,10 @@ ChunkGridData* ChunkGrid::getChunkGridData(const i32v2& gridPos) {
 }
 
 void ChunkGrid::update() {
-    // TODO(Ben): Handle generator distribution
-    generators[0].update();
+    // Each generator drains its own finished queries
+    for (ui32 i = 0; i < numGenerators; i++) {
+        generators[i].update();
+    }
 
     /* Update Queries */
     // Needs to be big so we can flush it every frame.
@@ -80,13 +86,47 @@ void ChunkGrid::update() {
     size_t numQueries = m_queries.try_dequeue_bulk(queries, MAX_QUERIES);
     for (size_t i = 0; i < numQueries; i++) {
         ChunkQuery* q = queries[i];
-        // TODO(Ben): Handle generator distribution
-        q->genTask.init(q, q->chunk->gridData->heightData, &generators[0]);
-        generators[0].submitQuery(q);
+        ChunkGenerator* generator = &generators[getGeneratorIndex(q->chunk->gridData->gridPosition)];
+        q->genTask.init(q, q->chunk->gridData->heightData, generator);
+        generator->submitQuery(q);
     }
     
     // Place any needed nodes
     nodeSetter.update();
+
+    // Step liquids and powders
+    caScheduler.update();
+}
+
+void ChunkGrid::saveEditedChunks() {
+    if (!chunkIo) return;
+    std::lock_guard<std::mutex> l(m_lckActiveChunks);
+    for (size_t i = 0; i < m_activeChunks.size(); i++) {
+        saveIfEdited(m_activeChunks[i]);
+    }
+}
+
+void ChunkGrid::saveIfEdited(Chunk* chunk) {
+    if (chunk->genLevel != GEN_DONE) return;
+    // Hold the lock while snapshotting so the saved voxels and the flag agree
+    std::lock_guard<std::mutex> l(chunk->dataMutex);
+    if (chunk->isDirty && chunkIo->addToSaveList(chunk)) {
+        chunk->isDirty = false;
+    }
+}
+
+ui32 ChunkGrid::getGeneratorIndex(const i32v2& gridPos) const {
+    // Floor divide so negative columns get their own regions
+    i32 rx = gridPos.x / GENERATOR_REGION_WIDTH;
+    i32 rz = gridPos.y / GENERATOR_REGION_WIDTH;
+    if (gridPos.x < rx * GENERATOR_REGION_WIDTH) rx--;
+    if (gridPos.y < rz * GENERATOR_REGION_WIDTH) rz--;
+    i32 perRow = (i32)generatorsPerRow;
+    i32 gx = rx % perRow;
+    i32 gz = rz % perRow;
+    if (gx < 0) gx += perRow;
+    if (gz < 0) gz += perRow;
+    return (ui32)(gz * perRow + gx);
 }
 
 void ChunkGrid::onAccessorAdd(Sender s, ChunkHandle& chunk) {
@@ -107,8 +147,12 @@ void ChunkGrid::onAccessorAdd(Sender s, ChunkHandle& chunk) {
         auto it = m_chunkGridDataMap.find(gridPos);
         if (it == m_chunkGridDataMap.end()) {
             // If its not allocated, make a new one with a new voxelMapData
-            // TODO(Ben): Cache this
             chunk->gridData = new ChunkGridData(chunk->getChunkPosition());
+            // Skip the heightmap gen if this column was generated recently
+            HeightmapTileKey key = HeightmapCache::getChunkKey(chunk->gridData->gridPosition);
+            if (m_genData->heightmapCache.get(key, chunk->gridData->heightData)) {
+                chunk->gridData->isLoaded = true;
+            }
             m_chunkGridDataMap[gridPos] = chunk->gridData;
         } else {
             chunk->gridData = it->second;
@@ -118,6 +162,9 @@ void ChunkGrid::onAccessorAdd(Sender s, ChunkHandle& chunk) {
 }
 
 void ChunkGrid::onAccessorRemove(Sender s, ChunkHandle& chunk) {
+    // Only edited chunks are saved, the rest generate the same way next time
+    if (chunkIo) saveIfEdited(chunk);
+
     { // Remove from active list
         std::lock_guard<std::mutex> l(m_lckActiveChunks);
         m_activeChunks[chunk->m_activeIndex] = m_activeChunks.back();
@@ -26,9 +26,13 @@
 #include "ChunkAccessor.h"
 #include "ChunkHandle.h"
 
+#include "CAScheduler.h"
 #include "VoxelNodeSetter.h"
 
 class BlockPack;
+class ChunkIOManager;
+
+const i32 GENERATOR_REGION_WIDTH = 4; ///< Width in columns of the regions handed to each generator
 
 class ChunkGrid {
     friend class ChunkMeshManager;
@@ -55,6 +59,10 @@ class ChunkGrid {
     // Processes chunk queries and set active chunks
     void update();
 
+    /// Queues a save of every edited chunk that is still loaded. Chunks
+    /// that get freed are saved on their own.
+    void saveEditedChunks();
+
     // Locks and gets active chunks. Must call releaseActiveChunks() later.
     const std::vector<ChunkHandle>& acquireActiveChunks() { 
         m_lckActiveChunks.lock(); 
@@ -68,8 +76,10 @@ class ChunkGrid {
 
     ChunkAccessor accessor;
     BlockPack* blockPack = nullptr; ///< Handle to the block pack for this grid
+    ChunkIOManager* chunkIo = nullptr; ///< Saves edited chunks. Optional.
 
     VoxelNodeSetter nodeSetter;
+    CAScheduler caScheduler;
 
     Event<ChunkHandle&> onNeighborsAcquire;
     Event<ChunkHandle&> onNeighborsRelease;
@@ -80,6 +90,13 @@ class ChunkGrid {
     void onAccessorAdd(Sender s, ChunkHandle& chunk);
     void onAccessorRemove(Sender s, ChunkHandle& chunk);
 
+    /// Queues a save of chunk if it was edited since its last save
+    void saveIfEdited(Chunk* chunk);
+
+    /// All queries for a column go to the same generator, since it
+    /// tracks the column's heightmap and the chunks' pending queries
+    ui32 getGeneratorIndex(const i32v2& gridPos) const;
+
     moodycamel::ConcurrentQueue<ChunkQuery*> m_queries;
 
     std::mutex m_lckActiveChunks;
@@ -95,6 +112,7 @@ class ChunkGrid {
     PtrRecycler<ChunkQuery> m_queryRecycler;
 
 
+    PlanetGenData* m_genData = nullptr;
     WorldCubeFace m_face = FACE_NONE;
 };
 
@@ -18,17 +18,25 @@
 #include "GameManager.h"
 #include "SoaOptions.h"
 
-ChunkIOManager::ChunkIOManager(const nString& saveDir) :
-    _regionFileManager(saveDir)
+ChunkIOManager::ChunkIOManager(const nString& saveDir, const nString& newSaveCodec) :
+    _regionFileManager(saveDir),
+    _saveJournal(saveDir)
 {
+    _snapshotBuffers = new RegionIOBuffers;
     _isThreadFinished = 0;
-    readWriteThread = NULL;
+    _isDone = 0;
     _shouldDisableLoading = 0;
+
+    // Picks up the save's codec before anything is read or written
+    if (!_regionFileManager.checkVersion(newSaveCodec)) {
+        pError("Failed to check the version of save " + saveDir);
+    }
 }
 
 ChunkIOManager::~ChunkIOManager()
 {
     onQuit();
+    delete _snapshotBuffers;
 }
 
 void ChunkIOManager::clear() {
@@ -36,126 +44,146 @@ void ChunkIOManager::clear() {
     _queueLock.lock();
     //flush queues
     while (chunksToLoad.try_dequeue(tmp));
+    _prefetchList.clear();
     _queueLock.unlock();
 
-    while (chunksToSave.peek() != nullptr);
-
     std::this_thread::sleep_for(std::chrono::milliseconds(30));
 
     while (finishedLoadChunks.try_dequeue(tmp));
 }
 
 
-void ChunkIOManager::addToSaveList(Chunk* ch)
+bool ChunkIOManager::addToSaveList(Chunk* ch)
 {
-    //if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-    //    ch->dirty = 0;
-    //    ch->inSaveThread = 1;
-    //    chunksToSave.enqueue(ch);
-    //    _cond.notify_one();
-    //}
+    // Snapshot the voxels now so the chunk can keep changing, or be freed,
+    // while the save waits for a checkpoint
+    std::vector<ui8> data;
+    {
+        std::lock_guard<std::mutex> lock(_snapshotLock);
+        if (!_regionFileManager.serializeChunk(ch, *_snapshotBuffers)) return false;
+        data.assign(_snapshotBuffers->chunkBuffer,
+                    _snapshotBuffers->chunkBuffer + _snapshotBuffers->chunkBufferSize);
+    }
+    _saveJournal.add(ch->getChunkPosition(), data);
+
+    if (_saveJournal.shouldCheckpoint()) _cond.notify_one();
+    return true;
 }
 
 void ChunkIOManager::addToSaveList(std::vector <Chunk* > &chunks)
 {
-  /*  NChunk* ch;
     for (size_t i = 0; i < chunks.size(); i++){
-        ch = chunks[i];
-        if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-            ch->inSaveThread = 1;
-            ch->dirty = 0;
-            chunksToSave.enqueue(ch);
-        }
+        addToSaveList(chunks[i]);
     }
-    _cond.notify_one();*/
 }
 
 void ChunkIOManager::addToLoadList(Chunk* ch)
 {
-  /*  if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-        ch->loadStatus = 0;
-        ch->inLoadThread = 1;
-        chunksToLoad.enqueue(ch);
-        _cond.notify_one();
-    }*/
+    if (_shouldDisableLoading) {
+        std::lock_guard<std::mutex> lock(_finishedLock);
+        finishedLoadChunks.enqueue(ch);
+        return;
+    }
+
+    _queueLock.lock();
+    chunksToLoad.enqueue(ch);
+    _queueLock.unlock();
+    _cond.notify_one();
 }
 
 void ChunkIOManager::addToLoadList(std::vector <Chunk* > &chunks)
 {
-   /* NChunk* ch;
-
     if (_shouldDisableLoading) {
+        std::lock_guard<std::mutex> lock(_finishedLock);
         for (size_t i = 0; i < chunks.size(); i++){
-            chunks[i]->loadStatus = 2;
             finishedLoadChunks.enqueue(chunks[i]);
         }
         return;
     }
 
+    _queueLock.lock();
     for (size_t i = 0; i < chunks.size(); i++){
-        ch = chunks[i];
-       
-        if (ch->inSaveThread == 0 && ch->inLoadThread == 0){
-            ch->inLoadThread = true;
-            chunksToLoad.enqueue(ch);
-        }
-        else{
-            std::cout << "ERROR: Tried to add chunk to load list and its in a thread! : " << (int)ch->inSaveThread << " " << (int)ch->inLoadThread << " " << ch->voxelPosition.z << std::endl;
-        }
+        chunksToLoad.enqueue(chunks[i]);
+    }
+    _queueLock.unlock();
+    _cond.notify_all();
+}
+
+bool ChunkIOManager::loadChunk(Chunk* ch, RegionIOBuffers& buffers) {
+    if (_shouldDisableLoading) return false;
+    // A save that hasn't been checkpointed is newer than the region file
+    if (_saveJournal.getPending(ch->getChunkPosition(), buffers)) {
+        return _regionFileManager.deserializeChunk(ch, buffers);
     }
-    _cond.notify_one();*/
+    return _regionFileManager.tryLoadChunk(ch, buffers);
+}
+
+void ChunkIOManager::setPrefetchList(std::vector<ChunkPosition3D>& positions) {
+    if (_shouldDisableLoading) return;
+
+    _queueLock.lock();
+    _prefetchList.swap(positions);
+    _queueLock.unlock();
+    _cond.notify_one();
 }
 
 void ChunkIOManager::readWriteChunks()
 {
-    //std::unique_lock<std::mutex> queueLock(_queueLock);
-    //NChunk* ch;
-
-    //nString reg;
-
-    //while (!_isDone){
-    //    if (_isDone){
-    //        _regionFileManager.clear();
-    //        queueLock.unlock();
-    //        _isThreadFinished = 1;
-    //        return;
-    //    }
-    //    _regionFileManager.flush();
-    //    _cond.wait(queueLock); //wait for a notification that queue is not empty
-
-    //    if (_isDone){
-    //        _regionFileManager.clear();
-    //        _isThreadFinished = 1;
-    //        queueLock.unlock();
-    //        return;
-    //    }
-    //    queueLock.unlock();
-
-    //    // All tasks
-    //    while (chunksToLoad.try_dequeue(ch) || chunksToSave.try_dequeue(ch)) {
-    //        if (ch->getState() == ChunkStates::LOAD) {
-    //            if (1 || _regionFileManager.tryLoadChunk(ch) == false) {
-    //                ch->loadStatus = 1;
-    //            }
-
-    //            finishedLoadChunks.enqueue(ch);
-    //        } else { //save
-    //           // _regionFileManager.saveChunk(ch);
-    //            ch->inSaveThread = 0; //race condition?
-    //        }
-    //       
-    //    }
-
-    //    queueLock.lock();
-    //}
+    // Scratch space for the chunk this worker has in flight
+    RegionIOBuffers* buffers = new RegionIOBuffers;
+
+    std::unique_lock<std::mutex> queueLock(_queueLock);
+    Chunk* ch;
+
+    while (true) {
+        // Loads go first since something is waiting on them
+        if (chunksToLoad.try_dequeue(ch)) {
+            queueLock.unlock();
+            loadChunk(ch, *buffers);
+            {
+                std::lock_guard<std::mutex> lock(_finishedLock);
+                finishedLoadChunks.enqueue(ch);
+            }
+            queueLock.lock();
+        } else if (_isDone) {
+            break;
+        } else if (_saveJournal.shouldCheckpoint()) {
+            queueLock.unlock();
+            _saveJournal.checkpoint(_regionFileManager, *buffers);
+            queueLock.lock();
+        } else if (_prefetchList.size()) {
+            // Nothing is waiting on these, so they only run when there is no other work
+            ChunkPosition3D pos = _prefetchList.back();
+            _prefetchList.pop_back();
+            queueLock.unlock();
+            _regionFileManager.prefetchChunk(pos);
+            queueLock.lock();
+        } else {
+            // Wake up now and then to see if pending saves are due
+            _cond.wait_for(queueLock, std::chrono::milliseconds(250));
+        }
+    }
+    queueLock.unlock();
+
+    delete buffers;
 }
 
-void ChunkIOManager::beginThread()
+void ChunkIOManager::beginThreads(ui32 numWorkers /* = 0 */)
 {
+    if (numWorkers == 0) {
+        // I/O workers mostly wait on the disk or zlib, leave room for the game threads
+        numWorkers = std::thread::hardware_concurrency() / 2;
+        if (numWorkers == 0) numWorkers = 1;
+    }
+
+    // Finish the checkpoint of a session that crashed before anything reads the regions
+    _saveJournal.replay(_regionFileManager);
+
     _isDone = 0;
     _isThreadFinished = 0;
-    readWriteThread = NULL;
-    readWriteThread = new std::thread(&ChunkIOManager::readWriteChunks, this);
+    for (ui32 i = 0; i < numWorkers; i++) {
+        _workers.push_back(new std::thread(&ChunkIOManager::readWriteChunks, this));
+    }
 }
 
 void ChunkIOManager::onQuit()
@@ -166,10 +194,22 @@ void ChunkIOManager::onQuit()
     _queueLock.lock();
     _isDone = 1;
     _queueLock.unlock();
-    _cond.notify_one();
-    if (readWriteThread != NULL && readWriteThread->joinable()) readWriteThread->join();
-    delete readWriteThread;
-    readWriteThread = NULL;
+    _cond.notify_all();
+    for (size_t i = 0; i < _workers.size(); i++) {
+        if (_workers[i]->joinable()) _workers[i]->join();
+        delete _workers[i];
+    }
+    _workers.clear();
+    _isThreadFinished = 1;
+
+    // Write out the last saves now that the workers are gone
+    if (_saveJournal.hasPending()) {
+        std::lock_guard<std::mutex> lock(_snapshotLock);
+        _saveJournal.checkpoint(_regionFileManager, *_snapshotBuffers);
+    }
+
+    // Closing the region files writes them back
+    _regionFileManager.clear();
 }
 
 bool ChunkIOManager::saveVersionFile() {
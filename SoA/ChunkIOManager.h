@@ -6,6 +6,7 @@
 
 #include <ZLIB/zlib.h>
 
+#include "ChunkSaveJournal.h"
 #include "RegionFileManager.h"
 #include "readerwriterqueue.h"
 
@@ -13,34 +14,59 @@ class Chunk;
 
 class ChunkIOManager{
 public:
-    ChunkIOManager(const nString& saveDir);
+    /// @param newSaveCodec: Codec to create the save with if it doesn't exist yet. Empty for the default.
+    ChunkIOManager(const nString& saveDir, const nString& newSaveCodec = "");
     ~ChunkIOManager();
     void clear();
 
-    void addToSaveList(Chunk*  ch);
+    /// Snapshots the chunk and queues the snapshot for saving
+    /// @return false if the chunk couldn't be serialized
+    bool addToSaveList(Chunk*  ch);
     void addToSaveList(std::vector<Chunk* >& chunks);
     void addToLoadList(Chunk*  ch);
     void addToLoadList(std::vector<Chunk* >& chunks);
+    /// Loads a saved chunk on the calling thread, from a pending save if there is one
+    /// @param buffers: Scratch space owned by the caller
+    /// @return false if the chunk was never saved
+    bool loadChunk(Chunk* ch, RegionIOBuffers& buffers);
+    /// Replaces the chunks whose region sectors are paged in while the workers are idle,
+    /// so that loadChunk doesn't wait on the disk when the generators get to them.
+    /// Positions that weren't read yet are dropped. Takes the contents of positions.
+    /// @param positions: Soonest needed last
+    void setPrefetchList(std::vector<ChunkPosition3D>& positions);
 
-    void beginThread();
+    /// Starts the I/O workers
+    /// @param numWorkers: Number of workers, or 0 to pick from the core count
+    void beginThreads(ui32 numWorkers = 0);
 
     void onQuit();
 
     void setDisableLoading(bool disableLoading) { _shouldDisableLoading = disableLoading; }
 
+    /// Picks the codec for chunk data, see RegionFileManager::setChunkCodec.
+    /// The save's codec is read, or set for a new save, when the manager is created.
+    bool setChunkCodec(const nString& name) { return _regionFileManager.setChunkCodec(name); }
+
     bool saveVersionFile();
     bool checkVersion();
 
     moodycamel::ReaderWriterQueue<Chunk* > chunksToLoad;
-    moodycamel::ReaderWriterQueue<Chunk* > chunksToSave;
-    std::thread* readWriteThread;
+    /// Chunks that finished loading. Loaded chunks have genLevel GEN_DONE.
     moodycamel::ReaderWriterQueue<Chunk* > finishedLoadChunks;
 private:
     RegionFileManager _regionFileManager;
+    ChunkSaveJournal _saveJournal; ///< Saves that aren't in the region files yet
+    RegionIOBuffers* _snapshotBuffers; ///< Guarded by _snapshotLock
+    std::mutex _snapshotLock; ///< Chunks are saved from whichever thread frees them
+
+    void readWriteChunks(); //used by the workers
+
+    std::vector<std::thread*> _workers;
 
-    void readWriteChunks(); //used by the thread
+    std::vector<ChunkPosition3D> _prefetchList; ///< Guarded by _queueLock
 
-    std::mutex _queueLock;
+    std::mutex _queueLock; ///< Serializes the worker side of chunksToLoad
+    std::mutex _finishedLock; ///< Serializes the producer side of finishedLoadChunks
     std::condition_variable _cond;
 
     bool _isDone;
@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "ChunkMaterialTable.h"
+
+// Materials to reserve in the texture buffer the first time
+#define INITIAL_MATERIAL_CAPACITY 1024
+
+ui32 ChunkMaterialTable::getIndex(const BlockMaterial& material) {
+    std::lock_guard<std::mutex> l(m_lock);
+    auto it = m_indices.find(material);
+    if (it != m_indices.end()) return it->second;
+
+    ui32 index = (ui32)m_materials.size();
+    m_materials.push_back(material);
+    m_indices[material] = index;
+    return index;
+}
+
+void ChunkMaterialTable::update() {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (m_numUploaded == m_materials.size()) return;
+
+    if (!m_buffer) {
+        glGenBuffers(1, &m_buffer);
+        glGenTextures(1, &m_texture);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+    if (m_materials.size() > m_capacity) {
+        // Grow and upload everything
+        if (m_capacity == 0) m_capacity = INITIAL_MATERIAL_CAPACITY;
+        while (m_capacity < m_materials.size()) m_capacity *= 2;
+        glBufferData(GL_TEXTURE_BUFFER, m_capacity * sizeof(BlockMaterial), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, m_materials.size() * sizeof(BlockMaterial), m_materials.data());
+
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    } else {
+        glBufferSubData(GL_TEXTURE_BUFFER, m_numUploaded * sizeof(BlockMaterial),
+                        (m_materials.size() - m_numUploaded) * sizeof(BlockMaterial),
+                        &m_materials[m_numUploaded]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    m_numUploaded = m_materials.size();
+}
+
+void ChunkMaterialTable::clear() {
+    std::lock_guard<std::mutex> l(m_lock);
+    std::vector<BlockMaterial>().swap(m_materials);
+    std::unordered_map<BlockMaterial, ui32, MaterialHash>().swap(m_indices);
+    m_numUploaded = 0;
+}
+
+void ChunkMaterialTable::dispose() {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (m_texture) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+    if (m_buffer) {
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+    }
+    m_capacity = 0;
+    m_numUploaded = 0;
+}
@@ -0,0 +1,68 @@
+///
+/// ChunkMaterialTable.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Global table of the BlockMaterials referenced by packed chunk meshes.
+/// Mesher threads add materials, the render thread mirrors them into a
+/// texture buffer the packed block shaders read from.
+///
+
+#pragma once
+
+#ifndef ChunkMaterialTable_h__
+#define ChunkMaterialTable_h__
+
+#include <mutex>
+#include <unordered_map>
+#include <Vorb/graphics/gtypes.h>
+
+#include "Vertex.h"
+
+class ChunkMaterialTable {
+public:
+    /// Returns the index of material, adding it if it's new. Thread safe.
+    ui32 getIndex(const BlockMaterial& material);
+
+    /// Uploads materials added since the last call. Call on render thread
+    /// before drawing any mesh that could use them.
+    void update();
+    /// Frees the GPU buffer. Indices stay valid and update uploads them again.
+    void dispose();
+    /// Forgets every material, so the table doesn't grow across worlds. Indices
+    /// handed out before are invalid, so only call once their meshes are gone.
+    /// The GPU buffer is kept and refilled by update.
+    void clear();
+
+    /// Texture buffer of GL_RG32UI texels, 3 per material, holding the BlockMaterial bytes:
+    /// texel 0: texturePosition, normTexturePosition
+    /// texel 1: dispTexturePosition, textureDims and overlayTextureDims
+    /// texel 2: color and blendMode, overlayColor and animationLength
+    VGTexture getTexture() const { return m_texture; }
+private:
+    struct MaterialHash {
+        size_t operator()(const BlockMaterial& m) const {
+            const ui32* words = (const ui32*)&m;
+            size_t h = 0;
+            for (size_t i = 0; i < sizeof(BlockMaterial) / sizeof(ui32); i++) {
+                h = h * 31 + std::hash<ui32>()(words[i]);
+            }
+            return h;
+        }
+    };
+
+    std::mutex m_lock;
+    std::vector<BlockMaterial> m_materials;
+    std::unordered_map<BlockMaterial, ui32, MaterialHash> m_indices;
+
+    VGBuffer m_buffer = 0;
+    VGTexture m_texture = 0;
+    size_t m_capacity = 0; ///< Materials the buffer can hold
+    size_t m_numUploaded = 0;
+};
+
+#endif // ChunkMaterialTable_h__
@@ -23,6 +23,35 @@ ChunkMeshData::ChunkMeshData(MeshTaskType type) : type(type) {
     // Empty
 }
 
+void ChunkMeshData::reset(MeshTaskType type) {
+    this->type = type;
+    chunkMeshRenderData = ChunkMeshRenderData();
+    opaqueQuads.clear();
+    transQuads.clear();
+    cutoutQuads.clear();
+    waterVertices.clear();
+    isPacked = false;
+    packedOpaqueQuads.clear();
+    packedCutoutQuads.clear();
+    remeshRegions = ALL_MESH_REGIONS;
+    memset(&regionLayout, 0, sizeof(regionLayout));
+    layoutVersion = 0;
+    transVertIndex = 0;
+    transQuadPositions.clear();
+    transQuadIndices.clear();
+}
+
+size_t ChunkMeshData::getCapacityBytes() const {
+    return opaqueQuads.capacity() * sizeof(VoxelQuad) +
+        transQuads.capacity() * sizeof(VoxelQuad) +
+        cutoutQuads.capacity() * sizeof(VoxelQuad) +
+        waterVertices.capacity() * sizeof(LiquidVertex) +
+        packedOpaqueQuads.capacity() * sizeof(PackedVoxelQuad) +
+        packedCutoutQuads.capacity() * sizeof(PackedVoxelQuad) +
+        transQuadPositions.capacity() * sizeof(i8v3) +
+        transQuadIndices.capacity() * sizeof(ui32);
+}
+
 void ChunkMeshData::addTransQuad(const i8v3& pos) {
     transQuadPositions.push_back(pos);
 
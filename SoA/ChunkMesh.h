@@ -1,4 +1,5 @@
 #pragma once
+#include "Constants.h"
 #include "Vertex.h"
 #include "BlockTextureMethods.h"
 #include "ChunkHandle.h"
@@ -66,6 +67,20 @@ struct VoxelQuad {
     };
 };
 
+struct PackedVoxelQuad {
+    PackedBlockVertex verts[4];
+};
+
+// Where each face's quads for each mesh region live in the opaque VBO.
+// Slots have spare capacity so a region can be remeshed in place.
+// Only the opaque VBO is patched. Cutout quads are rebuilt in full on every
+// remesh, and the mesher doesn't build transparent or liquid quads yet.
+struct ChunkMeshRegionLayout {
+    ui32 offset[6][NUM_MESH_REGIONS]; ///< In quads
+    ui32 capacity[6][NUM_MESH_REGIONS]; ///< In quads
+    ui32 count[6][NUM_MESH_REGIONS]; ///< Quads in use at the start of each slot. Only these are drawn.
+};
+
 class ChunkMeshData
 {
 public:
@@ -73,6 +88,10 @@ class ChunkMeshData
     ChunkMeshData::ChunkMeshData(MeshTaskType type);
 
     void addTransQuad(const i8v3& pos);
+    /// Empties the data for reuse, keeping the capacity of the vectors
+    void reset(MeshTaskType type);
+    /// Bytes reserved by the vectors
+    size_t getCapacityBytes() const;
 
     ChunkMeshRenderData chunkMeshRenderData;
 
@@ -83,6 +102,16 @@ class ChunkMeshData
     std::vector <LiquidVertex> waterVertices;
     MeshTaskType type;
 
+    // When packed, the opaque and cutout quads are in these instead
+    bool isPacked = false;
+    std::vector <PackedVoxelQuad> packedOpaqueQuads;
+    std::vector <PackedVoxelQuad> packedCutoutQuads;
+
+    // Regions contained in opaqueQuads. Anything but ALL_MESH_REGIONS patches the existing mesh.
+    ui32 remeshRegions = ALL_MESH_REGIONS;
+    ChunkMeshRegionLayout regionLayout;
+    ui32 layoutVersion = 0; ///< ChunkMesh::layoutVersion a partial remesh was built against
+
     //*** Transparency info for sorting ***
     ui32 transVertIndex = 0;
     std::vector <i8v3> transQuadPositions;
@@ -125,8 +154,13 @@ class ChunkMesh
     ui32 updateVersion;
     bool inFrustum = false;
     bool needsSort = true;
+    bool isPacked = false; ///< Opaque and cutout VBOs hold PackedVoxelQuads
     ChunkID id;
 
+    ChunkMeshRegionLayout regionLayout;
+    ui32 layoutVersion = 0; ///< Incremented on every full upload
+    ui32 pendingTasks = 0; ///< Mesh tasks in flight for this mesh
+
     //*** Transparency info for sorting ***
     VGIndexBuffer transIndexID = 0;
     std::vector<i8v3> transQuadPositions;
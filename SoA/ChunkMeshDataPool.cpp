@@ -0,0 +1,68 @@
+#include "stdafx.h"
+#include "ChunkMeshDataPool.h"
+
+// Enough for every worker to have a few in flight
+#define MAX_POOLED_MESH_DATA 128
+// Outliers give their memory back so one huge mesh doesn't pin it forever
+#define MAX_POOLED_MESH_DATA_BYTES (2 * 1024 * 1024)
+
+ChunkMeshDataPool::~ChunkMeshDataPool() {
+    clear();
+}
+
+ChunkMeshData* ChunkMeshDataPool::acquire(MeshTaskType type) {
+    ChunkMeshData* data = nullptr;
+    {
+        std::lock_guard<std::mutex> l(m_lock);
+        m_stats.numAcquires++;
+        if (m_free.size()) {
+            data = m_free.back();
+            m_free.pop_back();
+            m_stats.numHits++;
+            m_stats.numPooled--;
+            m_stats.pooledBytes -= data->getCapacityBytes();
+        }
+    }
+    if (!data) return new ChunkMeshData(type);
+    data->type = type;
+    return data;
+}
+
+void ChunkMeshDataPool::recycle(CALLEE_DELETE ChunkMeshData* data) {
+    if (!data) return;
+    // Clear outside the lock, it's the expensive part
+    size_t bytes = data->getCapacityBytes();
+    if (bytes > MAX_POOLED_MESH_DATA_BYTES) {
+        delete data;
+        return;
+    }
+    data->reset(MeshTaskType::DEFAULT);
+
+    std::lock_guard<std::mutex> l(m_lock);
+    if (m_free.size() >= MAX_POOLED_MESH_DATA) {
+        delete data;
+        return;
+    }
+    m_free.push_back(data);
+    m_stats.numPooled++;
+    m_stats.pooledBytes += bytes;
+    if (m_stats.pooledBytes > m_stats.peakPooledBytes) m_stats.peakPooledBytes = m_stats.pooledBytes;
+}
+
+void ChunkMeshDataPool::clear() {
+    std::lock_guard<std::mutex> l(m_lock);
+    for (auto& data : m_free) delete data;
+    std::vector<ChunkMeshData*>().swap(m_free);
+    m_stats.numPooled = 0;
+    m_stats.pooledBytes = 0;
+}
+
+void ChunkMeshDataPool::recordMesherBytes(size_t bytes) {
+    std::lock_guard<std::mutex> l(m_lock);
+    if (bytes > m_stats.peakMesherBytes) m_stats.peakMesherBytes = bytes;
+}
+
+ChunkMeshDataPoolStats ChunkMeshDataPool::getStats() {
+    std::lock_guard<std::mutex> l(m_lock);
+    return m_stats;
+}
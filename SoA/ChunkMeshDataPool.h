@@ -0,0 +1,54 @@
+///
+/// ChunkMeshDataPool.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Recycles ChunkMeshData between mesh tasks so their vectors keep
+/// their capacity instead of going back to the heap after every upload.
+///
+
+#pragma once
+
+#ifndef ChunkMeshDataPool_h__
+#define ChunkMeshDataPool_h__
+
+#include <mutex>
+
+#include "ChunkMesh.h"
+
+struct ChunkMeshDataPoolStats {
+    ui64 numAcquires = 0;
+    ui64 numHits = 0; ///< Acquires that reused pooled data
+    size_t numPooled = 0;
+    size_t pooledBytes = 0; ///< Capacity held by pooled data
+    size_t peakPooledBytes = 0;
+    size_t peakMesherBytes = 0; ///< Most held by any one worker's ChunkMesher
+
+    f32 getHitRate() const { return numAcquires ? (f32)numHits / (f32)numAcquires : 0.0f; }
+};
+
+class ChunkMeshDataPool {
+public:
+    ~ChunkMeshDataPool();
+
+    /// Thread safe. Reuses pooled data when there is any. Give it back with recycle().
+    ChunkMeshData* acquire(MeshTaskType type);
+    /// Thread safe. Takes ownership of data and keeps it for the next acquire.
+    void recycle(CALLEE_DELETE ChunkMeshData* data);
+    /// Frees all pooled data
+    void clear();
+    /// Thread safe. Records the transient bytes of a mesher that uses this pool.
+    void recordMesherBytes(size_t bytes);
+
+    ChunkMeshDataPoolStats getStats();
+private:
+    std::mutex m_lock;
+    std::vector<ChunkMeshData*> m_free;
+    ChunkMeshDataPoolStats m_stats;
+};
+
+#endif // ChunkMeshDataPool_h__
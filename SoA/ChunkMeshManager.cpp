@@ -1,23 +1,41 @@
 #include "stdafx.h"
 #include "ChunkMeshManager.h"
 
+#include <algorithm>
+
 #include "ChunkMesh.h"
 #include "ChunkMeshTask.h"
 #include "ChunkMesher.h"
 #include "ChunkRenderer.h"
+#include "Frustum.h"
+#include "SoaOptions.h"
 #include "SpaceSystemComponents.h"
 #include "soaUtils.h"
 
 #define MAX_UPDATES_PER_FRAME 300
+#define MAX_MESH_TASKS_PER_FRAME 32
+#define MAX_MESH_TASKS_IN_FLIGHT 128
+// Score multipliers. Scores are squared distances, so 4.0 counts as twice as far.
+#define MESH_OUT_OF_FRUSTUM_PENALTY 4.0
+#define MESH_RECENT_EDIT_BONUS 0.0625
+#define MESH_RECENT_EDIT_FRAMES 120
+// In flight tasks this much worse than the best pending mesh get cancelled
+#define MESH_STALE_SCORE_RATIO 16.0
+#define MESH_MIN_CANCEL_SCORE (f64)(CHUNK_WIDTH * CHUNK_WIDTH * 4)
+
+const f64v3 CHUNK_DIMS(CHUNK_WIDTH);
 
 ChunkMeshManager::ChunkMeshManager(vcore::ThreadPool<WorkerData>* threadPool, BlockPack* blockPack) {
     m_threadPool = threadPool;
     m_blockPack = blockPack;
+    m_frame = 1;
     SpaceSystemAssemblages::onAddSphericalVoxelComponent += makeDelegate(*this, &ChunkMeshManager::onAddSphericalVoxelComponent);
     SpaceSystemAssemblages::onRemoveSphericalVoxelComponent += makeDelegate(*this, &ChunkMeshManager::onRemoveSphericalVoxelComponent);
 }
 
-void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
+void ChunkMeshManager::update(const f64v3& cameraPosition, const Frustum* frustum, bool shouldSort) {
+    m_frame++;
+
     ChunkMeshUpdateMessage updateBuffer[MAX_UPDATES_PER_FRAME];
     size_t numUpdates;
     if (numUpdates = m_messages.try_dequeue_bulk(updateBuffer, MAX_UPDATES_PER_FRAME)) {
@@ -27,22 +45,88 @@ void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
     }
 
     // Update pending meshes
+    f64 bestScore = -1.0;
     {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
-        for (auto it = m_pendingMesh.begin(); it != m_pendingMesh.end();) {
-            ChunkMeshTask* task = createMeshTask(it->second);
-            if (task) {
-                {
-                    std::lock_guard<std::mutex> l(m_lckActiveChunks);
-                    m_activeChunks[it->first]->updateVersion = it->second->updateVersion;
+        // Near, visible and freshly edited chunks go first
+        m_meshQueue.clear();
+        for (auto it = m_pendingMesh.begin(); it != m_pendingMesh.end(); ++it) {
+            f64v3 position(it->second.chunk->getVoxelPosition().pos);
+            m_meshQueue.emplace_back(getMeshScore(position, cameraPosition, frustum, it->second.editFrame), it);
+        }
+        std::sort(m_meshQueue.begin(), m_meshQueue.end(),
+                  [](const std::pair<f64, PendingMeshMap::iterator>& a,
+                     const std::pair<f64, PendingMeshMap::iterator>& b) {
+            return a.first < b.first;
+        });
+
+        ui32 numSent = 0;
+        for (auto& e : m_meshQueue) {
+            if (numSent >= MAX_MESH_TASKS_PER_FRAME || m_numInFlight >= MAX_MESH_TASKS_IN_FLIGHT) break;
+            ChunkHandle& chunk = e.second->second.chunk;
+            ChunkMeshTask* task = createMeshTask(chunk);
+            if (!task) continue;
+            if (bestScore < 0.0) bestScore = e.first;
+
+            ui32 dirtyRegions;
+            {
+                std::lock_guard<std::mutex> l(chunk->dataMutex);
+                dirtyRegions = chunk->dirtyMeshRegions;
+                chunk->dirtyMeshRegions = 0;
+            }
+            bool isMeshGone = false;
+            {
+                std::lock_guard<std::mutex> l(m_lckActiveChunks);
+                auto it = m_activeChunks.find(chunk.getID());
+                if (it == m_activeChunks.end()) {
+                    isMeshGone = true;
+                } else {
+                    ChunkMesh* mesh = it->second;
+                    mesh->updateVersion = chunk->updateVersion;
+                    task->usePackedVertices = soaOptions.get(OPT_PACKED_CHUNK_VERTICES).value.b;
+                    // Small edits patch the uploaded mesh, unless another task could still replace it
+                    if (dirtyRegions && dirtyRegions != ALL_MESH_REGIONS &&
+                        mesh->vboID != 0 && mesh->pendingTasks == 0) {
+                        task->remeshRegions = dirtyRegions;
+                        task->regionLayout = mesh->regionLayout;
+                        task->layoutVersion = mesh->layoutVersion;
+                        // Patches have to match the format of the uploaded mesh
+                        task->usePackedVertices = mesh->isPacked;
+                    }
+                    mesh->pendingTasks++;
+                }
+            }
+            if (isMeshGone) {
+                // onNeighborsRelease dropped the mesh after the entry was requeued
+                task->chunk.release();
+                for (int i = 0; i < NUM_NEIGHBOR_HANDLES; i++) {
+                    task->neighborHandles[i].release();
                 }
-                m_threadPool->addTask(task);
-                it->second.release();
-                m_pendingMesh.erase(it++);
-            } else {
-                ++it;
+                delete task;
+                chunk.release();
+                m_pendingMesh.erase(e.second);
+                continue;
             }
+            {
+                std::lock_guard<std::mutex> l(m_lckInFlight);
+                InFlightMesh& inFlight = m_inFlight[chunk.getID()];
+                inFlight.position = f64v3(chunk->getVoxelPosition().pos);
+                inFlight.numTasks++;
+                inFlight.isCancelled = false;
+            }
+            m_numInFlight++;
+            numSent++;
+            m_threadPool->addTask(task);
+            chunk.release();
+            m_pendingMesh.erase(e.second);
         }
+        // Don't keep iterators around past the lock
+        m_meshQueue.clear();
+    }
+
+    // Make room for the pending meshes if the camera moved away from the queued ones
+    if (bestScore >= 0.0 && m_numInFlight >= MAX_MESH_TASKS_IN_FLIGHT) {
+        cancelStaleTasks(cameraPosition, frustum, bestScore);
     }
 
     // TODO(Ben): This is redundant with the chunk manager! Find a way to share! (Pointer?)
@@ -52,7 +136,30 @@ void ChunkMeshManager::update(const f64v3& cameraPosition, bool shouldSort) {
     }
 }
 
+bool ChunkMeshManager::isMeshTaskCancelled(const ChunkID& id) {
+    std::lock_guard<std::mutex> l(m_lckInFlight);
+    auto it = m_inFlight.find(id);
+    return it != m_inFlight.end() && it->second.isCancelled;
+}
+
+void ChunkMeshManager::requeueMesh(ChunkHandle& chunk) {
+    {
+        std::lock_guard<std::mutex> l(m_lckActiveChunks);
+        // The mesh was released while the task was queued
+        if (m_activeChunks.find(chunk.getID()) == m_activeChunks.end()) return;
+    }
+    std::lock_guard<std::mutex> l(m_lckPendingMesh);
+    if (m_pendingMesh.find(chunk.getID()) == m_pendingMesh.end()) {
+        m_pendingMesh.emplace(chunk.getID(), PendingMesh(chunk.acquire(), 0));
+    }
+}
+
 void ChunkMeshManager::destroy() {
+    ChunkMeshUpdateMessage message;
+    while (m_messages.try_dequeue(message)) {
+        m_meshDataPool.recycle(message.meshData);
+    }
+    m_meshDataPool.clear();
     std::vector <ChunkMesh*>().swap(m_activeChunkMeshes);
     moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage>().swap(m_messages);
     std::unordered_map<ChunkID, ChunkMesh*>().swap(m_activeChunks);
@@ -74,6 +181,9 @@ ChunkMesh* ChunkMeshManager::createMesh(ChunkHandle& h) {
     memset(mesh->vaos, 0, sizeof(mesh->vaos));
     mesh->transIndexID = 0;
     mesh->activeMeshesIndex = ACTIVE_MESH_INDEX_NONE;
+    mesh->layoutVersion = 0;
+    mesh->pendingTasks = 0;
+    mesh->isPacked = false;
 
     { // Register chunk as active and give it a mesh
         std::lock_guard<std::mutex> l(m_lckActiveChunks);
@@ -137,17 +247,29 @@ void ChunkMeshManager::disposeMesh(ChunkMesh* mesh) {
 }
 
 void ChunkMeshManager::updateMesh(ChunkMeshUpdateMessage& message) {
+    { // This task is no longer in flight
+        std::lock_guard<std::mutex> l(m_lckInFlight);
+        auto it = m_inFlight.find(message.chunkID);
+        if (it != m_inFlight.end() && --it->second.numTasks == 0) {
+            m_inFlight.erase(it);
+        }
+        m_numInFlight--;
+    }
+
     ChunkMesh *mesh;
     { // Get the mesh object
         std::lock_guard<std::mutex> l(m_lckActiveChunks);
         auto& it = m_activeChunks.find(message.chunkID);
         if (it == m_activeChunks.end()) {
-            delete message.meshData;
+            m_meshDataPool.recycle(message.meshData);
             return; /// The mesh was already released, so ignore!
         }
         mesh = it->second;
     }
-    
+    if (mesh->pendingTasks) mesh->pendingTasks--;
+    // Cancelled, the chunk is pending again
+    if (!message.meshData) return;
+
     if (ChunkMesher::uploadMeshData(*mesh, message.meshData)) {
         // Add to active list if its not there
         std::lock_guard<std::mutex> l(lckActiveChunkMeshes);
@@ -167,12 +289,11 @@ void ChunkMeshManager::updateMesh(ChunkMeshUpdateMessage& message) {
         }
     }
 
-    // TODO(Ben): come on...
-    delete message.meshData;
+    // Keep the capacity around for the next task
+    m_meshDataPool.recycle(message.meshData);
 }
 
 void ChunkMeshManager::updateMeshDistances(const f64v3& cameraPosition) {
-    static const f64v3 CHUNK_DIMS(CHUNK_WIDTH);
     // TODO(Ben): Spherical instead?
     std::lock_guard<std::mutex> l(lckActiveChunkMeshes);
     for (auto& mesh : m_activeChunkMeshes) { //update distances for all chunk meshes
@@ -183,6 +304,29 @@ void ChunkMeshManager::updateMeshDistances(const f64v3& cameraPosition) {
     }
 }
 
+f64 ChunkMeshManager::getMeshScore(const f64v3& chunkPosition, const f64v3& cameraPosition,
+                                  const Frustum* frustum, ui32 editFrame) const {
+    f64v3 closestPoint = getClosestPointOnAABB(cameraPosition, chunkPosition, CHUNK_DIMS);
+    f64 score = selfDot(closestPoint - cameraPosition);
+    if (frustum) {
+        f32v3 relCenter(chunkPosition + f64v3(CHUNK_WIDTH / 2) - cameraPosition);
+        if (!frustum->sphereInFrustum(relCenter, CHUNK_DIAGONAL_LENGTH)) score *= MESH_OUT_OF_FRUSTUM_PENALTY;
+    }
+    // Players want to see their edits right away
+    if (editFrame && m_frame - editFrame < MESH_RECENT_EDIT_FRAMES) score *= MESH_RECENT_EDIT_BONUS;
+    return score;
+}
+
+void ChunkMeshManager::cancelStaleTasks(const f64v3& cameraPosition, const Frustum* frustum, f64 bestScore) {
+    f64 maxScore = vmath::max(bestScore, MESH_MIN_CANCEL_SCORE) * MESH_STALE_SCORE_RATIO;
+    std::lock_guard<std::mutex> l(m_lckInFlight);
+    for (auto& it : m_inFlight) {
+        if (getMeshScore(it.second.position, cameraPosition, frustum, 0) > maxScore) {
+            it.second.isCancelled = true;
+        }
+    }
+}
+
 void ChunkMeshManager::onAddSphericalVoxelComponent(Sender s, SphericalVoxelComponent& cmp, vecs::EntityID e) {
     for (ui32 i = 0; i < 6; i++) {
         for (ui32 j = 0; j < cmp.chunkGrids[i].numGenerators; j++) {
@@ -203,13 +347,15 @@ void ChunkMeshManager::onRemoveSphericalVoxelComponent(Sender s, SphericalVoxelC
         cmp.chunkGrids[i].onNeighborsRelease -= makeDelegate(*this, &ChunkMeshManager::onNeighborsRelease);
         Chunk::DataChange -= makeDelegate(*this, &ChunkMeshManager::onDataChange);
     }
+    // The materials belong to the meshes of the world that is going away
+    ChunkRenderer::materialTable.clear();
 }
 
 void ChunkMeshManager::onGenFinish(Sender s, ChunkHandle& chunk, ChunkGenLevel gen) {
     // Check if can be meshed.
     if (chunk->genLevel == GEN_DONE && chunk->left.isAquired() && chunk->numBlocks) {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
-        m_pendingMesh.emplace(chunk.getID(), chunk.acquire());
+        m_pendingMesh.emplace(chunk.getID(), PendingMesh(chunk.acquire(), 0));
     }
 }
 
@@ -218,7 +364,7 @@ void ChunkMeshManager::onNeighborsAcquire(Sender s, ChunkHandle& chunk) {
     // Check if can be meshed.
     if (chunk->genLevel == GEN_DONE && chunk->numBlocks) {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
-        m_pendingMesh.emplace(chunk.getID(), chunk.acquire());
+        m_pendingMesh.emplace(chunk.getID(), PendingMesh(chunk.acquire(), 0));
     }
 }
 
@@ -239,7 +385,7 @@ void ChunkMeshManager::onNeighborsRelease(Sender s, ChunkHandle& chunk) {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
         auto& it = m_pendingMesh.find(chunk.getID());
         if (it != m_pendingMesh.end()) {
-            it->second.release();
+            it->second.chunk.release();
             m_pendingMesh.erase(it);
         }
     }
@@ -252,6 +398,11 @@ void ChunkMeshManager::onDataChange(Sender s, ChunkHandle& chunk) {
     // TODO(Ben): Race condition with neighbor removal here.
     if (chunk->left.isAquired()) {
         std::lock_guard<std::mutex> l(m_lckPendingMesh);
-        m_pendingMesh.emplace(chunk.getID(), chunk.acquire());
+        auto it = m_pendingMesh.find(chunk.getID());
+        if (it == m_pendingMesh.end()) {
+            m_pendingMesh.emplace(chunk.getID(), PendingMesh(chunk.acquire(), m_frame));
+        } else {
+            it->second.editFrame = m_frame;
+        }
     }
 }
@@ -19,26 +19,39 @@
 #include "concurrentqueue.h"
 #include "Chunk.h"
 #include "ChunkMesh.h"
+#include "ChunkMeshDataPool.h"
 #include "SpaceSystemAssemblages.h"
+#include <atomic>
 #include <mutex>
 
+class Frustum;
+
 struct ChunkMeshUpdateMessage {
     ChunkID chunkID;
-    ChunkMeshData* meshData = nullptr;
+    ChunkMeshData* meshData = nullptr; ///< nullptr if the task was cancelled
 };
 
 class ChunkMeshManager {
 public:
     ChunkMeshManager(vcore::ThreadPool<WorkerData>* threadPool, BlockPack* blockPack);
-    /// Updates the meshManager, uploading any needed meshes
-    void update(const f64v3& cameraPosition, bool shouldSort);
+    /// Updates the meshManager, uploading any needed meshes and
+    /// sending the most important pending meshes to the thread pool
+    /// @param frustum: Optional view frustum, relative to cameraPosition
+    void update(const f64v3& cameraPosition, const Frustum* frustum, bool shouldSort);
     /// Adds a mesh for updating
     void sendMessage(const ChunkMeshUpdateMessage& message) { m_messages.enqueue(message); }
+
+    /// Thread safe. True if a queued mesh task for this chunk should be dropped.
+    bool isMeshTaskCancelled(const ChunkID& id);
+    /// Thread safe. Puts a chunk whose task was cancelled back in the pending list.
+    void requeueMesh(ChunkHandle& chunk);
     /// Destroys all meshes
     void destroy();
 
     // Be sure to lock lckActiveChunkMeshes
     const std::vector <ChunkMesh*>& getChunkMeshes() { return m_activeChunkMeshes; }
+    /// Thread safe. Mesh data sent back in ChunkMeshUpdateMessage comes from here.
+    ChunkMeshDataPool& getMeshDataPool() { return m_meshDataPool; }
     std::mutex lckActiveChunkMeshes;
 private:
     VORB_NON_COPYABLE(ChunkMeshManager);
@@ -54,6 +67,12 @@ class ChunkMeshManager {
 
     void updateMeshDistances(const f64v3& cameraPosition);
 
+    /// Lower scores mesh first
+    f64 getMeshScore(const f64v3& chunkPosition, const f64v3& cameraPosition,
+                     const Frustum* frustum, ui32 editFrame) const;
+    /// Cancels in flight tasks that are much less important than the best pending mesh
+    void cancelStaleTasks(const f64v3& cameraPosition, const Frustum* frustum, f64 bestScore);
+
     /************************************************************************/
     /* Event Handlers                                                       */
     /************************************************************************/
@@ -69,12 +88,32 @@ class ChunkMeshManager {
     /************************************************************************/
     std::vector<ChunkMesh*> m_activeChunkMeshes; ///< Meshes that should be drawn
     moodycamel::ConcurrentQueue<ChunkMeshUpdateMessage> m_messages; ///< Lock-free queue of messages
+    ChunkMeshDataPool m_meshDataPool;
    
     BlockPack* m_blockPack = nullptr;
     vcore::ThreadPool<WorkerData>* m_threadPool = nullptr;
 
+    struct PendingMesh {
+        PendingMesh(ChunkHandle&& chunk, ui32 editFrame) : chunk(std::move(chunk)), editFrame(editFrame) {}
+        // Copying a handle doesn't keep it acquired, so this has to move
+        PendingMesh(PendingMesh&& other) : chunk(std::move(other.chunk)), editFrame(other.editFrame) {}
+        ChunkHandle chunk;
+        ui32 editFrame; ///< Frame of the last data change, 0 if it was never edited
+    };
+    typedef std::unordered_map<ChunkID, PendingMesh> PendingMeshMap;
     std::mutex m_lckPendingMesh;
-    std::map<ChunkID, ChunkHandle> m_pendingMesh;
+    PendingMeshMap m_pendingMesh;
+    std::vector<std::pair<f64, PendingMeshMap::iterator> > m_meshQueue; ///< Pending meshes sorted by score
+
+    struct InFlightMesh {
+        f64v3 position;
+        ui32 numTasks = 0;
+        bool isCancelled = false;
+    };
+    std::mutex m_lckInFlight;
+    std::unordered_map<ChunkID, InFlightMesh> m_inFlight; ///< Chunks with queued mesh tasks
+    ui32 m_numInFlight = 0; ///< Total tasks in flight. Render thread only.
+    std::atomic<ui32> m_frame; ///< Read by onDataChange on other threads
 
     std::mutex m_lckMeshRecycler;
     PtrRecycler<ChunkMesh> m_meshRecycler;
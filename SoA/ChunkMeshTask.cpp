@@ -9,23 +9,34 @@
 #include "ChunkMesher.h"
 #include "GameManager.h"
 #include "Chunk.h"
+#include "SoaOptions.h"
 #include "VoxelLightEngine.h"
 #include "VoxelUtils.h"
 
 void ChunkMeshTask::execute(WorkerData* workerData) {
+    // The camera moved away while we were queued
+    if (meshManager->isMeshTaskCancelled(chunk.getID())) {
+        cancel();
+        return;
+    }
+
     // Mesh updates are accompanied by light updates // TODO(Ben): Seems wasteful.
     if (workerData->voxelLightEngine == nullptr) {
         workerData->voxelLightEngine = new VoxelLightEngine();
     }
     
-    // TODO(Ben): Lighting
-    // updateLight(workerData->voxelLightEngine);
+    updateLight(workerData->voxelLightEngine);
     
     // Lazily allocate chunkMesher // TODO(Ben): Seems wasteful.
     if (workerData->chunkMesher == nullptr) {
         workerData->chunkMesher = new ChunkMesher;
         workerData->chunkMesher->init(blockPack);
     }
+    workerData->chunkMesher->mesherType = soaOptions.get(OPT_GREEDY_MESHING).value.b ?
+        ChunkMesherType::GREEDY : ChunkMesherType::DEFAULT;
+    workerData->chunkMesher->usePackedVertices = usePackedVertices;
+    workerData->chunkMesher->meshDataPool = &meshManager->getMeshDataPool();
+
     // Prepare message
     ChunkMeshUpdateMessage msg;
     msg.chunkID = chunk.getID();
@@ -34,7 +45,12 @@ void ChunkMeshTask::execute(WorkerData* workerData) {
     workerData->chunkMesher->prepareDataAsync(chunk, neighborHandles);
 
     // Create the actual mesh
-    msg.meshData = workerData->chunkMesher->createChunkMeshData(type);
+    if (remeshRegions != ALL_MESH_REGIONS) {
+        msg.meshData = workerData->chunkMesher->createChunkMeshData(type, remeshRegions, &regionLayout);
+        msg.meshData->layoutVersion = layoutVersion;
+    } else {
+        msg.meshData = workerData->chunkMesher->createChunkMeshData(type);
+    }
 
     // Send it for update
     meshManager->sendMessage(msg);
@@ -42,18 +58,31 @@ void ChunkMeshTask::execute(WorkerData* workerData) {
 
 void ChunkMeshTask::init(ChunkHandle& ch, MeshTaskType cType, const BlockPack* blockPack, ChunkMeshManager* meshManager) {
     type = cType;
+    remeshRegions = ALL_MESH_REGIONS;
+    usePackedVertices = false;
     chunk = ch.acquire();
     this->blockPack = blockPack;
     this->meshManager = meshManager;
 }
 
-// TODO(Ben): uhh
+void ChunkMeshTask::cancel() {
+    {
+        // Keep the regions dirty so the next task remeshes them
+        std::lock_guard<std::mutex> l(chunk->dataMutex);
+        chunk->dirtyMeshRegions |= remeshRegions;
+    }
+    meshManager->requeueMesh(chunk);
+
+    ChunkMeshUpdateMessage msg;
+    msg.chunkID = chunk.getID();
+    chunk.release();
+    for (int i = 0; i < NUM_NEIGHBOR_HANDLES; i++) {
+        neighborHandles[i].release();
+    }
+    meshManager->sendMessage(msg);
+}
+
 void ChunkMeshTask::updateLight(VoxelLightEngine* voxelLightEngine) {
-    /* if (chunk->sunRemovalList.size()) {
-         voxelLightEngine->calculateSunlightRemoval(chunk);
-         }
-         if (chunk->sunExtendList.size()) {
-         voxelLightEngine->calculateSunlightExtend(chunk);
-         }
-         voxelLightEngine->calculateLight(chunk);*/
+    // Relight edited voxels first so the mesh sees the new light
+    voxelLightEngine->updateChunkLight(chunk, blockPack);
 }
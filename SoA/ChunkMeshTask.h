@@ -18,6 +18,7 @@
 #include <Vorb/IThreadPoolTask.h>
 
 #include "ChunkHandle.h"
+#include "ChunkMesh.h"
 #include "Constants.h"
 #include "VoxPool.h"
 
@@ -59,7 +60,15 @@ class ChunkMeshTask : public vcore::IThreadPoolTask<WorkerData> {
     ChunkMeshManager* meshManager = nullptr;
     const BlockPack* blockPack = nullptr;
     ChunkHandle neighborHandles[NUM_NEIGHBOR_HANDLES];
+
+    // Regions to remesh in place. ALL_MESH_REGIONS builds a full mesh.
+    ui32 remeshRegions = ALL_MESH_REGIONS;
+    ChunkMeshRegionLayout regionLayout; ///< Layout of the mesh being patched
+    ui32 layoutVersion = 0;
+    bool usePackedVertices = false; ///< Build PackedVoxelQuads
 private:
+    /// Releases the chunks and hands the chunk back to the mesh manager
+    void cancel();
     void updateLight(VoxelLightEngine* voxelLightEngine);
 };
 
@@ -12,6 +12,7 @@
 
 #include "BlockPack.h"
 #include "Chunk.h"
+#include "ChunkMeshDataPool.h"
 #include "ChunkMeshTask.h"
 #include "ChunkRenderer.h"
 #include "Errors.h"
@@ -19,10 +20,14 @@
 #include "SoaOptions.h"
 #include "VoxelBits.h"
 #include "VoxelMesher.h"
+#include "VoxelRunKernels.h"
 #include "VoxelUtils.h"
 
 #define GETBLOCK(a) blocks->operator[](a)
 
+// Quads reserved per face up front, so workers don't grow them while warming up
+#define MESHER_QUAD_RESERVE 1024
+
 const float LIGHT_MULT = 0.95f, LIGHT_OFFSET = -0.2f;
 
 const int MAXLIGHT = 31;
@@ -60,10 +65,65 @@ const int FACE_AXIS[6][2] = { { 2, 1 }, { 2, 1 }, { 0, 2 }, { 0, 2 }, { 0, 1 },
 
 const int FACE_AXIS_SIGN[6][2] = { { 1, 1 }, { -1, 1 }, { 1, 1 }, { -1, 1 }, { -1, 1 }, { 1, 1 } };
 
+// Padded index offset to the neighbor each face looks at
+const int FACE_NEIGHBOR_OFFSET[6] = { -1, 1, -PADDED_LAYER, PADDED_LAYER, -PADDED_WIDTH, PADDED_WIDTH };
+// Up, front and right offsets passed to computeAmbientOcclusion for each face
+const int FACE_AO_OFFSETS[6][3] = {
+    { -1, -PADDED_LAYER, PADDED_WIDTH },
+    { 1, -PADDED_LAYER, -PADDED_WIDTH },
+    { -PADDED_LAYER, PADDED_WIDTH, 1 },
+    { PADDED_LAYER, -PADDED_WIDTH, -1 },
+    { -PADDED_WIDTH, -PADDED_LAYER, -1 },
+    { PADDED_WIDTH, -PADDED_LAYER, 1 }
+};
+
 PlanetHeightData ChunkMesher::defaultChunkHeightData[CHUNK_LAYER] = {};
 
+// Converts a chunk block index to an index into the padded arrays
+inline int getPaddedBlockIndex(int c) {
+    return (c / CHUNK_LAYER + 1) * PADDED_LAYER + ((c / CHUNK_WIDTH) % CHUNK_WIDTH + 1) * PADDED_WIDTH + (c % CHUNK_WIDTH + 1);
+}
+
+// Transposes a 32x32 bit matrix in place, so bit j of rows[i] becomes bit i of rows[j]
+inline void transposeBits32(ui32 rows[32]) {
+    ui32 mask = 0x0000FFFF;
+    for (int j = 16; j != 0; j >>= 1, mask ^= (mask << j)) {
+        for (int k = 0; k < 32; k = (k + j + 1) & ~j) {
+            ui32 t = ((rows[k] >> j) ^ rows[k + j]) & mask;
+            rows[k + j] ^= t;
+            rows[k] ^= (t << j);
+        }
+    }
+}
+
+// Spare quads given to every mesh region slot beyond a quarter of its size
+#define MESH_REGION_SLACK 2
+
+inline ui32 getRegionCapacity(ui32 numQuads) {
+    return numQuads + (numQuads >> 2) + MESH_REGION_SLACK;
+}
+
+// Mesh region of the voxel a quad was built from. Merging never moves v1 along y.
+inline int getQuadRegion(int face, const VoxelQuad& quad) {
+    return ((quad.v1.position.y - VoxelMesher::VOXEL_POSITIONS[face][1].y) / QUAD_SIZE) / MESH_REGION_HEIGHT;
+}
+
+// True when all four vertices share color and texturing, so the quad can be stretched
+inline bool isUniformQuad(const VoxelQuad& quad) {
+    return quad.v0 == quad.v1 && quad.v0 == quad.v2 && quad.v0 == quad.v3;
+}
+
+// True when quad can be absorbed by a rectangle started with the uniform quad base
+inline bool canMergeQuads(const VoxelQuad& base, const VoxelQuad& quad) {
+    return base.v0 == quad.v0 && isUniformQuad(quad) &&
+        base.v0.normTexturePosition == quad.v0.normTexturePosition &&
+        base.v0.dispTexturePosition == quad.v0.dispTexturePosition &&
+        base.v0.blendMode == quad.v0.blendMode;
+}
+
 void ChunkMesher::init(const BlockPack* blocks) {
     this->blocks = blocks;
+    m_hotTable = &blocks->getHotTable();
 
     // Set up the texture params
     m_textureMethodParams[X_NEG][B_INDEX].init(this, PADDED_CHUNK_WIDTH, PADDED_CHUNK_LAYER, -1, X_NEG, B_INDEX);
@@ -83,10 +143,25 @@ void ChunkMesher::init(const BlockPack* blocks) {
 
     m_textureMethodParams[Z_POS][B_INDEX].init(this, 1, PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, Z_POS, B_INDEX);
     m_textureMethodParams[Z_POS][O_INDEX].init(this, 1, PADDED_CHUNK_LAYER, PADDED_CHUNK_WIDTH, Z_POS, O_INDEX);
+
+    for (int i = 0; i < 6; i++) {
+        m_quads[i].reserve(MESHER_QUAD_RESERVE);
+    }
+    m_floraQuads.reserve(MESHER_QUAD_RESERVE);
+}
+
+size_t ChunkMesher::getTransientBytes() const {
+    size_t bytes = sizeof(ChunkMesher);
+    for (int i = 0; i < 6; i++) {
+        bytes += m_quads[i].capacity() * sizeof(VoxelQuad);
+    }
+    bytes += m_floraQuads.capacity() * sizeof(VoxelQuad);
+    bytes += _waterVboVerts.capacity() * sizeof(LiquidVertex);
+    return bytes;
 }
 
 void ChunkMesher::prepareData(const Chunk* chunk) {
-    int x, y, z, off1, off2;
+    int y, z, off1, off2;
 
     const Chunk* left = chunk->left;
     const Chunk* right = chunk->right;
@@ -94,10 +169,6 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
     const Chunk* top = chunk->top;
     const Chunk* back = chunk->back;
     const Chunk* front = chunk->front;
-    int wc;
-    int c = 0;
-
-    i32v3 pos;
 
     wSize = 0;
     chunkVoxelPos = chunk->getVoxelPosition();
@@ -113,67 +184,7 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
     memset(blockData, 0, sizeof(blockData));
     memset(tertiaryData, 0, sizeof(tertiaryData));
  
-    if (chunk->blocks.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-
-        int s = 0;
-        //block data
-        auto& dataTree = chunk->blocks.getTree();
-        for (size_t i = 0; i < dataTree.size(); i++) {
-            for (size_t j = 0; j < dataTree[i].length; j++) {
-                c = dataTree[i].getStart() + j;
-
-                getPosFromBlockIndex(c, pos);
-
-                wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-                blockData[wc] = dataTree[i].data;
-                if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                    m_wvec[s++] = wc;
-                }
-
-            }
-        }
-        wSize = s;
-    } else {
-        int s = 0;
-        for (y = 0; y < CHUNK_WIDTH; y++) {
-            for (z = 0; z < CHUNK_WIDTH; z++) {
-                for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                    wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                    blockData[wc] = chunk->blocks[c];
-                    if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                        m_wvec[s++] = wc;
-                    }
-                }
-            }
-        }
-        wSize = s;
-    }
-    if (chunk->tertiary.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-        //tertiary data
-        c = 0;
-        auto& dataTree = chunk->tertiary.getTree();
-        for (size_t i = 0; i < dataTree.size(); i++) {
-            for (size_t j = 0; j < dataTree[i].length; j++) {
-                c = dataTree[i].getStart() + j;
-
-                getPosFromBlockIndex(c, pos);
-                wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-
-                tertiaryData[wc] = dataTree[i].data;
-            }
-        }
-
-    } else {
-        c = 0;
-        for (y = 0; y < CHUNK_WIDTH; y++) {
-            for (z = 0; z < CHUNK_WIDTH; z++) {
-                for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                    wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                    tertiaryData[wc] = chunk->tertiary.get(c);
-                }
-            }
-        }
-    }
+    copyChunkData(chunk);
 
     if (left) {
         for (y = 1; y < PADDED_WIDTH - 1; y++) {
@@ -199,53 +210,73 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
         }
     }
 
+    // Rows along x are contiguous in both layouts, so copy them in bulk
     if (bottom) {
         for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                off1 = (z - 1)*CHUNK_WIDTH + x - 1;
-                off2 = z*PADDED_WIDTH + x;
-                //data
-                blockData[off2] = (bottom->getBlockData(CHUNK_SIZE - CHUNK_LAYER + off1)); //bottom
-                tertiaryData[off2] = bottom->getTertiaryData(CHUNK_SIZE - CHUNK_LAYER + off1);
-            }
+            off1 = (z - 1)*CHUNK_WIDTH + CHUNK_SIZE - CHUNK_LAYER;
+            off2 = z*PADDED_WIDTH + 1;
+            bottom->blocks.copyRange(off1, CHUNK_WIDTH, blockData + off2);
+            bottom->tertiary.copyRange(off1, CHUNK_WIDTH, tertiaryData + off2);
         }
     }
 
     if (top) {
         for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                off1 = (z - 1)*CHUNK_WIDTH + x - 1;
-                off2 = z*PADDED_WIDTH + x;
-
-                blockData[off2 + PADDED_SIZE - PADDED_LAYER] = (top->getBlockData(off1)); //top
-                tertiaryData[off2 + PADDED_SIZE - PADDED_LAYER] = top->getTertiaryData(off1);
-            }
+            off1 = (z - 1)*CHUNK_WIDTH;
+            off2 = z*PADDED_WIDTH + 1 + PADDED_SIZE - PADDED_LAYER;
+            top->blocks.copyRange(off1, CHUNK_WIDTH, blockData + off2);
+            top->tertiary.copyRange(off1, CHUNK_WIDTH, tertiaryData + off2);
         }
     }
 
     if (back) {
         for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                off1 = (x - 1) + (y - 1)*CHUNK_LAYER;
-                off2 = x + y*PADDED_LAYER;
-
-                blockData[off2] = back->getBlockData(off1 + CHUNK_LAYER - CHUNK_WIDTH);
-                tertiaryData[off2] = back->getTertiaryData(off1 + CHUNK_LAYER - CHUNK_WIDTH);
-            }
+            off1 = (y - 1)*CHUNK_LAYER + CHUNK_LAYER - CHUNK_WIDTH;
+            off2 = 1 + y*PADDED_LAYER;
+            back->blocks.copyRange(off1, CHUNK_WIDTH, blockData + off2);
+            back->tertiary.copyRange(off1, CHUNK_WIDTH, tertiaryData + off2);
         }
     }
 
     if (front) {
         for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                off1 = (x - 1) + (y - 1)*CHUNK_LAYER;
-                off2 = x + y*PADDED_LAYER;
+            off1 = (y - 1)*CHUNK_LAYER;
+            off2 = 1 + y*PADDED_LAYER + PADDED_LAYER - PADDED_WIDTH;
+            front->blocks.copyRange(off1, CHUNK_WIDTH, blockData + off2);
+            front->tertiary.copyRange(off1, CHUNK_WIDTH, tertiaryData + off2);
+        }
+    }
+}
 
-                blockData[off2 + PADDED_LAYER - PADDED_WIDTH] = (front->getBlockData(off1));
-                tertiaryData[off2 + PADDED_LAYER - PADDED_WIDTH] = front->getTertiaryData(off1);
+void ChunkMesher::copyChunkData(const Chunk* chunk) {
+    // Visit runs so each run does one block lookup and bulk row fills
+    int s = 0;
+    chunk->blocks.forEachRun(0, CHUNK_SIZE, [&](size_t start, size_t length, ui16 id) {
+        bool isLiquid = m_hotTable->getMeshType(id) == MeshType::LIQUID;
+        size_t end = start + length;
+        for (size_t c = start; c < end;) {
+            // Split the run at x row boundaries since padded rows aren't contiguous
+            size_t rowLength = std::min(CHUNK_WIDTH - (c & CHUNK_WIDTH_M1), end - c);
+            int wc = getPaddedBlockIndex((int)c);
+            vvox::fillRun(blockData + wc, rowLength, id);
+            if (isLiquid) {
+                for (size_t i = 0; i < rowLength; i++) {
+                    m_wvec[s++] = (ui16)(wc + i);
+                }
             }
+            c += rowLength;
         }
-    }
+    });
+    wSize = s;
+
+    chunk->tertiary.forEachRun(0, CHUNK_SIZE, [&](size_t start, size_t length, ui16 data) {
+        size_t end = start + length;
+        for (size_t c = start; c < end;) {
+            size_t rowLength = std::min(CHUNK_WIDTH - (c & CHUNK_WIDTH_M1), end - c);
+            vvox::fillRun(tertiaryData + getPaddedBlockIndex((int)c), rowLength, data);
+            c += rowLength;
+        }
+    });
 }
 
 #define GET_EDGE_X(ch, sy, sz, dy, dz) \
@@ -297,11 +328,6 @@ void ChunkMesher::prepareData(const Chunk* chunk) {
 void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM_NEIGHBOR_HANDLES]) {
     int x, y, z, srcIndex, destIndex;
 
-    int wc;
-    int c = 0;
-
-    i32v3 pos;
-
     wSize = 0;
     chunkVoxelPos = chunk->getVoxelPosition();
     if (chunk->gridData) {
@@ -316,66 +342,7 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     // TODO(Ben): Dude macro this or something.
     { // Main chunk
         std::lock_guard<std::mutex> l(chunk->dataMutex);
-        if (chunk->blocks.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-
-            int s = 0;
-            //block data
-            auto& dataTree = chunk->blocks.getTree();
-            for (size_t i = 0; i < dataTree.size(); i++) {
-                for (size_t j = 0; j < dataTree[i].length; j++) {
-                    c = dataTree[i].getStart() + j;
-
-                    getPosFromBlockIndex(c, pos);
-
-                    wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-                    blockData[wc] = dataTree[i].data;
-                    if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                        m_wvec[s++] = wc;
-                    }
-                }
-            }
-            wSize = s;
-        } else {
-            int s = 0;
-            for (y = 0; y < CHUNK_WIDTH; y++) {
-                for (z = 0; z < CHUNK_WIDTH; z++) {
-                    for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                        wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                        blockData[wc] = chunk->blocks[c];
-                        if (GETBLOCK(blockData[wc]).meshType == MeshType::LIQUID) {
-                            m_wvec[s++] = wc;
-                        }
-                    }
-                }
-            }
-            wSize = s;
-        }
-        if (chunk->tertiary.getState() == vvox::VoxelStorageState::INTERVAL_TREE) {
-            //tertiary data
-            c = 0;
-            auto& dataTree = chunk->tertiary.getTree();
-            for (size_t i = 0; i < dataTree.size(); i++) {
-                for (size_t j = 0; j < dataTree[i].length; j++) {
-                    c = dataTree[i].getStart() + j;
-
-                    getPosFromBlockIndex(c, pos);
-                    wc = (pos.y + 1)*PADDED_LAYER + (pos.z + 1)*PADDED_WIDTH + (pos.x + 1);
-
-                    tertiaryData[wc] = dataTree[i].data;
-                }
-            }
-
-        } else {
-            c = 0;
-            for (y = 0; y < CHUNK_WIDTH; y++) {
-                for (z = 0; z < CHUNK_WIDTH; z++) {
-                    for (x = 0; x < CHUNK_WIDTH; x++, c++) {
-                        wc = (y + 1)*PADDED_LAYER + (z + 1)*PADDED_WIDTH + (x + 1);
-                        tertiaryData[wc] = chunk->tertiary.get(c);
-                    }
-                }
-            }
-        }
+        copyChunkData(chunk);
     }
     chunk.release();
 
@@ -413,13 +380,10 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     { // Bottom
         std::lock_guard<std::mutex> l(bottom->dataMutex);
         for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + x - 1 + CHUNK_SIZE - CHUNK_LAYER;
-                destIndex = z*PADDED_WIDTH + x;
-                //data
-                blockData[destIndex] = (bottom->getBlockData(srcIndex)); //bottom
-                tertiaryData[destIndex] = bottom->getTertiaryData(srcIndex);
-            }
+            srcIndex = (z - 1)*CHUNK_WIDTH + CHUNK_SIZE - CHUNK_LAYER;
+            destIndex = z*PADDED_WIDTH + 1;
+            bottom->blocks.copyRange(srcIndex, CHUNK_WIDTH, blockData + destIndex);
+            bottom->tertiary.copyRange(srcIndex, CHUNK_WIDTH, tertiaryData + destIndex);
         }
     }
     bottom.release();
@@ -428,13 +392,10 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     { // Top
         std::lock_guard<std::mutex> l(top->dataMutex);
         for (z = 1; z < PADDED_WIDTH - 1; z++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (z - 1)*CHUNK_WIDTH + x - 1;
-                destIndex = z*PADDED_WIDTH + x + PADDED_SIZE - PADDED_LAYER;
-
-                blockData[destIndex] = (top->getBlockData(srcIndex)); //top
-                tertiaryData[destIndex] = top->getTertiaryData(srcIndex);
-            }
+            srcIndex = (z - 1)*CHUNK_WIDTH;
+            destIndex = z*PADDED_WIDTH + 1 + PADDED_SIZE - PADDED_LAYER;
+            top->blocks.copyRange(srcIndex, CHUNK_WIDTH, blockData + destIndex);
+            top->tertiary.copyRange(srcIndex, CHUNK_WIDTH, tertiaryData + destIndex);
         }
     }
     top.release();
@@ -443,13 +404,10 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     { // Back
         std::lock_guard<std::mutex> l(back->dataMutex);
         for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (x - 1) + (y - 1)*CHUNK_LAYER + CHUNK_LAYER - CHUNK_WIDTH;
-                destIndex = x + y*PADDED_LAYER;
-
-                blockData[destIndex] = back->getBlockData(srcIndex);
-                tertiaryData[destIndex] = back->getTertiaryData(srcIndex);
-            }
+            srcIndex = (y - 1)*CHUNK_LAYER + CHUNK_LAYER - CHUNK_WIDTH;
+            destIndex = 1 + y*PADDED_LAYER;
+            back->blocks.copyRange(srcIndex, CHUNK_WIDTH, blockData + destIndex);
+            back->tertiary.copyRange(srcIndex, CHUNK_WIDTH, tertiaryData + destIndex);
         }
     }
     back.release();
@@ -458,13 +416,10 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     { // Front
         std::lock_guard<std::mutex> l(front->dataMutex);
         for (y = 1; y < PADDED_WIDTH - 1; y++) {
-            for (x = 1; x < PADDED_WIDTH - 1; x++) {
-                srcIndex = (x - 1) + (y - 1)*CHUNK_LAYER;
-                destIndex = x + y*PADDED_LAYER + PADDED_LAYER - PADDED_WIDTH;
-
-                blockData[destIndex] = front->getBlockData(srcIndex);
-                tertiaryData[destIndex] = front->getTertiaryData(srcIndex);
-            }
+            srcIndex = (y - 1)*CHUNK_LAYER;
+            destIndex = 1 + y*PADDED_LAYER + PADDED_LAYER - PADDED_WIDTH;
+            front->blocks.copyRange(srcIndex, CHUNK_WIDTH, blockData + destIndex);
+            front->tertiary.copyRange(srcIndex, CHUNK_WIDTH, tertiaryData + destIndex);
         }
     }
     front.release();
@@ -543,7 +498,9 @@ void ChunkMesher::prepareDataAsync(ChunkHandle& chunk, ChunkHandle neighbors[NUM
     }
 }
 
-CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type) {
+CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type, ui32 remeshRegions /*= ALL_MESH_REGIONS*/,
+                                                              const ChunkMeshRegionLayout* layout /*= nullptr*/) {
+    m_remeshRegions = (layout && remeshRegions) ? remeshRegions : ALL_MESH_REGIONS;
     m_numQuads = 0;
     m_highestY = 0;
     m_lowestY = 256;
@@ -563,8 +520,18 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
     _waterVboVerts.clear();
 
     // Stores the data for a chunk mesh
-    // TODO(Ben): new is bad mkay
-    m_chunkMeshData = new ChunkMeshData(MeshTaskType::DEFAULT);
+    if (meshDataPool) {
+        m_chunkMeshData = meshDataPool->acquire(MeshTaskType::DEFAULT);
+    } else {
+        m_chunkMeshData = new ChunkMeshData(MeshTaskType::DEFAULT);
+    }
+
+    if (mesherType == ChunkMesherType::GREEDY) {
+        buildFaceMasks();
+        for (int face = 0; face < 6; face++) {
+            addGreedyFaces(face);
+        }
+    }
 
     // Loop through blocks
     for (by = 0; by < CHUNK_WIDTH; by++) {
@@ -582,7 +549,11 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
 
                 switch (block->meshType) {
                     case MeshType::BLOCK:
-                        addBlock();
+                        // Greedy meshing already emitted these faces
+                        if (mesherType == ChunkMesherType::DEFAULT &&
+                            (m_remeshRegions & (1u << (by / MESH_REGION_HEIGHT)))) {
+                            addBlock();
+                        }
                         break;
                     case MeshType::LEAVES:
                     case MeshType::CROSSFLORA:
@@ -598,30 +569,104 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
     }
 
     ChunkMeshRenderData& renderData = m_chunkMeshData->chunkMeshRenderData;
+    ChunkMeshRegionLayout& regionLayout = m_chunkMeshData->regionLayout;
+    m_chunkMeshData->remeshRegions = m_remeshRegions;
 
+    // Count the quads of each face in each region
+    ui32 regionCounts[6][NUM_MESH_REGIONS] = {};
+    for (int i = 0; i < 6; i++) {
+        std::vector<VoxelQuad>& quads = m_quads[i];
+        for (size_t j = 0; j < quads.size(); j++) {
+            if (quads[j].v0.mesherFlags & MESH_FLAG_ACTIVE) {
+                regionCounts[i][getQuadRegion(i, quads[j])]++;
+            }
+        }
+    }
+
+    if (m_remeshRegions == ALL_MESH_REGIONS) {
+        // Give every slot room to grow. Empty meshes get no slots.
+        ui32 offset = 0;
+        for (int i = 0; i < 6; i++) {
+            for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+                regionLayout.offset[i][r] = offset;
+                regionLayout.capacity[i][r] = m_numQuads ? getRegionCapacity(regionCounts[i][r]) : 0;
+                regionLayout.count[i][r] = regionCounts[i][r];
+                offset += regionLayout.capacity[i][r];
+            }
+        }
+    } else {
+        regionLayout = *layout;
+        for (int i = 0; i < 6; i++) {
+            for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+                if (regionCounts[i][r] > regionLayout.capacity[i][r]) {
+                    // Too much changed to patch in place
+                    m_floraQuads.clear();
+                    if (meshDataPool) {
+                        meshDataPool->recycle(m_chunkMeshData);
+                    } else {
+                        delete m_chunkMeshData;
+                    }
+                    m_chunkMeshData = nullptr;
+                    return createChunkMeshData(type);
+                }
+            }
+        }
+        for (int i = 0; i < 6; i++) {
+            for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+                if (m_remeshRegions & (1u << r)) regionLayout.count[i][r] = regionCounts[i][r];
+            }
+        }
+    }
+
+    m_chunkMeshData->isPacked = usePackedVertices;
     // Get quad buffer to fill
     std::vector<VoxelQuad>& finalQuads = m_chunkMeshData->opaqueQuads;
+    std::vector<PackedVoxelQuad>& packedQuads = m_chunkMeshData->packedOpaqueQuads;
+
+    // Slots of the meshed regions are stored back to back, face by face
+    ui32 slotIndex[6][NUM_MESH_REGIONS];
+    ui32 numFinalQuads = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+            slotIndex[i][r] = numFinalQuads;
+            if (m_remeshRegions & (1u << r)) numFinalQuads += regionLayout.capacity[i][r];
+        }
+    }
+    // Spare capacity isn't drawn, so it's left as is
+    if (usePackedVertices) {
+        packedQuads.resize(numFinalQuads);
+    } else {
+        finalQuads.resize(numFinalQuads);
+    }
 
-    finalQuads.resize(m_numQuads);
     // Copy the data
-    // TODO(Ben): Could construct in place and not need ANY copying with 6 iterations?
-    i32 index = 0;
-    i32 sizes[6];
     for (int i = 0; i < 6; i++) {
         std::vector<VoxelQuad>& quads = m_quads[i];
-        int tmp = index;
         for (size_t j = 0; j < quads.size(); j++) {
             VoxelQuad& q = quads[j];
             if (q.v0.mesherFlags & MESH_FLAG_ACTIVE) {
-                finalQuads[index++] = q;
+                ui32 slot = slotIndex[i][getQuadRegion(i, q)]++;
+                if (usePackedVertices) {
+                    packQuad(q, packedQuads[slot]);
+                } else {
+                    finalQuads[slot] = q;
+                }
             }
         }
-        sizes[i] = index - tmp;
     }
 
     // Swap flora quads
     renderData.cutoutVboSize = m_floraQuads.size() * INDICES_PER_QUAD;
-    m_chunkMeshData->cutoutQuads.swap(m_floraQuads);
+    if (usePackedVertices) {
+        std::vector<PackedVoxelQuad>& packedCutout = m_chunkMeshData->packedCutoutQuads;
+        packedCutout.resize(m_floraQuads.size());
+        for (size_t i = 0; i < m_floraQuads.size(); i++) {
+            packQuad(m_floraQuads[i], packedCutout[i]);
+        }
+        m_floraQuads.clear();
+    } else {
+        m_chunkMeshData->cutoutQuads.swap(m_floraQuads);
+    }
 
     m_highestY /= QUAD_SIZE;
     m_lowestY /= QUAD_SIZE;
@@ -632,7 +677,17 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
 
 #define INDICES_PER_QUAD 6
 
-    if (finalQuads.size()) {
+    // Faces span their whole range of slots. ChunkRenderer only draws the used part of each.
+    i32 sizes[6];
+    for (int i = 0; i < 6; i++) {
+        sizes[i] = 0;
+        for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+            sizes[i] += regionLayout.capacity[i][r];
+        }
+    }
+    const ui32 layoutSize = regionLayout.offset[5][NUM_MESH_REGIONS - 1] + regionLayout.capacity[5][NUM_MESH_REGIONS - 1];
+
+    if (layoutSize) {
         renderData.nxVboOff = 0;
         renderData.nxVboSize = sizes[0] * INDICES_PER_QUAD;
         renderData.pxVboOff = renderData.nxVboSize;
@@ -645,7 +700,7 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
         renderData.nzVboSize = sizes[4] * INDICES_PER_QUAD;
         renderData.pzVboOff = renderData.nzVboOff + renderData.nzVboSize;
         renderData.pzVboSize = sizes[5] * INDICES_PER_QUAD;
-        renderData.indexSize = finalQuads.size() * INDICES_PER_QUAD;
+        renderData.indexSize = layoutSize * INDICES_PER_QUAD;
 
         // Redundant
         renderData.highestX = m_highestX;
@@ -656,9 +711,47 @@ CALLER_DELETE ChunkMeshData* ChunkMesher::createChunkMeshData(MeshTaskType type)
         renderData.lowestZ = m_lowestZ;
     }
 
+    size_t transientBytes = getTransientBytes();
+    if (transientBytes > m_peakTransientBytes) {
+        m_peakTransientBytes = transientBytes;
+        if (meshDataPool) meshDataPool->recordMesherBytes(transientBytes);
+    }
+
     return m_chunkMeshData;
 }
 
+void ChunkMesher::packQuad(const VoxelQuad& quad, OUT PackedVoxelQuad& packed) {
+    BlockMaterial material;
+    ui32 materialIndex = 0;
+    for (int i = 0; i < 4; i++) {
+        const BlockVertex& v = quad.verts[i];
+        PackedBlockVertex& p = packed.verts[i];
+        p.position = v.position;
+        // AO is already in the colours when USE_AO is on
+        p.face = v.face;
+        p.tex = v.tex;
+        p.padding[0] = 0;
+        p.padding[1] = 0;
+
+        BlockMaterial vertMaterial;
+        vertMaterial.texturePosition = v.texturePosition;
+        vertMaterial.normTexturePosition = v.normTexturePosition;
+        vertMaterial.dispTexturePosition = v.dispTexturePosition;
+        vertMaterial.textureDims = v.textureDims;
+        vertMaterial.overlayTextureDims = v.overlayTextureDims;
+        vertMaterial.color = v.color;
+        vertMaterial.blendMode = v.blendMode;
+        vertMaterial.overlayColor = v.overlayColor;
+        vertMaterial.animationLength = v.animationLength;
+        // Vertices usually share the material of the quad, so skip the lookup
+        if (i == 0 || !(vertMaterial == material)) {
+            material = vertMaterial;
+            materialIndex = ChunkRenderer::materialTable.getIndex(material);
+        }
+        p.material = materialIndex;
+    }
+}
+
 inline bool mapBufferData(GLuint& vboID, GLsizeiptr size, void* src, GLenum usage) {
     // Block Vertices
     if (vboID == 0) {
@@ -678,20 +771,56 @@ inline bool mapBufferData(GLuint& vboID, GLsizeiptr size, void* src, GLenum usag
 }
 
 bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
+    bool isPartial = meshData->remeshRegions != ALL_MESH_REGIONS;
+    if (isPartial && (mesh.vboID == 0 || meshData->layoutVersion != mesh.layoutVersion ||
+                      meshData->isPacked != mesh.isPacked)) {
+        // A full upload since the task was made already has newer data
+        return mesh.vboID != 0 || mesh.transVboID != 0 || mesh.cutoutVboID != 0 || mesh.waterVboID != 0;
+    }
+
     bool canRender = false;
 
+    // Opaque and cutout quads are in one of the two vertex formats
+    const bool isPacked = meshData->isPacked;
+    const size_t quadSize = isPacked ? sizeof(PackedVoxelQuad) : sizeof(VoxelQuad);
+    const size_t numOpaqueQuads = isPacked ? meshData->packedOpaqueQuads.size() : meshData->opaqueQuads.size();
+    const size_t numCutoutQuads = isPacked ? meshData->packedCutoutQuads.size() : meshData->cutoutQuads.size();
+    if (meshData->type == MeshTaskType::DEFAULT && !isPartial && mesh.isPacked != isPacked) {
+        // The attributes changed, so the VAOs have to be rebuilt
+        if (mesh.vaoID != 0) {
+            glDeleteVertexArrays(1, &(mesh.vaoID));
+            mesh.vaoID = 0;
+        }
+        if (mesh.cutoutVaoID != 0) {
+            glDeleteVertexArrays(1, &(mesh.cutoutVaoID));
+            mesh.cutoutVaoID = 0;
+        }
+        mesh.isPacked = isPacked;
+    }
+
     //store the index data for sorting in the chunk mesh
     mesh.transQuadIndices.swap(meshData->transQuadIndices);
     mesh.transQuadPositions.swap(meshData->transQuadPositions);
 
     switch (meshData->type) {
         case MeshTaskType::DEFAULT:
-            if (meshData->opaqueQuads.size()) {
-
-                mapBufferData(mesh.vboID, meshData->opaqueQuads.size() * sizeof(VoxelQuad), &(meshData->opaqueQuads[0]), GL_STATIC_DRAW);
+            if (isPartial) {
+                patchMeshRegions(mesh, meshData);
+                // Same slots, with the counts of the remeshed regions
+                mesh.regionLayout = meshData->regionLayout;
+                canRender = true;
+            } else if (numOpaqueQuads) {
+                void* src = isPacked ? (void*)&(meshData->packedOpaqueQuads[0]) : (void*)&(meshData->opaqueQuads[0]);
+                mapBufferData(mesh.vboID, numOpaqueQuads * quadSize, src, GL_STATIC_DRAW);
                 canRender = true;
 
-                if (!mesh.vaoID) buildVao(mesh);
+                if (!mesh.vaoID) {
+                    if (isPacked) {
+                        buildPackedVao(mesh.vaoID, mesh.vboID);
+                    } else {
+                        buildVao(mesh);
+                    }
+                }
             } else {
                 if (mesh.vboID != 0) {
                     glDeleteBuffers(1, &(mesh.vboID));
@@ -702,6 +831,10 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
                     mesh.vaoID = 0;
                 }
             }
+            if (!isPartial) {
+                mesh.regionLayout = meshData->regionLayout;
+                mesh.layoutVersion++;
+            }
 
             if (meshData->transQuads.size()) {
 
@@ -729,11 +862,17 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
                 }
             }
 
-            if (meshData->cutoutQuads.size()) {
-
-                mapBufferData(mesh.cutoutVboID, meshData->cutoutQuads.size() * sizeof(VoxelQuad), &(meshData->cutoutQuads[0]), GL_STATIC_DRAW);
+            if (numCutoutQuads) {
+                void* src = isPacked ? (void*)&(meshData->packedCutoutQuads[0]) : (void*)&(meshData->cutoutQuads[0]);
+                mapBufferData(mesh.cutoutVboID, numCutoutQuads * quadSize, src, GL_STATIC_DRAW);
                 canRender = true;
-                if (!mesh.cutoutVaoID) buildCutoutVao(mesh);
+                if (!mesh.cutoutVaoID) {
+                    if (isPacked) {
+                        buildPackedVao(mesh.cutoutVaoID, mesh.cutoutVboID);
+                    } else {
+                        buildCutoutVao(mesh);
+                    }
+                }
             } else {
                 if (mesh.cutoutVaoID != 0) {
                     glDeleteVertexArrays(1, &(mesh.cutoutVaoID));
@@ -744,6 +883,16 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
                     mesh.cutoutVboID = 0;
                 }
             }
+            if (isPartial) {
+                // Bounds only grow until the next full upload
+                ChunkMeshRenderData& src = meshData->chunkMeshRenderData;
+                src.highestX = std::max(src.highestX, mesh.renderData.highestX);
+                src.lowestX = std::min(src.lowestX, mesh.renderData.lowestX);
+                src.highestY = std::max(src.highestY, mesh.renderData.highestY);
+                src.lowestY = std::min(src.lowestY, mesh.renderData.lowestY);
+                src.highestZ = std::max(src.highestZ, mesh.renderData.highestZ);
+                src.lowestZ = std::min(src.lowestZ, mesh.renderData.lowestZ);
+            }
             mesh.renderData = meshData->chunkMeshRenderData;
             //The missing break is deliberate!
         case MeshTaskType::LIQUID:
@@ -768,6 +917,27 @@ bool ChunkMesher::uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData) {
     return canRender;
 }
 
+void ChunkMesher::patchMeshRegions(ChunkMesh& cm, const ChunkMeshData* meshData) {
+    const ChunkMeshRegionLayout& layout = cm.regionLayout;
+    const size_t quadSize = cm.isPacked ? sizeof(PackedVoxelQuad) : sizeof(VoxelQuad);
+    const ui8* src = cm.isPacked ? (const ui8*)meshData->packedOpaqueQuads.data() : (const ui8*)meshData->opaqueQuads.data();
+    glBindBuffer(GL_ARRAY_BUFFER, cm.vboID);
+    size_t srcIndex = 0;
+    for (int i = 0; i < 6; i++) {
+        for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+            if (!(meshData->remeshRegions & (1u << r))) continue;
+            // Only the used part of the slot gets drawn, so that is all that is uploaded
+            ui32 count = meshData->regionLayout.count[i][r];
+            if (count) {
+                glBufferSubData(GL_ARRAY_BUFFER, layout.offset[i][r] * quadSize,
+                                count * quadSize, src + srcIndex * quadSize);
+            }
+            srcIndex += layout.capacity[i][r];
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void ChunkMesher::freeChunkMesh(CALLEE_DELETE ChunkMesh* mesh) {
     // Opaque
     if (mesh->vboID != 0) {
@@ -892,6 +1062,206 @@ void ChunkMesher::addBlock()
     }
 }
 
+void ChunkMesher::setCurrentVoxel(int x, int y, int z) {
+    bx = x;
+    by = y;
+    bz = z;
+    blockIndex = (y + 1) * PADDED_CHUNK_LAYER + (z + 1) * PADDED_CHUNK_WIDTH + (x + 1);
+    blockID = blockData[blockIndex];
+    heightData = &m_chunkHeightData[z * CHUNK_WIDTH + x];
+    block = &blocks->operator[](blockID);
+    voxelPosOffset = ui8v3(x * QUAD_SIZE, y * QUAD_SIZE, z * QUAD_SIZE);
+}
+
+void ChunkMesher::buildFaceMasks() {
+    ui32 blockMasks[CHUNK_WIDTH][CHUNK_WIDTH];
+
+    // Classify every padded voxel once
+    for (int y = 0; y < PADDED_WIDTH; y++) {
+        for (int z = 0; z < PADDED_WIDTH; z++) {
+            const ui16* row = blockData + y * PADDED_LAYER + z * PADDED_WIDTH;
+            ui64 occlude = 0;
+            ui64 selfOcclude = 0;
+            ui64 solid = 0;
+            for (int x = 0; x < PADDED_WIDTH; x++) {
+                BlockOcclusion o = m_hotTable->getOcclusion(row[x]);
+                if (o == BlockOcclusion::ALL) {
+                    occlude |= (ui64)1 << x;
+                } else if (o == BlockOcclusion::SELF) {
+                    selfOcclude |= (ui64)1 << x;
+                }
+                if (row[x] != 0 && m_hotTable->getMeshType(row[x]) == MeshType::BLOCK) solid |= (ui64)1 << x;
+            }
+            m_occludeMasks[y][z] = occlude;
+            m_selfOccludeMasks[y][z] = selfOcclude;
+            if (y > 0 && y <= CHUNK_WIDTH && z > 0 && z <= CHUNK_WIDTH) {
+                blockMasks[y - 1][z - 1] = (ui32)(solid >> 1);
+            }
+        }
+    }
+
+    // A face is visible unless its neighbor occludes it
+    for (int y = 0; y < CHUNK_WIDTH; y++) {
+        if (!(m_remeshRegions & (1u << (y / MESH_REGION_HEIGHT)))) {
+            // Region isn't being remeshed
+            for (int face = 0; face < 6; face++) {
+                memset(m_faceMasks[face][y], 0, sizeof(m_faceMasks[face][y]));
+            }
+            continue;
+        }
+        for (int z = 0; z < CHUNK_WIDTH; z++) {
+            const ui32 solid = blockMasks[y][z];
+            const int py = y + 1;
+            const int pz = z + 1;
+            ui32 occlude[6];
+            ui32 selfOcclude[6];
+            occlude[X_NEG] = (ui32)m_occludeMasks[py][pz];
+            occlude[X_POS] = (ui32)(m_occludeMasks[py][pz] >> 2);
+            occlude[Y_NEG] = (ui32)(m_occludeMasks[py - 1][pz] >> 1);
+            occlude[Y_POS] = (ui32)(m_occludeMasks[py + 1][pz] >> 1);
+            occlude[Z_NEG] = (ui32)(m_occludeMasks[py][pz - 1] >> 1);
+            occlude[Z_POS] = (ui32)(m_occludeMasks[py][pz + 1] >> 1);
+            selfOcclude[X_NEG] = (ui32)m_selfOccludeMasks[py][pz];
+            selfOcclude[X_POS] = (ui32)(m_selfOccludeMasks[py][pz] >> 2);
+            selfOcclude[Y_NEG] = (ui32)(m_selfOccludeMasks[py - 1][pz] >> 1);
+            selfOcclude[Y_POS] = (ui32)(m_selfOccludeMasks[py + 1][pz] >> 1);
+            selfOcclude[Z_NEG] = (ui32)(m_selfOccludeMasks[py][pz - 1] >> 1);
+            selfOcclude[Z_POS] = (ui32)(m_selfOccludeMasks[py][pz + 1] >> 1);
+
+            const int rowIndex = py * PADDED_LAYER + pz * PADDED_WIDTH + 1;
+            for (int face = 0; face < 6; face++) {
+                ui32 visible = solid & ~occlude[face];
+                // Self occluding neighbors only hide faces of the same block
+                ui32 selfBits = visible & selfOcclude[face];
+                while (selfBits) {
+                    ui32 x = vvox::countTrailingZeros(selfBits);
+                    selfBits &= selfBits - 1;
+                    int i = rowIndex + x;
+                    if (blockData[i + FACE_NEIGHBOR_OFFSET[face]] == blockData[i]) {
+                        visible &= ~(1u << x);
+                    }
+                }
+                m_faceMasks[face][y][z] = visible;
+            }
+        }
+    }
+}
+
+void ChunkMesher::addGreedyFaces(int face) {
+    ui32 rows[CHUNK_WIDTH];
+    switch (face) {
+        case X_NEG:
+        case X_POS: {
+            // Slices are along x with rows of z bits, so transpose each y layer
+            ui32 layers[CHUNK_WIDTH][CHUNK_WIDTH];
+            memcpy(layers, m_faceMasks[face], sizeof(layers));
+            for (int y = 0; y < CHUNK_WIDTH; y++) {
+                transposeBits32(layers[y]);
+            }
+            for (int x = 0; x < CHUNK_WIDTH; x++) {
+                for (int y = 0; y < CHUNK_WIDTH; y++) rows[y] = layers[y][x];
+                addGreedySlice(face, x, rows);
+            }
+            break;
+        }
+        case Y_NEG:
+        case Y_POS:
+            for (int y = 0; y < CHUNK_WIDTH; y++) {
+                memcpy(rows, m_faceMasks[face][y], sizeof(rows));
+                addGreedySlice(face, y, rows);
+            }
+            break;
+        default:
+            for (int z = 0; z < CHUNK_WIDTH; z++) {
+                for (int y = 0; y < CHUNK_WIDTH; y++) rows[y] = m_faceMasks[face][y][z];
+                addGreedySlice(face, z, rows);
+            }
+            break;
+    }
+}
+
+void ChunkMesher::addGreedySlice(int face, int slice, ui32 rows[CHUNK_WIDTH]) {
+    // u and v follow the texture axes of the face
+    const int uAxis = FACE_AXIS[face][0];
+    const int vAxis = FACE_AXIS[face][1];
+    const int sliceAxis = 3 - uAxis - vAxis;
+    // Rectangles can't span mesh regions
+    const int vRegionHeight = (vAxis == (int)vvox::Axis::Y) ? MESH_REGION_HEIGHT : CHUNK_WIDTH;
+    const int* aoOffsets = FACE_AO_OFFSETS[face];
+    f32 ao[4];
+
+    // Build the unmerged quad of every visible face
+    i32v3 pos;
+    pos[sliceAxis] = slice;
+    for (int v = 0; v < CHUNK_WIDTH; v++) {
+        ui32 bits = rows[v];
+        pos[vAxis] = v;
+        while (bits) {
+            int u = (int)vvox::countTrailingZeros(bits);
+            bits &= bits - 1;
+            pos[uAxis] = u;
+            setCurrentVoxel(pos.x, pos.y, pos.z);
+            computeAmbientOcclusion(aoOffsets[0], aoOffsets[1], aoOffsets[2], ao);
+            VoxelQuad& quad = m_sliceQuads[v * CHUNK_WIDTH + u];
+            memset(&quad, 0, sizeof(VoxelQuad));
+            buildQuad(face, ao, quad);
+        }
+    }
+
+    // Greedily cover the visible faces with rectangles, widest first
+    std::vector<VoxelQuad>& quads = m_quads[face];
+    for (int v = 0; v < CHUNK_WIDTH; v++) {
+        while (rows[v]) {
+            int u = (int)vvox::countTrailingZeros(rows[v]);
+            const VoxelQuad& base = m_sliceQuads[v * CHUNK_WIDTH + u];
+            int width = 1;
+            int height = 1;
+            if (isUniformQuad(base)) {
+                while (u + width < CHUNK_WIDTH && (rows[v] & (1u << (u + width))) &&
+                       canMergeQuads(base, m_sliceQuads[v * CHUNK_WIDTH + u + width])) {
+                    width++;
+                }
+                ui32 span = (width == CHUNK_WIDTH) ? 0xFFFFFFFF : (((1u << width) - 1) << u);
+                const int vEnd = (v / vRegionHeight + 1) * vRegionHeight;
+                while (v + height < vEnd && (rows[v + height] & span) == span) {
+                    const VoxelQuad* row = m_sliceQuads + (v + height) * CHUNK_WIDTH;
+                    int i = u;
+                    while (i < u + width && canMergeQuads(base, row[i])) i++;
+                    if (i != u + width) break;
+                    height++;
+                }
+            }
+            ui32 span = (width == CHUNK_WIDTH) ? 0xFFFFFFFF : (((1u << width) - 1) << u);
+            for (int i = 0; i < height; i++) {
+                rows[v + i] &= ~span;
+            }
+
+            // Stretch the far vertices over the rectangle
+            quads.push_back(base);
+            m_numQuads++;
+            VoxelQuad& quad = quads.back();
+            for (int i = 0; i < 4; i++) {
+                BlockVertex& vert = quad.verts[i];
+                if (VoxelMesher::VOXEL_POSITIONS[face][i][uAxis]) {
+                    vert.position[uAxis] += (ui8)((width - 1) * QUAD_SIZE);
+                    vert.tex.x += (ui8)((width - 1) * FACE_AXIS_SIGN[face][0]);
+                }
+                if (VoxelMesher::VOXEL_POSITIONS[face][i][vAxis]) {
+                    vert.position[vAxis] += (ui8)((height - 1) * QUAD_SIZE);
+                    vert.tex.y += (ui8)((height - 1) * FACE_AXIS_SIGN[face][1]);
+                }
+                // Check against lowest and highest for culling in render
+                if (vert.position.x < m_lowestX) m_lowestX = vert.position.x;
+                if (vert.position.x > m_highestX) m_highestX = vert.position.x;
+                if (vert.position.y < m_lowestY) m_lowestY = vert.position.y;
+                if (vert.position.y > m_highestY) m_highestY = vert.position.y;
+                if (vert.position.z < m_lowestZ) m_lowestZ = vert.position.z;
+                if (vert.position.z > m_highestZ) m_highestZ = vert.position.z;
+            }
+        }
+    }
+}
+
 void ChunkMesher::computeAmbientOcclusion(int upOffset, int frontOffset, int rightOffset, f32 ambientOcclusion[]) {
 #ifdef USE_AO
     // Ambient occlusion factor
@@ -899,10 +1269,10 @@ void ChunkMesher::computeAmbientOcclusion(int upOffset, int frontOffset, int rig
     // Helper macro
     // TODO(Ben): This isn't exactly right since self will occlude. Use a function
 #define CALCULATE_VERTEX(v, s1, s2) \
-    nearOccluders = getOcclusion(blocks->operator[](blockData[blockIndex])) + \
-    getOcclusion(blocks->operator[](blockData[blockIndex s1 frontOffset])) + \
-    getOcclusion(blocks->operator[](blockData[blockIndex s2 rightOffset])) + \
-    getOcclusion(blocks->operator[](blockData[blockIndex s1 frontOffset s2 rightOffset])); \
+    nearOccluders = getOcclusion(blockData[blockIndex]) + \
+    getOcclusion(blockData[blockIndex s1 frontOffset]) + \
+    getOcclusion(blockData[blockIndex s2 rightOffset]) + \
+    getOcclusion(blockData[blockIndex s1 frontOffset s2 rightOffset]); \
     ambientOcclusion[v] = 1.0f - nearOccluders * OCCLUSION_FACTOR; 
    
     // Move the block index upwards
@@ -926,6 +1296,27 @@ void ChunkMesher::computeAmbientOcclusion(int upOffset, int frontOffset, int rig
 }
 
 void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset, f32 ambientOcclusion[]) {
+    std::vector<VoxelQuad>& quads = m_quads[face];
+
+    // Construct the quad
+    quads.emplace_back();
+    m_numQuads++;
+    VoxelQuad* quad = &quads.back();
+    buildQuad(face, ambientOcclusion, *quad);
+
+    // Check against lowest and highest for culling in render
+    // TODO(Ben): Think about this more
+    if (quad->v0.position.x < m_lowestX) m_lowestX = quad->v0.position.x;
+    if (quad->v0.position.x > m_highestX) m_highestX = quad->v0.position.x;
+    if (quad->v0.position.y < m_lowestY) m_lowestY = quad->v0.position.y;
+    if (quad->v0.position.y > m_highestY) m_highestY = quad->v0.position.y;
+    if (quad->v0.position.z < m_lowestZ) m_lowestZ = quad->v0.position.z;
+    if (quad->v0.position.z > m_highestZ) m_highestZ = quad->v0.position.z;
+
+    m_numQuads -= tryMergeQuad(quad, quads, face, rightAxis, frontAxis, leftOffset, backOffset, rightStretchIndex, texOffset);
+}
+
+void ChunkMesher::buildQuad(int face, f32 ambientOcclusion[], VoxelQuad& quad) {
     // Get texture TODO(Ben): Null check?
     const BlockTexture* texture = block->textures[face];
 
@@ -939,8 +1330,6 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
                                 heightData->temperature,
                                 heightData->humidity, 0);
 
-    std::vector<VoxelQuad>& quads = m_quads[face];
-
     // Get texturing parameters
     ui8 blendMode = getBlendMode(texture->blendMode);
     // TODO(Ben): Make this better
@@ -962,15 +1351,10 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
     ui8 uOffset = (ui8)(pos[FACE_AXIS[face][0]] * FACE_AXIS_SIGN[face][0]);
     ui8 vOffset = (ui8)(pos[FACE_AXIS[face][1]] * FACE_AXIS_SIGN[face][1]);
 
-    // Construct the quad
-    i16 quadIndex = quads.size();
-    quads.emplace_back();
-    m_numQuads++;
-    VoxelQuad* quad = &quads.back();
-    quad->v0.mesherFlags = MESH_FLAG_ACTIVE;
+    quad.v0.mesherFlags = MESH_FLAG_ACTIVE;
 
     for (int i = 0; i < 4; i++) {
-        BlockVertex& v = quad->verts[i];
+        BlockVertex& v = quad.verts[i];
         v.position = VoxelMesher::VOXEL_POSITIONS[face][i] + voxelPosOffset;
 #ifdef USE_AO
         f32& ao = ambientOcclusion[i];
@@ -1001,28 +1385,18 @@ void ChunkMesher::addQuad(int face, int rightAxis, int frontAxis, int leftOffset
         v.textureDims = methodDatas[0].size;
         v.overlayTextureDims = methodDatas[3].size;
         v.blendMode = blendMode;
+        v.animationLength = 0;
         v.face = (ui8)face;
     }
     // Set texture coordinates
-    quad->verts[0].tex.x = (ui8)(UV_0 + uOffset);
-    quad->verts[0].tex.y = (ui8)(UV_1 + vOffset);
-    quad->verts[1].tex.x = (ui8)(UV_0 + uOffset);
-    quad->verts[1].tex.y = (ui8)(UV_0 + vOffset);
-    quad->verts[2].tex.x = (ui8)(UV_1 + uOffset);
-    quad->verts[2].tex.y = (ui8)(UV_0 + vOffset);
-    quad->verts[3].tex.x = (ui8)(UV_1 + uOffset);
-    quad->verts[3].tex.y = (ui8)(UV_1 + vOffset);
-
-    // Check against lowest and highest for culling in render
-    // TODO(Ben): Think about this more
-    if (quad->v0.position.x < m_lowestX) m_lowestX = quad->v0.position.x;
-    if (quad->v0.position.x > m_highestX) m_highestX = quad->v0.position.x;
-    if (quad->v0.position.y < m_lowestY) m_lowestY = quad->v0.position.y;
-    if (quad->v0.position.y > m_highestY) m_highestY = quad->v0.position.y;
-    if (quad->v0.position.z < m_lowestZ) m_lowestZ = quad->v0.position.z;
-    if (quad->v0.position.z > m_highestZ) m_highestZ = quad->v0.position.z;
-
-    m_numQuads -= tryMergeQuad(quad, quads, face, rightAxis, frontAxis, leftOffset, backOffset, rightStretchIndex, texOffset);
+    quad.verts[0].tex.x = (ui8)(UV_0 + uOffset);
+    quad.verts[0].tex.y = (ui8)(UV_1 + vOffset);
+    quad.verts[1].tex.x = (ui8)(UV_0 + uOffset);
+    quad.verts[1].tex.y = (ui8)(UV_0 + vOffset);
+    quad.verts[2].tex.x = (ui8)(UV_1 + uOffset);
+    quad.verts[2].tex.y = (ui8)(UV_0 + vOffset);
+    quad.verts[3].tex.x = (ui8)(UV_1 + uOffset);
+    quad.verts[3].tex.y = (ui8)(UV_1 + vOffset);
 }
 
 struct FloraQuadData {
@@ -1117,6 +1491,7 @@ void ChunkMesher::addFloraQuad(const ui8v3* positions, FloraQuadData& data) {
         v.textureDims = data.methodDatas[0].size;
         v.overlayTextureDims = data.methodDatas[3].size;
         v.blendMode = data.blendMode;
+        v.animationLength = 0;
         v.face = (ui8)vvox::Cardinal::Y_POS;
     }
     // Set texture coordinates
@@ -1169,7 +1544,9 @@ int ChunkMesher::tryMergeQuad(VoxelQuad* quad, std::vector<VoxelQuad>& quads, in
     // Check back merge
     if (quad->v0 == quad->v1 && quad->v2 == quad->v3) {
         quad->v0.mesherFlags |= MESH_FLAG_MERGE_FRONT;
-        int backIndex = m_quadIndices[blockIndex + backOffset][face];
+        // Don't merge across mesh regions
+        bool isRegionStart = (backOffset == -PADDED_CHUNK_LAYER && by % MESH_REGION_HEIGHT == 0);
+        int backIndex = isRegionStart ? NO_QUAD_INDEX : m_quadIndices[blockIndex + backOffset][face];
         if (backIndex != NO_QUAD_INDEX) {
             VoxelQuad* bQuad = &quads[backIndex];
             while (!(bQuad->v0.mesherFlags & MESH_FLAG_ACTIVE)) {
@@ -1506,16 +1883,11 @@ int ChunkMesher::getLiquidLevel(int blockIndex, const Block& block) {
 }
 
 bool ChunkMesher::shouldRenderFace(int offset) {
-    const Block& neighbor = blocks->operator[](blockData[blockIndex + offset]);
-    if (neighbor.occlude == BlockOcclusion::ALL) return false;
-    if ((neighbor.occlude == BlockOcclusion::SELF) && (blockID == neighbor.ID)) return false;
-    return true;
+    return !m_hotTable->occludes(blockData[blockIndex + offset], blockID);
 }
 
-int ChunkMesher::getOcclusion(const Block& block) {
-    if (block.occlude == BlockOcclusion::ALL) return 1;
-    if ((block.occlude == BlockOcclusion::SELF) && (blockID == block.ID)) return 1;
-    return 0;
+int ChunkMesher::getOcclusion(BlockID id) {
+    return m_hotTable->occludes(id, blockID) ? 1 : 0;
 }
 
 ui8 ChunkMesher::getBlendMode(const BlendType& blendType) {
@@ -1631,6 +2003,27 @@ void ChunkMesher::buildVao(ChunkMesh& cm) {
     glBindVertexArray(0);
 }
 
+void ChunkMesher::buildPackedVao(VGVertexArray& vao, VGVertexBuffer vbo) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ChunkRenderer::sharedIBO);
+
+    for (int i = 0; i < 3; i++) {
+        glEnableVertexAttribArray(i);
+    }
+
+    // The shader unpacks these, so they stay integers
+    // vPosition_Face
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_BYTE, sizeof(PackedBlockVertex), offsetptr(PackedBlockVertex, position));
+    // vTex
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_BYTE, sizeof(PackedBlockVertex), offsetptr(PackedBlockVertex, tex));
+    // vMaterial
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(PackedBlockVertex), offsetptr(PackedBlockVertex, material));
+
+    glBindVertexArray(0);
+}
+
 void ChunkMesher::buildWaterVao(ChunkMesh& cm) {
     glGenVertexArrays(1, &(cm.waterVaoID));
     glBindVertexArray(cm.waterVaoID);
@@ -5,9 +5,11 @@
 #include "ChunkMesh.h"
 #include "ChunkMeshTask.h"
 
+class BlockHotTable;
 class BlockPack;
 class BlockTextureLayer;
 class ChunkMeshData;
+class ChunkMeshDataPool;
 struct BlockTexture;
 struct PlanetHeightData;
 struct FloraQuadData;
@@ -17,6 +19,12 @@ const int PADDED_CHUNK_WIDTH = (CHUNK_WIDTH + 2);
 const int PADDED_CHUNK_LAYER = (PADDED_CHUNK_WIDTH * PADDED_CHUNK_WIDTH);
 const int PADDED_CHUNK_SIZE = (PADDED_CHUNK_LAYER * PADDED_CHUNK_WIDTH);
 
+// Selects the algorithm used to mesh MeshType::BLOCK voxels
+enum class ChunkMesherType {
+    DEFAULT, ///< Per voxel faces with run merging against the previous quad
+    GREEDY ///< Bitmask face culling with rectangle merging per slice
+};
+
 // !!! IMPORTANT !!!
 // TODO(BEN): Make a class for complex Chunk Mesh Splicing. Store plenty of metadata in RAM about the regions in each mesh and just do a CPU copy to align them all and mix them around. Then meshes can be remeshed, rendered, recombined, at will.
 // Requirements: Each chunk is only meshed when it needs to, as they do now.
@@ -46,7 +54,10 @@ class ChunkMesher {
 
     // TODO(Ben): Unique ptr?
     // Must call prepareData or prepareDataAsync first
-    CALLER_DELETE ChunkMeshData* createChunkMeshData(MeshTaskType type);
+    // When layout is given, only the opaque quads of remeshRegions are built, to be patched
+    // into a mesh with that layout. Falls back to a full mesh if a region outgrows its slot.
+    CALLER_DELETE ChunkMeshData* createChunkMeshData(MeshTaskType type, ui32 remeshRegions = ALL_MESH_REGIONS,
+                                                     const ChunkMeshRegionLayout* layout = nullptr);
 
     // Returns true if the mesh is renderable
     static bool uploadMeshData(ChunkMesh& mesh, ChunkMeshData* meshData);
@@ -72,31 +83,65 @@ class ChunkMesher {
     const BlockPack* blocks = nullptr;
 
     VoxelPosition3D chunkVoxelPos;
+
+    ChunkMesherType mesherType = ChunkMesherType::DEFAULT;
+    /// Emit PackedVoxelQuads for the opaque and cutout meshes
+    bool usePackedVertices = false;
+    /// Optional, mesh data comes from and goes back to this pool
+    ChunkMeshDataPool* meshDataPool = nullptr;
+
+    /// Bytes this mesher holds between tasks, fixed arrays included
+    size_t getTransientBytes() const;
+    size_t getPeakTransientBytes() const { return m_peakTransientBytes; }
 private:
+    // Copies chunk voxels into the padded arrays and records liquid voxels
+    void copyChunkData(const Chunk* chunk);
     void addBlock();
     void addQuad(int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset, f32 ambientOcclusion[]);
+    // Fills quad for the current voxel without merging it
+    void buildQuad(int face, f32 ambientOcclusion[], VoxelQuad& quad);
+    // Sets bx, by, bz and the per voxel members for a chunk position
+    void setCurrentVoxel(int x, int y, int z);
+    // Greedy meshing
+    void buildFaceMasks();
+    void addGreedyFaces(int face);
+    void addGreedySlice(int face, int slice, ui32 rows[CHUNK_WIDTH]);
     void computeAmbientOcclusion(int upOffset, int frontOffset, int rightOffset, f32 ambientOcclusion[]);
     void addFlora();
     void addFloraQuad(const ui8v3* positions, FloraQuadData& data);
     int tryMergeQuad(VoxelQuad* quad, std::vector<VoxelQuad>& quads, int face, int rightAxis, int frontAxis, int leftOffset, int backOffset, int rightStretchIndex, const ui8v2& texOffset);
     void addLiquid();
+    // Moves the per quad data of quad into the material table
+    static void packQuad(const VoxelQuad& quad, OUT PackedVoxelQuad& packed);
 
     int getLiquidLevel(int blockIndex, const Block& block);
 
     bool shouldRenderFace(int offset);
-    int getOcclusion(const Block& block);
+    int getOcclusion(BlockID id);
 
     ui8 getBlendMode(const BlendType& blendType);
 
+    // Uploads the remeshed regions of a partial mesh into the slots of cm's opaque VBO
+    static void patchMeshRegions(ChunkMesh& cm, const ChunkMeshData* meshData);
+
     static void buildTransparentVao(ChunkMesh& cm);
     static void buildCutoutVao(ChunkMesh& cm);
     static void buildVao(ChunkMesh& cm);
     static void buildWaterVao(ChunkMesh& cm);
+    // Opaque and cutout VAO for PackedBlockVertex
+    static void buildPackedVao(VGVertexArray& vao, VGVertexBuffer vbo);
 
+    const BlockHotTable* m_hotTable = nullptr; ///< Hot properties of blocks
     ui16 m_quadIndices[PADDED_CHUNK_SIZE][6];
-    ui16 m_wvec[CHUNK_SIZE];
 
-    std::vector<BlockVertex> m_finalVerts[6];
+    // Greedy meshing masks. Bit x of [y][z] is the voxel at (x, y, z).
+    ui32 m_faceMasks[6][CHUNK_WIDTH][CHUNK_WIDTH];
+    // Per padded row masks, bit x is padded x
+    ui64 m_occludeMasks[PADDED_CHUNK_WIDTH][PADDED_CHUNK_WIDTH];
+    ui64 m_selfOccludeMasks[PADDED_CHUNK_WIDTH][PADDED_CHUNK_WIDTH];
+    // Unmerged quads for the slice being meshed, indexed v * CHUNK_WIDTH + u
+    VoxelQuad m_sliceQuads[CHUNK_LAYER];
+    ui16 m_wvec[CHUNK_SIZE];
 
     std::vector<VoxelQuad> m_floraQuads;
     std::vector<VoxelQuad> m_quads[6];
@@ -108,6 +153,8 @@ class ChunkMesher {
     std::vector<LiquidVertex> _waterVboVerts;
 
     ChunkMeshData* m_chunkMeshData = nullptr;
+    ui32 m_remeshRegions = ALL_MESH_REGIONS;
+    size_t m_peakTransientBytes = 0;
 
     int m_highestY;
     int m_lowestY;
@@ -121,9 +168,4 @@ class ChunkMesher {
     static PlanetHeightData defaultChunkHeightData[CHUNK_LAYER];
 
     int wSize;
-
-    ui32 m_finalQuads[7000];
-
-    BlockVertex m_topVerts[4100];
-
 };
\ No newline at end of file
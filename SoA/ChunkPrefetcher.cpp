@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "ChunkPrefetcher.h"
+
+#include <set>
+#include <Vorb/utils.h>
+
+#include "Chunk.h"
+#include "ChunkGrid.h"
+#include "ChunkIOManager.h"
+#include "GameSystemComponents.h"
+#include "soaUtils.h"
+
+// The update thread runs at a fixed rate
+#define PREFETCH_UPDATES_PER_SECOND 60.0
+// Slower agents never outrun the sphere, in voxels per second
+#define PREFETCH_MIN_SPEED 8.0
+// How far ahead we will ever look, in chunks along the path
+#define PREFETCH_MAX_STEPS 32
+#define PREFETCH_MAX_CHUNKS 1024
+// Predict again at least this often, in updates
+#define PREFETCH_REPLAN_UPDATES 30
+// Only submit while fewer tasks than this are waiting in the pool
+#define PREFETCH_MAX_POOL_BACKLOG 16
+#define PREFETCH_SUBMITS_PER_UPDATE 8
+// Looking closer than this to the heading doesn't get its own path
+#define PREFETCH_LOOK_DOT 0.95
+
+void ChunkPrefetcher::update(ChunkSphereComponent& cmp, const f64v3& velocity, const f64v3& lookDir,
+                             f64 horizon, VoxPool* threadPool, ChunkIOManager* chunkIo) {
+    ChunkPrefetchData& data = cmp.prefetch;
+    if (horizon <= 0.0 || !cmp.chunkGrid) {
+        if (data.chunks.size() || data.queue.size()) cancel(cmp);
+        return;
+    }
+
+    if (data.center != cmp.centerPosition || ++data.age >= PREFETCH_REPLAN_UPDATES) {
+        predict(cmp, velocity, lookDir, horizon, chunkIo);
+    }
+
+    // Demand queries skip this queue, so they always get the pool first
+    for (int i = 0; i < PREFETCH_SUBMITS_PER_UPDATE && data.queue.size(); i++) {
+        if (threadPool && threadPool->getTasksSizeApprox() >= PREFETCH_MAX_POOL_BACKLOG) break;
+        i32v3 chunkPos = data.queue.back();
+        data.queue.pop_back();
+        // Hold it before submitting so it can't be freed in between
+        ChunkHandle h = cmp.chunkGrid->accessor.acquire(ChunkID(chunkPos));
+        if (h->genLevel < GEN_DONE) cmp.chunkGrid->submitQuery(chunkPos, GEN_DONE, true);
+        data.chunks[ChunkID(chunkPos)] = std::move(h);
+    }
+}
+
+void ChunkPrefetcher::cancel(ChunkSphereComponent& cmp) {
+    ChunkPrefetchData& data = cmp.prefetch;
+    for (auto& it : data.chunks) {
+        it.second.release();
+    }
+    data.chunks.clear();
+    data.queue.clear();
+    // Predict right away on the next update
+    data.age = PREFETCH_REPLAN_UPDATES;
+}
+
+void ChunkPrefetcher::predict(ChunkSphereComponent& cmp, const f64v3& velocity, const f64v3& lookDir,
+                              f64 horizon, ChunkIOManager* chunkIo) {
+    ChunkPrefetchData& data = cmp.prefetch;
+    data.center = cmp.centerPosition;
+    data.age = 0;
+    data.queue.clear();
+
+    std::map<ChunkID, ChunkHandle> kept;
+    f64 speed = vmath::length(velocity);
+    if (speed * PREFETCH_UPDATES_PER_SECOND >= PREFETCH_MIN_SPEED) {
+        // Chunks travelled within the horizon
+        i32 numSteps = (i32)std::min(speed * PREFETCH_UPDATES_PER_SECOND * horizon / CHUNK_WIDTH + 1.0,
+                                     (f64)PREFETCH_MAX_STEPS);
+        // Follow the velocity, and the view since that is where free movement turns to
+        f64v3 paths[2];
+        int numPaths = 0;
+        paths[numPaths++] = velocity / speed;
+        if (vmath::dot(lookDir, paths[0]) < PREFETCH_LOOK_DOT) paths[numPaths++] = lookDir;
+
+        const std::vector<i32v3>& offsets = getSphereOffsets(cmp.radius);
+        i32 radius2 = cmp.radius * cmp.radius;
+        std::set<ChunkID> visited;
+        bool isFull = false;
+        // Step outwards so the cap keeps the chunks that are needed first
+        for (i32 s = 1; s <= numSteps && !isFull; s++) {
+            for (int p = 0; p < numPaths && !isFull; p++) {
+                f64v3 c = f64v3(cmp.centerPosition) + paths[p] * (f64)s;
+                i32v3 center(fastFloor(c.x + 0.5), fastFloor(c.y + 0.5), fastFloor(c.z + 0.5));
+                for (auto& o : offsets) {
+                    // Only the leading half of the sphere can be new
+                    if (vmath::dot(f64v3(o), paths[p]) < 0.0) continue;
+                    i32v3 pos = center + o;
+                    if (selfDot(pos - cmp.centerPosition) <= radius2) continue; // Sphere has it
+                    ChunkID id(pos);
+                    if (!visited.insert(id).second) continue;
+
+                    auto it = data.chunks.find(id);
+                    if (it != data.chunks.end()) {
+                        kept[id] = std::move(it->second);
+                        data.chunks.erase(it);
+                    } else {
+                        data.queue.push_back(pos);
+                    }
+                    if (data.queue.size() + kept.size() >= PREFETCH_MAX_CHUNKS) {
+                        isFull = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Cancel what left the path, and what the sphere holds now
+    for (auto& it : data.chunks) {
+        it.second.release();
+    }
+    data.chunks.swap(kept);
+
+    // Soonest needed last
+    std::reverse(data.queue.begin(), data.queue.end());
+
+    if (chunkIo) {
+        m_ioPositions.resize(data.queue.size());
+        for (size_t i = 0; i < data.queue.size(); i++) {
+            m_ioPositions[i].pos = data.queue[i];
+            m_ioPositions[i].face = cmp.currentCubeFace;
+        }
+        chunkIo->setPrefetchList(m_ioPositions);
+    }
+}
+
+const std::vector<i32v3>& ChunkPrefetcher::getSphereOffsets(i32 radius) {
+    if (radius != m_offsetRadius) {
+        m_offsetRadius = radius;
+        m_sphereOffsets.clear();
+        i32 radius2 = radius * radius;
+        for (i32 y = -radius; y <= radius; y++) {
+            for (i32 z = -radius; z <= radius; z++) {
+                for (i32 x = -radius; x <= radius; x++) {
+                    if (x * x + y * y + z * z <= radius2) m_sphereOffsets.emplace_back(x, y, z);
+                }
+            }
+        }
+    }
+    return m_sphereOffsets;
+}
@@ -0,0 +1,62 @@
+///
+/// ChunkPrefetcher.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Requests the chunks a ChunkSphereComponent is about to enter, before
+/// its agent gets there. Prefetches only use the thread pool when demand
+/// queries leave it idle, and are released when the prediction changes.
+///
+
+#pragma once
+
+#ifndef ChunkPrefetcher_h__
+#define ChunkPrefetcher_h__
+
+#include <map>
+
+#include "ChunkHandle.h"
+#include "VoxelCoordinateSpaces.h"
+#include "VoxPool.h"
+
+class ChunkIOManager;
+struct ChunkSphereComponent;
+
+/// Prefetch state of one chunk sphere
+struct ChunkPrefetchData {
+    std::map<ChunkID, ChunkHandle> chunks; ///< Submitted, held until the sphere reaches them
+    std::vector<i32v3> queue; ///< Predicted but not submitted yet, soonest needed last
+    i32v3 center = i32v3(0); ///< Sphere center the prediction was made from
+    ui32 age = 0; ///< Updates since the prediction
+};
+
+class ChunkPrefetcher {
+public:
+    /// Predicts where the agent is headed and submits what the sphere will need
+    /// within horizon seconds.
+    /// @param velocity: Voxels per update
+    /// @param lookDir: Normalized view direction, in voxel space
+    /// @param horizon: How far ahead to prefetch, in seconds. 0 disables it.
+    /// @param chunkIo: Optional, pages in saved chunks on the path
+    void update(ChunkSphereComponent& cmp, const f64v3& velocity, const f64v3& lookDir,
+                f64 horizon, VoxPool* threadPool, ChunkIOManager* chunkIo);
+
+    /// Releases every prefetch of the sphere
+    void cancel(ChunkSphereComponent& cmp);
+private:
+    /// Rebuilds the queue along the predicted path, releasing chunks that left it
+    void predict(ChunkSphereComponent& cmp, const f64v3& velocity, const f64v3& lookDir,
+                 f64 horizon, ChunkIOManager* chunkIo);
+    /// Offsets inside a sphere of radius, for the current radius
+    const std::vector<i32v3>& getSphereOffsets(i32 radius);
+
+    std::vector<i32v3> m_sphereOffsets;
+    i32 m_offsetRadius = -1;
+    std::vector<ChunkPosition3D> m_ioPositions; ///< Scratch for ChunkIOManager::setPrefetchList
+};
+
+#endif // ChunkPrefetcher_h__
@@ -13,10 +13,139 @@
 #include "SoaOptions.h"
 #include "soaUtils.h"
 
+// Indices per quad in sharedIBO
+#define QUAD_INDICES 6
+
+namespace {
+    // Draws the quads of a face that are in use. The spare capacity at the
+    // end of each region slot is skipped.
+    void drawFaceRegions(const ChunkMesh* cm, int face) {
+        const ChunkMeshRegionLayout& layout = cm->regionLayout;
+        GLsizei counts[NUM_MESH_REGIONS];
+        const GLvoid* offsets[NUM_MESH_REGIONS];
+        GLsizei numDraws = 0;
+        for (int r = 0; r < NUM_MESH_REGIONS; r++) {
+            if (layout.count[face][r] == 0) continue;
+            counts[numDraws] = layout.count[face][r] * QUAD_INDICES;
+            offsets[numDraws] = (const GLvoid*)(layout.offset[face][r] * QUAD_INDICES * sizeof(GLuint));
+            numDraws++;
+        }
+        if (numDraws) glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, numDraws);
+    }
+
+    // Shaders for PackedBlockVertex. Inputs are in buildPackedVao order, and
+    // unMaterials holds the BlockMaterials in the layout ChunkMaterialTable documents.
+    const cString PACKED_VERT_SRC = R"(
+uniform mat4 unWVP;
+uniform mat4 unW;
+uniform usamplerBuffer unMaterials;
+
+in uvec4 vPosition_Face;
+in uvec2 vTex;
+in uint vMaterial;
+
+out vec3 fPosition;
+out vec2 fUV;
+flat out vec3 fNormal;
+flat out vec4 fTiles;
+flat out vec2 fAtlases;
+flat out vec4 fDims;
+flat out vec3 fColor;
+flat out vec3 fOverlayColor;
+flat out vec3 fBlendMode;
+
+// Positions are in 1/QUAD_SIZE voxels
+const float QUAD_SIZE = 7.0;
+const float TILES_PER_ROW = 16.0;
+// Indexed by vvox::Cardinal
+const vec3 FACE_NORMALS[6] = vec3[6](vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+                                     vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+                                     vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+
+vec4 unpackBytes(uint v) {
+    return vec4(v & 0xFFu, (v >> 8) & 0xFFu, (v >> 16) & 0xFFu, v >> 24);
+}
+
+void main() {
+    int texel = int(vMaterial) * 3;
+    uvec2 t0 = texelFetch(unMaterials, texel).rg;
+    uvec2 t1 = texelFetch(unMaterials, texel + 1).rg;
+    uvec2 t2 = texelFetch(unMaterials, texel + 2).rg;
+
+    vec4 texturePosition = unpackBytes(t0.x);
+    fAtlases = texturePosition.xz;
+    fTiles = vec4(mod(texturePosition.y, TILES_PER_ROW), floor(texturePosition.y / TILES_PER_ROW),
+                  mod(texturePosition.w, TILES_PER_ROW), floor(texturePosition.w / TILES_PER_ROW));
+    fDims = max(unpackBytes(t1.y), vec4(1.0));
+    vec4 color = unpackBytes(t2.x);
+    fColor = color.rgb / 255.0;
+    fOverlayColor = unpackBytes(t2.y).rgb / 255.0;
+    // Alpha, add and multiply fields of ChunkMesher::getBlendMode
+    uint blendMode = uint(color.a);
+    fBlendMode = vec3(float(blendMode & 3u), float((blendMode >> 2) & 3u) - 1.0, float((blendMode >> 4) & 3u));
+
+    fNormal = FACE_NORMALS[vPosition_Face.w];
+    fUV = vec2(vTex) - 128.0;
+    vec4 position = vec4(vec3(vPosition_Face.xyz) / QUAD_SIZE, 1.0);
+    fPosition = (unW * position).xyz;
+    gl_Position = unWVP * position;
+}
+)";
+    const cString PACKED_FRAG_SRC = R"(
+uniform sampler2DArray unTextures;
+uniform vec3 unLightDirWorld;
+uniform vec3 unSunColor;
+uniform vec3 unAmbientLight;
+uniform float unSpecularExponent;
+uniform float unSpecularIntensity;
+uniform float unFadeDist;
+
+in vec3 fPosition;
+in vec2 fUV;
+flat in vec3 fNormal;
+flat in vec4 fTiles;
+flat in vec2 fAtlases;
+flat in vec4 fDims;
+flat in vec3 fColor;
+flat in vec3 fOverlayColor;
+flat in vec3 fBlendMode;
+
+out vec4 pColor;
+
+const float TILES_PER_ROW = 16.0;
+
+// Textures that span several tiles repeat every dims tiles
+vec4 sampleTile(vec2 tile, float atlas, vec2 dims) {
+    vec2 uv = (tile + mod(fUV, dims)) / TILES_PER_ROW;
+    return texture(unTextures, vec3(uv, atlas));
+}
+
+void main() {
+    // Chunks are drawn relative to the camera
+    if (length(fPosition) > unFadeDist) discard;
+
+    vec4 base = sampleTile(fTiles.xy, fAtlases.x, fDims.xy) * vec4(fColor, 1.0);
+#ifdef CUTOUT
+    if (base.a < 0.5) discard;
+#endif
+    vec4 overlay = sampleTile(fTiles.zw, fAtlases.y, fDims.zw) * vec4(fOverlayColor, 1.0);
+    vec3 color = mix(base.rgb, overlay.rgb, overlay.a * fBlendMode.x);
+    color += overlay.rgb * overlay.a * fBlendMode.y;
+    color *= mix(vec3(1.0), overlay.rgb, overlay.a * (1.0 - fBlendMode.z));
+
+    float diffuse = max(dot(fNormal, unLightDirWorld), 0.0);
+    vec3 toEye = normalize(-fPosition);
+    float specular = pow(max(dot(reflect(-unLightDirWorld, fNormal), toEye), 0.0), unSpecularExponent) * unSpecularIntensity;
+    pColor = vec4(color * (unAmbientLight + unSunColor * diffuse) + unSunColor * specular * diffuse, 1.0);
+}
+)";
+}
+
 volatile f32 ChunkRenderer::fadeDist = 1.0f;
 f32m4 ChunkRenderer::worldMatrix = f32m4(1.0f);
 
 VGIndexBuffer ChunkRenderer::sharedIBO = 0;
+ChunkMaterialTable ChunkRenderer::materialTable;
 
 void ChunkRenderer::init() {
     // Not thread safe
@@ -63,77 +192,124 @@ void ChunkRenderer::init() {
      //   m_waterProgram = ShaderLoader::createProgramFromFile("Shaders/WaterShading/WaterShading.vert",
      //                                                        "Shaders/WaterShading/WaterShading.frag");
     }
+    if (soaOptions.get(OPT_PACKED_CHUNK_VERTICES).value.b) loadPackedPrograms();
     vg::GLProgram::unuse();
 }
 
-void ChunkRenderer::dispose() {
-    if (m_opaqueProgram.isCreated()) m_opaqueProgram.dispose();
-    if (m_transparentProgram.isCreated()) m_transparentProgram.dispose();
-    if (m_cutoutProgram.isCreated()) m_cutoutProgram.dispose();
-    if (m_waterProgram.isCreated()) m_waterProgram.dispose();
+void ChunkRenderer::loadPackedPrograms() {
+    if (m_packedOpaqueProgram.isCreated()) return;
+    // These don't do normal or displacement mapping, or animation
+    { // Opaque
+        m_packedOpaqueProgram = ShaderLoader::createProgram("PackedBlockOpaque", PACKED_VERT_SRC, PACKED_FRAG_SRC);
+        m_packedOpaqueProgram.use();
+        glUniform1i(m_packedOpaqueProgram.getUniform("unTextures"), 0);
+        glUniform1i(m_packedOpaqueProgram.getUniform("unMaterials"), 1);
+    }
+    { // Cutout
+        m_packedCutoutProgram = ShaderLoader::createProgram("PackedBlockCutout", PACKED_VERT_SRC, PACKED_FRAG_SRC,
+                                                            nullptr, "#define CUTOUT\n");
+        m_packedCutoutProgram.use();
+        glUniform1i(m_packedCutoutProgram.getUniform("unTextures"), 0);
+        glUniform1i(m_packedCutoutProgram.getUniform("unMaterials"), 1);
+    }
+    vg::GLProgram::unuse();
 }
 
-void ChunkRenderer::beginOpaque(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor /*= f32v3(1.0f)*/, const f32v3& ambient /*= f32v3(0.0f)*/) {
-    m_opaqueProgram.use();
-    glUniform3fv(m_opaqueProgram.getUniform("unLightDirWorld"), 1, &(sunDir[0]));
-    glUniform1f(m_opaqueProgram.getUniform("unSpecularExponent"), soaOptions.get(OPT_SPECULAR_EXPONENT).value.f);
-    glUniform1f(m_opaqueProgram.getUniform("unSpecularIntensity"), soaOptions.get(OPT_SPECULAR_INTENSITY).value.f * 0.3f);
+void ChunkRenderer::setupProgram(vg::GLProgram& program) {
+    m_activeProgram = &program;
+    program.use();
+    glUniform3fv(program.getUniform("unLightDirWorld"), 1, &(m_sunDir[0]));
+    glUniform1f(program.getUniform("unSpecularExponent"), soaOptions.get(OPT_SPECULAR_EXPONENT).value.f);
+    glUniform1f(program.getUniform("unSpecularIntensity"), soaOptions.get(OPT_SPECULAR_INTENSITY).value.f * 0.3f);
 
     // Bind the block textures
     glActiveTexture(GL_TEXTURE0);
-    glUniform1i(m_opaqueProgram.getUniform("unTextures"), 0); // TODO(Ben): Temporary
-    glBindTexture(GL_TEXTURE_2D_ARRAY, textureAtlas);
+    glUniform1i(program.getUniform("unTextures"), 0); // TODO(Ben): Temporary
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureAtlas);
+    if (&program == &m_packedOpaqueProgram || &program == &m_packedCutoutProgram) {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, materialTable.getTexture());
+        glActiveTexture(GL_TEXTURE0);
+    }
 
-    f32 blockAmbient = 0.000f;
-    glUniform3fv(m_opaqueProgram.getUniform("unAmbientLight"), 1, &ambient[0]);
-    glUniform3fv(m_opaqueProgram.getUniform("unSunColor"), 1, &sunDir[0]);
+    glUniform3fv(program.getUniform("unAmbientLight"), 1, &m_ambient[0]);
+    glUniform3fv(program.getUniform("unSunColor"), 1, &m_sunDir[0]);
 
-    glUniform1f(m_opaqueProgram.getUniform("unFadeDist"), 100000.0f/*ChunkRenderer::fadeDist*/);
+    glUniform1f(program.getUniform("unFadeDist"), 100000.0f/*ChunkRenderer::fadeDist*/);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedIBO);
 }
 
-void ChunkRenderer::drawOpaque(const ChunkMesh *cm, const f64v3 &PlayerPos, const f32m4 &VP) const {
+bool ChunkRenderer::useProgramFor(const ChunkMesh* cm, vg::GLProgram& program, vg::GLProgram& packedProgram) {
+    vg::GLProgram& p = cm->isPacked ? packedProgram : program;
+    if (!p.isCreated()) return false;
+    // Only switches while meshes of both formats are around
+    if (&p != m_activeProgram) setupProgram(p);
+    return true;
+}
+
+void ChunkRenderer::dispose() {
+    if (m_opaqueProgram.isCreated()) m_opaqueProgram.dispose();
+    if (m_transparentProgram.isCreated()) m_transparentProgram.dispose();
+    if (m_cutoutProgram.isCreated()) m_cutoutProgram.dispose();
+    if (m_waterProgram.isCreated()) m_waterProgram.dispose();
+    if (m_packedOpaqueProgram.isCreated()) m_packedOpaqueProgram.dispose();
+    if (m_packedCutoutProgram.isCreated()) m_packedCutoutProgram.dispose();
+    materialTable.dispose();
+}
+
+void ChunkRenderer::beginOpaque(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor /*= f32v3(1.0f)*/, const f32v3& ambient /*= f32v3(0.0f)*/) {
+    m_textureAtlas = textureAtlas;
+    m_sunDir = sunDir;
+    m_ambient = ambient;
+    if (soaOptions.get(OPT_PACKED_CHUNK_VERTICES).value.b) loadPackedPrograms();
+    // Meshes uploaded so far only reference materials added before them
+    materialTable.update();
+    setupProgram(m_opaqueProgram);
+}
+
+void ChunkRenderer::drawOpaque(const ChunkMesh *cm, const f64v3 &PlayerPos, const f32m4 &VP) {
     if (cm->vaoID == 0) return;
+    if (!useProgramFor(cm, m_opaqueProgram, m_packedOpaqueProgram)) return;
     
     setMatrixTranslation(worldMatrix, f64v3(cm->position), PlayerPos);
 
     f32m4 MVP = VP * worldMatrix;
-    glUniformMatrix4fv(m_opaqueProgram.getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
-    glUniformMatrix4fv(m_opaqueProgram.getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
+    glUniformMatrix4fv(m_activeProgram->getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
+    glUniformMatrix4fv(m_activeProgram->getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
 
     glBindVertexArray(cm->vaoID);
 
     const ChunkMeshRenderData& chunkMeshInfo = cm->renderData;
     //top
     if (chunkMeshInfo.pyVboSize && PlayerPos.y > cm->position.y + chunkMeshInfo.lowestY) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pyVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pyVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 3);
     }
     //front
     if (chunkMeshInfo.pzVboSize && PlayerPos.z > cm->position.z + chunkMeshInfo.lowestZ){
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pzVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pzVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 5);
     }
     //back
     if (chunkMeshInfo.nzVboSize && PlayerPos.z < cm->position.z + chunkMeshInfo.highestZ){
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nzVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nzVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 4);
     }
     //left
     if (chunkMeshInfo.nxVboSize && PlayerPos.x < cm->position.x + chunkMeshInfo.highestX){
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nxVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nxVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 0);
     }
     //right
     if (chunkMeshInfo.pxVboSize && PlayerPos.x > cm->position.x + chunkMeshInfo.lowestX){
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pxVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pxVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 1);
     }
     //bottom
     if (chunkMeshInfo.nyVboSize && PlayerPos.y < cm->position.y + chunkMeshInfo.highestY){
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nyVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nyVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 2);
     }
 
     glBindVertexArray(0);
 }
 
 void ChunkRenderer::drawOpaqueCustom(const ChunkMesh* cm, vg::GLProgram& m_program, const f64v3& PlayerPos, const f32m4& VP) {
-    if (cm->vaoID == 0) return;
+    if (cm->vaoID == 0 || cm->isPacked) return;
     
     setMatrixTranslation(worldMatrix, f64v3(cm->position), PlayerPos);
 
@@ -147,27 +323,27 @@ void ChunkRenderer::drawOpaqueCustom(const ChunkMesh* cm, vg::GLProgram& m_progr
     const ChunkMeshRenderData& chunkMeshInfo = cm->renderData;
     //top
     if (chunkMeshInfo.pyVboSize && PlayerPos.y > cm->position.y + chunkMeshInfo.lowestY) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pyVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pyVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 3);
     }
     //front
     if (chunkMeshInfo.pzVboSize && PlayerPos.z > cm->position.z + chunkMeshInfo.lowestZ) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pzVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pzVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 5);
     }
     //back
     if (chunkMeshInfo.nzVboSize && PlayerPos.z < cm->position.z + chunkMeshInfo.highestZ) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nzVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nzVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 4);
     }
     //left
     if (chunkMeshInfo.nxVboSize && PlayerPos.x < cm->position.x + chunkMeshInfo.highestX) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nxVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nxVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 0);
     }
     //right
     if (chunkMeshInfo.pxVboSize && PlayerPos.x > cm->position.x + chunkMeshInfo.lowestX) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.pxVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.pxVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 1);
     }
     //bottom
     if (chunkMeshInfo.nyVboSize && PlayerPos.y < cm->position.y + chunkMeshInfo.highestY) {
-        glDrawElements(GL_TRIANGLES, chunkMeshInfo.nyVboSize, GL_UNSIGNED_INT, (void*)(chunkMeshInfo.nyVboOff * sizeof(GLuint)));
+        drawFaceRegions(cm, 2);
     }
 
     glBindVertexArray(0);
@@ -212,33 +388,24 @@ void ChunkRenderer::drawTransparent(const ChunkMesh *cm, const f64v3 &playerPos,
 }
 
 void ChunkRenderer::beginCutout(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor /*= f32v3(1.0f)*/, const f32v3& ambient /*= f32v3(0.0f)*/) {
-    m_cutoutProgram.use();
-    glUniform3fv(m_cutoutProgram.getUniform("unLightDirWorld"), 1, &(sunDir[0]));
-    glUniform1f(m_cutoutProgram.getUniform("unSpecularExponent"), soaOptions.get(OPT_SPECULAR_EXPONENT).value.f);
-    glUniform1f(m_cutoutProgram.getUniform("unSpecularIntensity"), soaOptions.get(OPT_SPECULAR_INTENSITY).value.f * 0.3f);
-
-    // Bind the block textures
-    glActiveTexture(GL_TEXTURE0);
-    glUniform1i(m_cutoutProgram.getUniform("unTextures"), 0); // TODO(Ben): Temporary
-    glBindTexture(GL_TEXTURE_2D_ARRAY, textureAtlas);
-
-    f32 blockAmbient = 0.000f;
-    glUniform3fv(m_cutoutProgram.getUniform("unAmbientLight"), 1, &ambient[0]);
-    glUniform3fv(m_cutoutProgram.getUniform("unSunColor"), 1, &sunDir[0]);
-
-    glUniform1f(m_cutoutProgram.getUniform("unFadeDist"), 100000.0f/*ChunkRenderer::fadeDist*/);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedIBO);
+    m_textureAtlas = textureAtlas;
+    m_sunDir = sunDir;
+    m_ambient = ambient;
+    if (soaOptions.get(OPT_PACKED_CHUNK_VERTICES).value.b) loadPackedPrograms();
+    materialTable.update();
+    setupProgram(m_cutoutProgram);
 }
 
-void ChunkRenderer::drawCutout(const ChunkMesh *cm, const f64v3 &playerPos, const f32m4 &VP) const {
+void ChunkRenderer::drawCutout(const ChunkMesh *cm, const f64v3 &playerPos, const f32m4 &VP) {
     if (cm->cutoutVaoID == 0) return;
+    if (!useProgramFor(cm, m_cutoutProgram, m_packedCutoutProgram)) return;
 
     setMatrixTranslation(worldMatrix, f64v3(cm->position), playerPos);
 
     f32m4 MVP = VP * worldMatrix;
 
-    glUniformMatrix4fv(m_cutoutProgram.getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
-    glUniformMatrix4fv(m_cutoutProgram.getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
+    glUniformMatrix4fv(m_activeProgram->getUniform("unWVP"), 1, GL_FALSE, &MVP[0][0]);
+    glUniformMatrix4fv(m_activeProgram->getUniform("unW"), 1, GL_FALSE, &worldMatrix[0][0]);
 
     glBindVertexArray(cm->cutoutVaoID);
 
@@ -5,6 +5,7 @@
 
 #include <Vorb/graphics/GLProgram.h>
 
+#include "ChunkMaterialTable.h"
 #include "ChunkMesh.h"
 
 class GameRenderParams;
@@ -19,14 +20,15 @@ class ChunkRenderer {
     void dispose();
 
     void beginOpaque(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
-    void drawOpaque(const ChunkMesh* cm, const f64v3& PlayerPos, const f32m4& VP) const;
+    void drawOpaque(const ChunkMesh* cm, const f64v3& PlayerPos, const f32m4& VP);
+    // Skips packed meshes, since m_program reads BlockVertex attributes
     static void drawOpaqueCustom(const ChunkMesh* cm, vg::GLProgram& m_program, const f64v3& PlayerPos, const f32m4& VP);
 
     void beginTransparent(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
     void drawTransparent(const ChunkMesh* cm, const f64v3& playerPos, const f32m4& VP) const;
     
     void beginCutout(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
-    void drawCutout(const ChunkMesh* cm, const f64v3& playerPos, const f32m4& VP) const;
+    void drawCutout(const ChunkMesh* cm, const f64v3& playerPos, const f32m4& VP);
 
     void beginLiquid(VGTexture textureAtlas, const f32v3& sunDir, const f32v3& lightColor = f32v3(1.0f), const f32v3& ambient = f32v3(0.0f));
     void drawLiquid(const ChunkMesh* cm, const f64v3& PlayerPos, const f32m4& VP) const;
@@ -36,12 +38,28 @@ class ChunkRenderer {
 
     static volatile f32 fadeDist;
     static VGIndexBuffer sharedIBO;
+    static ChunkMaterialTable materialTable; ///< Materials of packed meshes
 private:
+    // Loads the programs for PackedBlockVertex if they aren't yet
+    void loadPackedPrograms();
+    // Binds program and sets the uniforms of the current begin call
+    void setupProgram(vg::GLProgram& program);
+    // Switches to the program for the vertex format of cm. Returns false if cm can't be drawn.
+    bool useProgramFor(const ChunkMesh* cm, vg::GLProgram& program, vg::GLProgram& packedProgram);
+
     static f32m4 worldMatrix; ///< Reusable world matrix for chunks
     vg::GLProgram m_opaqueProgram;
     vg::GLProgram m_transparentProgram;
     vg::GLProgram m_cutoutProgram;
     vg::GLProgram m_waterProgram;
+    vg::GLProgram m_packedOpaqueProgram;
+    vg::GLProgram m_packedCutoutProgram;
+
+    // State of the last beginOpaque or beginCutout
+    vg::GLProgram* m_activeProgram = nullptr;
+    VGTexture m_textureAtlas = 0;
+    f32v3 m_sunDir;
+    f32v3 m_ambient;
 };
 
 #endif // ChunkRenderer_h__
@@ -0,0 +1,223 @@
+#include "stdafx.h"
+#include "ChunkSaveJournal.h"
+
+#include <algorithm>
+#include <io.h>
+
+#include <Vorb/utils.h>
+#include <ZLIB/zlib.h>
+
+#include "Errors.h"
+#include "RegionFileManager.h"
+
+// Journal records are a header followed by a compressed chunk, ChunkHeader included.
+// Header: magic, x, y, z, face, size, adler32 of the chunk. All big-endian.
+#define JOURNAL_MAGIC 0x534F414A // "SOAJ"
+#define RECORD_HEADER_SIZE 28
+
+// Checkpoint once this many chunks are pending...
+#define CHECKPOINT_MIN_PENDING 256
+// ...or the oldest pending save is this old
+#define CHECKPOINT_DELAY_MS 2000
+
+namespace {
+    struct JournalRecord {
+        ChunkPosition3D gridPos;
+        nString region;
+        size_t offset; ///< Offset of the compressed chunk in the batch
+        ui32 size;
+    };
+
+    /// Orders writes by region, then by grid position, so each region file
+    /// is acquired once and neighboring chunks are written together
+    bool recordWriteOrder(const JournalRecord& a, const JournalRecord& b) {
+        if (a.region != b.region) return a.region < b.region;
+        if (a.gridPos.pos.y != b.gridPos.pos.y) return a.gridPos.pos.y < b.gridPos.pos.y;
+        if (a.gridPos.pos.z != b.gridPos.pos.z) return a.gridPos.pos.z < b.gridPos.pos.z;
+        return a.gridPos.pos.x < b.gridPos.pos.x;
+    }
+}
+
+ChunkSaveJournal::ChunkSaveJournal(const nString& saveDir) :
+    m_filePath(saveDir + "/Region/journal.dat") {
+    // Empty
+}
+
+void ChunkSaveJournal::add(const ChunkPosition3D& gridPos, std::vector<ui8>& data) {
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    if (m_pending.empty()) m_oldestPending = std::chrono::steady_clock::now();
+
+    PendingSave& save = m_pending[SaveKey(gridPos)];
+    save.gridPos = gridPos;
+    save.data.swap(data);
+}
+
+bool ChunkSaveJournal::getPending(const ChunkPosition3D& gridPos, RegionIOBuffers& buffers) {
+    SaveKey key(gridPos);
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    auto it = m_pending.find(key);
+    if (it == m_pending.end()) {
+        it = m_checkpointing.find(key);
+        if (it == m_checkpointing.end()) return false;
+    }
+    memcpy(buffers.chunkBuffer, it->second.data.data(), it->second.data.size());
+    buffers.chunkBufferSize = it->second.data.size();
+    return true;
+}
+
+bool ChunkSaveJournal::shouldCheckpoint() {
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    if (m_pending.empty()) return false;
+    if (m_pending.size() >= CHECKPOINT_MIN_PENDING) return true;
+    return std::chrono::steady_clock::now() - m_oldestPending >= std::chrono::milliseconds(CHECKPOINT_DELAY_MS);
+}
+
+bool ChunkSaveJournal::hasPending() {
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    return !m_pending.empty();
+}
+
+bool ChunkSaveJournal::checkpoint(RegionFileManager& regionFileManager, RegionIOBuffers& buffers) {
+    std::unique_lock<std::mutex> checkpointLock(m_checkpointLock, std::try_to_lock);
+    if (!checkpointLock.owns_lock()) return true;
+
+    { // Take the pending saves. Saves queued from now on go in the next checkpoint.
+        std::lock_guard<std::mutex> lock(m_pendingLock);
+        if (m_pending.empty()) return true;
+        m_checkpointing.swap(m_pending);
+    }
+
+    // Compress everything into one batch so the journal gets a single append.
+    // Only this thread changes m_checkpointing, so reading it without the lock
+    // is safe. Changes still take the lock, since getPending reads it.
+    std::vector<ui8> batch;
+    std::vector<JournalRecord> records;
+    std::vector<SaveKey> failed;
+    records.reserve(m_checkpointing.size());
+    for (auto& it : m_checkpointing) {
+        const PendingSave& save = it.second;
+        memcpy(buffers.chunkBuffer, save.data.data(), save.data.size());
+        buffers.chunkBufferSize = save.data.size();
+        if (!regionFileManager.compressChunk(buffers)) {
+            // Compressing the same snapshot again won't go any better
+            pError("Failed to compress a chunk save for region " + regionFileManager.getRegionString(save.gridPos) +
+                   ", dropping it");
+            failed.push_back(it.first);
+            continue;
+        }
+
+        JournalRecord record;
+        record.gridPos = save.gridPos;
+        record.region = regionFileManager.getRegionString(save.gridPos);
+        record.offset = batch.size() + RECORD_HEADER_SIZE;
+        record.size = (ui32)buffers.compressedBufferSize;
+        records.push_back(record);
+
+        ui8 header[RECORD_HEADER_SIZE];
+        BufferUtils::setInt(header, 0, JOURNAL_MAGIC);
+        BufferUtils::setInt(header, 4, (ui32)save.gridPos.pos.x);
+        BufferUtils::setInt(header, 8, (ui32)save.gridPos.pos.y);
+        BufferUtils::setInt(header, 12, (ui32)save.gridPos.pos.z);
+        BufferUtils::setInt(header, 16, (ui32)save.gridPos.face);
+        BufferUtils::setInt(header, 20, record.size);
+        BufferUtils::setInt(header, 24, (ui32)adler32(adler32(0L, Z_NULL, 0), buffers.compressedBuffer, record.size));
+        batch.insert(batch.end(), header, header + RECORD_HEADER_SIZE);
+        batch.insert(batch.end(), buffers.compressedBuffer, buffers.compressedBuffer + record.size);
+    }
+
+    if (!failed.empty()) {
+        std::lock_guard<std::mutex> lock(m_pendingLock);
+        for (size_t i = 0; i < failed.size(); i++) {
+            m_checkpointing.erase(failed[i]);
+        }
+    }
+
+    // Once the batch is on disk the saves survive a crash
+    FILE* file = fopen(m_filePath.c_str(), "ab");
+    bool isJournaled = file && fwrite(batch.data(), 1, batch.size(), file) == batch.size() &&
+                       fflush(file) == 0 && _commit(_fileno(file)) == 0;
+    if (file) fclose(file);
+
+    bool rv = isJournaled;
+    if (isJournaled) {
+        std::sort(records.begin(), records.end(), recordWriteOrder);
+        std::vector<SaveKey> written;
+        written.reserve(records.size());
+        for (size_t i = 0; i < records.size(); i++) {
+            const JournalRecord& record = records[i];
+            if (regionFileManager.writeChunk(record.gridPos, &batch[record.offset], record.size)) {
+                written.push_back(SaveKey(record.gridPos));
+            } else {
+                rv = false;
+            }
+        }
+        regionFileManager.flush();
+
+        std::lock_guard<std::mutex> lock(m_pendingLock);
+        for (size_t i = 0; i < written.size(); i++) {
+            m_checkpointing.erase(written[i]);
+        }
+        // Failed writes are still in the journal, keep it until they land
+        if (rv) truncate();
+    } else {
+        pError("Failed to write chunk save journal " + m_filePath);
+    }
+
+    std::lock_guard<std::mutex> lock(m_pendingLock);
+    // Retry whatever didn't make it, unless a newer save replaced it
+    for (auto& it : m_checkpointing) {
+        if (m_pending.empty()) m_oldestPending = std::chrono::steady_clock::now();
+        m_pending.insert(std::move(it));
+    }
+    m_checkpointing.clear();
+    return rv;
+}
+
+bool ChunkSaveJournal::replay(RegionFileManager& regionFileManager) {
+    std::lock_guard<std::mutex> checkpointLock(m_checkpointLock);
+
+    FILE* file = fopen(m_filePath.c_str(), "rb");
+    if (!file) return true;
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<ui8> data(fileSize > 0 ? fileSize : 0);
+    size_t size = data.empty() ? 0 : fread(data.data(), 1, data.size(), file);
+    fclose(file);
+
+    bool rv = true;
+    size_t offset = 0;
+    // Stop at the first bad record. Only the end of the journal can be torn by a crash.
+    while (offset + RECORD_HEADER_SIZE <= size) {
+        ui8* header = &data[offset];
+        if (BufferUtils::extractInt(header, 0) != JOURNAL_MAGIC) break;
+        ui32 chunkSize = BufferUtils::extractInt(header, 20);
+        if (chunkSize > size - offset - RECORD_HEADER_SIZE) break;
+        ui8* chunkData = header + RECORD_HEADER_SIZE;
+        if ((ui32)adler32(adler32(0L, Z_NULL, 0), chunkData, chunkSize) != BufferUtils::extractInt(header, 24)) break;
+
+        ChunkPosition3D gridPos;
+        gridPos.pos.x = (i32)BufferUtils::extractInt(header, 4);
+        gridPos.pos.y = (i32)BufferUtils::extractInt(header, 8);
+        gridPos.pos.z = (i32)BufferUtils::extractInt(header, 12);
+        gridPos.face = (WorldCubeFace)BufferUtils::extractInt(header, 16);
+        // Later records of the same chunk overwrite earlier ones
+        if (!regionFileManager.writeChunk(gridPos, chunkData, chunkSize)) rv = false;
+
+        offset += RECORD_HEADER_SIZE + chunkSize;
+    }
+
+    regionFileManager.flush();
+    if (rv) {
+        truncate();
+    } else {
+        pError("Failed to replay chunk save journal " + m_filePath);
+    }
+    return rv;
+}
+
+void ChunkSaveJournal::truncate() {
+    FILE* file = fopen(m_filePath.c_str(), "wb");
+    if (file) fclose(file);
+}
@@ -0,0 +1,82 @@
+///
+/// ChunkSaveJournal.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Write-behind cache for chunk saves. Saves are snapshotted when they are
+/// queued, coalesced by cube face and ChunkID, appended to a journal, and then written to
+/// the region files one region at a time.
+///
+
+#pragma once
+
+#ifndef ChunkSaveJournal_h__
+#define ChunkSaveJournal_h__
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "ChunkID.h"
+#include "VoxelCoordinateSpaces.h"
+
+class RegionFileManager;
+struct RegionIOBuffers;
+
+class ChunkSaveJournal {
+public:
+    ChunkSaveJournal(const nString& saveDir);
+
+    /// Queues a snapshot of a chunk, replacing any pending snapshot of the same chunk.
+    /// @param data: Uncompressed chunk data from RegionFileManager::serializeChunk. Swapped out.
+    void add(const ChunkPosition3D& gridPos, std::vector<ui8>& data);
+    /// Copies the newest unwritten snapshot of a chunk into chunkBuffer
+    /// @return false if the chunk has no pending save
+    bool getPending(const ChunkPosition3D& gridPos, RegionIOBuffers& buffers);
+
+    /// @return true if enough saves are pending, or they have waited long enough
+    bool shouldCheckpoint();
+    bool hasPending();
+
+    /// Journals every pending snapshot, then writes them to the region files.
+    /// Only one thread checkpoints at a time, others return right away.
+    bool checkpoint(RegionFileManager& regionFileManager, RegionIOBuffers& buffers);
+    /// Writes the saves of a journal left behind by a crash to the region files
+    bool replay(RegionFileManager& regionFileManager);
+private:
+    /// Every cube face has its own grid, so the same ChunkID shows up once per face
+    struct SaveKey {
+        SaveKey(const ChunkPosition3D& gridPos) : id(gridPos.pos), face(gridPos.face) {}
+        bool operator==(const SaveKey& o) const { return id.id == o.id.id && face == o.face; }
+
+        ChunkID id;
+        WorldCubeFace face;
+    };
+    struct SaveKeyHash {
+        size_t operator()(const SaveKey& k) const {
+            return std::hash<ui64>()(k.id.id ^ ((ui64)k.face * 0x9E3779B97F4A7C15ull));
+        }
+    };
+    struct PendingSave {
+        ChunkPosition3D gridPos;
+        std::vector<ui8> data;
+    };
+    typedef std::unordered_map<SaveKey, PendingSave, SaveKeyHash> PendingMap;
+
+    /// Empties the journal once its saves are in the region files
+    void truncate();
+
+    PendingMap m_pending; ///< Guarded by m_pendingLock
+    PendingMap m_checkpointing; ///< Saves being written by checkpoint. Guarded by m_pendingLock.
+    std::chrono::steady_clock::time_point m_oldestPending;
+    std::mutex m_pendingLock;
+    std::mutex m_checkpointLock;
+
+    nString m_filePath;
+};
+
+#endif // ChunkSaveJournal_h__
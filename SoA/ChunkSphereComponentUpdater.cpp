@@ -4,6 +4,7 @@
 #include "ChunkAccessor.h"
 #include "ChunkID.h"
 #include "GameSystem.h"
+#include "SoaOptions.h"
 #include "SpaceSystem.h"
 #include "VoxelSpaceConversions.h"
 #include "soaUtils.h"
@@ -21,6 +22,7 @@ void ChunkSphereComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* sp
         // Check for grid shift or init
         if (cmp.currentCubeFace != chunkPos.face) {
             releaseHandles(cmp);
+            m_prefetcher.cancel(cmp);
             cmp.centerPosition = chunkPos;
             cmp.currentCubeFace = chunkPos.face;
             auto& sphericalVoxel = spaceSystem->sphericalVoxel.get(voxelPos.parentVoxel);
@@ -93,6 +95,18 @@ void ChunkSphereComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* sp
                 }
             }
         }
+
+        // Request the chunks we are heading into before the sphere needs them
+        f64v3 velocity(0.0);
+        vecs::ComponentID physicsID = gameSystem->physics.getComponentID(it.first);
+        if (physicsID) velocity = gameSystem->physics.get(physicsID).velocity;
+        f64q orientation = voxelPos.orientation;
+        vecs::ComponentID headID = gameSystem->head.getComponentID(it.first);
+        if (headID) orientation = orientation * gameSystem->head.get(headID).relativeOrientation;
+        auto& sphericalVoxel = spaceSystem->sphericalVoxel.get(voxelPos.parentVoxel);
+        m_prefetcher.update(cmp, velocity, orientation * f64v3(0.0, 0.0, 1.0),
+                            (f64)soaOptions.get(OPT_CHUNK_PREFETCH_HORIZON).value.f,
+                            sphericalVoxel.threadPool, sphericalVoxel.chunkIo);
     }
 }
 
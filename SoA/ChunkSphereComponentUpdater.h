@@ -16,6 +16,7 @@
 #define ChunkSphereAcquirer_h__
 
 #include "ChunkHandle.h"
+#include "ChunkPrefetcher.h"
 #include "GameSystemComponents.h"
 
 class GameSystem;
@@ -35,6 +36,8 @@ class ChunkSphereComponentUpdater {
     void releaseAndDisconnect(ChunkSphereComponent& cmp, ChunkHandle& h);
     void releaseHandles(ChunkSphereComponent& cmp);
     void initSphere(ChunkSphereComponent& cmp);
+
+    ChunkPrefetcher m_prefetcher;
 };
 
 #endif // ChunkSphereAcquirer_h__
@@ -127,6 +127,10 @@ void ChunkUpdater::placeBlockNoUpdate(Chunk* chunk, BlockIndex blockIndex, Block
  
     chunk->blocks.set(blockIndex, blockType);
     chunk->flagDirty();
+    chunk->flagDirtyMeshRegion(blockIndex);
+    chunk->queueLightUpdate(blockIndex);
+    chunk->queueCaUpdate(blockIndex);
+    chunk->updateVersion++;
 
     //Block &block = GETBLOCK(blockType);
 
@@ -9,10 +9,12 @@
 
 struct ChunkAccessSpeedData {
     size_t numThreads;
-    std::thread* threads;
+    size_t requestCount;
 
     std::mutex lock;
     std::condition_variable cv;
+    size_t numReady;
+    bool isStarted;
 
     PagedChunkAllocator allocator;
     ChunkAccessor accessor;
@@ -25,25 +27,43 @@ ChunkAccessSpeedData* createCASData(size_t numThreads, size_t requestCount, ui64
     ChunkAccessSpeedData* data = new ChunkAccessSpeedData;
 
     data->accessor.init(&data->allocator);
-
-    // Create the thread pools
     data->numThreads = numThreads;
-    data->threads = new std::thread[numThreads] {};
-    for (size_t threadID = 0; threadID < numThreads; threadID++) {
-        std::thread([data, threadID, requestCount] () {
-            { // Wait until everyone is notified
+    data->requestCount = requestCount;
+
+    // Create the random requests. Fixed seed so runs can be compared.
+    std::mt19937 rEngine(0);
+    std::uniform_int_distribution<ui64> idDist(0, maxID - 1);
+    data->ids = new ChunkID[requestCount * numThreads];
+    data->handles = new ChunkHandle[requestCount * numThreads]{};
+    for (size_t i = 0; i < requestCount * numThreads; i++) {
+        data->ids[i] = idDist(rEngine);
+    }
+
+    return data;
+}
+
+void runCAS(ChunkAccessSpeedData* data) {
+    data->numReady = 0;
+    data->isStarted = false;
+
+    std::vector<f64> threadTimes(data->numThreads);
+    std::vector<std::thread> threads;
+    for (size_t threadID = 0; threadID < data->numThreads; threadID++) {
+        threads.emplace_back([data, threadID, &threadTimes] () {
+            { // Wait until every thread is ready so they all race
                 std::unique_lock<std::mutex> lock(data->lock);
-                printf("Thread %d awaiting notification\n", threadID);
-                data->cv.wait(lock);
+                data->numReady++;
+                data->cv.notify_all();
+                data->cv.wait(lock, [data] () { return data->isStarted; });
             }
 
-            std::mt19937 rEngine(threadID);
+            // Same release pattern every run
+            std::mt19937 rEngine((ui32)threadID);
             std::uniform_int_distribution<int> release(0, 1);
 
-            // Begin requesting chunks
-            printf("Thread %d starting\n", threadID);
             PreciseTimer timer;
             timer.start();
+            size_t requestCount = data->requestCount;
             ChunkID* id = data->ids + (requestCount * threadID);
             ChunkHandle* hndAcquire = data->handles + (requestCount * threadID);
             ChunkHandle* hndRelease = hndAcquire;
@@ -60,33 +80,40 @@ ChunkAccessSpeedData* createCASData(size_t numThreads, size_t requestCount, ui64
                     id++;
                 }
             }
-            printf("Thread %d finished in %lf ms\n", threadID, timer.stop());
-        }).swap(data->threads[threadID]);
-        data->threads[threadID].detach();
+            threadTimes[threadID] = timer.stop();
+        });
     }
 
-    // Create the random requests
-    data->ids = new ChunkID[requestCount * numThreads];
-    data->handles = new ChunkHandle[requestCount * numThreads]{};
-    for (size_t i = 0; i < requestCount * numThreads; i++) {
-        data->ids[i] = rand() % maxID;
+    { // Start the races
+        std::unique_lock<std::mutex> lock(data->lock);
+        data->cv.wait(lock, [data] () { return data->numReady == data->numThreads; });
+        data->isStarted = true;
     }
-
-    return data;
-}
-
-void runCAS(ChunkAccessSpeedData* data) {
-    // Start the races
+    PreciseTimer timer;
+    timer.start();
     data->cv.notify_all();
+    for (auto& t : threads) t.join();
+    f64 totalMs = timer.stop();
+
+    f64 slowestMs = 0.0;
+    for (size_t i = 0; i < data->numThreads; i++) {
+        if (threadTimes[i] > slowestMs) slowestMs = threadTimes[i];
+    }
+    // Every request is one acquire and one release
+    f64 numOps = (f64)(data->requestCount * data->numThreads * 2);
+    printf("CAS: %d threads, %d requests each\n", (int)data->numThreads, (int)data->requestCount);
+    printf("  Total %lf ms, slowest thread %lf ms\n", totalMs, slowestMs);
+    printf("  %lf million ops/s\n", numOps / (totalMs * 1000.0));
+    printf("  Chunks Alive: %d\n", (int)data->accessor.getCountAlive());
+    fflush(stdout);
 }
 
 void freeCAS(ChunkAccessSpeedData* data) {
-    printf("Chunks Alive: %d\n", data->accessor.getCountAlive());
+    printf("Chunks Alive: %d\n", (int)data->accessor.getCountAlive());
     fflush(stdout);
     data->accessor.destroy();
     delete[] data->ids;
     delete[] data->handles;
-    delete[] data->threads;
     delete data;
 }
 
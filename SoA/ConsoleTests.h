@@ -22,6 +22,8 @@
 /************************************************************************/
 struct ChunkAccessSpeedData;
 ChunkAccessSpeedData* createCASData(size_t numThreads, size_t requestCount, ui64 maxID);
+/// Races the threads through their requests and prints the throughput.
+/// Can be run again on the same data, requests are the same every run.
 void runCAS(ChunkAccessSpeedData* data);
 void freeCAS(ChunkAccessSpeedData* data);
 
@@ -35,6 +35,10 @@ const i32 CHUNK_WIDTH_M1 = 31;
 const i32 HALF_CHUNK_WIDTH = CHUNK_WIDTH / 2;
 const i32 CHUNK_LAYER = CHUNK_WIDTH*CHUNK_WIDTH;
 const i32 CHUNK_SIZE = CHUNK_LAYER*CHUNK_WIDTH;
+// Chunk meshes are split into slabs of MESH_REGION_HEIGHT layers that can be remeshed alone
+const i32 MESH_REGION_HEIGHT = 8;
+const i32 NUM_MESH_REGIONS = CHUNK_WIDTH / MESH_REGION_HEIGHT;
+const ui32 ALL_MESH_REGIONS = (1u << NUM_MESH_REGIONS) - 1u;
 const i32 SURFACE_DEPTH = 256;
 const i32 OBJECT_LIST_SIZE = 24096;
 
@@ -1,12 +1,12 @@
 #include "stdafx.h"
 #include "FarTerrainComponentUpdater.h"
 
-#include "FarTerrainPatch.h"
 #include "SpaceSystem.h"
 #include "SpaceSystemAssemblages.h"
 #include "SpaceSystemComponents.h"
 #include "SphericalHeightmapGenerator.h"
 #include "TerrainPatchMeshManager.h"
+#include "TerrainPatchTree.h"
 #include "VoxelCoordinateSpaces.h"
 #include "soaUtils.h"
 
@@ -34,15 +34,15 @@ void FarTerrainComponentUpdater::update(SpaceSystem* spaceSystem, const f64v3& c
         if (cmp.transitionFace != FACE_NONE) {
             cmp.face = cmp.transitionFace;
             cmp.transitionFace = FACE_NONE;
-            if (cmp.patches) {
-                delete[] cmp.patches;
-                cmp.patches = nullptr;
+            if (cmp.patchTree) {
+                delete cmp.patchTree;
+                cmp.patchTree = nullptr;
             }
         }
 
         if (distance <= LOAD_DIST) {
             // In range, allocate if needed
-            if (!cmp.patches) {
+            if (!cmp.patchTree) {
                 initPatches(cmp, cameraPos);
             } else {
                 // Check to see if the grid should shift
@@ -52,15 +52,13 @@ void FarTerrainComponentUpdater::update(SpaceSystem* spaceSystem, const f64v3& c
             }
 
             // Update patches
-            for (int i = 0; i < FT_TOTAL_PATCHES; i++) {
-                cmp.patches[i].update(cameraPos);
-            }      
+            TerrainPatchTree::updateTrees(cmp.patchTree, 1, cameraPos, cmp.threadPool);
             
         } else {
             // Out of range, delete everything
-            if (cmp.patches) {
-                delete[] cmp.patches;
-                cmp.patches = nullptr;
+            if (cmp.patchTree) {
+                delete cmp.patchTree;
+                cmp.patchTree = nullptr;
             }
         }
     }
@@ -70,7 +68,8 @@ void FarTerrainComponentUpdater::initPatches(FarTerrainComponent& cmp, const f64
     const f64& patchWidth = (cmp.sphericalTerrainData->radius * 2.000) / FT_PATCH_ROW;
 
     // Allocate top level patches
-    cmp.patches = new FarTerrainPatch[FT_TOTAL_PATCHES];
+    cmp.patchTree = new TerrainPatchTree;
+    cmp.patchTree->init(cmp.sphericalTerrainData, cmp.face, false, FT_TOTAL_PATCHES);
 
     cmp.center.x = fastFloor(cameraPos.x / patchWidth);
     cmp.center.y = fastFloor(cameraPos.z / patchWidth);
@@ -85,11 +84,9 @@ void FarTerrainComponentUpdater::initPatches(FarTerrainComponent& cmp, const f64
 
     for (int z = 0; z < FT_PATCH_ROW; z++) {
         for (int x = 0; x < FT_PATCH_ROW; x++) {
-            FarTerrainPatch& p = cmp.patches[index++];
             gridPos.x = (x - centerX) * patchWidth;
             gridPos.y = (z - centerZ) * patchWidth;
-            p.init(gridPos, cmp.face,
-                   0, cmp.sphericalTerrainData, patchWidth);
+            cmp.patchTree->initRoot(index++, gridPos, patchWidth);
         }
     }
 }
@@ -111,12 +108,9 @@ void FarTerrainComponentUpdater::checkGridShift(FarTerrainComponent& cmp, const
         i32 gx = cmp.origin.x;
         for (i32 z = 0; z < FT_PATCH_ROW; z++) {
             i32 gz = (cmp.origin.y + z) % FT_PATCH_ROW;
-            FarTerrainPatch& p = cmp.patches[gz * FT_PATCH_ROW + gx];
-            p.destroy();
             gridPos.x = (cmp.center.x + FT_PATCH_ROW / 2 - 1) * patchWidth;
             gridPos.y = (cmp.center.y + z - FT_PATCH_ROW / 2) * patchWidth;
-            p.init(gridPos, cmp.face,
-                   0, cmp.sphericalTerrainData, patchWidth);
+            cmp.patchTree->initRoot(gz * FT_PATCH_ROW + gx, gridPos, patchWidth);
         }
         // Shift origin
         cmp.origin.x++;
@@ -130,12 +124,9 @@ void FarTerrainComponentUpdater::checkGridShift(FarTerrainComponent& cmp, const
         i32 gx = (cmp.origin.x + FT_PATCH_ROW - 1) % FT_PATCH_ROW;
         for (i32 z = 0; z < FT_PATCH_ROW; z++) {
             i32 gz = (cmp.origin.y + z) % FT_PATCH_ROW;
-            FarTerrainPatch& p = cmp.patches[gz * FT_PATCH_ROW + gx];
-            p.destroy();
             gridPos.x = (cmp.center.x - FT_PATCH_ROW / 2) * patchWidth;
             gridPos.y = (cmp.center.y + z - FT_PATCH_ROW / 2) * patchWidth;
-            p.init(gridPos, cmp.face,
-                   0, cmp.sphericalTerrainData, patchWidth);
+            cmp.patchTree->initRoot(gz * FT_PATCH_ROW + gx, gridPos, patchWidth);
         }
         // Shift origin
         cmp.origin.x--;
@@ -152,12 +143,9 @@ void FarTerrainComponentUpdater::checkGridShift(FarTerrainComponent& cmp, const
         i32 gz = cmp.origin.y;
         for (int x = 0; x < FT_PATCH_ROW; x++) {
             int gx = (cmp.origin.x + x) % FT_PATCH_ROW;
-            FarTerrainPatch& p = cmp.patches[gz * FT_PATCH_ROW + gx];
-            p.destroy();
             gridPos.x = (cmp.center.x + x - FT_PATCH_ROW / 2) * patchWidth;
             gridPos.y = (cmp.center.y + FT_PATCH_ROW / 2 - 1) * patchWidth;
-            p.init(gridPos, cmp.face,
-                   0, cmp.sphericalTerrainData, patchWidth);
+            cmp.patchTree->initRoot(gz * FT_PATCH_ROW + gx, gridPos, patchWidth);
         }
         // Shift origin
         cmp.origin.y++;
@@ -170,12 +158,9 @@ void FarTerrainComponentUpdater::checkGridShift(FarTerrainComponent& cmp, const
         i32 gz = (cmp.origin.y + FT_PATCH_ROW - 1) % FT_PATCH_ROW;
         for (i32 x = 0; x < FT_PATCH_ROW; x++) {
             int gx = (cmp.origin.x + x) % FT_PATCH_ROW;
-            FarTerrainPatch& p = cmp.patches[gz * FT_PATCH_ROW + gx];
-            p.destroy();
             gridPos.x = (cmp.center.x + x - FT_PATCH_ROW / 2) * patchWidth;
             gridPos.y = (cmp.center.y - FT_PATCH_ROW / 2) * patchWidth;
-            p.init(gridPos, cmp.face,
-                   0, cmp.sphericalTerrainData, patchWidth);
+            cmp.patchTree->initRoot(gz * FT_PATCH_ROW + gx, gridPos, patchWidth);
         }
         // Shift origin
         cmp.origin.y--;
@@ -12,74 +12,6 @@
 #include "VoxelSpaceConversions.h"
 #include "soaUtils.h"
 
-FarTerrainPatch::~FarTerrainPatch() {
-    destroy();
-}
-
-void FarTerrainPatch::init(const f64v2& gridPosition, WorldCubeFace cubeFace, int lod, const TerrainPatchData* sphericalTerrainData, f64 width) {
-    m_gridPos = gridPosition;
-    m_cubeFace = cubeFace;
-    m_lod = lod;
-    m_terrainPatchData = sphericalTerrainData;
-    m_width = width;
-
-    // Get world position and bounding box
-    m_aabbPos = f32v3(m_gridPos.x, 0, m_gridPos.y);
-    m_aabbDims = f32v3(m_width, 0, m_width);
-}
-
-void FarTerrainPatch::update(const f64v3& cameraPos) {
-    f64v3 closestPoint = calculateClosestPointAndDist(cameraPos);
-
-    if (m_children) {
-        if (m_distance > m_width * DIST_MAX) {
-            if (!m_mesh) {
-                requestMesh(false);
-            }
-            if (hasMesh()) {
-                // Out of range, kill children
-                delete[] m_children;
-                m_children = nullptr;
-            }
-        } else if (m_mesh) {
-            // In range, but we need to remove our mesh.
-            // Check to see if all children are renderable
-            bool deleteMesh = true;
-            for (int i = 0; i < 4; i++) {
-                if (!m_children[i].isRenderable()) {
-                    deleteMesh = false;
-                    break;
-                }
-            }
-
-            if (deleteMesh) {
-                // Children are renderable, free mesh.
-                // Render thread will deallocate.
-                m_mesh->m_shouldDelete = true;
-                m_mesh = nullptr;
-            }
-        }
-    } else if (m_lod < PATCH_MAX_LOD && m_distance < m_width * DIST_MIN && m_width > MIN_SIZE) {
-        m_children = new FarTerrainPatch[4];
-        // Segment into 4 children
-        for (int z = 0; z < 2; z++) {
-            for (int x = 0; x < 2; x++) {
-                m_children[(z << 1) + x].init(m_gridPos + f64v2((m_width / 2.0) * x, (m_width / 2.0) * z),
-                                                m_cubeFace, m_lod + 1, m_terrainPatchData, m_width / 2.0);
-            }
-        }
-    } else if (!m_mesh) {
-        requestMesh(false);
-    }
-
-    // Recursively update children if they exist
-    if (m_children) {
-        for (int i = 0; i < 4; i++) {
-            m_children[i].update(cameraPos);
-        }
-    }
-}
-
 bool FarTerrainPatch::isOverHorizon(const f64v3 &relCamPos, const f64v3 &point, f64 planetRadius) {
     const f64 DELTA = 0.1;
 
@@ -7,7 +7,7 @@
 /// All Rights Reserved
 ///
 /// Summary:
-/// Defines a class for a patch of far-terrain
+/// Horizon checks for patches of far-terrain
 ///
 
 #pragma once
@@ -20,23 +20,6 @@
 // TODO(Ben): Linear fade to prevent LOD popping
 class FarTerrainPatch : public TerrainPatch {
 public:
-    FarTerrainPatch() {};
-    ~FarTerrainPatch();
-
-    /// Initializes the patch
-    /// @param gridPosition: Position on the 2d face grid
-    /// @param sphericalTerrainData: Shared data
-    /// @param width: Width of the patch in KM
-    void init(const f64v2& gridPosition,
-              WorldCubeFace cubeFace,
-              int lod,
-              const TerrainPatchData* sphericalTerrainData,
-              f64 width) override;
-
-    /// Updates the patch
-    /// @param cameraPos: Position of the camera
-    void update(const f64v3& cameraPos) override;
-
     /// Checks if the point is over the horizon
     /// @param relCamPos: Relative observer position
     /// @param point: The point to check
@@ -130,7 +130,8 @@ void GameplayScreen::update(const vui::GameTime& gameTime) {
     // TODO(Ben): Move to glUpdate for voxel component
     // TODO(Ben): Don't hardcode for a single player
     auto& vpCmp = m_soaState->gameSystem->voxelPosition.getFromEntity(m_soaState->clientState.playerEntity);
-    m_soaState->clientState.chunkMeshManager->update(vpCmp.gridPosition.pos, true);
+    auto& frCmp = m_soaState->gameSystem->frustum.getFromEntity(m_soaState->clientState.playerEntity);
+    m_soaState->clientState.chunkMeshManager->update(vpCmp.gridPosition.pos, &frCmp.frustum, true);
 
     // Update the PDA
     if (m_pda.isOpen()) m_pda.update();
@@ -24,32 +24,39 @@
 
 #include "BlockData.h"
 #include "ChunkHandle.h"
+#include "ChunkPrefetcher.h"
 #include "Frustum.h"
 #include "VoxelCoordinateSpaces.h"
 
 class ChunkAccessor;
 class ChunkGrid;
 
-struct BlockCollisionData {
-    BlockCollisionData(BlockID id, ui16 index) : id(id), index(index), neighborCollideFlags(0) {}
-    BlockID id;
-    ui16 index;
-    union {
-        struct {
-            bool left : 1;
-            bool right : 1;
-            bool bottom : 1;
-            bool top : 1;
-            bool back : 1;
-            bool front : 1;
-        };
-        ui8 neighborCollideFlags;
-    };
+/// Dense bitset of the collidable voxels around an AABB. It is only rebuilt
+/// when the box leaves it or a chunk it was read from changes.
+struct VoxelCollisionCache {
+    /// @return true if the voxel is cached and collidable
+    bool isSolid(const i32v3& voxelPos) const {
+        i32v3 p = voxelPos - origin;
+        if (p.x < 0 || p.y < 0 || p.z < 0 ||
+            p.x >= dims.x || p.y >= dims.y || p.z >= dims.z) return false;
+        ui32 i = (ui32)((p.y * dims.z + p.z) * dims.x + p.x);
+        return ((bits[i >> 6] >> (i & 63)) & 1) != 0;
+    }
+
+    i32v3 boxPos = i32v3(0); ///< First voxel the box overlaps this update
+    i32v3 boxDims = i32v3(0); ///< Voxels the box overlaps on each axis, 0 when not in a voxel world
+    i32v3 origin = i32v3(0); ///< Voxel of the first bit
+    i32v3 dims = i32v3(0);
+    vecs::ComponentID parentVoxel = 0;
+    WorldCubeFace face = FACE_NONE;
+    std::vector<ui64> bits; ///< One bit per voxel, x fastest then z then y
+    std::vector<ChunkID> chunkIDs; ///< Chunks the bits were read from
+    std::vector<ui32> chunkVersions; ///< updateVersion of each chunk, 0 if it wasn't generated
 };
 
 struct AabbCollidableComponent {
     vecs::ComponentID physics;
-    std::map<ChunkID, std::vector<BlockCollisionData>> voxelCollisions;
+    VoxelCollisionCache voxelCache;
     // TODO(Ben): Entity-Entity collision
     f32v3 box = f32v3(0.0f); ///< x, y, z widths in blocks
     f32v3 offset = f32v3(0.0f); ///< x, y, z offsets in blocks
@@ -147,6 +154,7 @@ struct ChunkSphereComponent {
     // For fast 1 chunk shift
     std::vector<i32v3> acquireOffsets;
     WorldCubeFace currentCubeFace = FACE_NONE;
+    ChunkPrefetchData prefetch; ///< Chunks requested ahead of the agent
 
     i32 radius = 0;
     i32 width = 0;
@@ -160,6 +168,12 @@ class ChunkSphereComponentTable : public vecs::ComponentTable<ChunkSphereCompone
         delete[] cmp.handleGrid;
         cmp.handleGrid = nullptr;
         cmp.chunkGrid = nullptr;
+        // Same as ChunkPrefetcher::cancel, the prefetched chunks hold a reference each
+        for (auto& it : cmp.prefetch.chunks) {
+            it.second.release();
+        }
+        cmp.prefetch.chunks.clear();
+        cmp.prefetch.queue.clear();
     }
 };
 
@@ -4,6 +4,7 @@
 #include "Chunk.h"
 #include "ChunkGenerator.h"
 #include "ChunkGrid.h"
+#include "ChunkIOManager.h"
 #include "FloraGenerator.h"
 
 void GenerateTask::execute(WorkerData* workerData) {
@@ -17,6 +18,13 @@ void GenerateTask::execute(WorkerData* workerData) {
         switch (query->genLevel) {
             case ChunkGenLevel::GEN_DONE:
             case ChunkGenLevel::GEN_TERRAIN:
+                // Saved chunks have their edits and flora already
+                if (query->grid->chunkIo) {
+                    if (!workerData->regionBuffers) {
+                        workerData->regionBuffers = new RegionIOBuffers;
+                    }
+                    if (query->grid->chunkIo->loadChunk(&chunk, *workerData->regionBuffers)) break;
+                }
                 chunkGenerator->m_proceduralGenerator.generateChunk(&chunk, heightData);
                 chunk.genLevel = GEN_TERRAIN;
                 // TODO(Ben): Not lazy load.
@@ -75,18 +83,27 @@ void GenerateTask::generateFlora(WorkerData* workerData, Chunk& chunk) {
     // Traverse chunks
     for (auto& it : chunkMap) {
         ChunkHandle h = query->grid->accessor.acquire(it.first);
+        // Saves already hold their flora and the player's edits since. isFromSave
+        // is set before genLevel, so it's final once the chunk has terrain.
+        if (h->genLevel >= GEN_TERRAIN && h->isFromSave) {
+            h.release();
+            continue;
+        }
         // TODO(Ben): Handle other case
         if (h->genLevel >= GEN_TERRAIN) {
             {
                 std::lock_guard<std::mutex> l(h->dataMutex);
                 for (auto& node : it.second.wNodes) {
                     h->blocks.set(node.blockIndex, node.blockID);
+                    h->queueLightUpdate(node.blockIndex);
                 }
                 for (auto& node : it.second.fNodes) {
                     if (h->blocks.get(node.blockIndex) == 0) {
                         h->blocks.set(node.blockIndex, node.blockID);
+                        h->queueLightUpdate(node.blockIndex);
                     }
                 }
+                h->updateVersion++;
             }
 
             if (h->genLevel == GEN_DONE) h->DataChange(h);
@@ -0,0 +1,134 @@
+#include "stdafx.h"
+#include "HeightmapCache.h"
+
+namespace {
+    inline i32 floorDiv(i32 a, i32 b) {
+        return (a >= 0) ? a / b : -((-a + b - 1) / b);
+    }
+}
+
+HeightmapCache::HeightmapCache(ui32 width, ui32 span, ui32 padding, size_t budget) :
+    m_budget(budget),
+    m_tileBytes(width * width * sizeof(PlanetHeightData)),
+    m_width(width),
+    m_span(span),
+    m_padding(padding) {
+    // Empty
+}
+
+ui32 HeightmapCache::get(const HeightmapTileKey& key, OUT PlanetHeightData* dst, OUT ui8* found) {
+    const ui32 size = m_width * m_width;
+    std::lock_guard<std::mutex> l(m_lock);
+
+    const Tile* tile = find(key);
+    if (tile) {
+        memcpy(dst, tile->data.data(), size * sizeof(PlanetHeightData));
+        if (found) memset(found, 1, size);
+        return size;
+    }
+    if (key.lod == 0) return 0;
+    return downsample(key, dst, found);
+}
+
+void HeightmapCache::put(const HeightmapTileKey& key, const PlanetHeightData* src) {
+    std::lock_guard<std::mutex> l(m_lock);
+    insert(key, src);
+}
+
+void HeightmapCache::setBudget(size_t budget) {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_budget = budget;
+    evict();
+}
+
+void HeightmapCache::clear() {
+    std::lock_guard<std::mutex> l(m_lock);
+    m_tiles.clear();
+    m_lru.clear();
+    m_numTiles = 0;
+}
+
+const HeightmapCache::Tile* HeightmapCache::find(const HeightmapTileKey& key) {
+    auto it = m_tiles.find(key);
+    if (it == m_tiles.end()) return nullptr;
+    // Move to the front
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return &m_lru.front();
+}
+
+ui32 HeightmapCache::downsample(const HeightmapTileKey& key, OUT PlanetHeightData* dst, OUT ui8* found) {
+    const i32 span = (i32)m_span;
+    const i32 padding = (i32)m_padding;
+    const i32 width = (i32)m_width;
+
+    // Finer samples covered by this tile, relative to the finer lattice
+    i32v2 minSample = (key.tile * span - padding) * 2;
+    i32v2 maxSample = minSample + (width - 1) * 2;
+    i32v2 minTile(floorDiv(minSample.x, span), floorDiv(minSample.y, span));
+    i32v2 maxTile(floorDiv(maxSample.x, span), floorDiv(maxSample.y, span));
+    i32v2 numTiles = maxTile - minTile + 1;
+
+    std::vector<const Tile*> fineTiles(numTiles.x * numTiles.y);
+    bool isComplete = true;
+    for (i32 y = 0; y < numTiles.y; y++) {
+        for (i32 x = 0; x < numTiles.x; x++) {
+            HeightmapTileKey fineKey(key.face, key.lod - 1, minTile + i32v2(x, y));
+            const Tile* t = find(fineKey);
+            fineTiles[y * numTiles.x + x] = t;
+            if (!t) isComplete = false;
+        }
+    }
+    if (!isComplete && !found) return 0;
+
+    // Heights are point samples, so every other finer sample is exact
+    ui32 filled = 0;
+    for (i32 y = 0; y < width; y++) {
+        i32 sy = minSample.y + y * 2;
+        i32 ty = floorDiv(sy, span);
+        i32 ly = sy - ty * span + padding;
+        for (i32 x = 0; x < width; x++) {
+            i32 sx = minSample.x + x * 2;
+            i32 tx = floorDiv(sx, span);
+            i32 lx = sx - tx * span + padding;
+            const Tile* t = fineTiles[(ty - minTile.y) * numTiles.x + (tx - minTile.x)];
+            if (t) {
+                dst[y * width + x] = t->data[ly * width + lx];
+                filled++;
+            }
+            if (found) found[y * width + x] = t ? 1 : 0;
+        }
+    }
+
+    if (isComplete) insert(key, dst);
+    return filled;
+}
+
+void HeightmapCache::insert(const HeightmapTileKey& key, const PlanetHeightData* src) {
+    const ui32 size = m_width * m_width;
+    auto it = m_tiles.find(key);
+    if (it != m_tiles.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+    } else {
+        // Reuse the least recently used tile's storage when we're full
+        if (m_numTiles && (m_numTiles + 1) * m_tileBytes > m_budget) {
+            m_tiles.erase(m_lru.back().key);
+            m_lru.splice(m_lru.begin(), m_lru, std::prev(m_lru.end()));
+        } else {
+            m_lru.emplace_front();
+            m_lru.front().data.resize(size);
+            m_numTiles++;
+        }
+        m_lru.front().key = key;
+        m_tiles[key] = m_lru.begin();
+    }
+    memcpy(m_lru.front().data.data(), src, size * sizeof(PlanetHeightData));
+    evict();
+}
+
+void HeightmapCache::evict() {
+    while (m_numTiles && m_numTiles * m_tileBytes > m_budget) {
+        m_tiles.erase(m_lru.back().key);
+        m_lru.pop_back();
+        m_numTiles--;
+    }
+}
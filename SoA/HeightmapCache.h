@@ -0,0 +1,110 @@
+///
+/// HeightmapCache.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Thread safe LRU cache of generated heightmap tiles, so chunk columns
+/// and terrain patches that come back into view skip the noise. Missing
+/// coarse tiles are downsampled from the next finer LOD when it's cached.
+///
+
+#pragma once
+
+#ifndef HeightmapCache_h__
+#define HeightmapCache_h__
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "Constants.h"
+#include "PlanetHeightData.h"
+#include "VoxelCoordinateSpaces.h"
+
+const size_t DEFAULT_HEIGHTMAP_CACHE_BYTES = 64 * 1024 * 1024;
+
+struct HeightmapTileKey {
+    HeightmapTileKey() {}
+    HeightmapTileKey(WorldCubeFace face, i32 lod, const i32v2& tile) :
+        face(face), lod(lod), tile(tile) {
+        // Empty
+    }
+    bool operator==(const HeightmapTileKey& other) const {
+        return face == other.face && lod == other.lod && tile == other.tile;
+    }
+
+    WorldCubeFace face = FACE_NONE;
+    i32 lod = 0; ///< Each LOD doubles the sample spacing of the one below
+    i32v2 tile = i32v2(0); ///< Tile coordinate on the face at this LOD
+};
+
+class HeightmapCache {
+public:
+    /// The defaults match chunk columns, one sample per voxel at LOD 0
+    /// @param width: Samples per tile row, padding included
+    /// @param span: Samples between the first samples of neighbouring tiles
+    /// @param padding: Samples before the first sample of the tile
+    /// @param budget: Bytes of tiles to keep before evicting
+    HeightmapCache(ui32 width = CHUNK_WIDTH, ui32 span = CHUNK_WIDTH, ui32 padding = 0,
+                   size_t budget = DEFAULT_HEIGHTMAP_CACHE_BYTES);
+
+    /// Key of the heightmap of a chunk column
+    static HeightmapTileKey getChunkKey(const ChunkPosition2D& gridPosition) {
+        return HeightmapTileKey(gridPosition.face, 0, gridPosition.pos);
+    }
+
+    /// Copies a tile into dst. A missing tile is downsampled from the LOD below.
+    /// @param dst: width * width samples
+    /// @param found: Optional, set to 1 for each sample of dst that was filled.
+    /// When null, only a complete tile is copied.
+    /// @return Number of samples filled
+    ui32 get(const HeightmapTileKey& key, OUT PlanetHeightData* dst, OUT ui8* found = nullptr);
+    /// Adds or replaces a complete tile
+    void put(const HeightmapTileKey& key, const PlanetHeightData* src);
+
+    /// Evicts tiles until the cache fits in budget
+    void setBudget(size_t budget);
+    void clear();
+
+    size_t getMemoryUsage() const { return m_numTiles * m_tileBytes; }
+    ui32 getTileWidth() const { return m_width; }
+private:
+    struct Tile {
+        HeightmapTileKey key;
+        std::vector<PlanetHeightData> data;
+    };
+    typedef std::list<Tile> TileList;
+
+    struct KeyHash {
+        size_t operator()(const HeightmapTileKey& k) const {
+            size_t h = std::hash<i32>()(k.tile.x);
+            h = h * 31 + std::hash<i32>()(k.tile.y);
+            h = h * 31 + std::hash<i32>()(k.lod);
+            return h * 31 + (size_t)k.face;
+        }
+    };
+
+    /// Finds a tile and marks it as most recently used. Lock must be held.
+    const Tile* find(const HeightmapTileKey& key);
+    /// Fills dst from the tiles one LOD finer. Lock must be held.
+    ui32 downsample(const HeightmapTileKey& key, OUT PlanetHeightData* dst, OUT ui8* found);
+    /// Lock must be held
+    void insert(const HeightmapTileKey& key, const PlanetHeightData* src);
+    void evict();
+
+    std::mutex m_lock;
+    TileList m_lru; ///< Most recently used first
+    std::unordered_map<HeightmapTileKey, TileList::iterator, KeyHash> m_tiles;
+    size_t m_numTiles = 0;
+    size_t m_budget;
+    size_t m_tileBytes;
+    ui32 m_width;
+    ui32 m_span;
+    ui32 m_padding;
+};
+
+#endif // HeightmapCache_h__
@@ -0,0 +1,167 @@
+#include "stdafx.h"
+#include "LZ4Block.h"
+
+// Format constants from the LZ4 block specification
+#define MIN_MATCH 4
+#define LAST_LITERALS 5 ///< The last 5 bytes are always literals
+#define MF_LIMIT 12 ///< The last match must start at least 12 bytes before the end
+#define MAX_DISTANCE 65535
+#define HASH_LOG 12
+
+namespace {
+    inline ui32 read32(const ui8* p) {
+        ui32 v;
+        memcpy(&v, p, sizeof(ui32));
+        return v;
+    }
+
+    inline ui32 hash32(ui32 v) {
+        return (v * 2654435761u) >> (32 - HASH_LOG);
+    }
+
+    /// Writes the 255 continuation bytes of a length that didn't fit in its token nibble
+    inline ui8* writeLength(ui8* op, ui32 length) {
+        while (length >= 255) {
+            *op++ = 255;
+            length -= 255;
+        }
+        *op++ = (ui8)length;
+        return op;
+    }
+
+    /// Writes a sequence of literals followed by an optional match
+    /// @return The new output position, or nullptr if it doesn't fit
+    ui8* writeSequence(ui8* op, ui8* opEnd, const ui8* literals, ui32 numLiterals, ui32 offset, ui32 matchLength) {
+        // Worst case size of this sequence
+        if ((size_t)(opEnd - op) < 1 + numLiterals / 255 + 1 + numLiterals + 2 + matchLength / 255 + 1) return nullptr;
+
+        ui8* token = op++;
+        *token = 0;
+        if (numLiterals >= 15) {
+            *token = 15 << 4;
+            op = writeLength(op, numLiterals - 15);
+        } else {
+            *token = (ui8)(numLiterals << 4);
+        }
+        memcpy(op, literals, numLiterals);
+        op += numLiterals;
+
+        // The last sequence has no match
+        if (matchLength == 0) return op;
+
+        *op++ = (ui8)(offset & 0xFF);
+        *op++ = (ui8)(offset >> 8);
+        matchLength -= MIN_MATCH;
+        if (matchLength >= 15) {
+            *token |= 15;
+            op = writeLength(op, matchLength - 15);
+        } else {
+            *token |= (ui8)matchLength;
+        }
+        return op;
+    }
+}
+
+ui32 lz4::compressBlock(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity) {
+    ui32 table[1 << HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    ui8* op = dst;
+    ui8* opEnd = dst + dstCapacity;
+    ui32 anchor = 0;
+
+    if (srcSize > MF_LIMIT) {
+        const ui32 matchLimit = srcSize - LAST_LITERALS;
+        const ui32 mfLimit = srcSize - MF_LIMIT;
+
+        ui32 ip = 1;
+        while (ip < mfLimit) {
+            ui32 h = hash32(read32(src + ip));
+            ui32 ref = table[h];
+            table[h] = ip;
+
+            if (ref >= ip || ip - ref > MAX_DISTANCE || read32(src + ref) != read32(src + ip)) {
+                // Skip faster through data that doesn't compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // Extend the match backwards into the pending literals
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            ui32 matchLength = MIN_MATCH;
+            while (ip + matchLength < matchLimit && src[ip + matchLength] == src[ref + matchLength]) {
+                matchLength++;
+            }
+
+            op = writeSequence(op, opEnd, src + anchor, ip - anchor, ip - ref, matchLength);
+            if (!op) return 0;
+
+            ip += matchLength;
+            anchor = ip;
+            // Index the end of the match so runs that continue are found
+            if (ip < mfLimit) table[hash32(read32(src + ip - 2))] = ip - 2;
+        }
+    }
+
+    op = writeSequence(op, opEnd, src + anchor, srcSize - anchor, 0, 0);
+    if (!op) return 0;
+    return (ui32)(op - dst);
+}
+
+bool lz4::decompressBlock(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, ui32& dstSize) {
+    ui32 ip = 0;
+    ui32 op = 0;
+
+    while (ip < srcSize) {
+        ui32 token = src[ip++];
+
+        ui32 numLiterals = token >> 4;
+        if (numLiterals == 15) {
+            ui8 b;
+            do {
+                if (ip >= srcSize) return false;
+                b = src[ip++];
+                numLiterals += b;
+            } while (b == 255);
+        }
+        if (numLiterals > srcSize - ip || numLiterals > dstCapacity - op) return false;
+        memcpy(dst + op, src + ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // The last sequence ends after its literals
+        if (ip == srcSize) break;
+
+        if (srcSize - ip < 2) return false;
+        ui32 offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) return false;
+
+        ui32 matchLength = token & 15;
+        if (matchLength == 15) {
+            ui8 b;
+            do {
+                if (ip >= srcSize) return false;
+                b = src[ip++];
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += MIN_MATCH;
+        if (matchLength > dstCapacity - op) return false;
+
+        // Matches can overlap their own output, which repeats the last offset bytes
+        const ui8* match = dst + op - offset;
+        if (offset >= matchLength) {
+            memcpy(dst + op, match, matchLength);
+        } else {
+            for (ui32 i = 0; i < matchLength; i++) dst[op + i] = match[i];
+        }
+        op += matchLength;
+    }
+
+    dstSize = op;
+    return true;
+}
@@ -0,0 +1,32 @@
+///
+/// LZ4Block.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// A small encoder and decoder for the LZ4 block format.
+/// Output can be read by the reference LZ4_decompress_safe.
+///
+
+#pragma once
+
+#ifndef LZ4Block_h__
+#define LZ4Block_h__
+
+namespace lz4 {
+    /// Worst case compressed size for srcSize bytes
+    inline ui32 compressBound(ui32 srcSize) { return srcSize + srcSize / 255 + 16; }
+
+    /// Compresses src into one LZ4 block. Thread safe.
+    /// @return Compressed size, or 0 if it doesn't fit in dstCapacity
+    ui32 compressBlock(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity);
+    /// Decompresses one LZ4 block. Malformed input is rejected, never read or written out of bounds.
+    /// @param dstSize: Set to the decompressed size
+    /// @return false if the block is malformed or doesn't fit in dstCapacity
+    bool decompressBlock(const ui8* src, ui32 srcSize, ui8* dst, ui32 dstCapacity, ui32& dstSize);
+}
+
+#endif // LZ4Block_h__
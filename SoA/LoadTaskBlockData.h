@@ -1,6 +1,7 @@
 #pragma once
 #include "BlockPack.h"
 #include "BlockLoader.h"
+#include "BlockStartupCache.h"
 #include "BlockTextureLoader.h"
 #include "BlockTexturePack.h"
 #include "Errors.h"
@@ -25,29 +26,50 @@ class LoadTaskBlockData : public ILoadTask {
         // TODO(Ben): Put in state
         vio::IOManager iom;
         iom.setSearchDirectory("Data/Blocks/");
-        // Load in .yml
-        if (!BlockLoader::loadBlocks(iom, blockPack)) {
+
+        // Skip parsing, decoding and stitching when nothing changed since the last run
+        BlockTexturePack* texturePack = loader->getTexturePack();
+        ui64 sourceHash = BlockStartupCache::hashSources(iom, *loader);
+        BlockStartupCache cache;
+        bool isCached = cache.open(BLOCK_STARTUP_CACHE_PATH, sourceHash, texturePack) &&
+                        cache.restoreAtlas(texturePack);
+
+        // Load in .yml, or the cached table
+        bool isLoaded;
+        if (isCached) {
+            isLoaded = BlockLoader::loadBlocks(iom, blockPack, cache.getBlockData(), cache.getBlockDataSize());
+        } else {
+            isLoaded = BlockLoader::loadBlocks(iom, blockPack);
+        }
+        cache.close();
+        if (!isLoaded) {
             pError("Failed to load Data/Blocks/BlockData.yml");
             exit(123456);
         }
         context->addWorkCompleted(40);
 
+        if (!isCached) loader->preloadImages(*blockPack);
         for (size_t i = 0; i < blockPack->size(); i++) {
             Block& b = blockPack->operator[](i);
             if (b.active) {
                 loader->loadBlockTextures(b);
             }
         }
+        loader->clearPreloadedImages();
         // Set the none textures so we dont get a crash later
         Block& b = blockPack->operator[]("none");
         for (int i = 0; i < 6; i++) {
-            b.textures[i] = loader->getTexturePack()->getDefaultTexture();
+            b.textures[i] = texturePack->getDefaultTexture();
         }
-        context->addWorkCompleted(10);
 
-
-        // Uncomment to Save in .yml
-        BlockLoader::saveBlocks("Data/Blocks/SavedBlockData.yml", blockPack);
+        if (!isCached) {
+            if (!BlockStartupCache::save(BLOCK_STARTUP_CACHE_PATH, sourceHash, blockPack, texturePack)) {
+                printf("Failed to save %s\n", BLOCK_STARTUP_CACHE_PATH);
+            }
+            // Readable dump of what was parsed, only when it could have changed
+            BlockLoader::saveBlocks("Data/Blocks/SavedBlockData.yml", blockPack);
+        }
+        context->addWorkCompleted(10);
 
         //{ // For use in pressure explosions
         //    Block visitedNode = Blocks[0];
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "MappedRegionFile.h"
+
+#include <Vorb/utils.h>
+
+#include "Errors.h"
+
+// Smallest growth step when remapping, in sectors
+#define MIN_GROW_SECTORS 64
+// Stride when touching a chunk's sectors, the smallest page size we run on
+#define PREFETCH_PAGE_SIZE 4096
+
+MappedRegionFile::MappedRegionFile() {
+    InitializeSRWLock(&m_lock);
+}
+
+MappedRegionFile::~MappedRegionFile() {
+    close();
+}
+
+bool MappedRegionFile::open(const nString& filePath, bool create) {
+    m_filePath = filePath;
+
+    m_file = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        if (create) pError("Failed to create region file " + filePath);
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize)) {
+        pError("Stat call failed for region file open");
+        close();
+        return false;
+    }
+
+    if (fileSize.QuadPart == 0) {
+        // New file. Mapping it zero fills the header, which is an empty lookup table.
+        m_totalSectors = 0;
+        m_isDirty = true;
+    } else {
+        if (fileSize.QuadPart < sizeof(RegionFileHeader) || (fileSize.QuadPart - sizeof(RegionFileHeader)) % SECTOR_SIZE) {
+            pError(filePath + ": Region file chunk storage must be multiple of " + std::to_string(SECTOR_SIZE));
+            close();
+            return false;
+        }
+        m_totalSectors = (ui32)((fileSize.QuadPart - sizeof(RegionFileHeader)) / SECTOR_SIZE);
+    }
+
+    if (!remap(m_totalSectors)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedRegionFile::close() {
+    bool wasMapped = (m_view != nullptr);
+    if (m_view) {
+        FlushViewOfFile(m_view, 0);
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        // Drop the spare capacity so the file size matches the used sectors again
+        if (wasMapped) {
+            LARGE_INTEGER size;
+            size.QuadPart = sizeof(RegionFileHeader) + (i64)m_totalSectors * SECTOR_SIZE;
+            if (!SetFilePointerEx(m_file, size, nullptr, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+                pError("Region file: Truncate error! " + m_filePath);
+            }
+        }
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_totalSectors = 0;
+    m_capacity = 0;
+    m_isDirty = false;
+}
+
+ui32 MappedRegionFile::readChunk(ui32 tableOffset, ui8* dst, ui32 maxSize) {
+    ui32 size = 0;
+
+    AcquireSRWLockShared(&m_lock);
+    if (m_view) {
+        // Location is not stored zero indexed, so that 0 indicates that it hasn't been saved
+        ui32 chunkSector = BufferUtils::extractInt(getHeader()->lookupTable, tableOffset);
+        if (chunkSector > m_totalSectors) {
+            pError("Region: Lookup table corrupted in " + m_filePath);
+        } else if (chunkSector != 0) {
+            chunkSector--;
+            ChunkHeader* header = (ChunkHeader*)getSector(chunkSector);
+            ui32 chunkSize = BufferUtils::extractInt(header->dataLength) + sizeof(ChunkHeader);
+            if (chunkSize > maxSize || chunkSector + sectorsFromBytes(chunkSize) > m_totalSectors) {
+                pError("Region: Chunk header corrupted in " + m_filePath);
+            } else {
+                memcpy(dst, header, chunkSize);
+                size = chunkSize;
+            }
+        }
+    }
+    ReleaseSRWLockShared(&m_lock);
+
+    return size;
+}
+
+bool MappedRegionFile::writeChunk(ui32 tableOffset, const ui8* src, ui32 size) {
+    AcquireSRWLockExclusive(&m_lock);
+    if (!m_view) {
+        ReleaseSRWLockExclusive(&m_lock);
+        return false;
+    }
+
+    ui8* lookupTable = getHeader()->lookupTable;
+    ui32 chunkSector = BufferUtils::extractInt(lookupTable, tableOffset);
+    bool isNew = (chunkSector == 0);
+    ui32 numOldSectors = 0;
+
+    if (isNew) {
+        // New chunks go at the end of the file
+        chunkSector = m_totalSectors;
+    } else {
+        chunkSector--;
+        ChunkHeader* oldHeader = (ChunkHeader*)getSector(chunkSector);
+        numOldSectors = sectorsFromBytes(BufferUtils::extractInt(oldHeader->dataLength) + sizeof(ChunkHeader));
+        if (chunkSector + numOldSectors > m_totalSectors) {
+            pError("Region: Chunk header corrupted in " + m_filePath);
+            ReleaseSRWLockExclusive(&m_lock);
+            return false;
+        }
+    }
+
+    ui32 numSectors = sectorsFromBytes(size);
+    i32 sectorDiff = (i32)numSectors - (i32)numOldSectors;
+    ui32 newTotalSectors = m_totalSectors + sectorDiff;
+
+    if (newTotalSectors > m_capacity) {
+        // Grow geometrically so that appending chunks doesn't remap on every save
+        ui32 capacity = m_capacity + m_capacity / 2 + MIN_GROW_SECTORS;
+        if (capacity < newTotalSectors) capacity = newTotalSectors;
+        if (!remap(capacity)) {
+            ReleaseSRWLockExclusive(&m_lock);
+            return false;
+        }
+        lookupTable = getHeader()->lookupTable;
+    }
+
+    // If the chunk changed size and isn't at the end of the file, the sectors after it
+    // have to move. This operation should be fairly rare.
+    ui32 tailSector = chunkSector + numOldSectors;
+    if (sectorDiff != 0 && tailSector < m_totalSectors) {
+        memmove(getSector(chunkSector + numSectors), getSector(tailSector), (size_t)(m_totalSectors - tailSector) * SECTOR_SIZE);
+        for (ui32 i = 0; i < REGION_SIZE * 4; i += 4) {
+            ui32 nextChunkSector = BufferUtils::extractInt(lookupTable, i);
+            // See if the 1 indexed nextChunkSector is > the 0 indexed chunkSector
+            if (nextChunkSector > chunkSector + 1) {
+                BufferUtils::setInt(lookupTable, i, nextChunkSector + sectorDiff);
+            }
+        }
+    }
+
+    ui8* dst = getSector(chunkSector);
+    memcpy(dst, src, size);
+    // Zero the padding so old data never follows the chunk
+    memset(dst + size, 0, (size_t)numSectors * SECTOR_SIZE - size);
+
+    // We add 1 so that 0 can indicate not saved
+    if (isNew) BufferUtils::setInt(lookupTable, tableOffset, chunkSector + 1);
+
+    m_totalSectors = newTotalSectors;
+    m_isDirty = true;
+
+    ReleaseSRWLockExclusive(&m_lock);
+    return true;
+}
+
+bool MappedRegionFile::prefetchChunk(ui32 tableOffset) {
+    bool rv = false;
+    AcquireSRWLockShared(&m_lock);
+    if (m_view) {
+        ui32 chunkSector = BufferUtils::extractInt(getHeader()->lookupTable, tableOffset);
+        if (chunkSector != 0 && chunkSector <= m_totalSectors) {
+            chunkSector--;
+            ChunkHeader* header = (ChunkHeader*)getSector(chunkSector);
+            ui32 chunkSize = BufferUtils::extractInt(header->dataLength) + sizeof(ChunkHeader);
+            ui32 numSectors = std::min(sectorsFromBytes(chunkSize), m_totalSectors - chunkSector);
+            // One read per page is enough to fault it in
+            volatile ui8 sum = 0;
+            const ui8* data = getSector(chunkSector);
+            for (ui32 i = 0; i < numSectors * SECTOR_SIZE; i += PREFETCH_PAGE_SIZE) {
+                sum += data[i];
+            }
+            rv = true;
+        }
+    }
+    ReleaseSRWLockShared(&m_lock);
+    return rv;
+}
+
+void MappedRegionFile::flush() {
+    AcquireSRWLockExclusive(&m_lock);
+    if (m_view && m_isDirty) {
+        FlushViewOfFile(m_view, 0);
+        // FlushViewOfFile doesn't wait for the disk, and the save journal relies on it
+        FlushFileBuffers(m_file);
+        m_isDirty = false;
+    }
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+bool MappedRegionFile::remap(ui32 capacity) {
+    if (m_view) {
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    // Mapping past the end of the file extends it with zeros
+    ui64 mapSize = sizeof(RegionFileHeader) + (ui64)capacity * SECTOR_SIZE;
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, (DWORD)(mapSize >> 32), (DWORD)mapSize, nullptr);
+    if (!m_mapping) {
+        pError("Region: Failed to map " + m_filePath + " error " + std::to_string(GetLastError()));
+        return false;
+    }
+    m_view = (ui8*)MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)mapSize);
+    if (!m_view) {
+        pError("Region: Failed to map view of " + m_filePath + " error " + std::to_string(GetLastError()));
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+
+    m_capacity = capacity;
+    return true;
+}
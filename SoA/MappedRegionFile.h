@@ -0,0 +1,71 @@
+///
+/// MappedRegionFile.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// A region file mapped into memory. Many threads can read chunks
+/// at once, writes are exclusive and grow the file by remapping.
+///
+
+#pragma once
+
+#ifndef MappedRegionFile_h__
+#define MappedRegionFile_h__
+
+#include <Windows.h>
+
+#include "RegionFileManager.h"
+
+class MappedRegionFile {
+public:
+    MappedRegionFile();
+    ~MappedRegionFile();
+
+    /// Opens and maps a region file
+    /// @param create: Create an empty region if the file doesn't exist
+    /// @return false if the file couldn't be opened or is corrupt
+    bool open(const nString& filePath, bool create);
+    /// Trims the file to its used sectors and unmaps it
+    void close();
+
+    /// Copies the saved chunk at tableOffset, ChunkHeader included, into dst.
+    /// Safe to call from many threads at once.
+    /// @param tableOffset: Byte offset of the chunk in RegionFileHeader::lookupTable
+    /// @return Number of bytes copied, or 0 if the chunk isn't saved or doesn't fit
+    ui32 readChunk(ui32 tableOffset, ui8* dst, ui32 maxSize);
+    /// Writes a chunk that starts with its ChunkHeader. Moves the following sectors
+    /// if the chunk changed size.
+    bool writeChunk(ui32 tableOffset, const ui8* src, ui32 size);
+
+    /// Touches the sectors of the chunk at tableOffset so the OS pages them in
+    /// @return false if the chunk isn't saved
+    bool prefetchChunk(ui32 tableOffset);
+
+    /// Flushes written sectors to disk and waits for them to land
+    void flush();
+
+    bool isOpen() const { return m_view != nullptr; }
+    const nString& getFilePath() const { return m_filePath; }
+
+    int refCount = 0; ///< Users of the file, guarded by the RegionFileManager cache lock
+private:
+    /// Maps the header and capacity sectors. Call with m_lock held exclusively.
+    bool remap(ui32 capacity);
+    ui8* getSector(ui32 sector) { return m_view + sizeof(RegionFileHeader) + (size_t)sector * SECTOR_SIZE; }
+    RegionFileHeader* getHeader() { return (RegionFileHeader*)m_view; }
+
+    nString m_filePath;
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+    ui8* m_view = nullptr;
+    ui32 m_totalSectors = 0; ///< Sectors in use
+    ui32 m_capacity = 0; ///< Sectors mapped, the file is this big while open
+    bool m_isDirty = false;
+    SRWLOCK m_lock; ///< Shared for reads, exclusive for writes and remaps
+};
+
+#endif // MappedRegionFile_h__
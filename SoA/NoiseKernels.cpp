@@ -0,0 +1,332 @@
+#include "stdafx.h"
+#include "NoiseKernels.h"
+
+#include "Noise.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define NOISE_KERNELS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NOISE_KERNELS_SSE2
+#endif
+
+#if defined(NOISE_KERNELS_AVX) || defined(NOISE_KERNELS_SSE2)
+#define NOISE_KERNELS_SIMD
+#endif
+
+// Same as the constants in Noise::cellular
+#define CELL_K 0.142857142857 // 1/7
+#define CELL_KO 0.428571428571 // 1/2-K/2
+#define CELL_KZ 0.166666666667 // 1/6
+#define CELL_KZO 0.416666666667 // 1/2-1/6*2
+
+namespace {
+#if defined(NOISE_KERNELS_AVX)
+    struct F64Lanes {
+        typedef f64 Scalar;
+        typedef __m256d V;
+        enum { WIDTH = 4 };
+        static V set1(f64 v) { return _mm256_set1_pd(v); }
+        static V load(const f64* p) { return _mm256_loadu_pd(p); }
+        static void store(f64* p, V v) { _mm256_storeu_pd(p, v); }
+        static V add(V a, V b) { return _mm256_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm256_div_pd(a, b); }
+        static V min(V a, V b) { return _mm256_min_pd(a, b); }
+        static V max(V a, V b) { return _mm256_max_pd(a, b); }
+        static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+        static V floor(V a) { return _mm256_floor_pd(a); }
+        static V cmpge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+        static V and_(V a, V b) { return _mm256_and_pd(a, b); }
+        static V or_(V a, V b) { return _mm256_or_pd(a, b); }
+        /// ~a & b
+        static V andnot(V a, V b) { return _mm256_andnot_pd(a, b); }
+    };
+    struct F32Lanes {
+        typedef f32 Scalar;
+        typedef __m256 V;
+        enum { WIDTH = 8 };
+        static V set1(f32 v) { return _mm256_set1_ps(v); }
+        static V load(const f32* p) { return _mm256_loadu_ps(p); }
+        static void store(f32* p, V v) { _mm256_storeu_ps(p, v); }
+        static V add(V a, V b) { return _mm256_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm256_div_ps(a, b); }
+        static V min(V a, V b) { return _mm256_min_ps(a, b); }
+        static V max(V a, V b) { return _mm256_max_ps(a, b); }
+        static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+        static V floor(V a) { return _mm256_floor_ps(a); }
+        static V cmpge(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static V and_(V a, V b) { return _mm256_and_ps(a, b); }
+        static V or_(V a, V b) { return _mm256_or_ps(a, b); }
+        static V andnot(V a, V b) { return _mm256_andnot_ps(a, b); }
+    };
+#elif defined(NOISE_KERNELS_SSE2)
+    struct F64Lanes {
+        typedef f64 Scalar;
+        typedef __m128d V;
+        enum { WIDTH = 2 };
+        static V set1(f64 v) { return _mm_set1_pd(v); }
+        static V load(const f64* p) { return _mm_loadu_pd(p); }
+        static void store(f64* p, V v) { _mm_storeu_pd(p, v); }
+        static V add(V a, V b) { return _mm_add_pd(a, b); }
+        static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+        static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+        static V div(V a, V b) { return _mm_div_pd(a, b); }
+        static V min(V a, V b) { return _mm_min_pd(a, b); }
+        static V max(V a, V b) { return _mm_max_pd(a, b); }
+        static V sqrt(V a) { return _mm_sqrt_pd(a); }
+        // No SSE2 floor, so truncate and step down where that rounded up
+        static V floor(V a) {
+            V t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+            return _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, a), _mm_set1_pd(1.0)));
+        }
+        static V cmpge(V a, V b) { return _mm_cmpge_pd(a, b); }
+        static V and_(V a, V b) { return _mm_and_pd(a, b); }
+        static V or_(V a, V b) { return _mm_or_pd(a, b); }
+        static V andnot(V a, V b) { return _mm_andnot_pd(a, b); }
+    };
+    struct F32Lanes {
+        typedef f32 Scalar;
+        typedef __m128 V;
+        enum { WIDTH = 4 };
+        static V set1(f32 v) { return _mm_set1_ps(v); }
+        static V load(const f32* p) { return _mm_loadu_ps(p); }
+        static void store(f32* p, V v) { _mm_storeu_ps(p, v); }
+        static V add(V a, V b) { return _mm_add_ps(a, b); }
+        static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+        static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+        static V div(V a, V b) { return _mm_div_ps(a, b); }
+        static V min(V a, V b) { return _mm_min_ps(a, b); }
+        static V max(V a, V b) { return _mm_max_ps(a, b); }
+        static V sqrt(V a) { return _mm_sqrt_ps(a); }
+        static V floor(V a) {
+            V t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+        }
+        static V cmpge(V a, V b) { return _mm_cmpge_ps(a, b); }
+        static V and_(V a, V b) { return _mm_and_ps(a, b); }
+        static V or_(V a, V b) { return _mm_or_ps(a, b); }
+        static V andnot(V a, V b) { return _mm_andnot_ps(a, b); }
+    };
+#endif
+
+#ifdef NOISE_KERNELS_SIMD
+    /// Contribution of one simplex corner, see Noise::raw
+    template <typename L>
+    inline typename L::V simplexCorner(typename L::V x, typename L::V y, typename L::V z,
+                                       typename L::V gx, typename L::V gy, typename L::V gz) {
+        typedef typename L::V V;
+        V t = L::sub(L::sub(L::sub(L::set1((typename L::Scalar)0.6), L::mul(x, x)), L::mul(y, y)), L::mul(z, z));
+        // Negative t contributes nothing
+        t = L::max(t, L::set1(0));
+        t = L::mul(t, t);
+        V dot = L::add(L::add(L::mul(gx, x), L::mul(gy, y)), L::mul(gz, z));
+        return L::mul(L::mul(t, t), dot);
+    }
+
+    /// Vectorized Noise::raw(x, y, z). Points that don't fill a vector use the scalar version.
+    template <typename L>
+    void rawKernel(const typename L::Scalar* x, const typename L::Scalar* y, const typename L::Scalar* z,
+                   size_t n, typename L::Scalar frequency, typename L::Scalar* out) {
+        typedef typename L::V V;
+        typedef typename L::Scalar S;
+        const f64 G3 = 1.0 / 6.0;
+        const V F3V = L::set1((S)(1.0 / 3.0));
+        const V G3V = L::set1((S)G3);
+        const V G3x2 = L::set1((S)(2.0 * G3));
+        const V G3x3 = L::set1((S)(3.0 * G3));
+        const V ONE = L::set1(1);
+        const V FREQ = L::set1(frequency);
+
+        S fi[L::WIDTH], fj[L::WIDTH], fk[L::WIDTH];
+        S vi1[L::WIDTH], vj1[L::WIDTH], vk1[L::WIDTH], vi2[L::WIDTH], vj2[L::WIDTH], vk2[L::WIDTH];
+        // Gradients of the four corners
+        S g[4][3][L::WIDTH];
+
+        size_t p = 0;
+        for (; p + L::WIDTH <= n; p += L::WIDTH) {
+            V px = L::mul(L::load(x + p), FREQ);
+            V py = L::mul(L::load(y + p), FREQ);
+            V pz = L::mul(L::load(z + p), FREQ);
+
+            // Skew to find the simplex cell
+            V s = L::mul(L::add(L::add(px, py), pz), F3V);
+            V i = L::floor(L::add(px, s));
+            V j = L::floor(L::add(py, s));
+            V k = L::floor(L::add(pz, s));
+            V t = L::mul(L::add(L::add(i, j), k), G3V);
+            V x0 = L::sub(px, L::sub(i, t));
+            V y0 = L::sub(py, L::sub(j, t));
+            V z0 = L::sub(pz, L::sub(k, t));
+
+            // Branch free version of the simplex order table
+            V a = L::cmpge(x0, y0);
+            V b = L::cmpge(y0, z0);
+            V c = L::cmpge(x0, z0);
+            V i1 = L::and_(L::and_(a, c), ONE);
+            V j1 = L::and_(L::andnot(a, b), ONE);
+            V k1 = L::andnot(L::or_(b, L::and_(a, c)), ONE);
+            V i2 = L::and_(L::or_(a, L::and_(b, c)), ONE);
+            V j2 = L::andnot(L::andnot(b, a), ONE);
+            V k2 = L::andnot(L::and_(b, L::or_(a, c)), ONE);
+
+            // Hash the corners one lane at a time, there is no gather
+            L::store(fi, i); L::store(fj, j); L::store(fk, k);
+            L::store(vi1, i1); L::store(vj1, j1); L::store(vk1, k1);
+            L::store(vi2, i2); L::store(vj2, j2); L::store(vk2, k2);
+            for (int l = 0; l < L::WIDTH; l++) {
+                int ii = (int)fi[l] & 255;
+                int jj = (int)fj[l] & 255;
+                int kk = (int)fk[l] & 255;
+                int oi1 = (int)vi1[l], oj1 = (int)vj1[l], ok1 = (int)vk1[l];
+                int oi2 = (int)vi2[l], oj2 = (int)vj2[l], ok2 = (int)vk2[l];
+                int gi[4];
+                gi[0] = Noise::perm[ii + Noise::perm[jj + Noise::perm[kk]]] % 12;
+                gi[1] = Noise::perm[ii + oi1 + Noise::perm[jj + oj1 + Noise::perm[kk + ok1]]] % 12;
+                gi[2] = Noise::perm[ii + oi2 + Noise::perm[jj + oj2 + Noise::perm[kk + ok2]]] % 12;
+                gi[3] = Noise::perm[ii + 1 + Noise::perm[jj + 1 + Noise::perm[kk + 1]]] % 12;
+                for (int corner = 0; corner < 4; corner++) {
+                    g[corner][0][l] = (S)Noise::grad3[gi[corner]][0];
+                    g[corner][1][l] = (S)Noise::grad3[gi[corner]][1];
+                    g[corner][2][l] = (S)Noise::grad3[gi[corner]][2];
+                }
+            }
+
+            V n0 = simplexCorner<L>(x0, y0, z0, L::load(g[0][0]), L::load(g[0][1]), L::load(g[0][2]));
+            V n1 = simplexCorner<L>(L::add(L::sub(x0, i1), G3V), L::add(L::sub(y0, j1), G3V), L::add(L::sub(z0, k1), G3V),
+                                    L::load(g[1][0]), L::load(g[1][1]), L::load(g[1][2]));
+            V n2 = simplexCorner<L>(L::add(L::sub(x0, i2), G3x2), L::add(L::sub(y0, j2), G3x2), L::add(L::sub(z0, k2), G3x2),
+                                    L::load(g[2][0]), L::load(g[2][1]), L::load(g[2][2]));
+            V n3 = simplexCorner<L>(L::add(L::sub(x0, ONE), G3x3), L::add(L::sub(y0, ONE), G3x3), L::add(L::sub(z0, ONE), G3x3),
+                                    L::load(g[3][0]), L::load(g[3][1]), L::load(g[3][2]));
+            L::store(out + p, L::mul(L::set1(32), L::add(L::add(L::add(n0, n1), n2), n3)));
+        }
+        for (; p < n; p++) {
+            out[p] = (S)Noise::raw((f64)x[p] * frequency, (f64)y[p] * frequency, (f64)z[p] * frequency);
+        }
+    }
+
+    /// (34x^2 + x) mod 289, see permute in Noise.cpp
+    template <typename L>
+    inline typename L::V cellPermute(typename L::V x) {
+        typedef typename L::V V;
+        const V M = L::set1(289);
+        V v = L::mul(L::add(L::mul(L::set1(34), x), L::set1(1)), x);
+        return L::sub(v, L::mul(M, L::floor(L::div(v, M))));
+    }
+
+    /// Vectorized Noise::cellular, returns F2 - F1. Tracks the two smallest
+    /// distances with a running min instead of the sorting network.
+    template <typename L>
+    void cellularKernel(const typename L::Scalar* x, const typename L::Scalar* y, const typename L::Scalar* z,
+                        size_t n, typename L::Scalar frequency, typename L::Scalar* out) {
+        typedef typename L::V V;
+        typedef typename L::Scalar S;
+        const V M = L::set1(289);
+        const V HALF = L::set1((S)0.5);
+        const V K = L::set1((S)CELL_K);
+        const V KO = L::set1((S)CELL_KO);
+        const V KZ = L::set1((S)CELL_KZ);
+        const V KZO = L::set1((S)CELL_KZO);
+        const V SEVEN = L::set1(7);
+        const V FORTY_NINE = L::set1(49);
+        const V ZERO = L::set1(0);
+        const V FREQ = L::set1(frequency);
+        // Cell offsets pair with the opposite offsets of the fractional position
+        const S CELL_OFFSET[3] = { -1, 0, 1 };
+        const S FRAC_OFFSET[3] = { 1, 0, -1 };
+
+        size_t p = 0;
+        for (; p + L::WIDTH <= n; p += L::WIDTH) {
+            V P[3];
+            P[0] = L::mul(L::load(x + p), FREQ);
+            P[1] = L::mul(L::load(y + p), FREQ);
+            P[2] = L::mul(L::load(z + p), FREQ);
+            V Pi[3], Pf[3];
+            for (int c = 0; c < 3; c++) {
+                V f = L::floor(P[c]);
+                Pi[c] = L::sub(f, L::mul(M, L::floor(L::div(f, M))));
+                Pf[c] = L::sub(L::sub(P[c], f), HALF);
+            }
+
+            V f1 = L::set1(1e30f);
+            V f2 = f1;
+            for (int dx = 0; dx < 3; dx++) {
+                V px = cellPermute<L>(L::add(Pi[0], L::set1(CELL_OFFSET[dx])));
+                V fx = L::add(Pf[0], L::set1(FRAC_OFFSET[dx]));
+                for (int dy = 0; dy < 3; dy++) {
+                    V py = cellPermute<L>(L::add(L::add(px, Pi[1]), L::set1(CELL_OFFSET[dy])));
+                    V fy = L::add(Pf[1], L::set1(FRAC_OFFSET[dy]));
+                    for (int dz = 0; dz < 3; dz++) {
+                        V pp = cellPermute<L>(L::add(L::add(py, Pi[2]), L::set1(CELL_OFFSET[dz])));
+                        V fz = L::add(Pf[2], L::set1(FRAC_OFFSET[dz]));
+
+                        // Jittered feature point of the cell. pp is a whole number and K and K2
+                        // are a hair under 1/7 and 1/49, so floor(pp * K) is floor((pp - 0.5) / 7)
+                        // for pp > 0. Dividing keeps that exact in f32 too.
+                        V ppm = L::max(L::sub(pp, HALF), ZERO);
+                        V q = L::floor(L::div(ppm, SEVEN));
+                        V ox = L::sub(L::sub(L::mul(pp, K), q), KO);
+                        V oy = L::sub(L::mul(L::sub(q, L::mul(SEVEN, L::floor(L::div(q, SEVEN)))), K), KO);
+                        V oz = L::sub(L::mul(L::floor(L::div(ppm, FORTY_NINE)), KZ), KZO);
+
+                        V ddx = L::add(fx, ox);
+                        V ddy = L::add(fy, oy);
+                        V ddz = L::add(fz, oz);
+                        V d = L::add(L::add(L::mul(ddx, ddx), L::mul(ddy, ddy)), L::mul(ddz, ddz));
+                        f2 = L::min(f2, L::max(f1, d));
+                        f1 = L::min(f1, d);
+                    }
+                }
+            }
+            L::store(out + p, L::sub(L::sqrt(f2), L::sqrt(f1)));
+        }
+        for (; p < n; p++) {
+            f64v2 ff = Noise::cellular(f64v3(x[p], y[p], z[p]) * (f64)frequency);
+            out[p] = (S)(ff.y - ff.x);
+        }
+    }
+#endif
+}
+
+void Noise::rawBatch(const f64* x, const f64* y, const f64* z, size_t n, f64 frequency, OUT f64* out) {
+#ifdef NOISE_KERNELS_SIMD
+    rawKernel<F64Lanes>(x, y, z, n, frequency, out);
+#else
+    for (size_t i = 0; i < n; i++) out[i] = raw(x[i] * frequency, y[i] * frequency, z[i] * frequency);
+#endif
+}
+
+void Noise::rawBatch(const f32* x, const f32* y, const f32* z, size_t n, f32 frequency, OUT f32* out) {
+#ifdef NOISE_KERNELS_SIMD
+    rawKernel<F32Lanes>(x, y, z, n, frequency, out);
+#else
+    for (size_t i = 0; i < n; i++) out[i] = (f32)raw((f64)x[i] * frequency, (f64)y[i] * frequency, (f64)z[i] * frequency);
+#endif
+}
+
+void Noise::cellularBatch(const f64* x, const f64* y, const f64* z, size_t n, f64 frequency, OUT f64* out) {
+#ifdef NOISE_KERNELS_SIMD
+    cellularKernel<F64Lanes>(x, y, z, n, frequency, out);
+#else
+    for (size_t i = 0; i < n; i++) {
+        f64v2 ff = cellular(f64v3(x[i], y[i], z[i]) * frequency);
+        out[i] = ff.y - ff.x;
+    }
+#endif
+}
+
+void Noise::cellularBatch(const f32* x, const f32* y, const f32* z, size_t n, f32 frequency, OUT f32* out) {
+#ifdef NOISE_KERNELS_SIMD
+    cellularKernel<F32Lanes>(x, y, z, n, frequency, out);
+#else
+    for (size_t i = 0; i < n; i++) {
+        f64v2 ff = cellular(f64v3(x[i], y[i], z[i]) * (f64)frequency);
+        out[i] = (f32)(ff.y - ff.x);
+    }
+#endif
+}
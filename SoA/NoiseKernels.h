@@ -0,0 +1,30 @@
+///
+/// NoiseKernels.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Array versions of Noise::raw and Noise::cellular for 3D points.
+/// Uses AVX or SSE2 when the build targets them. The f32 versions
+/// trade precision for twice the lanes.
+///
+
+#pragma once
+
+#ifndef NoiseKernels_h__
+#define NoiseKernels_h__
+
+namespace Noise {
+    /// out[i] = raw(x[i] * frequency, y[i] * frequency, z[i] * frequency)
+    void rawBatch(const f64* x, const f64* y, const f64* z, size_t n, f64 frequency, OUT f64* out);
+    void rawBatch(const f32* x, const f32* y, const f32* z, size_t n, f32 frequency, OUT f32* out);
+
+    /// out[i] = F2 - F1 of cellular() at the point scaled by frequency
+    void cellularBatch(const f64* x, const f64* y, const f64* z, size_t n, f64 frequency, OUT f64* out);
+    void cellularBatch(const f32* x, const f32* y, const f32* z, size_t n, f32 frequency, OUT f32* out);
+}
+
+#endif // NoiseKernels_h__
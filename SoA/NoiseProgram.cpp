@@ -0,0 +1,268 @@
+#include "stdafx.h"
+#include "NoiseProgram.h"
+
+#include <algorithm>
+
+#include "NoiseKernels.h"
+
+namespace {
+    inline f64 doOperation(TerrainOp op, f64 a, f64 b) {
+        switch (op) {
+            case TerrainOp::ADD: return a + b;
+            case TerrainOp::SUB: return a - b;
+            case TerrainOp::MUL: return a * b;
+            case TerrainOp::DIV: return a / b;
+        }
+        return 0.0;
+    }
+
+    inline bool isCellular(TerrainStage func) {
+        return func == TerrainStage::CELLULAR_NOISE ||
+               func == TerrainStage::CELLULAR_SQUARED_NOISE ||
+               func == TerrainStage::CELLULAR_CUBED_NOISE;
+    }
+
+    /// Adds one octave of raw noise values to total, shaped by the stage
+    template <typename T>
+    void accumulateOctave(TerrainStage func, const T* noise, size_t n, f64 amplitude, f64* total) {
+        switch (func) {
+            case TerrainStage::CUBED_NOISE:
+            case TerrainStage::SQUARED_NOISE:
+            case TerrainStage::NOISE:
+            case TerrainStage::CELLULAR_NOISE:
+                for (size_t i = 0; i < n; i++) total[i] += (f64)noise[i] * amplitude;
+                break;
+            case TerrainStage::RIDGED_NOISE:
+                for (size_t i = 0; i < n; i++) total[i] += ((1.0 - vmath::abs((f64)noise[i])) * 2.0 - 1.0) * amplitude;
+                break;
+            case TerrainStage::ABS_NOISE:
+                for (size_t i = 0; i < n; i++) total[i] += vmath::abs((f64)noise[i]) * amplitude;
+                break;
+            case TerrainStage::CELLULAR_SQUARED_NOISE:
+                for (size_t i = 0; i < n; i++) {
+                    f64 tmp = (f64)noise[i];
+                    total[i] += tmp * tmp * amplitude;
+                }
+                break;
+            case TerrainStage::CELLULAR_CUBED_NOISE:
+                for (size_t i = 0; i < n; i++) {
+                    f64 tmp = (f64)noise[i];
+                    total[i] += tmp * tmp * tmp * amplitude;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void NoiseBatch::set(const f64v3* positions, size_t n, bool useF32) {
+    size = n;
+    isF32 = useF32;
+    if (useF32) {
+        fx.resize(n); fy.resize(n); fz.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            fx[i] = (f32)positions[i].x;
+            fy[i] = (f32)positions[i].y;
+            fz[i] = (f32)positions[i].z;
+        }
+    } else {
+        x.resize(n); y.resize(n); z.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = positions[i].x;
+            y[i] = positions[i].y;
+            z[i] = positions[i].z;
+        }
+    }
+}
+
+void NoiseBatch::gather(const NoiseBatch& src, const ui32* indices, size_t n) {
+    size = n;
+    isF32 = src.isF32;
+    if (isF32) {
+        fx.resize(n); fy.resize(n); fz.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            fx[i] = src.fx[indices[i]];
+            fy[i] = src.fy[indices[i]];
+            fz[i] = src.fz[indices[i]];
+        }
+    } else {
+        x.resize(n); y.resize(n); z.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = src.x[indices[i]];
+            y[i] = src.y[indices[i]];
+            z[i] = src.z[indices[i]];
+        }
+    }
+}
+
+void NoiseProgram::compile(const Array<TerrainFuncProperties>& funcs) {
+    m_ops.clear();
+    m_numMasks = 0;
+    compileFuncs(funcs, -1, TerrainOp::ADD, -1);
+}
+
+void NoiseProgram::compileFuncs(const Array<TerrainFuncProperties>& funcs, i32 modifier, TerrainOp op, i32 mask) {
+    // NOTE: Make sure this matches SphericalHeightmapGenerator::getNoiseValue()
+    for (size_t f = 0; f < funcs.size(); ++f) {
+        auto& fn = funcs[f];
+
+        Op o;
+        o.fn = &fn;
+        o.parentOp = op;
+        o.modifier = modifier;
+        o.mask = mask;
+        o.hasClamp = fn.clamp[0] != 0.0 || fn.clamp[1] != 0.0;
+
+        TerrainOp nextOp;
+        switch (fn.func) {
+            case TerrainStage::PASS_THROUGH:
+            case TerrainStage::SQUARED:
+            case TerrainStage::CUBED:
+                // Children modify the parent's value
+                o.nextMod = modifier;
+                nextOp = op;
+                break;
+            default:
+                o.nextMod = (i32)m_ops.size();
+                nextOp = fn.op;
+                break;
+        }
+        // Multiplying by zero skips the children, so they need their own mask
+        if (fn.children.size() && nextOp == TerrainOp::MUL && o.nextMod >= 0) {
+            o.childMask = m_numMasks++;
+        } else {
+            o.childMask = mask;
+        }
+
+        m_ops.push_back(o);
+        if (fn.children.size()) {
+            compileFuncs(fn.children, o.nextMod, nextOp, o.childMask);
+        }
+    }
+}
+
+void NoiseProgram::evaluate(const NoiseBatch& batch, f64* height) const {
+    const size_t n = batch.size;
+    if (m_ops.empty() || n == 0) return;
+
+    // One register per op, one mask per op with a multiply early out
+    std::vector<f64> regs(m_ops.size() * n, 0.0);
+    std::vector<ui8> masks(m_numMasks * n, 0);
+    std::vector<f64> total(n);
+    std::vector<f64> noise(batch.isF32 ? 0 : n);
+    std::vector<f32> noise32(batch.isF32 ? n : 0);
+
+    for (size_t o = 0; o < m_ops.size(); o++) {
+        const Op& op = m_ops[o];
+        const TerrainFuncProperties& fn = *op.fn;
+        const ui8* mask = op.mask >= 0 ? &masks[op.mask * n] : nullptr;
+        // Every sample skipped this op. Its child mask stays zeroed so they skip it too.
+        if (mask && std::find(mask, mask + n, (ui8)1) == mask + n) continue;
+
+        f64* h = &regs[o * n];
+        f64* modifier = op.modifier >= 0 ? &regs[op.modifier * n] : nullptr;
+        const f64 clampLow = fn.clamp[0];
+        const f64 clampHigh = fn.clamp[1];
+
+        switch (fn.func) {
+            case TerrainStage::CONSTANT:
+                for (size_t i = 0; i < n; i++) {
+                    if (mask && !mask[i]) continue;
+                    f64 v = fn.low;
+                    // Apply parent before clamping
+                    if (modifier) v = doOperation(op.parentOp, v, modifier[i]);
+                    // The scalar version clamps the modifier here
+                    if (op.hasClamp) v = vmath::clamp(modifier ? modifier[i] : v, clampLow, clampHigh);
+                    h[i] = v;
+                }
+                break;
+            case TerrainStage::PASS_THROUGH:
+                if (!modifier) break;
+                for (size_t i = 0; i < n; i++) {
+                    if (mask && !mask[i]) continue;
+                    f64 v = doOperation(op.parentOp, modifier[i], fn.low);
+                    if (op.hasClamp) v = vmath::clamp(v, clampLow, clampHigh);
+                    h[i] = v;
+                }
+                break;
+            case TerrainStage::SQUARED:
+            case TerrainStage::CUBED:
+                if (!modifier) break;
+                for (size_t i = 0; i < n; i++) {
+                    if (mask && !mask[i]) continue;
+                    f64 m = modifier[i];
+                    modifier[i] = (fn.func == TerrainStage::SQUARED) ? m * m : m * m * m;
+                    if (op.hasClamp) h[i] = vmath::clamp(0.0, clampLow, clampHigh);
+                }
+                break;
+            default: { // It's a noise function
+                // Skipped samples are evaluated too, it's cheaper than compacting
+                evaluateNoise(fn, batch, total.data(), noise.data(), noise32.data());
+                const bool isScaled = fn.low != -1.0 || fn.high != 1.0;
+                for (size_t i = 0; i < n; i++) {
+                    if (mask && !mask[i]) continue;
+                    f64 v = total[i];
+                    // Handle any post processes per noise
+                    if (fn.func == TerrainStage::CUBED_NOISE) {
+                        v = v * v * v;
+                    } else if (fn.func == TerrainStage::SQUARED_NOISE) {
+                        v = v * v;
+                    }
+                    if (isScaled) v = v * (fn.high - fn.low) * 0.5 + (fn.high + fn.low) * 0.5;
+                    if (op.hasClamp) v = vmath::clamp(v, clampLow, clampHigh);
+                    if (modifier) v = doOperation(op.parentOp, v, modifier[i]);
+                    h[i] = v;
+                }
+            } break;
+        }
+
+        if (fn.children.size()) {
+            if (op.childMask != op.mask) {
+                // Early exit for speed, like the scalar version
+                const f64* next = &regs[op.nextMod * n];
+                ui8* childMask = &masks[op.childMask * n];
+                for (size_t i = 0; i < n; i++) {
+                    childMask[i] = (!mask || mask[i]) && next[i] != 0.0;
+                }
+            }
+        } else {
+            for (size_t i = 0; i < n; i++) {
+                if (mask && !mask[i]) continue;
+                height[i] = doOperation(fn.op, height[i], h[i]);
+            }
+        }
+    }
+}
+
+void NoiseProgram::evaluateNoise(const TerrainFuncProperties& fn, const NoiseBatch& batch,
+                                 f64* total, f64* noise, f32* noise32) const {
+    const size_t n = batch.size;
+    std::fill(total, total + n, 0.0);
+    const bool cellular = isCellular(fn.func);
+
+    f64 maxAmplitude = 0.0;
+    f64 amplitude = 1.0;
+    f64 frequency = fn.frequency;
+    for (int i = 0; i < fn.octaves; i++) {
+        if (batch.isF32) {
+            if (cellular) {
+                Noise::cellularBatch(batch.fx.data(), batch.fy.data(), batch.fz.data(), n, (f32)frequency, noise32);
+            } else {
+                Noise::rawBatch(batch.fx.data(), batch.fy.data(), batch.fz.data(), n, (f32)frequency, noise32);
+            }
+            accumulateOctave(fn.func, noise32, n, amplitude, total);
+        } else {
+            if (cellular) {
+                Noise::cellularBatch(batch.x.data(), batch.y.data(), batch.z.data(), n, frequency, noise);
+            } else {
+                Noise::rawBatch(batch.x.data(), batch.y.data(), batch.z.data(), n, frequency, noise);
+            }
+            accumulateOctave(fn.func, noise, n, amplitude, total);
+        }
+        frequency *= 2.0;
+        maxAmplitude += amplitude;
+        amplitude *= fn.persistence;
+    }
+    for (size_t i = 0; i < n; i++) total[i] = total[i] / maxAmplitude;
+}
@@ -0,0 +1,65 @@
+///
+/// NoiseProgram.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// A TerrainFuncProperties tree flattened into a list of ops that
+/// evaluates whole arrays of positions with the batched noise kernels.
+///
+
+#pragma once
+
+#ifndef NoiseProgram_h__
+#define NoiseProgram_h__
+
+#include "Noise.h"
+
+/// Positions for a batch of noise evaluations, split into components
+struct NoiseBatch {
+    /// @param useF32: Evaluate noise in f32. Faster, but loses detail far from the origin.
+    void set(const f64v3* positions, size_t n, bool useF32);
+    /// Copies the positions at indices out of another batch
+    void gather(const NoiseBatch& src, const ui32* indices, size_t n);
+
+    std::vector<f64> x, y, z;
+    std::vector<f32> fx, fy, fz; ///< Only filled in f32 mode
+    size_t size = 0;
+    bool isF32 = false;
+};
+
+class NoiseProgram {
+public:
+    /// Flattens funcs into ops. Keep the funcs alive and unchanged while the program is used.
+    void compile(const Array<TerrainFuncProperties>& funcs);
+
+    /// Applies the noise to every height, same as
+    /// SphericalHeightmapGenerator::getNoiseValue with no modifier and TerrainOp::ADD
+    /// @param height: batch.size values, holding the base value on input
+    void evaluate(const NoiseBatch& batch, f64* height) const;
+
+    bool empty() const { return m_ops.empty(); }
+private:
+    struct Op {
+        const TerrainFuncProperties* fn;
+        TerrainOp parentOp; ///< How the parent modifier is applied
+        i32 modifier; ///< Register of the parent modifier, -1 if there is none
+        i32 mask; ///< Mask register of samples this op runs for, -1 for all
+        i32 nextMod; ///< Modifier register handed to the children
+        i32 childMask; ///< Mask register the children run under
+        bool hasClamp;
+    };
+
+    void compileFuncs(const Array<TerrainFuncProperties>& funcs, i32 modifier, TerrainOp op, i32 mask);
+    /// Evaluates the octaves of a noise op into total
+    void evaluateNoise(const TerrainFuncProperties& fn, const NoiseBatch& batch,
+                       f64* total, f64* noise, f32* noise32) const;
+
+    std::vector<Op> m_ops; ///< Op i writes register i, in the order getNoiseValue visits them
+    i32 m_numMasks = 0;
+};
+
+#endif // NoiseProgram_h__
@@ -5,18 +5,8 @@
 #include "Constants.h"
 #include "soaUtils.h"
 
-void OrbitComponentUpdater::update(SpaceSystem* spaceSystem, f64 time) {
-    for (auto& it : spaceSystem->orbit) {
-        auto& cmp = it.second;
-        if (cmp.parentOrbId) {
-            OrbitComponent* pOrbC = &spaceSystem->orbit.get(cmp.parentOrbId);
-            updatePosition(cmp, time, &spaceSystem->namePosition.get(cmp.npID),
-                              pOrbC,
-                              &spaceSystem->namePosition.get(pOrbC->npID));
-        } else {
-            updatePosition(cmp, time, &spaceSystem->namePosition.get(cmp.npID));
-        }
-    }
+void OrbitComponentUpdater::update(SpaceSystem* spaceSystem, f64 time, VoxPool* threadPool /*= nullptr*/) {
+    m_solver.solve(spaceSystem, time, threadPool);
 }
 
 void OrbitComponentUpdater::updatePosition(OrbitComponent& cmp, f64 time, NamePositionComponent* npComponent,
@@ -69,18 +59,14 @@ void OrbitComponentUpdater::updatePosition(OrbitComponent& cmp, f64 time, NamePo
 
 f64 OrbitComponentUpdater::calculateTrueAnomaly(f64 meanAnomaly, f64 e) {
     // 2. Solve Kepler's equation to compute eccentric anomaly 
-    // using Newton's method
+    // using Newton's method, until it converges
     // http://www.jgiesen.de/kepler/kepler.html
-#define ITERATIONS 3
-    f64 E; ///< Eccentric Anomaly
-    f64 F;
-    E = meanAnomaly;
-    F = E - e * sin(meanAnomaly) - meanAnomaly;
-    for (int n = 0; n < ITERATIONS; n++) {
-        E = E -
-            F / (1.0 - e * cos(E));
-        F = E -
-            e * sin(E) - meanAnomaly;
+    meanAnomaly = fmod(meanAnomaly, 2.0 * M_PI);
+    f64 E = meanAnomaly; ///< Eccentric Anomaly
+    for (int n = 0; n < KEPLER_MAX_ITERATIONS; n++) {
+        f64 delta = (E - e * sin(E) - meanAnomaly) / (1.0 - e * cos(E));
+        E -= delta;
+        if (!(std::abs(delta) > KEPLER_TOLERANCE)) break;
     }
     // 3. Calculate true anomaly
     return atan2(sqrt(1.0 - e * e) * sin(E), cos(E) - e);
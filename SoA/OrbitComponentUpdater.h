@@ -15,6 +15,8 @@
 #ifndef OrbitComponentUpdater_h__
 #define OrbitComponentUpdater_h__
 
+#include "OrbitSolver.h"
+
 class SpaceSystem;
 struct NamePositionComponent;
 struct OrbitComponent;
@@ -22,7 +24,9 @@ struct SphericalGravityComponent;
 
 class OrbitComponentUpdater {
 public:
-    void update(SpaceSystem* spaceSystem, f64 time);
+    /// Updates every orbit, parents before children
+    /// @param threadPool: Optional, solves large hierarchy levels in parallel
+    void update(SpaceSystem* spaceSystem, f64 time, VoxPool* threadPool = nullptr);
 
     /// Updates the position based on time and parent position
     /// @param cmp: The component to update
@@ -34,6 +38,8 @@ class OrbitComponentUpdater {
                            NamePositionComponent* parentNpComponent = nullptr);
 
     f64 calculateTrueAnomaly(f64 meanAnomaly, f64 e);
+private:
+    OrbitSolver m_solver;
 };
 
 #endif // OrbitComponentUpdater_h__
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "stdafx.h"
+#include "OrbitSolver.h"
+
+#include <thread>
+#include <unordered_map>
+
+#include "Constants.h"
+#include "SpaceSystem.h"
+
+// Levels smaller than this are solved on the calling thread
+#define ORBIT_PARALLEL_THRESHOLD 4096
+#define ORBIT_BATCH_SIZE 1024
+#define ORBIT_MAX_TASKS 8
+// Parent chains deeper than this are treated as broken
+#define MAX_ORBIT_DEPTH 64
+
+void OrbitLevel::resize(size_t n) {
+    a.resize(n); e.resize(n); t.resize(n); startMeanAnomaly.resize(n);
+    o.resize(n); p.resize(n); i.resize(n); parentMass.resize(n);
+    meanAnomaly.resize(n); eccentricAnomaly.resize(n); trueAnomaly.resize(n);
+}
+
+void OrbitDispatch::run() {
+    size_t batch;
+    while ((batch = nextBatch++) < numBatches) {
+        size_t begin = batch * ORBIT_BATCH_SIZE;
+        size_t end = std::min(begin + ORBIT_BATCH_SIZE, level->orbits.size());
+        OrbitSolver::solveRange(spaceSystem, *level, time, begin, end);
+        numDone++;
+    }
+}
+
+void OrbitSolveTask::execute(WorkerData* workerData) {
+    m_dispatch->run();
+}
+
+void OrbitSolveTask::cleanup() {
+    delete this;
+}
+
+void OrbitSolver::solve(SpaceSystem* spaceSystem, f64 time, VoxPool* threadPool /*= nullptr*/) {
+    ui64 signature = getSignature(spaceSystem);
+    if (signature != m_signature) {
+        buildLevels(spaceSystem);
+        m_signature = signature;
+    }
+
+    // Levels in order, so every parent is placed before its children
+    for (auto& level : m_levels) {
+        size_t n = level.orbits.size();
+        if (!threadPool || n < ORBIT_PARALLEL_THRESHOLD) {
+            solveRange(spaceSystem, level, time, 0, n);
+            continue;
+        }
+
+        std::shared_ptr<OrbitDispatch> dispatch(new OrbitDispatch);
+        dispatch->spaceSystem = spaceSystem;
+        dispatch->level = &level;
+        dispatch->time = time;
+        dispatch->numBatches = (n + ORBIT_BATCH_SIZE - 1) / ORBIT_BATCH_SIZE;
+        dispatch->nextBatch = 0;
+        dispatch->numDone = 0;
+        size_t numTasks = std::min(dispatch->numBatches - 1, (size_t)ORBIT_MAX_TASKS);
+        for (size_t t = 0; t < numTasks; t++) {
+            threadPool->addTask(new OrbitSolveTask(dispatch));
+        }
+        // Work alongside the pool so a busy pool can't stall us, then wait for batches in flight
+        dispatch->run();
+        while (dispatch->numDone < dispatch->numBatches) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void OrbitSolver::solveRange(SpaceSystem* spaceSystem, OrbitLevel& level, f64 time, size_t begin, size_t end) {
+    /// Calculates position as a function of time
+    /// http://en.wikipedia.org/wiki/Kepler%27s_laws_of_planetary_motion#Position_as_a_function_of_time
+
+    // Gather the elements
+    for (size_t k = begin; k < end; k++) {
+        const OrbitComponent& cmp = spaceSystem->orbit.get(level.orbits[k]);
+        level.a[k] = cmp.a;
+        level.e[k] = cmp.e;
+        level.t[k] = cmp.t;
+        level.startMeanAnomaly[k] = cmp.startMeanAnomaly;
+        level.o[k] = cmp.o;
+        level.p[k] = cmp.p;
+        level.i[k] = cmp.i;
+        level.parentMass[k] = cmp.parentMass;
+    }
+
+    // 1. Calculate the mean anomaly
+    f64* M = level.meanAnomaly.data();
+    f64* E = level.eccentricAnomaly.data();
+    const f64* e = level.e.data();
+    for (size_t k = begin; k < end; k++) {
+        M[k] = (M_2_PI / level.t[k]) * time + level.startMeanAnomaly[k];
+    }
+
+    // 2. Solve Kepler's equation for the eccentric anomaly with Newton's method.
+    // The whole batch iterates together until every orbit converged.
+    // http://www.jgiesen.de/kepler/kepler.html
+    for (size_t k = begin; k < end; k++) {
+        // Wrap so large times don't lose precision in the iteration
+        f64 m = fmod(M[k], 2.0 * M_PI);
+        M[k] = m;
+        E[k] = m;
+    }
+    for (int n = 0; n < KEPLER_MAX_ITERATIONS; n++) {
+        f64 maxDelta = 0.0;
+        for (size_t k = begin; k < end; k++) {
+            f64 delta = (E[k] - e[k] * sin(E[k]) - M[k]) / (1.0 - e[k] * cos(E[k]));
+            E[k] -= delta;
+            maxDelta = std::max(maxDelta, std::abs(delta));
+        }
+        // std::max skips the NaNs of empty orbits, so they can't stall this
+        if (!(maxDelta > KEPLER_TOLERANCE)) break;
+    }
+
+    // 3. Calculate true anomaly
+    f64* v = level.trueAnomaly.data();
+    for (size_t k = begin; k < end; k++) {
+        v[k] = atan2(sqrt(1.0 - e[k] * e[k]) * sin(E[k]), cos(E[k]) - e[k]);
+    }
+
+    // Positions and velocities, relative to the parents which are already solved
+    for (size_t k = begin; k < end; k++) {
+        if (level.a[k] == 0.0) continue;
+        OrbitComponent& cmp = spaceSystem->orbit.get(level.orbits[k]);
+        NamePositionComponent& npCmp = spaceSystem->namePosition.get(cmp.npID);
+        cmp.currentMeanAnomaly = (f32)((M_2_PI / level.t[k]) * time + level.startMeanAnomaly[k]);
+
+        // Calculate radius
+        // http://www.stargazing.net/kepler/ellipse.html
+        f64 r = level.a[k] * (1.0 - e[k] * e[k]) / (1.0 + e[k] * cos(v[k]));
+
+        f64 w = level.p[k] - level.o[k]; ///< Argument of periapsis
+
+        // Calculate position
+        f64v3 position;
+        f64 cosv = cos(v[k] + w);
+        f64 sinv = sin(v[k] + w);
+        f64 coso = cos(level.o[k]);
+        f64 sino = sin(level.o[k]);
+        f64 cosi = cos(level.i[k]);
+        f64 sini = sin(level.i[k]);
+        position.x = r * (coso * cosv - sino * sinv * cosi);
+        position.y = r * (sinv * sini);
+        position.z = r * (sino * cosv + coso * sinv * cosi);
+
+        // Calculate velocity
+        f64 g = sqrt(M_G * KM_PER_M * level.parentMass[k] * (2.0 / r - 1.0 / level.a[k])) * KM_PER_M;
+        cmp.relativeVelocity.x = -g * sinv * cosi;
+        cmp.relativeVelocity.y = g * sinv * sini;
+        cmp.relativeVelocity.z = g * cosv;
+
+        // If this planet has a parent, make it parent relative
+        if (cmp.parentOrbId) {
+            const OrbitComponent& pOrbC = spaceSystem->orbit.get(cmp.parentOrbId);
+            cmp.velocity = pOrbC.velocity + cmp.relativeVelocity;
+            npCmp.position = position + spaceSystem->namePosition.get(pOrbC.npID).position;
+        } else {
+            cmp.velocity = cmp.relativeVelocity;
+            npCmp.position = position;
+        }
+    }
+}
+
+void OrbitSolver::buildLevels(SpaceSystem* spaceSystem) {
+    std::vector<OrbitLevel>().swap(m_levels);
+
+    std::unordered_map<vecs::ComponentID, i32> depths;
+    for (auto& it : spaceSystem->orbit) {
+        depths[spaceSystem->orbit.getComponentID(it.first)] = -1;
+    }
+    std::vector<vecs::ComponentID> chain;
+    for (auto& it : depths) {
+        if (it.second >= 0) continue;
+        // Walk up until we reach a root or an orbit we already placed
+        chain.clear();
+        vecs::ComponentID id = it.first;
+        i32 depth = 0;
+        while (chain.size() < MAX_ORBIT_DEPTH) {
+            chain.push_back(id);
+            vecs::ComponentID parent = spaceSystem->orbit.get(id).parentOrbId;
+            auto pit = depths.find(parent);
+            if (!parent || pit == depths.end()) break;
+            if (pit->second >= 0) {
+                depth = pit->second + 1;
+                break;
+            }
+            id = parent;
+        }
+        for (auto cit = chain.rbegin(); cit != chain.rend(); ++cit) {
+            depths[*cit] = depth++;
+        }
+    }
+
+    for (auto& it : depths) {
+        if ((size_t)it.second >= m_levels.size()) m_levels.resize(it.second + 1);
+        m_levels[it.second].orbits.push_back(it.first);
+    }
+    for (auto& level : m_levels) {
+        // Component order keeps memory access roughly linear
+        std::sort(level.orbits.begin(), level.orbits.end());
+        level.resize(level.orbits.size());
+    }
+}
+
+ui64 OrbitSolver::getSignature(SpaceSystem* spaceSystem) const {
+    ui64 signature = 1;
+    for (auto& it : spaceSystem->orbit) {
+        signature = signature * 31 + it.first;
+        signature = signature * 31 + it.second.parentOrbId;
+    }
+    return signature;
+}
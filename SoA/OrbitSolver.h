@@ -0,0 +1,96 @@
+///
+/// OrbitSolver.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Solves every orbit of a SpaceSystem one hierarchy level at a time,
+/// so parents are always placed before their children. Each level is
+/// evaluated in batches over flat arrays of orbital elements.
+///
+
+#pragma once
+
+#ifndef OrbitSolver_h__
+#define OrbitSolver_h__
+
+#include <atomic>
+#include <memory>
+#include <Vorb/ecs/Entity.h>
+#include <Vorb/IThreadPoolTask.h>
+
+#include "VoxPool.h"
+
+class SpaceSystem;
+
+#define ORBIT_SOLVE_TASK_ID 8
+
+// Kepler's equation is solved to within this many radians
+#define KEPLER_TOLERANCE 1e-12
+#define KEPLER_MAX_ITERATIONS 16
+
+/// Orbits at the same depth of the hierarchy
+struct OrbitLevel {
+    void resize(size_t n);
+
+    std::vector<vecs::ComponentID> orbits;
+    // Elements, gathered from the components every solve
+    std::vector<f64> a, e, t, startMeanAnomaly, o, p, i, parentMass;
+    // Intermediates
+    std::vector<f64> meanAnomaly, eccentricAnomaly, trueAnomaly;
+};
+
+/// One level being solved by the thread pool. Batches are claimed by
+/// whoever gets to them first, so late tasks just find nothing to do.
+struct OrbitDispatch {
+    void run();
+
+    SpaceSystem* spaceSystem = nullptr;
+    OrbitLevel* level = nullptr;
+    f64 time = 0.0;
+    size_t numBatches = 0;
+    std::atomic<size_t> nextBatch;
+    std::atomic<size_t> numDone;
+};
+
+class OrbitSolveTask : public vcore::IThreadPoolTask<WorkerData> {
+public:
+    OrbitSolveTask(std::shared_ptr<OrbitDispatch> dispatch) :
+        vcore::IThreadPoolTask<WorkerData>(ORBIT_SOLVE_TASK_ID),
+        m_dispatch(dispatch) {
+        // Empty
+    }
+
+    void execute(WorkerData* workerData) override;
+
+    void cleanup() override;
+private:
+    std::shared_ptr<OrbitDispatch> m_dispatch;
+};
+
+class OrbitSolver {
+public:
+    /// Updates the velocity and position of every orbit
+    /// @param time: Time in seconds
+    /// @param threadPool: Optional, solves large levels in parallel
+    void solve(SpaceSystem* spaceSystem, f64 time, VoxPool* threadPool = nullptr);
+
+    /// Solves orbits [begin, end) of a level. Their parents must be solved already.
+    static void solveRange(SpaceSystem* spaceSystem, OrbitLevel& level, f64 time, size_t begin, size_t end);
+
+    /// Forces the hierarchy to be rebuilt on the next solve
+    void invalidate() { m_signature = 0; }
+private:
+    /// Sorts the orbits into levels by how many parents they have
+    void buildLevels(SpaceSystem* spaceSystem);
+    /// Cheap check for orbits being added or removed
+    ui64 getSignature(SpaceSystem* spaceSystem) const;
+
+    std::vector<OrbitLevel> m_levels; ///< Stars first
+    ui64 m_signature = 0;
+};
+
+#endif // OrbitSolver_h__
@@ -0,0 +1,344 @@
+//
+// PaletteVoxelArray.hpp
+// Seed of Andromeda
+//
+// Created on 16 Oct 2026
+// Copyright 2014 Regrowth Studios
+// All Rights Reserved
+//
+// Summary:
+// Palette compressed voxel storage. Stores each distinct value once
+// and packs per voxel palette indices into 1, 2, 4 or 8 bits. A single
+// value palette needs no indices at all.
+//
+
+#pragma once
+
+#ifndef PaletteVoxelArray_h__
+#define PaletteVoxelArray_h__
+
+#include <vector>
+
+#include "Constants.h"
+#include "VoxelRunKernels.h"
+
+#include <Vorb/Voxel/IntervalTree.h>
+
+namespace vorb {
+    namespace voxel {
+
+        /*! @brief Palette compressed array of SIZE voxels.
+         *
+         * T must be an integral type. Index widths are always powers of two that
+         * divide 32, so an index never straddles two words and get/set are O(1).
+         * A palette with one entry uses 0 bit indices and allocates no index words.
+         */
+        template <typename T, size_t SIZE = CHUNK_SIZE>
+        class PaletteVoxelArray {
+        public:
+            typedef ui32 Word;
+
+            static const ui32 MAX_PALETTE_SIZE = 256; ///< Palettes can't grow past 8 bit indices
+            static const ui32 NO_PALETTE_INDEX = 0xFFFFFFFF;
+
+            /// Builds the palette from a flat array of SIZE elements.
+            /// @return false if data has more than MAX_PALETTE_SIZE distinct values. The array is left empty.
+            bool initFromFlatArray(const T* data) {
+                clear();
+                LookupTable lookup;
+                // Gather the palette first so we only pack once at the final width
+                for (size_t i = 0; i < SIZE; i = findRunEnd(data, i, SIZE)) {
+                    if (lookup.findOrAdd(m_palette, data[i]) == NO_PALETTE_INDEX) {
+                        clear();
+                        return false;
+                    }
+                }
+                allocateIndices(getBitsForPaletteSize((ui32)m_palette.size()));
+                if (m_palette.size() == 1) return true; // 0 bit indices, nothing to fill
+
+                size_t i = 0;
+                while (i < SIZE) {
+                    size_t end = findRunEnd(data, i, SIZE);
+                    fillIndices(i, end - i, lookup.find(m_palette, data[i]));
+                    i = end;
+                }
+                return true;
+            }
+
+            /// Builds the palette from a sorted array of runs that adds up to SIZE.
+            /// @return false if data has more than MAX_PALETTE_SIZE distinct values. The array is left empty.
+            bool initFromSortedArray(const typename IntervalTree<T>::LNode data[], size_t size) {
+                clear();
+                LookupTable lookup;
+                for (size_t i = 0; i < size; i++) {
+                    if (lookup.findOrAdd(m_palette, data[i].data) == NO_PALETTE_INDEX) {
+                        clear();
+                        return false;
+                    }
+                }
+                allocateIndices(getBitsForPaletteSize((ui32)m_palette.size()));
+                if (m_palette.size() == 1) return true;
+
+                for (size_t i = 0; i < size; i++) {
+                    fillIndices(data[i].start, data[i].length, lookup.find(m_palette, data[i].data));
+                }
+                return true;
+            }
+
+            /// Builds the palette from the nodes of an interval tree.
+            /// @param maxPaletteSize: Largest palette to build, at most MAX_PALETTE_SIZE
+            /// @return false if the tree has more than maxPaletteSize distinct values. The array is left empty.
+            bool initFromTree(IntervalTree<T>& tree, ui32 maxPaletteSize = MAX_PALETTE_SIZE) {
+                clear();
+                LookupTable lookup;
+                for (size_t i = 0; i < tree.size(); i++) {
+                    if (lookup.findOrAdd(m_palette, tree[i].data, maxPaletteSize) == NO_PALETTE_INDEX) {
+                        clear();
+                        return false;
+                    }
+                }
+                allocateIndices(getBitsForPaletteSize((ui32)m_palette.size()));
+                if (m_palette.size() == 1) return true;
+
+                for (size_t i = 0; i < tree.size(); i++) {
+                    fillIndices(tree[i].getStart(), tree[i].length, lookup.find(m_palette, tree[i].data));
+                }
+                return true;
+            }
+
+            /// Frees all memory
+            void clear() {
+                std::vector<T>().swap(m_palette);
+                std::vector<Word>().swap(m_words);
+                m_bitsPerIndex = 0;
+                m_indexMask = 0;
+                m_lastPaletteIndex = 0;
+            }
+
+            /// Gets the element at index
+            inline const T& get(size_t index) const {
+                return m_palette[readIndex(index)];
+            }
+
+            /// Sets the element at index, growing the palette and index width as needed.
+            /// @return false if value would need a palette entry past MAX_PALETTE_SIZE. Nothing is written.
+            inline bool set(size_t index, T value) {
+                ui32 p = findPaletteIndex(value);
+                if (p == NO_PALETTE_INDEX) {
+                    if (m_palette.size() == MAX_PALETTE_SIZE) {
+                        // Drop entries that were overwritten before giving up
+                        compact();
+                        if (m_palette.size() == MAX_PALETTE_SIZE) return false;
+                    }
+                    p = (ui32)m_palette.size();
+                    m_palette.push_back(value);
+                    if (m_palette.size() > (1u << m_bitsPerIndex)) {
+                        repack(getBitsForPaletteSize((ui32)m_palette.size()), nullptr);
+                    }
+                }
+                m_lastPaletteIndex = p;
+                writeIndex(index, p);
+                return true;
+            }
+
+            /// Sets count elements starting at begin to value.
+            /// @return false if value would need a palette entry past MAX_PALETTE_SIZE. Nothing is written.
+            inline bool fill(size_t begin, size_t count, T value) {
+                if (count == 0) return true;
+                // set() handles palette growth, the rest reuses its index
+                if (!set(begin, value)) return false;
+                fillIndices(begin + 1, count - 1, m_lastPaletteIndex);
+                return true;
+            }
+
+            /// Expands the array into buffer, which must hold SIZE elements
+            void uncompressIntoBuffer(T* buffer) const {
+                copyRange(0, SIZE, buffer);
+            }
+            /// Copies count elements starting at begin into out
+            void copyRange(size_t begin, size_t count, T* out) const {
+                if (m_palette.size() == 1) {
+                    fillRun(out, count, m_palette[0]);
+                    return;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    out[i] = m_palette[readIndex(begin + i)];
+                }
+            }
+            /// Calls f(start, length, value) for each run of equal values in
+            /// [begin, begin + count), in index order.
+            template <typename F>
+            void forEachRun(size_t begin, size_t count, F f) const {
+                if (count == 0) return;
+                if (m_palette.size() == 1) {
+                    f(begin, count, m_palette[0]);
+                    return;
+                }
+                const size_t end = begin + count;
+                size_t runStart = begin;
+                ui32 runIndex = readIndex(begin);
+                for (size_t i = begin + 1; i < end; i++) {
+                    ui32 p = readIndex(i);
+                    if (p != runIndex) {
+                        f(runStart, i - runStart, m_palette[runIndex]);
+                        runStart = i;
+                        runIndex = p;
+                    }
+                }
+                f(runStart, end - runStart, m_palette[runIndex]);
+            }
+
+            /// Removes palette entries that are no longer referenced and shrinks
+            /// the index width if possible.
+            void compact() {
+                ui32 counts[MAX_PALETTE_SIZE] = {};
+                for (size_t i = 0; i < SIZE; i++) {
+                    counts[readIndex(i)]++;
+                }
+                ui8 remap[MAX_PALETTE_SIZE];
+                std::vector<T> palette;
+                palette.reserve(m_palette.size());
+                for (size_t i = 0; i < m_palette.size(); i++) {
+                    if (counts[i]) {
+                        remap[i] = (ui8)palette.size();
+                        palette.push_back(m_palette[i]);
+                    }
+                }
+                if (palette.size() == m_palette.size()) return;
+                m_palette.swap(palette);
+                m_lastPaletteIndex = 0;
+                repack(getBitsForPaletteSize((ui32)m_palette.size()), remap);
+            }
+
+            /// Getters
+            const std::vector<T>& getPalette() const { return m_palette; }
+            ui32 getBitsPerIndex() const { return m_bitsPerIndex; }
+            bool isEmpty() const { return m_palette.empty(); }
+            /// @return Bytes of heap memory held by the array
+            size_t getMemoryUsage() const {
+                return m_palette.capacity() * sizeof(T) + m_words.capacity() * sizeof(Word);
+            }
+
+            /// @return The smallest supported index width that can address paletteSize entries
+            static ui32 getBitsForPaletteSize(ui32 paletteSize) {
+                if (paletteSize <= 1) return 0;
+                if (paletteSize <= 2) return 1;
+                if (paletteSize <= 4) return 2;
+                if (paletteSize <= 16) return 4;
+                return 8;
+            }
+            /// @return Estimated bytes of heap memory for a palette of paletteSize entries
+            static size_t estimateMemoryUsage(ui32 paletteSize) {
+                return getWordCount(getBitsForPaletteSize(paletteSize)) * sizeof(Word) + paletteSize * sizeof(T);
+            }
+        private:
+            /// Small open addressing table used to map values to palette indices
+            /// while building a palette from scratch.
+            class LookupTable {
+            public:
+                LookupTable() {
+                    memset(m_slots, 0, sizeof(m_slots));
+                }
+                ui32 find(const std::vector<T>& palette, T value) const {
+                    ui32 s = hash(value);
+                    while (m_slots[s]) {
+                        if (palette[m_slots[s] - 1] == value) return m_slots[s] - 1;
+                        s = (s + 1) & (NUM_SLOTS - 1);
+                    }
+                    return NO_PALETTE_INDEX;
+                }
+                ui32 findOrAdd(std::vector<T>& palette, T value, ui32 maxPaletteSize = MAX_PALETTE_SIZE) {
+                    ui32 s = hash(value);
+                    while (m_slots[s]) {
+                        if (palette[m_slots[s] - 1] == value) return m_slots[s] - 1;
+                        s = (s + 1) & (NUM_SLOTS - 1);
+                    }
+                    if (palette.size() >= maxPaletteSize) return NO_PALETTE_INDEX;
+                    palette.push_back(value);
+                    m_slots[s] = (ui16)palette.size();
+                    return (ui32)palette.size() - 1;
+                }
+            private:
+                static const ui32 NUM_SLOTS = MAX_PALETTE_SIZE * 2;
+                static ui32 hash(T value) {
+                    return ((ui32)value * 2654435761u) >> 23; // Top 9 bits for 512 slots
+                }
+                ui16 m_slots[NUM_SLOTS]; ///< Palette index + 1, 0 is empty
+            };
+
+            static size_t getWordCount(ui32 bitsPerIndex) {
+                return (SIZE * bitsPerIndex + 31) / 32;
+            }
+
+            inline ui32 readIndex(size_t index) const {
+                if (m_bitsPerIndex == 0) return 0;
+                size_t bit = index * m_bitsPerIndex;
+                return (m_words[bit >> 5] >> (bit & 31)) & m_indexMask;
+            }
+            inline void writeIndex(size_t index, ui32 p) {
+                if (m_bitsPerIndex == 0) return; // p is always 0
+                size_t bit = index * m_bitsPerIndex;
+                ui32 shift = (ui32)(bit & 31);
+                Word& w = m_words[bit >> 5];
+                w = (w & ~(m_indexMask << shift)) | (p << shift);
+            }
+            inline ui32 findPaletteIndex(T value) const {
+                // Edits tend to repeat the same value, so check the last one first
+                if (m_lastPaletteIndex < m_palette.size() && m_palette[m_lastPaletteIndex] == value) {
+                    return m_lastPaletteIndex;
+                }
+                for (size_t i = 0; i < m_palette.size(); i++) {
+                    if (m_palette[i] == value) return (ui32)i;
+                }
+                return NO_PALETTE_INDEX;
+            }
+
+            void allocateIndices(ui32 bitsPerIndex) {
+                m_bitsPerIndex = bitsPerIndex;
+                m_indexMask = (1u << bitsPerIndex) - 1;
+                m_words.assign(getWordCount(bitsPerIndex), 0);
+            }
+            void fillIndices(size_t start, size_t length, ui32 p) {
+                if (m_bitsPerIndex == 0) return;
+                const size_t end = start + length;
+                const size_t indicesPerWord = 32 / m_bitsPerIndex;
+                size_t i = start;
+                // Leading partial word
+                for (; i < end && (i % indicesPerWord) != 0; i++) {
+                    writeIndex(i, p);
+                }
+                // Whole words at once, p repeated in every slot
+                const Word pattern = p * (0xFFFFFFFFu / m_indexMask);
+                for (; i + indicesPerWord <= end; i += indicesPerWord) {
+                    m_words[(i * m_bitsPerIndex) >> 5] = pattern;
+                }
+                // Trailing partial word
+                for (; i < end; i++) {
+                    writeIndex(i, p);
+                }
+            }
+            /// Rewrites every index at a new width, optionally remapping palette indices
+            void repack(ui32 newBitsPerIndex, const ui8* remap) {
+                std::vector<Word> words(getWordCount(newBitsPerIndex), 0);
+                for (size_t i = 0; newBitsPerIndex && i < SIZE; i++) {
+                    ui32 p = readIndex(i);
+                    if (remap) p = remap[p];
+                    size_t bit = i * newBitsPerIndex;
+                    words[bit >> 5] |= p << (bit & 31);
+                }
+                m_words.swap(words);
+                m_bitsPerIndex = newBitsPerIndex;
+                m_indexMask = (1u << newBitsPerIndex) - 1;
+            }
+
+            std::vector<T> m_palette; ///< Distinct values, indexed by the packed indices
+            std::vector<Word> m_words; ///< Packed palette indices
+            ui32 m_bitsPerIndex = 0;
+            ui32 m_indexMask = 0;
+            ui32 m_lastPaletteIndex = 0; ///< Palette index of the last set() value
+        };
+    }
+}
+namespace vvox = vorb::voxel;
+
+#endif // PaletteVoxelArray_h__
@@ -94,71 +94,76 @@ void ParkourComponentUpdater::update(GameSystem* gameSystem, SpaceSystem* spaceS
         }
 
         // Collision
-        if (aabbCollidable.voxelCollisions.size() && voxelPosition.parentVoxel) {
-            
+        const VoxelCollisionCache& voxels = aabbCollidable.voxelCache;
+        if (voxels.boxDims.x && voxelPosition.parentVoxel) {
+
             const f64v3 MIN_DISTANCE = f64v3(aabbCollidable.box) * 0.5 + 0.5;
+            const i32v3 boxEnd = voxels.boxPos + voxels.boxDims;
 
-            for (auto& it : aabbCollidable.voxelCollisions) {
-                for (auto& cd : it.second) {
-                    f64v3 aabbPos = voxelPosition.gridPosition.pos + f64v3(aabbCollidable.offset);
+            for (int y = voxels.boxPos.y; y < boxEnd.y; y++) {
+                for (int z = voxels.boxPos.z; z < boxEnd.z; z++) {
+                    for (int x = voxels.boxPos.x; x < boxEnd.x; x++) {
+                        i32v3 p(x, y, z);
+                        if (!voxels.isSolid(p)) continue;
 
-                    f64v3 vpos = f64v3(it.first.x, it.first.y, it.first.z) * (f64)CHUNK_WIDTH + f64v3(getPosFromBlockIndex(cd.index)) + 0.5;
-                        
-                    f64v3 dp = vpos - aabbPos;
-                    f64v3 adp(vmath::abs(dp));
+                        f64v3 aabbPos = voxelPosition.gridPosition.pos + f64v3(aabbCollidable.offset);
 
-                   // std::cout << MIN_DISTANCE.y - adp.y << std::endl;
+                        f64v3 vpos = f64v3(p) + 0.5;
 
-                    // Check slow feet collision first
-                    if (dp.y < 0 && MIN_DISTANCE.y - adp.y < 0.55 && !cd.top) {
-                        voxelPosition.gridPosition.y += (MIN_DISTANCE.y - adp.y) * 0.01;
-                        if (physics.velocity.y < 0) physics.velocity.y = 0.0;
-                        continue;
-                    }
-                    if (adp.y > adp.z && adp.y > adp.x) {
-                        // Y collision
-                        if (dp.y < 0) {
-                            if (!cd.top) {
-                                voxelPosition.gridPosition.y += MIN_DISTANCE.y - adp.y;
-                                if (physics.velocity.y < 0) physics.velocity.y = 0.0;
-                                continue;
+                        f64v3 dp = vpos - aabbPos;
+                        f64v3 adp(vmath::abs(dp));
+
+                        // Check slow feet collision first
+                        if (dp.y < 0 && MIN_DISTANCE.y - adp.y < 0.55 && !voxels.isSolid(i32v3(x, y + 1, z))) {
+                            voxelPosition.gridPosition.y += (MIN_DISTANCE.y - adp.y) * 0.01;
+                            if (physics.velocity.y < 0) physics.velocity.y = 0.0;
+                            continue;
+                        }
+                        if (adp.y > adp.z && adp.y > adp.x) {
+                            // Y collision
+                            if (dp.y < 0) {
+                                if (!voxels.isSolid(i32v3(x, y + 1, z))) {
+                                    voxelPosition.gridPosition.y += MIN_DISTANCE.y - adp.y;
+                                    if (physics.velocity.y < 0) physics.velocity.y = 0.0;
+                                    continue;
+                                }
+                            } else {
+                                if (!voxels.isSolid(i32v3(x, y - 1, z))) {
+                                    voxelPosition.gridPosition.y -= MIN_DISTANCE.y - adp.y;
+                                    if (physics.velocity.y > 0) physics.velocity.y = 0.0;
+                                    continue;
+                                }
                             }
-                        } else {
-                            if (!cd.bottom) {
-                                voxelPosition.gridPosition.y -= MIN_DISTANCE.y - adp.y;
-                                if (physics.velocity.y > 0) physics.velocity.y = 0.0;
-                                continue;
+                        }
+                        if (adp.z > adp.x) {
+                            // Z collision
+                            if (dp.z < 0) {
+                                if (!voxels.isSolid(i32v3(x, y, z + 1))) {
+                                    voxelPosition.gridPosition.z += MIN_DISTANCE.z - adp.z;
+                                    if (physics.velocity.z < 0) physics.velocity.z = 0.0;
+                                    continue;
+                                }
+                            } else {
+                                if (!voxels.isSolid(i32v3(x, y, z - 1))) {
+                                    voxelPosition.gridPosition.z -= MIN_DISTANCE.z - adp.z;
+                                    if (physics.velocity.z > 0) physics.velocity.z = 0.0;
+                                    continue;
+                                }
                             }
                         }
-                    }
-                    if (adp.z > adp.x) {
-                        // Z collision
-                        if (dp.z < 0) {
-                            if (!cd.front) {
-                                voxelPosition.gridPosition.z += MIN_DISTANCE.z - adp.z;
-                                if (physics.velocity.z < 0) physics.velocity.z = 0.0;
-                                continue;
+                        // X collision
+                        if (dp.x < 0) {
+                            if (!voxels.isSolid(i32v3(x + 1, y, z))) {
+                                voxelPosition.gridPosition.x += MIN_DISTANCE.x - adp.x;
+                                if (physics.velocity.x < 0) physics.velocity.x = 0.0;
                             }
                         } else {
-                            if (!cd.back) {
-                                voxelPosition.gridPosition.z -= MIN_DISTANCE.z - adp.z;
-                                if (physics.velocity.z > 0) physics.velocity.z = 0.0;
-                                continue;
+                            if (!voxels.isSolid(i32v3(x - 1, y, z))) {
+                                voxelPosition.gridPosition.x -= MIN_DISTANCE.x - adp.x;
+                                if (physics.velocity.x > 0) physics.velocity.x = 0.0;
                             }
                         }
                     }
-                    // X collision
-                    if (dp.x < 0) {
-                        if (!cd.right) {
-                            voxelPosition.gridPosition.x += MIN_DISTANCE.x - adp.x;
-                            if (physics.velocity.x < 0) physics.velocity.x = 0.0;
-                        }
-                    } else {
-                        if (!cd.left) {
-                            voxelPosition.gridPosition.x -= MIN_DISTANCE.x - adp.x;
-                            if (physics.velocity.x > 0) physics.velocity.x = 0.0;
-                        }
-                    }
                 }
             }
         }
@@ -23,6 +23,7 @@
 
 #include "Noise.h"
 #include "Biome.h"
+#include "HeightmapCache.h"
 
 DECL_VG(class GLProgram; class BitmapResource);
 
@@ -204,6 +205,8 @@ struct PlanetGenData {
     std::vector<Biome> biomes; ///< Biome object storage. DON'T EVER RESIZE AFTER GEN.
 
     nString terrainFilePath;
+
+    HeightmapCache heightmapCache; ///< Chunk column heights, shared by every face
 };
 
 #endif // PlanetData_h__
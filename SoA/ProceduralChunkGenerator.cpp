@@ -7,161 +7,117 @@
 
 #include "SmartVoxelContainer.hpp"
 
+#include <algorithm>
+
 void ProceduralChunkGenerator::init(PlanetGenData* genData) {
     m_genData = genData;
     m_heightGenerator.init(genData);
 }
 
 void ProceduralChunkGenerator::generateChunk(Chunk* chunk, PlanetHeightData* heightData) const {
-
-    int temperature;
-    int rainfall;
-    int height;
-    int mapHeight;
-    int hIndex;
-    int depth;
-
-    ui16 blockID;
-    ui16 tertiaryData;
-    //double CaveDensity1[9][5][5], CaveDensity2[9][5][5];
-
-    std::vector<BlockLayer>& blockLayers = m_genData->blockLayers;
     VoxelPosition3D voxPosition = chunk->getVoxelPosition();
+    const int chunkY = (int)voxPosition.pos.y; // TODO(Ben): Fastfloor?
     chunk->numBlocks = 0;
 
-    // Generation data
-    IntervalTree<ui16>::LNode blockDataArray[CHUNK_SIZE];
-    IntervalTree<ui16>::LNode tertiaryDataArray[CHUNK_SIZE];
-    size_t blockDataSize = 0;
-    size_t tertiaryDataSize = 0;
-
-    ui16 c = 0;
-    bool allAir = true;
-
-    ui32 layerIndices[CHUNK_LAYER];
-
-    // First pass at y = 0. We separate it so we can getBlockLayerIndex a single
-    // time and cut out some comparisons.
-    for (size_t z = 0; z < CHUNK_WIDTH; ++z) {
-        for (size_t x = 0; x < CHUNK_WIDTH; ++x, ++c) {
-            tertiaryData = 0;
-
-            mapHeight = (int)heightData[c].height;
-            temperature = heightData[c].temperature;
-            rainfall = heightData[c].humidity;
-
-            //tooSteep = (flags & TOOSTEEP) != 0;
-            
-            // TODO(Ben): Fastfloor?
-            height = (int)voxPosition.pos.y;
-            depth = mapHeight - height; // Get depth of voxel
-
-            // Determine the layer
-            if (depth < 0) {
-                layerIndices[c] = 0;
-            } else {
-                allAir = false;
-                layerIndices[c] = getBlockLayerIndex(depth);
-            }
-            BlockLayer& layer = blockLayers[layerIndices[c]];
-            // Get the block ID
-            blockID = getBlockID(chunk, c, depth, mapHeight, height, heightData[c], layer);
-
-            if (blockID != 0) chunk->numBlocks++;
-
-            // Set up the data arrays
-            if (blockDataSize == 0) {
-                blockDataArray[blockDataSize++].set(c, 1, blockID);
-                tertiaryDataArray[tertiaryDataSize++].set(c, 1, tertiaryData);
-            } else {
-                if (blockID == blockDataArray[blockDataSize - 1].data) {
-                    ++blockDataArray[blockDataSize - 1].length;
-                } else {
-                    blockDataArray[blockDataSize++].set(c, 1, blockID);
-                }
-                if (tertiaryData == tertiaryDataArray[tertiaryDataSize - 1].data) {
-                    ++tertiaryDataArray[tertiaryDataSize - 1].length;
-                } else {
-                    tertiaryDataArray[tertiaryDataSize++].set(c, 1, tertiaryData);
-                }
-            }
+    // Runs of each column, bottom to top
+    ColumnRun columnRuns[CHUNK_LAYER][MAX_COLUMN_RUNS];
+    ui8 numColumnRuns[CHUNK_LAYER];
+    // Bit y is set when some column changes block at y
+    ui32 changeMask = 0;
+    size_t floraStart = chunk->floraToGenerate.size();
+
+    for (int c = 0; c < CHUNK_LAYER; c++) {
+        ColumnRun* runs = columnRuns[c];
+        ui8& numRuns = numColumnRuns[c];
+        numRuns = 0;
+        getColumnRuns(chunk, c, chunkY, heightData[c], runs, numRuns);
+        for (int i = 0; i < numRuns; i++) {
+            if (runs[i].blockID != 0) chunk->numBlocks += runs[i].yEnd - runs[i].yStart;
+            if (i > 0) changeMask |= 1u << runs[i].yStart;
         }
     }
-
-    // Early exit optimization for solid air chunks
-    if (allAir && blockDataSize == 1 && tertiaryDataSize == 1) {
-        // Set up interval trees
-        blockDataArray[0].length = CHUNK_SIZE;
-        tertiaryDataArray[0].length = CHUNK_SIZE;
-        chunk->blocks.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, blockDataArray, blockDataSize);
-        chunk->tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, tertiaryDataArray, tertiaryDataSize);
-        return;
+    // Flora was found column by column, but is expected in block index order
+    std::sort(chunk->floraToGenerate.begin() + floraStart, chunk->floraToGenerate.end());
+
+    // Tertiary data is all zeroes for now
+    IntervalTree<ui16>::LNode tertiaryNode;
+    tertiaryNode.set(0, CHUNK_SIZE, 0);
+    chunk->tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &tertiaryNode, 1);
+
+    // Early exit for solid, liquid and air chunks
+    if (changeMask == 0) {
+        bool isUniform = true;
+        for (int c = 1; c < CHUNK_LAYER && isUniform; c++) {
+            isUniform = columnRuns[c][0].blockID == columnRuns[0][0].blockID;
+        }
+        if (isUniform) {
+            IntervalTree<ui16>::LNode node;
+            node.set(0, CHUNK_SIZE, columnRuns[0][0].blockID);
+            chunk->blocks.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, &node, 1);
+            return;
+        }
     }
 
-    // All the rest of the layers.
-    for (size_t y = 1; y < CHUNK_WIDTH; ++y) {
-        for (size_t z = 0; z < CHUNK_WIDTH; ++z) {
-            for (size_t x = 0; x < CHUNK_WIDTH; ++x, ++c) {
-                tertiaryData = 0;
-                hIndex = (c & 0x3FF); // Same as % CHUNK_LAYER
-
-                mapHeight = heightData[hIndex].height;
-                temperature = heightData[hIndex].temperature;
-                rainfall = heightData[hIndex].humidity;
-
-                // TODO(Ben): Fastfloor?
-                height = (int)(y + voxPosition.pos.y);
-                depth = mapHeight - height; // Get depth of voxel
-
-                // Check for going up one layer
-                ui16 layerIndex = layerIndices[hIndex];
-                if (blockLayers[layerIndex].start > (ui32)depth && layerIndex > 0) layerIndex--;
-                // Get the block ID
-                BlockLayer& layer = blockLayers[layerIndex];
-                blockID = getBlockID(chunk, c, depth, mapHeight, height, heightData[hIndex], layer);
-
-                //if (tooSteep) dh += 3; // If steep, increase depth
-
-                // TODO: Modulate dh with noise
-
-                // TODO(Ben): Check for underground
-                
-                if (blockID != 0) ++chunk->numBlocks;
-
-                // Add to the data arrays
-                if (blockID == blockDataArray[blockDataSize - 1].data) {
-                    ++blockDataArray[blockDataSize - 1].length;
-                } else {
-                    blockDataArray[blockDataSize++].set(c, 1, blockID);
-                }
-                if (tertiaryData == tertiaryDataArray[tertiaryDataSize - 1].data) {
-                    ++tertiaryDataArray[tertiaryDataSize - 1].length;
+    // Voxels are stored y major, so walk the columns one layer at a time.
+    // Layers where no column changes block repeat the runs of the layer below.
+    IntervalTree<ui16>::LNode blockDataArray[CHUNK_SIZE];
+    size_t blockDataSize = 0;
+    IntervalTree<ui16>::LNode layerRuns[CHUNK_LAYER];
+    size_t numLayerRuns = 0;
+    ui8 cursors[CHUNK_LAYER] = {};
+    for (int y = 0; y < CHUNK_WIDTH; y++) {
+        if (y == 0 || (changeMask & (1u << y))) {
+            numLayerRuns = 0;
+            for (int c = 0; c < CHUNK_LAYER; c++) {
+                ui8& cursor = cursors[c];
+                while (columnRuns[c][cursor].yEnd <= y) cursor++;
+                ui16 blockID = columnRuns[c][cursor].blockID;
+                if (numLayerRuns && layerRuns[numLayerRuns - 1].data == blockID) {
+                    layerRuns[numLayerRuns - 1].length++;
                 } else {
-                    tertiaryDataArray[tertiaryDataSize++].set(c, 1, tertiaryData);
+                    layerRuns[numLayerRuns++].set(c, 1, blockID);
                 }
             }
         }
+        const ui16 layerStart = (ui16)(y * CHUNK_LAYER);
+        for (size_t i = 0; i < numLayerRuns; i++) {
+            const IntervalTree<ui16>::LNode& run = layerRuns[i];
+            if (blockDataSize && blockDataArray[blockDataSize - 1].data == run.data) {
+                blockDataArray[blockDataSize - 1].length += run.length;
+            } else {
+                blockDataArray[blockDataSize++].set(layerStart + run.start, run.length, run.data);
+            }
+        }
     }
-    // Set up interval trees
     chunk->blocks.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, blockDataArray, blockDataSize);
-    chunk->tertiary.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, tertiaryDataArray, tertiaryDataSize);
 }
 
 void ProceduralChunkGenerator::generateHeightmap(Chunk* chunk, PlanetHeightData* heightData) const {
+    const ChunkPosition2D& gridPosition = chunk->gridData->gridPosition;
+    if (getCachedHeightmap(gridPosition, heightData)) return;
+
     VoxelPosition3D cornerPos3D = chunk->getVoxelPosition();
     VoxelPosition2D cornerPos2D;
     cornerPos2D.pos.x = cornerPos3D.pos.x;
     cornerPos2D.pos.y = cornerPos3D.pos.z;
     cornerPos2D.face = cornerPos3D.face;
 
+    VoxelPosition2D positions[CHUNK_LAYER];
     for (int z = 0; z < CHUNK_WIDTH; z++) {
         for (int x = 0; x < CHUNK_WIDTH; x++) {
-            VoxelPosition2D pos = cornerPos2D;
+            VoxelPosition2D& pos = positions[z * CHUNK_WIDTH + x];
+            pos = cornerPos2D;
             pos.pos.x += x;
             pos.pos.y += z;
-            m_heightGenerator.generateHeightData(heightData[z * CHUNK_WIDTH + x], pos);
         }
     }
+    // The whole column at once so the noise runs in batches
+    m_heightGenerator.generateHeightData(heightData, positions, CHUNK_LAYER);
+    m_genData->heightmapCache.put(HeightmapCache::getChunkKey(gridPosition), heightData);
+}
+
+bool ProceduralChunkGenerator::getCachedHeightmap(const ChunkPosition2D& gridPosition, OUT PlanetHeightData* heightData) const {
+    return m_genData->heightmapCache.get(HeightmapCache::getChunkKey(gridPosition), heightData) != 0;
 }
 
 // Gets layer in O(log(n)) where n is the number of layers
@@ -188,24 +144,55 @@ ui32 ProceduralChunkGenerator::getBlockLayerIndex(ui32 depth) const {
     return layers.size() - 1;
 }
 
-// TODO(Ben): Too many parameters?
-ui16 ProceduralChunkGenerator::getBlockID(Chunk* chunk, int blockIndex, int depth, int mapHeight, int height, const PlanetHeightData& hd, BlockLayer& layer) const {
-    ui16 blockID = 0;
-    if (depth > 0) {
-        blockID = layer.block;
-    } else if (depth < 0) {
-        // Liquid
-        if (height < 0 && m_genData->liquidBlock) {
-            blockID = m_genData->liquidBlock;
-        } else if (depth == -1) {
-            if (hd.flora != FLORA_ID_NONE) {
-                // We can determine the flora from the heightData during gen.
-                // Only need to store index.
-                chunk->floraToGenerate.push_back(blockIndex);            
-            }
-        }
+void ProceduralChunkGenerator::getColumnRuns(Chunk* chunk, int column, int chunkY, const PlanetHeightData& hd,
+                                             OUT ColumnRun* runs, OUT ui8& numRuns) const {
+    const std::vector<BlockLayer>& blockLayers = m_genData->blockLayers;
+    // Depth of the surface relative to the bottom of the chunk. Depth of voxel y is surfaceY - y.
+    const int surfaceY = (int)hd.height - chunkY;
+
+    // The layer is picked at the bottom of the chunk. Voxels shallower than its
+    // start use the layer above, no further.
+    ui32 layerIndex = (surfaceY >= 0) ? getBlockLayerIndex(surfaceY) : 0;
+    const BlockLayer& layer = blockLayers[layerIndex];
+    const BlockLayer& upperLayer = blockLayers[layerIndex > 0 ? layerIndex - 1 : 0];
+    // First y whose depth is less than the layer start
+    const int upperLayerY = (layerIndex > 0) ? surfaceY - (int)layer.start + 1 : surfaceY;
+
+    // Underground
+    addColumnRun(runs, numRuns, layer.block, 0, std::min(upperLayerY, surfaceY));
+    addColumnRun(runs, numRuns, upperLayer.block, upperLayerY, surfaceY);
+    // Surface
+    const BlockLayer& surfaceLayer = (layerIndex > 0 && layer.start > 0) ? upperLayer : layer;
+    addColumnRun(runs, numRuns, surfaceLayer.surfaceTransform, surfaceY, surfaceY + 1);
+    // Liquid below sea level, air above
+    const int seaLevelY = -chunkY;
+    if (m_genData->liquidBlock) {
+        addColumnRun(runs, numRuns, m_genData->liquidBlock, surfaceY + 1, seaLevelY);
+        addColumnRun(runs, numRuns, 0, std::max(surfaceY + 1, seaLevelY), CHUNK_WIDTH);
+    } else {
+        addColumnRun(runs, numRuns, 0, surfaceY + 1, CHUNK_WIDTH);
+    }
+
+    // Flora goes on the air just above the surface
+    const int floraY = surfaceY + 1;
+    if (hd.flora != FLORA_ID_NONE && floraY >= 0 && floraY < CHUNK_WIDTH &&
+        !(m_genData->liquidBlock && floraY < seaLevelY)) {
+        // We can determine the flora from the heightData during gen.
+        // Only need to store index.
+        chunk->floraToGenerate.push_back((ui16)(floraY * CHUNK_LAYER + column));
+    }
+}
+
+void ProceduralChunkGenerator::addColumnRun(OUT ColumnRun* runs, OUT ui8& numRuns, ui16 blockID, int yStart, int yEnd) {
+    yStart = std::max(yStart, 0);
+    yEnd = std::min(yEnd, CHUNK_WIDTH);
+    if (yStart >= yEnd) return;
+    if (numRuns && runs[numRuns - 1].blockID == blockID) {
+        runs[numRuns - 1].yEnd = (ui8)yEnd;
     } else {
-        blockID = layer.surfaceTransform;
+        ColumnRun& run = runs[numRuns++];
+        run.blockID = blockID;
+        run.yStart = (ui8)yStart;
+        run.yEnd = (ui8)yEnd;
     }
-    return blockID;
 }
@@ -27,9 +27,26 @@ class ProceduralChunkGenerator {
     void init(PlanetGenData* genData);
     void generateChunk(Chunk* chunk, PlanetHeightData* heightData) const;
     void generateHeightmap(Chunk* chunk, PlanetHeightData* heightData) const;
+    /// Copies a chunk column heightmap out of the planet's heightmap cache
+    /// @return false if it isn't cached
+    bool getCachedHeightmap(const ChunkPosition2D& gridPosition, OUT PlanetHeightData* heightData) const;
 private:
+    /// Blocks of a column from y to yEnd - 1, in chunk space
+    struct ColumnRun {
+        ui16 blockID;
+        ui8 yStart;
+        ui8 yEnd;
+    };
+    /// Underground, upper layer, surface, liquid and air
+    static const int MAX_COLUMN_RUNS = 5;
+
     ui32 getBlockLayerIndex(ui32 depth) const;
-    ui16 getBlockID(Chunk* chunk, int blockIndex, int depth, int mapHeight, int height, const PlanetHeightData& hd, BlockLayer& layer) const;
+    /// Gets the runs of blocks of a column from its height data, bottom to top.
+    /// Also queues the column's flora on chunk.
+    void getColumnRuns(Chunk* chunk, int column, int chunkY, const PlanetHeightData& hd,
+                       OUT ColumnRun* runs, OUT ui8& numRuns) const;
+    /// Appends the part of a run inside the chunk, merging it with the last run
+    static void addColumnRun(OUT ColumnRun* runs, OUT ui8& numRuns, ui16 blockID, int yStart, int yEnd);
 
     PlanetGenData* m_genData = nullptr;
     SphericalHeightmapGenerator m_heightGenerator;
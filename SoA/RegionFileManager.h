@@ -1,9 +1,11 @@
 #pragma once
 #include <deque>
 #include <map>
+#include <mutex>
 
 #include <ZLIB/zconf.h>
 #include <Vorb/Vorb.h>
+#include <Vorb/Voxel/IntervalTree.h>
 
 #include "Constants.h"
 #include "VoxelCoordinateSpaces.h"
@@ -20,13 +22,29 @@
 #define REGION_SIZE 4096
 
 #define REGION_VER_0 1000
+#define REGION_VER_1 1001 //Adds the chunk codec to the version file
 
-#define CURRENT_REGION_VER REGION_VER_0
+#define CURRENT_REGION_VER REGION_VER_1
 
 #define CHUNK_DATA_SIZE (CHUNK_SIZE * 4) //right now a voxel is 4 bytes
 
+//ChunkHeader::compression is a layout flag in the low bits and a ChunkCodec ID in the rest
+#define COMPRESSION_LAYOUT_MASK 0xF
+#define COMPRESSION_CODEC_MASK 0xFFFFFFF0
+
+//Layouts
 #define COMPRESSION_RLE 0x1
+
+//Codecs
+#define COMPRESSION_NONE 0x0
 #define COMPRESSION_ZLIB 0x10
+#define COMPRESSION_LZ4 0x20
+#define COMPRESSION_ZLIB_MAX 0x40
+
+//Worst case RLE size, a tag plus one run per voxel in each of the four arrays
+#define CHUNK_RLE_MAX_SIZE (4 + CHUNK_SIZE * 15)
+//Worst case codec output for CHUNK_RLE_MAX_SIZE bytes, plus the chunk header
+#define CHUNK_COMPRESSED_MAX_SIZE (CHUNK_RLE_MAX_SIZE + CHUNK_RLE_MAX_SIZE / 255 + 64 + sizeof(ChunkHeader))
 
 //All data is stored in byte arrays so we can force it to be saved in big-endian
 class ChunkHeader {
@@ -41,24 +59,42 @@ class RegionFileHeader {
     ui8 lookupTable[REGION_SIZE * 4];
 };
 
-class RegionFile {
-public:
-    RegionFileHeader header;
-    nString region;
-    FILE* file;
-    int fileDescriptor;
-    i32 totalSectors;
-    bool isHeaderDirty;
+inline ui32 sectorsFromBytes(ui32 bytes) {
+    return (bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+/// Scratch space for loading or saving one chunk. Each I/O worker owns one
+/// so that any number of chunks can be in flight. Too big for the stack.
+struct RegionIOBuffers {
+    ui8 chunkBuffer[CHUNK_RLE_MAX_SIZE]; ///< Uncompressed chunk data
+    uLongf chunkBufferSize;
+    ui8 compressedBuffer[CHUNK_COMPRESSED_MAX_SIZE]; ///< ChunkHeader followed by the compressed data
+    uLongf compressedBufferSize;
+
+    //Runs read back from chunkBuffer
+    IntervalTree<ui16>::LNode blockNodes[CHUNK_SIZE];
+    IntervalTree<ui16>::LNode lampNodes[CHUNK_SIZE];
+    IntervalTree<ui8>::LNode sunlightNodes[CHUNK_SIZE];
+    IntervalTree<ui16>::LNode tertiaryNodes[CHUNK_SIZE];
+    size_t numBlockNodes;
+    size_t numLampNodes;
+    size_t numSunlightNodes;
+    size_t numTertiaryNodes;
 };
 
 class SaveVersion {
 public:
     ui8 regionVersion[4];
     ui8 chunkVersion[4];
+    ui8 chunkCodec[4]; //Since REGION_VER_1
 };
 
 class Chunk;
+class MappedRegionFile;
+struct ChunkCodec;
 
+/// Loads and saves chunks in memory mapped region files.
+/// All public functions are thread safe.
 class RegionFileManager {
 public:
     RegionFileManager(const nString& saveDir);
@@ -66,69 +102,59 @@ class RegionFileManager {
 
     void clear();
 
-    bool openRegionFile(nString region, const ChunkPosition3D& gridPosition, bool create);
-
-    bool tryLoadChunk(Chunk* chunk);
-    bool saveChunk(Chunk* chunk);
+    /// Attempt to load a chunk. Sets genLevel to GEN_DONE on success.
+    /// @return false if the chunk isn't saved or the data is corrupt
+    bool tryLoadChunk(Chunk* chunk, RegionIOBuffers& buffers);
+    bool saveChunk(Chunk* chunk, RegionIOBuffers& buffers);
+
+    /// Writes the chunk's voxel data into chunkBuffer, uncompressed
+    bool serializeChunk(Chunk* chunk, RegionIOBuffers& buffers);
+    /// Fills the chunk from the data in chunkBuffer. Sets genLevel to GEN_DONE on success.
+    bool deserializeChunk(Chunk* chunk, RegionIOBuffers& buffers);
+    /// Compresses chunkBuffer into compressedBuffer with the save's codec and fills in the header
+    bool compressChunk(RegionIOBuffers& buffers);
+    /// Writes a compressed chunk, ChunkHeader included, to its region file
+    bool writeChunk(const ChunkPosition3D& gridPos, const ui8* data, ui32 size);
+    /// Opens the chunk's region and pages its sectors in, ahead of a load
+    /// @return false if the chunk isn't saved
+    bool prefetchChunk(const ChunkPosition3D& gridPos);
+    /// @return Name of the region file the chunk is saved in
+    nString getRegionString(const ChunkPosition3D& gridPos);
 
     void flush();
 
+    /// Picks the codec new chunk data is compressed with, and saves it in the version file
+    /// @return false if there is no codec with that name, or the version file can't be written
+    bool setChunkCodec(const nString& name);
+    const ChunkCodec* getChunkCodec() const { return m_codec; }
+
     bool saveVersionFile();
-    bool checkVersion();
+    /// Reads the save's codec and converts older saves. New saves get a
+    /// version file with newSaveCodec.
+    /// @param newSaveCodec: Codec name for a new save. Empty keeps the current codec.
+    bool checkVersion(const nString& newSaveCodec = "");
 private:
-    void closeRegionFile(RegionFile* regionFile);
-
-    bool readChunkHeader();
-    bool readChunkData_v0();
-
-    int rleUncompressArray(ui8* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    int rleUncompressArray(ui16* data, ui32& byteIndex, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    bool fillChunkVoxelData(Chunk* chunk);
+    /// Gets an open region file from the cache, opening it if needed.
+    /// Release it with releaseRegionFile.
+    MappedRegionFile* acquireRegionFile(const nString& region, bool create);
+    void releaseRegionFile(MappedRegionFile* regionFile);
 
-    bool saveRegionHeader();
-    bool loadRegionHeader();
+    /// Decompresses the chunk in compressedBuffer into chunkBuffer with the codec in its header
+    bool decompressChunk(RegionIOBuffers& buffers);
 
-    void rleCompressArray(ui8* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    void rleCompressArray(ui16* data, int jStart, int jMult, int jEnd, int jInc, int kStart, int kMult, int kEnd, int kInc);
-    bool rleCompressChunk(Chunk* chunk);
-    bool zlibCompress();
+    bool fillChunkVoxelData(Chunk* chunk, ui32& byteIndex, RegionIOBuffers& buffers);
 
     bool tryConvertSave(ui32 regionVersion);
+    /// Recompresses every saved chunk that doesn't use m_codec
+    bool recompressRegions();
+
+    ui32 getTableOffset(const ChunkPosition3D& gridPos);
 
-    bool writeSectors(ui8* srcBuffer, ui32 size);
-    bool readSectors(ui8* dstBuffer, ui32 size);
-
-    bool seek(ui32 byteOffset);
-    bool seekToChunk(ui32 chunkSectorOffset);
-
-    ui32 getChunkSectorOffset(Chunk* chunk, ui32* retTableOffset = nullptr);
-    nString getRegionString(Chunk* chunk);
-    
-    //Byte buffer for reading chunk data
-    ui32 _bufferSize;
-    ui8 _chunkBuffer[CHUNK_DATA_SIZE];
-    //Byte buffer for compressed data. It is slightly larger because of worst case with RLE
-    uLongf _compressedBufferSize;
-    ui8 _compressedByteBuffer[CHUNK_DATA_SIZE + CHUNK_SIZE * 4 + sizeof(ChunkHeader)];
-    //Dynamic byte buffer used in copying contents of a file for resize
-    ui32 _copySectorsBufferSize;
-    ui8* _copySectorsBuffer;
-
-    ui16 _blockIDBuffer[CHUNK_SIZE];
-    ui8 _sunlightBuffer[CHUNK_SIZE];
-    ui16 _lampLightBuffer[CHUNK_SIZE];
-    ui16 _tertiaryDataBuffer[CHUNK_SIZE];
-
-    ui8 _chunkHeaderBuffer[sizeof(ChunkHeader)];
-    ui8 _regionFileHeaderBuffer[sizeof(RegionFileHeader)];
-    
     ui32 _maxCacheSize;
-    ui32 _chunkOffset; ///< Offset into the chunk data
-    uLongf _chunkBufferSize;
-    std::map <nString, RegionFile*> _regionFileCache;
-    std::deque <RegionFile*> _regionFileCacheQueue;
+    std::map <nString, MappedRegionFile*> _regionFileCache;
+    std::deque <MappedRegionFile*> _regionFileCacheQueue; ///< Least recently used first
+    std::mutex m_cacheMutex;
 
+    const ChunkCodec* m_codec;
     nString m_saveDir;
-    RegionFile* _regionFile;
-    ChunkHeader _chunkHeader;
-};
\ No newline at end of file
+};
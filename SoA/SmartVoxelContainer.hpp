@@ -18,12 +18,16 @@
 #include <mutex>
 
 #include "Constants.h"
+#include "PaletteVoxelArray.hpp"
+#include "VoxelRunKernels.h"
 
 #include <Vorb/FixedSizeArrayRecycler.hpp>
 #include <Vorb/Voxel/IntervalTree.h>
 
 #define QUIET_FRAMES_UNTIL_COMPRESS 60
 #define ACCESS_COUNT_UNTIL_DECOMPRESS 5
+#define INTERVAL_TREE_MAX_RUNS 64 ///< Compressed data with more runs than this goes in a palette if it fits
+#define PALETTE_MAX_BUSY_SIZE 16 ///< Busy palettes with more distinct values than this are expanded to a flat array
 
 // TODO(Cristian): We'll see how to fit it into Vorb
 namespace vorb {
@@ -68,7 +72,8 @@ namespace vorb {
 
         enum class VoxelStorageState {
             FLAT_ARRAY = 0,
-            INTERVAL_TREE = 1
+            INTERVAL_TREE = 1,
+            PALETTE = 2
         };
 
         template <typename T, size_t SIZE = CHUNK_SIZE>
@@ -107,6 +112,11 @@ namespace vorb {
                 _state = state;
                 if (_state == VoxelStorageState::FLAT_ARRAY) {
                     _dataArray = _arrayRecycler->create();
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    // Start out as a single value palette of T()
+                    typename IntervalTree<T>::LNode node;
+                    node.set(0, SIZE, T());
+                    _dataPalette.initFromSortedArray(&node, 1);
                 }
             }
 
@@ -119,16 +129,18 @@ namespace vorb {
                 _state = state;
                 _accessCount = 0;
                 _quietFrames = 0;
+                if (_state == VoxelStorageState::PALETTE) {
+                    if (_dataPalette.initFromSortedArray(&data[0], data.size())) return;
+                    // Too many distinct values for a palette
+                    _state = VoxelStorageState::INTERVAL_TREE;
+                }
                 if (_state == VoxelStorageState::INTERVAL_TREE) {
                     _dataTree.initFromSortedArray(data);
                     _dataTree.checkTreeValidity();
                 } else {
                     _dataArray = _arrayRecycler->create();
-                    int index = 0;
                     for (size_t i = 0; i < data.size(); i++) {
-                        for (int j = 0; j < data[i].length; j++) {
-                            _dataArray[index++] = data[i].data;
-                        }
+                        fillRun(_dataArray + data[i].start, data[i].length, data[i].data);
                     }
                 }
             }
@@ -137,26 +149,28 @@ namespace vorb {
                 _state = state;
                 _accessCount = 0;
                 _quietFrames = 0;
+                if (_state == VoxelStorageState::PALETTE) {
+                    if (_dataPalette.initFromSortedArray(data, size)) return;
+                    // Too many distinct values for a palette
+                    _state = VoxelStorageState::INTERVAL_TREE;
+                }
                 if (_state == VoxelStorageState::INTERVAL_TREE) {
                     _dataTree.initFromSortedArray(data, size);
                     _dataTree.checkTreeValidity();
                 } else {
                     _dataArray = _arrayRecycler->create();
-                    int index = 0;
                     for (size_t i = 0; i < size; i++) {
-                        for (int j = 0; j < data[i].length; j++) {
-                            _dataArray[index++] = data[i].data;
-                        }
+                        fillRun(_dataArray + data[i].start, data[i].length, data[i].data);
                     }
                 }
             }
 
             inline void changeState(VoxelStorageState newState, std::mutex& dataLock) {
                 if (newState == _state) return;
-                if (newState == VoxelStorageState::INTERVAL_TREE) {
-                    compress(dataLock);
-                } else {
+                if (newState == VoxelStorageState::FLAT_ARRAY) {
                     uncompress(dataLock);
+                } else {
+                    compress(dataLock, newState);
                 }
                 _quietFrames = 0;
                 _accessCount = 0;
@@ -173,11 +187,20 @@ namespace vorb {
                 }
 
                 if (_state == VoxelStorageState::INTERVAL_TREE) {
-                    // Check if we should uncompress the data
+                    // Check if we should uncompress the data. Prefer a small palette since
+                    // it has O(1) access without allocating a full array.
                     if (_quietFrames == 0) {
+                        if (!treeToPalette(dataLock)) {
+                            uncompress(dataLock);
+                        }
+                    }
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    // Wide palettes pay for bit unpacking and palette growth on every
+                    // access, so busy ones become flat arrays
+                    if (_quietFrames == 0 && _dataPalette.getPalette().size() > PALETTE_MAX_BUSY_SIZE) {
                         uncompress(dataLock);
                     }
-                } else {
+                } else if (_state == VoxelStorageState::FLAT_ARRAY) {
                     // Check if we should compress the data
                     if (_quietFrames >= QUIET_FRAMES_UNTIL_COMPRESS && totalContainerCompressions <= MAX_COMPRESSIONS_PER_FRAME) {
                         compress(dataLock);
@@ -192,17 +215,90 @@ namespace vorb {
                 _quietFrames = 0;
                 if (_state == VoxelStorageState::INTERVAL_TREE) {
                     _dataTree.clear();
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    _dataPalette.clear();
                 } else if (_dataArray) {
                     _arrayRecycler->recycle(_dataArray);
                     _dataArray = nullptr;
                 }
             }
 
-            /// Uncompressed the interval tree into a buffer.
-            /// May only be called when getState() == VoxelStorageState::INTERVAL_TREE
-            /// or you will get a null access violation.
+            /// Uncompressed the data into a buffer.
+            /// Works in any state, flat data is copied.
             /// @param buffer: Buffer of memory to store the result
-            inline void uncompressIntoBuffer(T* buffer) { _dataTree.uncompressIntoBuffer(buffer); }
+            inline void uncompressIntoBuffer(T* buffer) const {
+                copyRange(0, SIZE, buffer);
+            }
+
+            /************************************************************************/
+            /* Bulk access. These skip the per voxel getter/setter tables.          */
+            /************************************************************************/
+            /// Copies count elements starting at begin into out
+            inline void copyRange(size_t begin, size_t count, T* out) const {
+                switch (_state) {
+                    case VoxelStorageState::INTERVAL_TREE:
+                        if (count * 16 < _dataTree.size()) {
+                            // Short range in a big tree, lookups are cheaper than a node scan
+                            for (size_t i = 0; i < count; i++) {
+                                out[i] = _dataTree.getData(begin + i);
+                            }
+                        } else {
+                            // Order doesn't matter here so skip the sort in forEachTreeRun
+                            const size_t end = begin + count;
+                            for (size_t i = 0; i < _dataTree.size(); i++) {
+                                const auto& node = _dataTree[i];
+                                size_t start = std::max((size_t)node.getStart(), begin);
+                                size_t nodeEnd = std::min((size_t)node.getStart() + node.length, end);
+                                if (start < nodeEnd) fillRun(out + (start - begin), nodeEnd - start, node.data);
+                            }
+                        }
+                        break;
+                    case VoxelStorageState::PALETTE:
+                        _dataPalette.copyRange(begin, count, out); break;
+                    default:
+                        memcpy(out, _dataArray + begin, count * sizeof(T)); break;
+                }
+            }
+            /// Sets count elements starting at begin to value
+            inline void fillRange(size_t begin, size_t count, T value) {
+                if (count == 0) return;
+                _accessCount++;
+                switch (_state) {
+                    case VoxelStorageState::INTERVAL_TREE:
+                        fillTreeRange(begin, count, value); break;
+                    case VoxelStorageState::PALETTE:
+                        if (!_dataPalette.fill(begin, count, value)) {
+                            // Palette is full. Caller already holds the data lock, so expand in place.
+                            paletteToFlat();
+                            fillRun(_dataArray + begin, count, value);
+                        }
+                        break;
+                    default:
+                        fillRun(_dataArray + begin, count, value); break;
+                }
+            }
+            /// Calls f(start, length, value) for each run of equal values in
+            /// [begin, begin + count), clipped to the range and in index order.
+            template <typename F>
+            inline void forEachRun(size_t begin, size_t count, F f) const {
+                if (count == 0) return;
+                switch (_state) {
+                    case VoxelStorageState::INTERVAL_TREE:
+                        forEachTreeRun(begin, count, f); break;
+                    case VoxelStorageState::PALETTE:
+                        _dataPalette.forEachRun(begin, count, f); break;
+                    default: {
+                        const size_t end = begin + count;
+                        size_t i = begin;
+                        while (i < end) {
+                            size_t runEnd = findRunEnd(_dataArray, i, end);
+                            f(i, runEnd - i, _dataArray[i]);
+                            i = runEnd;
+                        }
+                        break;
+                    }
+                }
+            }
 
             /// Getters
             const VoxelStorageState& getState() const {
@@ -220,6 +316,9 @@ namespace vorb {
             const IntervalTree<T>& getTree() const {
                 return _dataTree;
             }
+            const PaletteVoxelArray<T, SIZE>& getPaletteArray() const {
+                return _dataPalette;
+            }
 
             /// Gets the element at index
             /// @param index: must be (0, SIZE]
@@ -250,9 +349,80 @@ namespace vorb {
             static void setFlat(SmartVoxelContainer* container, size_t index, T data) {
                 container->_dataArray[index] = data;
             }
+            static const T& getPalette(const SmartVoxelContainer* container, size_t index) {
+                return container->_dataPalette.get(index);
+            }
+            static void setPalette(SmartVoxelContainer* container, size_t index, T data) {
+                if (!container->_dataPalette.set(index, data)) {
+                    // Palette is full. Caller already holds the data lock, so expand in place.
+                    container->paletteToFlat();
+                    container->_dataArray[index] = data;
+                }
+            }
 
-            static Getter getters[2];
-            static Setter setters[2];
+            static Getter getters[3];
+            static Setter setters[3];
+
+            /// Picks the compressed representation for data with numRuns runs.
+            /// Data with few runs stays in the tree since it is tiny and the walk is short.
+            /// Everything else goes in a palette to keep random access O(1). The palette
+            /// falls back to the tree when there are too many distinct values.
+            static VoxelStorageState choosePackedState(size_t numRuns) {
+                if (numRuns <= INTERVAL_TREE_MAX_RUNS) return VoxelStorageState::INTERVAL_TREE;
+                return VoxelStorageState::PALETTE;
+            }
+
+            /// Expands the palette into a flat array without locking
+            inline void paletteToFlat() {
+                _dataArray = _arrayRecycler->create();
+                _dataPalette.uncompressIntoBuffer(_dataArray);
+                _dataPalette.clear();
+                _state = VoxelStorageState::FLAT_ARRAY;
+            }
+            /// Calls f(start, length, value) for each tree node overlapping
+            /// [begin, begin + count), clipped to the range and in index order.
+            template <typename F>
+            inline void forEachTreeRun(size_t begin, size_t count, F f) const {
+                const size_t end = begin + count;
+                // Nodes are stored in insertion order, so sort them by start if needed
+                std::vector<ui16> order;
+                order.reserve(_dataTree.size());
+                bool isSorted = true;
+                for (size_t i = 0; i < _dataTree.size(); i++) {
+                    if (!order.empty() && _dataTree[i].getStart() < _dataTree[order.back()].getStart()) isSorted = false;
+                    order.push_back((ui16)i);
+                }
+                if (!isSorted) {
+                    const IntervalTree<T>& tree = _dataTree;
+                    std::sort(order.begin(), order.end(), [&](ui16 a, ui16 b) {
+                        return tree[a].getStart() < tree[b].getStart();
+                    });
+                }
+                for (size_t i = 0; i < order.size(); i++) {
+                    const auto& node = _dataTree[order[i]];
+                    size_t start = std::max((size_t)node.getStart(), begin);
+                    size_t nodeEnd = std::min((size_t)node.getStart() + node.length, end);
+                    if (start < nodeEnd) f(start, nodeEnd - start, node.data);
+                }
+            }
+            /// Rebuilds the tree with [begin, begin + count) set to value
+            inline void fillTreeRange(size_t begin, size_t count, T value) {
+                const size_t end = begin + count;
+                std::vector<typename IntervalTree<T>::LNode> runs;
+                runs.reserve(_dataTree.size() + 2);
+                auto addRun = [&](size_t start, size_t length, const T& data) {
+                    if (!runs.empty() && runs.back().data == data) {
+                        runs.back().length += (ui16)length;
+                    } else {
+                        runs.emplace_back((ui16)start, (ui16)length, data);
+                    }
+                };
+                forEachTreeRun(0, begin, addRun);
+                addRun(begin, count, value);
+                forEachTreeRun(end, SIZE - end, addRun);
+                _dataTree.clear();
+                _dataTree.initFromSortedArray(runs);
+            }
 
             inline void uncompress(std::mutex& dataLock) {
                 dataLock.lock();
@@ -260,40 +430,65 @@ namespace vorb {
                 uncompressIntoBuffer(_dataArray);
                 // Free memory
                 _dataTree.clear();
+                _dataPalette.clear();
                 // Set the new state
                 _state = VoxelStorageState::FLAT_ARRAY;
                 dataLock.unlock();
             }
-            inline void compress(std::mutex& dataLock) {
+            /// Compresses the data into newState. When newState is FLAT_ARRAY the
+            /// representation is picked by choosePackedState.
+            inline void compress(std::mutex& dataLock, VoxelStorageState newState = VoxelStorageState::FLAT_ARRAY) {
                 dataLock.lock();
+                // Switching between compressed states goes through a temporary flat copy
+                T* flatData = _dataArray;
+                if (_state != VoxelStorageState::FLAT_ARRAY) {
+                    flatData = _arrayRecycler->create();
+                    uncompressIntoBuffer(flatData);
+                }
                 // Sorted array for creating the interval tree
                 // Using stack array to avoid allocations, beware stack overflow
-                IntervalTree<T>::LNode data[CHUNK_SIZE];
-                int index = 0;
-                data[0].set(0, 1, _dataArray[0]);
-                // Set the data
-                for (int i = 1; i < CHUNK_SIZE; ++i) {
-                    if (_dataArray[i] == data[index].data) {
-                        ++(data[index].length);
-                    } else {
-                        data[++index].set(i, 1, _dataArray[i]);
-                    }
+                typename IntervalTree<T>::LNode data[CHUNK_SIZE];
+                size_t numRuns = encodeRuns(flatData, CHUNK_SIZE, data);
+                if (newState == VoxelStorageState::FLAT_ARRAY) {
+                    newState = choosePackedState(numRuns);
+                }
+                // Free the old compressed data
+                if (_state == VoxelStorageState::INTERVAL_TREE) {
+                    _dataTree.clear();
+                } else if (_state == VoxelStorageState::PALETTE) {
+                    _dataPalette.clear();
+                }
+                // Create the palette or tree
+                if (newState == VoxelStorageState::PALETTE && !_dataPalette.initFromSortedArray(data, numRuns)) {
+                    newState = VoxelStorageState::INTERVAL_TREE;
+                }
+                if (newState == VoxelStorageState::INTERVAL_TREE) {
+                    _dataTree.initFromSortedArray(data, numRuns);
                 }
                 // Set new state
-                _state = VoxelStorageState::INTERVAL_TREE;
-                // Create the tree
-                _dataTree.initFromSortedArray(data, index + 1);
+                _state = newState;
+                _dataArray = nullptr;
 
                 dataLock.unlock();
 
                 // Recycle memory
-                _arrayRecycler->recycle(_dataArray);
-                _dataArray = nullptr;
+                _arrayRecycler->recycle(flatData);
 
                 totalContainerCompressions++;
             }
+            /// Converts the interval tree to a palette if it has at most
+            /// PALETTE_MAX_BUSY_SIZE distinct values.
+            /// @return true on success
+            inline bool treeToPalette(std::mutex& dataLock) {
+                std::lock_guard<std::mutex> l(dataLock);
+                if (!_dataPalette.initFromTree(_dataTree, PALETTE_MAX_BUSY_SIZE)) return false;
+                _dataTree.clear();
+                _state = VoxelStorageState::PALETTE;
+                return true;
+            }
 
             IntervalTree<T> _dataTree; ///< Interval tree of voxel data
+            PaletteVoxelArray<T, SIZE> _dataPalette; ///< Palette compressed voxel data
 
             T* _dataArray = nullptr; ///< pointer to an array of voxel data
             int _accessCount = 0; ///< Number of times the container was accessed this frame
@@ -324,14 +519,16 @@ namespace vorb {
         }
 
         template<typename T, size_t SIZE>
-        typename SmartVoxelContainer<T, SIZE>::Getter SmartVoxelContainer<T, SIZE>::getters[2] = {
+        typename SmartVoxelContainer<T, SIZE>::Getter SmartVoxelContainer<T, SIZE>::getters[3] = {
             SmartVoxelContainer<T, SIZE>::getFlat,
-            SmartVoxelContainer<T, SIZE>::getInterval
+            SmartVoxelContainer<T, SIZE>::getInterval,
+            SmartVoxelContainer<T, SIZE>::getPalette
         };
         template<typename T, size_t SIZE>
-        typename SmartVoxelContainer<T, SIZE>::Setter SmartVoxelContainer<T, SIZE>::setters[2] = {
+        typename SmartVoxelContainer<T, SIZE>::Setter SmartVoxelContainer<T, SIZE>::setters[3] = {
             SmartVoxelContainer<T, SIZE>::setFlat,
-            SmartVoxelContainer<T, SIZE>::setInterval
+            SmartVoxelContainer<T, SIZE>::setInterval,
+            SmartVoxelContainer<T, SIZE>::setPalette
         };
 
     }
@@ -3,6 +3,7 @@
 
 #include "BlockData.h"
 #include "BlockPack.h"
+#include "ChunkCodec.h"
 #include "ChunkMeshManager.h"
 #include "ChunkUpdater.h"
 #include "DebugRenderer.h"
@@ -42,7 +43,12 @@ void SoaEngine::initOptions(SoaOptions& options) {
     options.addOption(OPT_BORDERLESS, "Borderless Window", OptionValue(false));
     options.addOption(OPT_SCREEN_WIDTH, "Screen Width", OptionValue(1280));
     options.addOption(OPT_SCREEN_HEIGHT, "Screen Height", OptionValue(720));
+    options.addOption(OPT_GREEDY_MESHING, "Greedy Meshing", OptionValue(false));
+    options.addOption(OPT_PACKED_CHUNK_VERTICES, "Packed Chunk Vertices", OptionValue(false));
+    options.addOption(OPT_CHUNK_PREFETCH_HORIZON, "Chunk Prefetch Horizon", OptionValue(2.0f));
     options.addStringOption("Texture Pack", "Default");
+    // Only applies to new saves, existing saves keep the codec in their version file
+    options.addStringOption("Chunk Codec", ChunkCodecs::getDefaultCodec()->name);
 
     SoaEngine::optionsController.setDefault();
 }
@@ -71,6 +71,9 @@ enum DefaultOptions : int {
     OPT_BORDERLESS,
     OPT_SCREEN_WIDTH,
     OPT_SCREEN_HEIGHT,
+    OPT_GREEDY_MESHING,
+    OPT_PACKED_CHUNK_VERTICES,
+    OPT_CHUNK_PREFETCH_HORIZON,
     OPT_NUM_OPTIONS // This should be last
 };
 
@@ -4,8 +4,9 @@
 #include "ChunkGrid.h"
 #include "ChunkIOManager.h"
 #include "ChunkAllocator.h"
-#include "FarTerrainPatch.h"
+#include "TerrainPatchTree.h"
 #include "OrbitComponentUpdater.h"
+#include "SoaOptions.h"
 #include "SoaState.h"
 #include "SpaceSystem.h"
 #include "SphericalTerrainComponentUpdater.h"
@@ -19,6 +20,8 @@
 #include "GameManager.h"
 #include "PlanetGenData.h"
 
+#include <thread>
+
 #define SEC_PER_HOUR 3600.0
 
 Event<SphericalVoxelComponent&, vecs::EntityID> SpaceSystemAssemblages::onAddSphericalVoxelComponent;
@@ -258,17 +261,22 @@ vecs::ComponentID SpaceSystemAssemblages::addSphericalVoxelComponent(SpaceSystem
     svcmp.voxelRadius = ftcmp.sphericalTerrainData->radius * VOXELS_PER_KM;
 
     svcmp.generator = ftcmp.cpuGenerator;
-    svcmp.chunkIo = new ChunkIOManager("TESTSAVEDIR"); // TODO(Ben): Fix
+    svcmp.chunkIo = new ChunkIOManager("TESTSAVEDIR", soaOptions.getStringOption("Chunk Codec").value); // TODO(Ben): Fix
     svcmp.blockPack = &soaState->blocks;
 
     svcmp.threadPool = soaState->threadPool;
 
-    svcmp.chunkIo->beginThread();
+    svcmp.chunkIo->beginThreads();
+
+    // Enough generators that their bookkeeping keeps every core fed
+    ui32 generatorsPerRow = (ui32)sqrt((f64)std::thread::hardware_concurrency() / 2.0);
+    if (generatorsPerRow < 1) generatorsPerRow = 1;
 
     svcmp.chunkGrids = new ChunkGrid[6];
     for (int i = 0; i < 6; i++) {
-        svcmp.chunkGrids[i].init(static_cast<WorldCubeFace>(i), svcmp.threadPool, 1, ftcmp.planetGenData, &soaState->chunkAllocator);
+        svcmp.chunkGrids[i].init(static_cast<WorldCubeFace>(i), svcmp.threadPool, generatorsPerRow, ftcmp.planetGenData, &soaState->chunkAllocator);
         svcmp.chunkGrids[i].blockPack = &soaState->blocks;
+        svcmp.chunkGrids[i].chunkIo = svcmp.chunkIo;
     }
 
     svcmp.planetGenData = ftcmp.planetGenData;
@@ -402,8 +410,8 @@ vecs::ComponentID SpaceSystemAssemblages::addFarTerrainComponent(SpaceSystem* sp
 void SpaceSystemAssemblages::removeFarTerrainComponent(SpaceSystem* spaceSystem, vecs::EntityID entity) {
     auto& ftcmp = spaceSystem->farTerrain.getFromEntity(entity);
 
-    if (ftcmp.patches) delete[] ftcmp.patches;
-    ftcmp.patches = nullptr;
+    delete ftcmp.patchTree;
+    ftcmp.patchTree = nullptr;
     spaceSystem->deleteComponent(SPACE_SYSTEM_CT_FARTERRAIN_NAME, entity);
 }
 
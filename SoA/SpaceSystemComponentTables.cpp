@@ -6,17 +6,21 @@
 
 #include "ChunkAllocator.h"
 #include "ChunkIOManager.h"
-#include "FarTerrainPatch.h"
 #include "ChunkGrid.h"
 #include "PlanetGenData.h"
 #include "SphericalHeightmapGenerator.h"
 #include "TerrainPatch.h"
+#include "TerrainPatchTree.h"
 #include "TerrainPatchMeshManager.h"
 
 void SphericalVoxelComponentTable::disposeComponent(vecs::ComponentID cID, vecs::EntityID eID) {
     SphericalVoxelComponent& cmp = _components[cID].second;
     // Let the threadpool finish
     while (cmp.threadPool->getTasksSizeApprox() > 0);
+    // Chunks that are still loaded won't be freed through the accessor
+    for (int i = 0; i < 6; i++) {
+        cmp.chunkGrids[i].saveEditedChunks();
+    }
     delete cmp.chunkIo;
     delete[] cmp.chunkGrids;
     cmp = _components[0].second;
@@ -24,9 +28,9 @@ void SphericalVoxelComponentTable::disposeComponent(vecs::ComponentID cID, vecs:
 
 void SphericalTerrainComponentTable::disposeComponent(vecs::ComponentID cID, vecs::EntityID eID) {
     SphericalTerrainComponent& cmp = _components[cID].second;
-    if (cmp.patches) {
-        delete[] cmp.patches;
-        cmp.patches = nullptr;
+    if (cmp.patchTrees) {
+        delete[] cmp.patchTrees;
+        cmp.patchTrees = nullptr;
     }
     if (cmp.planetGenData) {
         delete cmp.meshManager;
@@ -38,9 +42,9 @@ void SphericalTerrainComponentTable::disposeComponent(vecs::ComponentID cID, vec
 
 void FarTerrainComponentTable::disposeComponent(vecs::ComponentID cID, vecs::EntityID eID) {
     FarTerrainComponent& cmp = _components[cID].second;  
-    if (cmp.patches) {
-        delete[] cmp.patches;
-        cmp.patches = nullptr;
+    if (cmp.patchTree) {
+        delete cmp.patchTree;
+        cmp.patchTree = nullptr;
     }
 }
 
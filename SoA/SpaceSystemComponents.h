@@ -35,13 +35,13 @@
 class BlockPack;
 class ChunkIOManager;
 class ChunkManager;
-class FarTerrainPatch;
 class PagedChunkAllocator;
 class ParticleEngine;
 class PhysicsEngine;
 class SphericalHeightmapGenerator;
 class SphericalTerrainGpuGenerator;
 class TerrainPatch;
+class TerrainPatchTree;
 class TerrainPatchMeshManager;
 class TerrainRpcDispatcher;
 struct PlanetGenData;
@@ -199,7 +199,7 @@ struct SphericalTerrainComponent {
     vecs::ComponentID sphericalVoxelComponent = 0;
     vecs::ComponentID farTerrainComponent = 0;
 
-    TerrainPatch* patches = nullptr; ///< Buffer for top level patches
+    TerrainPatchTree* patchTrees = nullptr; ///< Patches of each cube face
     TerrainPatchData* sphericalTerrainData = nullptr;
 
     TerrainPatchMeshManager* meshManager = nullptr;
@@ -245,7 +245,7 @@ KEG_TYPE_DECL(StarComponent);
 struct FarTerrainComponent {
     TerrainRpcDispatcher* rpcDispatcher = nullptr;
 
-    FarTerrainPatch* patches = nullptr; ///< Buffer for top level patches
+    TerrainPatchTree* patchTree = nullptr; ///< Patches around the camera
     TerrainPatchData* sphericalTerrainData = nullptr;
 
     TerrainPatchMeshManager* meshManager = nullptr;
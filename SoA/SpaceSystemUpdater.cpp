@@ -9,7 +9,7 @@ void SpaceSystemUpdater::init(const SoaState* soaState) {
     // Set planet rotation
     m_axisRotationComponentUpdater.update(soaState->spaceSystem, soaState->time);
     // Set initial position
-    m_orbitComponentUpdater.update(soaState->spaceSystem, soaState->time);
+    m_orbitComponentUpdater.update(soaState->spaceSystem, soaState->time, soaState->threadPool);
 }
 
 void SpaceSystemUpdater::update(SoaState* soaState, const f64v3& spacePos, const f64v3& voxelPos) {
@@ -32,7 +32,7 @@ void SpaceSystemUpdater::update(SoaState* soaState, const f64v3& spacePos, const
     m_sphericalVoxelComponentUpdater.update(soaState);
 
     // Update Orbits ( Do this last)
-    m_orbitComponentUpdater.update(spaceSystem, soaState->time);
+    m_orbitComponentUpdater.update(spaceSystem, soaState->time, soaState->threadPool);
 }
 
 void SpaceSystemUpdater::glUpdate(const SoaState* soaState) {
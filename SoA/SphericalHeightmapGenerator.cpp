@@ -11,6 +11,15 @@
 
 void SphericalHeightmapGenerator::init(const PlanetGenData* planetGenData) {
     m_genData = planetGenData;
+
+    // Flatten the noise trees once instead of walking them for every sample
+    m_baseTerrainProgram.compile(m_genData->baseTerrainFuncs.funcs);
+    m_temperatureProgram.compile(m_genData->tempTerrainFuncs.funcs);
+    m_humidityProgram.compile(m_genData->humTerrainFuncs.funcs);
+    m_biomeTerrainPrograms.clear();
+    for (auto& biome : m_genData->biomes) {
+        m_biomeTerrainPrograms[&biome].compile(biome.terrainNoise.funcs);
+    }
 }
 
 void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData& height, const VoxelPosition2D& facePosition) const {
@@ -39,6 +48,46 @@ void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData& heigh
     generateHeightData(height, normal * m_genData->radius, normal);
 }
 
+void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData* heights, const VoxelPosition2D* facePositions, size_t n) const {
+    std::vector<f64v3> worldPositions(n);
+    std::vector<f64v3> positions(n);
+    std::vector<f64v3> normals(n);
+    for (size_t i = 0; i < n; i++) {
+        const VoxelPosition2D& facePosition = facePositions[i];
+        // Need to convert to world-space
+        f32v2 coordMults = f32v2(VoxelSpaceConversions::FACE_TO_WORLD_MULTS[(int)facePosition.face]);
+        i32v3 coordMapping = VoxelSpaceConversions::VOXEL_TO_WORLD[(int)facePosition.face];
+
+        f64v3& pos = worldPositions[i];
+        pos[coordMapping.x] = facePosition.pos.x * KM_PER_VOXEL * coordMults.x;
+        pos[coordMapping.y] = m_genData->radius * (f64)VoxelSpaceConversions::FACE_Y_MULTS[(int)facePosition.face];
+        pos[coordMapping.z] = facePosition.pos.y * KM_PER_VOXEL * coordMults.y;
+
+        normals[i] = vmath::normalize(pos);
+        positions[i] = normals[i] * m_genData->radius;
+    }
+
+    generateHeightData(heights, positions.data(), normals.data(), n);
+
+    for (size_t i = 0; i < n; i++) {
+        PlanetHeightData& height = heights[i];
+        // For Voxel Position, automatically get tree or flora
+        height.flora = getTreeID(height.biome, facePositions[i], worldPositions[i]);
+        // If no tree, try flora
+        if (height.flora == FLORA_ID_NONE) {
+            height.flora = getFloraID(height.biome, facePositions[i], worldPositions[i]);
+        }
+    }
+}
+
+void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData* heights, const f64v3* normals, size_t n) const {
+    std::vector<f64v3> positions(n);
+    for (size_t i = 0; i < n; i++) {
+        positions[i] = normals[i] * m_genData->radius;
+    }
+    generateHeightData(heights, positions.data(), normals, n);
+}
+
 FloraID SphericalHeightmapGenerator::getTreeID(const Biome* biome, const VoxelPosition2D& facePosition, const f64v3& worldPos) const {
     // TODO(Ben): Experiment with optimizations with large amounts of flora.
     f64 noTreeChance = 1.0;
@@ -220,6 +269,92 @@ inline void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData
     height.biome = bestBiome;
 }
 
+void SphericalHeightmapGenerator::generateHeightData(OUT PlanetHeightData* heights, const f64v3* positions, const f64v3* normals, size_t n) const {
+    NoiseBatch batch;
+    batch.set(positions, n, m_useF32Noise);
+
+    // Planet wide noise for every sample at once
+    std::vector<f64> baseHeight(n, m_genData->baseTerrainFuncs.base);
+    std::vector<f64> temperature(n, m_genData->tempTerrainFuncs.base);
+    std::vector<f64> humidity(n, m_genData->humTerrainFuncs.base);
+    m_baseTerrainProgram.evaluate(batch, baseHeight.data());
+    m_temperatureProgram.evaluate(batch, temperature.data());
+    m_humidityProgram.evaluate(batch, humidity.data());
+
+    // Group the samples by base biome. The groups are ordered like each sample's
+    // own biome map, so every sample mixes its biomes in the same order as before.
+    struct BiomeSample {
+        ui32 index;
+        f64 weight;
+    };
+    std::map<const Biome*, std::vector<BiomeSample>> biomeSamples;
+    std::vector<f64> biggestWeight(n, 0.0);
+    std::vector<const Biome*> bestBiome(n);
+    std::map<BiomeInfluence, f64> baseBiomes;
+    for (size_t i = 0; i < n; i++) {
+        PlanetHeightData& height = heights[i];
+        f64 h = baseHeight[i];
+        height.height = (f32)(h * VOXELS_PER_M);
+        h *= KM_PER_M;
+        f64 angle = computeAngleFromNormal(normals[i]);
+        temperature[i] = calculateTemperature(m_genData->tempLatitudeFalloff, angle, temperature[i] - vmath::max(0.0, m_genData->tempHeightFalloff * h));
+        humidity[i] = calculateHumidity(m_genData->humLatitudeFalloff, angle, humidity[i] - vmath::max(0.0, m_genData->humHeightFalloff * h));
+        height.temperature = (ui8)temperature[i];
+        height.humidity = (ui8)humidity[i];
+        height.flora = FLORA_ID_NONE;
+        bestBiome[i] = m_genData->baseBiomeLookup[height.humidity][height.temperature];
+
+        baseBiomes.clear();
+        getBaseBiomes(m_genData->baseBiomeInfluenceMap, temperature[i], humidity[i], baseBiomes);
+        for (auto& bb : baseBiomes) {
+            BiomeSample sample;
+            sample.index = (ui32)i;
+            sample.weight = bb.first.weight * bb.second;
+            biomeSamples[bb.first.b].push_back(sample);
+        }
+    }
+
+    std::vector<ui32> indices;
+    std::vector<f64> newHeights;
+    NoiseBatch biomeBatch;
+    for (auto& it : biomeSamples) {
+        const Biome* biome = it.first;
+        const std::vector<BiomeSample>& samples = it.second;
+
+        // Get base biome terrain
+        newHeights.resize(samples.size());
+        for (size_t k = 0; k < samples.size(); k++) {
+            newHeights[k] = biome->terrainNoise.base + heights[samples[k].index].height;
+        }
+        auto program = m_biomeTerrainPrograms.find(biome);
+        if (program != m_biomeTerrainPrograms.end()) {
+            indices.resize(samples.size());
+            for (size_t k = 0; k < samples.size(); k++) indices[k] = samples[k].index;
+            biomeBatch.gather(batch, indices.data(), indices.size());
+            program->second.evaluate(biomeBatch, newHeights.data());
+        } else {
+            for (size_t k = 0; k < samples.size(); k++) {
+                getNoiseValue(positions[samples[k].index], biome->terrainNoise.funcs, nullptr, TerrainOp::ADD, newHeights[k]);
+            }
+        }
+
+        for (size_t k = 0; k < samples.size(); k++) {
+            ui32 i = samples[k].index;
+            f64 baseWeight = samples[k].weight;
+            PlanetHeightData& height = heights[i];
+            // Mix in height with squared interpolation
+            height.height = (f32)((baseWeight * newHeights[k]) + (1.0 - baseWeight) * (f64)height.height);
+            // Sub biomes depend on the height so far, they stay per sample
+            recurseChildBiomes(biome, positions[i], height.height, biggestWeight[i], bestBiome[i], baseWeight);
+        }
+    }
+
+    // Mark biome that is the best
+    for (size_t i = 0; i < n; i++) {
+        heights[i].biome = bestBiome[i];
+    }
+}
+
 void SphericalHeightmapGenerator::recurseChildBiomes(const Biome* biome, const f64v3& pos, f32& height, f64& biggestWeight, const Biome*& bestBiome, f64 baseWeight) const {
     // Get child noise value
     f64 noiseVal = biome->childNoise.base;
@@ -20,7 +20,9 @@
 #include "TerrainPatchMesher.h"
 #include "VoxelCoordinateSpaces.h"
 #include "PlanetGenData.h"
+#include "NoiseProgram.h"
 
+#include <unordered_map>
 #include <Vorb/Events.hpp>
 
 struct NoiseBase;
@@ -36,6 +38,13 @@ class SphericalHeightmapGenerator {
     /// Gets the height at a specific face position.
     void generateHeightData(OUT PlanetHeightData& height, const VoxelPosition2D& facePosition) const;
     void generateHeightData(OUT PlanetHeightData& height, const f64v3& normal) const;
+    /// Gets the heights at many face positions at once. Much faster than one at a time.
+    void generateHeightData(OUT PlanetHeightData* heights, const VoxelPosition2D* facePositions, size_t n) const;
+    /// Gets the heights at many normals at once
+    void generateHeightData(OUT PlanetHeightData* heights, const f64v3* normals, size_t n) const;
+
+    /// Evaluates batched noise in f32. Faster, but loses detail far from the origin.
+    void setUseF32Noise(bool useF32Noise) { m_useF32Noise = useF32Noise; }
 
     // Gets the tree id that should be at a specific worldspace position
     FloraID getTreeID(const Biome* biome, const VoxelPosition2D& facePosition, const f64v3& worldPos) const;
@@ -45,6 +54,7 @@ class SphericalHeightmapGenerator {
     const PlanetGenData* getGenData() const { return m_genData; }
 private:
     void generateHeightData(OUT PlanetHeightData& height, const f64v3& pos, const f64v3& normal) const;
+    void generateHeightData(OUT PlanetHeightData* heights, const f64v3* positions, const f64v3* normals, size_t n) const;
     void recurseChildBiomes(const Biome* biome, const f64v3& pos, f32& height, f64& biggestWeight, const Biome*& bestBiome, f64 baseWeight) const;
     
     /// Gets noise value using terrainFuncs
@@ -74,6 +84,13 @@ class SphericalHeightmapGenerator {
     static f64 computeAngleFromNormal(const f64v3& normal);
 
     const PlanetGenData* m_genData = nullptr; ///< Planet generation data for this generator
+
+    // Noise trees flattened for the batched paths
+    NoiseProgram m_baseTerrainProgram;
+    NoiseProgram m_temperatureProgram;
+    NoiseProgram m_humidityProgram;
+    std::unordered_map<const Biome*, NoiseProgram> m_biomeTerrainPrograms;
+    bool m_useF32Noise = false;
 };
 
 #endif // SphericalTerrainCpuGenerator_h__
@@ -44,7 +44,7 @@ void SphericalTerrainComponentRenderer::draw(SphericalTerrainComponent& cmp,
                                              const SpaceLightComponent* spComponent,
                                              const AxisRotationComponent* arComponent,
                                              const AtmosphereComponent* aComponent) {
-    if (cmp.patches) {
+    if (cmp.patchTrees) {
         
         f64v3 relativeCameraPos = camera->getPosition() - position;
 
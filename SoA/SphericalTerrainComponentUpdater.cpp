@@ -7,6 +7,7 @@
 #include "SpaceSystemComponents.h"
 #include "SphericalHeightmapGenerator.h"
 #include "TerrainPatchMeshManager.h"
+#include "TerrainPatchTree.h"
 #include "VoxelCoordinateSpaces.h"
 #include "PlanetGenLoader.h"
 #include "soaUtils.h"
@@ -55,20 +56,19 @@ void SphericalTerrainComponentUpdater::update(SoaState* state, const f64v3& came
            
             if (stCmp.planetGenData && !stCmp.needsVoxelComponent) {
                 // Allocate if needed
-                if (!stCmp.patches) {
+                if (!stCmp.patchTrees) {
                     initPatches(stCmp);
                 }
 
-                // Update patches
-                for (int i = 0; i < ST_TOTAL_PATCHES; i++) {
-                    stCmp.patches[i].update(relativeCameraPos);
-                }
+                // Update patches, a face per task
+                TerrainPatchTree::updateTrees(stCmp.patchTrees, NUM_FACES, relativeCameraPos,
+                                              stCmp.sphericalTerrainData->threadPool);
             }
         } else {
             // Out of range, delete everything
-            if (stCmp.patches) {
-                delete[] stCmp.patches;
-                stCmp.patches = nullptr;
+            if (stCmp.patchTrees) {
+                delete[] stCmp.patchTrees;
+                stCmp.patchTrees = nullptr;
             }
         }
 
@@ -88,22 +88,22 @@ void SphericalTerrainComponentUpdater::glUpdate(const SoaState* soaState) {
 void SphericalTerrainComponentUpdater::initPatches(SphericalTerrainComponent& cmp) {
     const f64& patchWidth = cmp.sphericalTerrainData->patchWidth;
 
-    // Allocate top level patches
-    cmp.patches = new TerrainPatch[ST_TOTAL_PATCHES];
+    // Allocate a tree per face
+    cmp.patchTrees = new TerrainPatchTree[NUM_FACES];
 
     int center = ST_PATCH_ROW / 2;
     f64v2 gridPos;
-    int index = 0;
 
     // Init all the top level patches for each of the 6 grids
     for (int face = 0; face < NUM_FACES; face++) {
+        TerrainPatchTree& tree = cmp.patchTrees[face];
+        tree.init(cmp.sphericalTerrainData, static_cast<WorldCubeFace>(face), true, ST_PATCHES_PER_FACE);
+        int index = 0;
         for (int z = 0; z < ST_PATCH_ROW; z++) {
             for (int x = 0; x < ST_PATCH_ROW; x++) {
-                auto& p = cmp.patches[index++];
                 gridPos.x = (x - center) * patchWidth;
                 gridPos.y = (z - center) * patchWidth;
-                p.init(gridPos, static_cast<WorldCubeFace>(face),
-                       0, cmp.sphericalTerrainData, patchWidth);
+                tree.initRoot(index++, gridPos, patchWidth);
             }
         }
     }
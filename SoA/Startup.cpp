@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Startup.h"
 
+#include "ChunkGenBenchmark.h"
+
 namespace {
     void printHelp() {
         printf(R"(
@@ -8,6 +10,7 @@ namespace {
 Command-line arguments:
 "-a" to launch main application
 "-c" to bring up the console
+"-b [chunks]" to benchmark chunk generation, meshing and saving
 "-h" for this help text
 "-q" to do nothing
 
@@ -16,7 +19,7 @@ Command-line arguments:
     }
 }
 
-Startup startup(int argc, cString* argv) {
+Startup startup(int argc, cString* argv, OUT ui32* benchmarkChunks /*= nullptr*/) {
     // Application mode is the default
     Startup mode = Startup::HELP;
     bool shouldOutputHelp = false;
@@ -28,6 +31,14 @@ Startup startup(int argc, cString* argv) {
                 mode = Startup::APP;
             } else if (strcmp(argv[i], "-c") == 0) {
                 mode = Startup::CONSOLE;
+            } else if (strcmp(argv[i], "-b") == 0) {
+                mode = Startup::BENCHMARK;
+                ui32 numChunks = DEFAULT_BENCHMARK_CHUNKS;
+                // Chunk count is optional
+                if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+                    numChunks = (ui32)atoi(argv[++i]);
+                }
+                if (benchmarkChunks) *benchmarkChunks = numChunks;
             } else if (strcmp(argv[i], "-help") == 0 || strcmp(argv[i], "-h") == 0) {
                 shouldOutputHelp = true;
                 break;
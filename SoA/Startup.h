@@ -20,6 +20,7 @@
 enum class Startup {
     APP,
     CONSOLE,
+    BENCHMARK,
     HELP,
     EXIT
 };
@@ -28,8 +29,9 @@ enum class Startup {
  * 
  * @param argc: Number of process arguments.
  * @param argv: Values of process arguments.
+ * @param benchmarkChunks: Optional, set to the number of chunks for Startup::BENCHMARK.
  * @return The way to start the application.
  */
-Startup startup(int argc, cString* argv);
+Startup startup(int argc, cString* argv, OUT ui32* benchmarkChunks = nullptr);
 
 #endif // Startup_h__
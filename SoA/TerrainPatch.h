@@ -15,6 +15,7 @@
 #ifndef TerrainPatch_h__
 #define TerrainPatch_h__
 
+#include "HeightmapCache.h"
 #include "VoxelCoordinateSpaces.h"
 #include "TerrainPatchConstants.h"
 #include "VoxPool.h"
@@ -38,7 +39,8 @@ struct TerrainPatchData { // TODO(Ben): probably dont need this
         patchWidth(patchWidth),
         generator(generator),
         meshManager(meshManager),
-        threadPool(threadPool) {
+        threadPool(threadPool),
+        heightmapCache(PADDED_PATCH_WIDTH, PATCH_WIDTH - 1, 1) {
         // Empty
     }
 
@@ -47,72 +49,22 @@ struct TerrainPatchData { // TODO(Ben): probably dont need this
     SphericalHeightmapGenerator* generator;
     TerrainPatchMeshManager* meshManager;
     vcore::ThreadPool<WorkerData>* threadPool;
+    mutable HeightmapCache heightmapCache; ///< Padded patch heights, shared by spherical and far patches
 };
 
-// TODO(Ben): Sorting
-// fix redundant quality changes
+/// LOD settings and horizon checks for terrain patches.
+/// The patches themselves live in a TerrainPatchTree.
 class TerrainPatch {
+    friend class TerrainPatchTree;
 public:
-    TerrainPatch() { };
-    virtual ~TerrainPatch();
-    
-    /// Initializes the patch
-    /// @param gridPosition: Position on the 2d face grid
-    /// @param sphericalTerrainData: Shared data
-    /// @param width: Width of the patch in KM
-    virtual void init(const f64v2& gridPosition,
-              WorldCubeFace cubeFace,
-              int lod,
-              const TerrainPatchData* sphericalTerrainData,
-              f64 width);
-
-    /// Updates the patch
-    /// @param cameraPos: Position of the camera
-    virtual void update(const f64v3& cameraPos);
-
-    /// Frees resources
-    void destroy();
-
-    /// @return true if it has a generated mesh
-    bool hasMesh() const;
-
-    /// @return true if it has a mesh, or all of its children are
-    /// renderable.
-    bool isRenderable() const;
-
-                            
     static bool isOverHorizon(const f64v3 &relCamPos, const f64v3 &point, f64 planetRadius);
 
     static void setQuality(int quality);
-
-    /// Returns true if the patch can subdivide
-    bool canSubdivide() const;
 protected:
-    /// Requests a mesh via RPC
-    void requestMesh(bool isSpherical);
-    /// Calculates the closest point to the camera, as well as distance
-    /// @param cameraPos: position of the observer
-    /// @return closest point on the AABB
-    f64v3 calculateClosestPointAndDist(const f64v3& cameraPos);
-
     static f32 DIST_MIN;
     static f32 DIST_MAX;
     static f32 MIN_SIZE;
     static int PATCH_MAX_LOD;
-
-    f64v2 m_gridPos = f64v2(0.0); ///< Position on 2D grid
-    f64v3 m_aabbPos = f64v3(0.0); ///< Position relative to world
-    f64v3 m_aabbDims = f64v3(0.0);
-    f64 m_distance = 1000000000.0; ///< Distance from camera
-    int m_lod = 0; ///< Level of detail
-    WorldCubeFace m_cubeFace; ///< Which cube face grid it is on
-
-    f64 m_width = 0.0; ///< Width of the patch in KM
-
-    TerrainPatchMesh* m_mesh = nullptr;
-
-    const TerrainPatchData* m_terrainPatchData = nullptr; ///< Shared data pointer
-    TerrainPatch* m_children = nullptr; ///< Pointer to array of 4 children
 };
 
 #endif // TerrainPatch_h__
\ No newline at end of file
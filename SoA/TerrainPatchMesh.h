@@ -48,11 +48,10 @@ class WaterVertex {
 
 class TerrainPatchMesh {
 public:
-    friend class FarTerrainPatch;
-    friend class TerrainPatch;
     friend class TerrainPatchMeshManager;
     friend class TerrainPatchMeshTask;
     friend class TerrainPatchMesher;
+    friend class TerrainPatchTree;
     TerrainPatchMesh(WorldCubeFace cubeFace, bool isSpherical) :
         m_cubeFace(cubeFace), m_isSpherical(isSpherical) {}
     ~TerrainPatchMesh();
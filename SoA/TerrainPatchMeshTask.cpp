@@ -6,6 +6,9 @@
 #include "TerrainPatchMesher.h"
 #include "VoxelSpaceConversions.h"
 
+// Patch LOD 0 is the coarsest, but cache LODs count up as tiles get coarser
+#define PATCH_CACHE_LOD_OFFSET 64
+
 void TerrainPatchMeshTask::init(const TerrainPatchData* patchData,
                                 TerrainPatchMesh* mesh,
                                 const f32v3& startPos,
@@ -22,6 +25,7 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
 
     PlanetHeightData heightData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
     f64v3 positionData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
+    f64v3 normalData[PADDED_PATCH_WIDTH][PADDED_PATCH_WIDTH];
     f64v3 pos;
     f32v3 tmpPos;
 
@@ -43,11 +47,14 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
                 pos[coordMapping.x] = (m_startPos.x + (x - 1) * VERT_WIDTH) * coordMults.x;
                 pos[coordMapping.y] = m_startPos.y;
                 pos[coordMapping.z] = (m_startPos.z + (z - 1) * VERT_WIDTH) * coordMults.y;
-                f64v3 normal(vmath::normalize(pos));
-                generator->generateHeightData(heightData[z][x], normal);
-                
+                normalData[z][x] = vmath::normalize(pos);
+            }
+        }
+        getHeightData(&heightData[0][0], &normalData[0][0]);
+        for (int z = 0; z < PADDED_PATCH_WIDTH; z++) {
+            for (int x = 0; x < PADDED_PATCH_WIDTH; x++) {
                 // offset position by height;
-                positionData[z][x] = normal * (m_patchData->radius + heightData[z][x].height * KM_PER_VOXEL);
+                positionData[z][x] = normalData[z][x] * (m_patchData->radius + heightData[z][x].height * KM_PER_VOXEL);
             }
         }
     } else { // Far terrain
@@ -63,11 +70,16 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
                 pos[coordMapping.x] = spos.x * coordMults.x;
                 pos[coordMapping.y] = m_startPos.y;
                 pos[coordMapping.z] = spos.y * coordMults.y;
-                f64v3 normal(vmath::normalize(pos));
-                generator->generateHeightData(heightData[z][x], normal);
-
+                normalData[z][x] = vmath::normalize(pos);
+                // Height is filled in below
+                positionData[z][x] = f64v3(spos.x, 0.0, spos.y);
+            }
+        }
+        getHeightData(&heightData[0][0], &normalData[0][0]);
+        for (int z = 0; z < PADDED_PATCH_WIDTH; z++) {
+            for (int x = 0; x < PADDED_PATCH_WIDTH; x++) {
                 // offset position by height;
-                positionData[z][x] = f64v3(spos.x, heightData[z][x].height * KM_PER_VOXEL, spos.y);
+                positionData[z][x].y = heightData[z][x].height * KM_PER_VOXEL;
             }
         }
     }
@@ -83,3 +95,43 @@ void TerrainPatchMeshTask::execute(WorkerData* workerData) {
     // Finally, add to the mesh manager
     m_patchData->meshManager->addMeshAsync(m_mesh);
 }
+
+void TerrainPatchMeshTask::getHeightData(OUT PlanetHeightData* heightData, const f64v3* normalData) const {
+    const int SIZE = PADDED_PATCH_WIDTH * PADDED_PATCH_WIDTH;
+    SphericalHeightmapGenerator* generator = m_patchData->generator;
+
+    // Spherical and far patches share one lattice, since the far patch width
+    // is a power of two fraction of the spherical one
+    HeightmapTileKey key;
+    key.face = m_cubeFace;
+    key.lod = PATCH_CACHE_LOD_OFFSET - (i32)floor(log2(m_patchData->patchWidth / m_width) + 0.5);
+    key.tile.x = (i32)floor(m_startPos.x / m_width + 0.5f);
+    key.tile.y = (i32)floor(m_startPos.z / m_width + 0.5f);
+
+    ui8 found[SIZE];
+    HeightmapCache& cache = m_patchData->heightmapCache;
+    ui32 numFound = cache.get(key, heightData, found);
+    if (numFound == SIZE) return;
+
+    if (numFound == 0) {
+        generator->generateHeightData(heightData, normalData, SIZE);
+    } else {
+        // Only generate what the finer patches didn't cover
+        std::vector<f64v3> normals;
+        std::vector<ui32> indices;
+        normals.reserve(SIZE - numFound);
+        indices.reserve(SIZE - numFound);
+        for (int i = 0; i < SIZE; i++) {
+            if (!found[i]) {
+                normals.push_back(normalData[i]);
+                indices.push_back(i);
+            }
+        }
+        std::vector<PlanetHeightData> heights(normals.size());
+        generator->generateHeightData(heights.data(), normals.data(), normals.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            heightData[indices[i]] = heights[i];
+        }
+    }
+    cache.put(key, heightData);
+}
@@ -21,6 +21,7 @@
 #include "VoxPool.h"
 #include "VoxelCoordinateSpaces.h"
 
+struct PlanetHeightData;
 struct TerrainPatchData;
 class TerrainPatchMesh;
 class TerrainPatchMesher;
@@ -45,6 +46,9 @@ class TerrainPatchMeshTask : public vcore::IThreadPoolTask < WorkerData > {
     void execute(WorkerData* workerData) override;
 
 private:
+    /// Fills heightData for the padded patch, reusing cached patches when it can
+    void getHeightData(OUT PlanetHeightData* heightData, const f64v3* normalData) const;
+
     f32v3 m_startPos;
     WorldCubeFace m_cubeFace;
     float m_width;
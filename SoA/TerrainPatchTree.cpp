@@ -0,0 +1,324 @@
+#include "stdafx.h"
+#include "TerrainPatchTree.h"
+
+#include <queue>
+#include <thread>
+
+#include "RenderUtils.h"
+#include "TerrainPatch.h"
+#include "TerrainPatchMesh.h"
+#include "TerrainPatchMeshTask.h"
+#include "VoxelSpaceConversions.h"
+#include "soaUtils.h"
+
+// Splits plus merges a tree may do each update
+#define TERRAIN_PATCH_CHANGES_PER_UPDATE 64
+// Meshes requested each update, over all trees
+#define TERRAIN_PATCH_MESHES_PER_UPDATE 32
+// Marks the second visit of a node, after its children
+#define TERRAIN_PATCH_EXIT_BIT 0x80000000
+
+void TerrainPatchTreeDispatch::run() {
+    ui32 tree;
+    while ((tree = nextTree++) < numTrees) {
+        trees[tree].update(cameraPos);
+        numDone++;
+    }
+}
+
+void TerrainPatchTreeTask::execute(WorkerData* workerData) {
+    m_dispatch->run();
+}
+
+void TerrainPatchTreeTask::cleanup() {
+    delete this;
+}
+
+TerrainPatchTree::~TerrainPatchTree() {
+    dispose();
+}
+
+void TerrainPatchTree::init(const TerrainPatchData* terrainPatchData, WorldCubeFace cubeFace,
+                            bool isSpherical, ui32 numRoots) {
+    dispose();
+    m_terrainPatchData = terrainPatchData;
+    m_cubeFace = cubeFace;
+    m_isSpherical = isSpherical;
+    m_numRoots = numRoots;
+    m_nodes.resize(numRoots);
+    m_hasCamera = false;
+    m_travel = 0.0;
+}
+
+void TerrainPatchTree::initRoot(ui32 root, const f64v2& gridPos, f64 width) {
+    freeChildren(root);
+    releaseMesh(m_nodes[root]);
+    initNode(root, gridPos, width, 0);
+}
+
+void TerrainPatchTree::update(const f64v3& cameraPos) {
+    m_meshRequests.clear();
+    if (m_hasCamera) m_travel += vmath::length(cameraPos - m_cameraPos);
+    m_cameraPos = cameraPos;
+    m_hasCamera = true;
+
+    // Subtrees that were judged with other settings can't be skipped
+    bool canSkip = (m_distMin == TerrainPatch::DIST_MIN && m_maxLod == TerrainPatch::PATCH_MAX_LOD);
+    m_distMin = TerrainPatch::DIST_MIN;
+    m_maxLod = TerrainPatch::PATCH_MAX_LOD;
+
+    ui32 budget = TERRAIN_PATCH_CHANGES_PER_UPDATE;
+    m_stack.clear();
+    for (ui32 i = 0; i < m_numRoots; i++) {
+        m_stack.push_back(i);
+    }
+    while (m_stack.size()) {
+        ui32 entry = m_stack.back();
+        m_stack.pop_back();
+        ui32 index = entry & ~TERRAIN_PATCH_EXIT_BIT;
+
+        if (entry & TERRAIN_PATCH_EXIT_BIT) {
+            // The subtree can't be skipped for longer than any of its children
+            TerrainPatchNode& node = m_nodes[index];
+            for (ui32 i = 0; i < 4; i++) {
+                node.validTravel = std::min(node.validTravel, m_nodes[node.children + i].validTravel);
+            }
+            continue;
+        }
+
+        if (canSkip && m_travel < m_nodes[index].validTravel) continue;
+
+        TerrainPatchNode* node = &m_nodes[index];
+        node->distance = vmath::length(getClosestPointOnAABB(cameraPos, node->aabbPos, node->aabbDims) - cameraPos);
+        // Whether the node is waiting on something other than the camera
+        bool isWaiting = false;
+
+        if (node->children != TERRAIN_PATCH_NO_CHILDREN) {
+            if (node->distance > node->width * TerrainPatch::DIST_MAX) {
+                // Out of range, the children go once we can draw in their place
+                if (!node->mesh) {
+                    addMeshRequest(index);
+                    isWaiting = true;
+                } else if (node->mesh->m_isRenderable && budget) {
+                    budget--;
+                    freeChildren(index);
+                } else {
+                    isWaiting = true;
+                }
+            } else if (node->mesh) {
+                // In range, our mesh goes once the children can draw in its place.
+                // Render thread will deallocate.
+                if (isRenderable(node->children) && isRenderable(node->children + 1) &&
+                    isRenderable(node->children + 2) && isRenderable(node->children + 3)) {
+                    releaseMesh(*node);
+                } else {
+                    isWaiting = true;
+                }
+            }
+        } else if (canSubdivide(*node)) {
+            if (budget) {
+                budget--;
+                f64v2 gridPos = node->gridPos;
+                f64 width = node->width / 2.0;
+                i32 lod = node->lod + 1;
+                // Allocating can move the pool
+                ui32 children = allocChildren();
+                node = &m_nodes[index];
+                node->children = children;
+                // Segment into 4 children
+                for (int z = 0; z < 2; z++) {
+                    for (int x = 0; x < 2; x++) {
+                        initNode(children + (z << 1) + x, gridPos + f64v2(width * x, width * z), width, lod);
+                    }
+                }
+            } else {
+                isWaiting = true;
+            }
+        } else if (!node->mesh) {
+            addMeshRequest(index);
+            isWaiting = true;
+        } else if (!node->mesh->m_isRenderable) {
+            isWaiting = true;
+        }
+
+        if (isWaiting) {
+            node->validTravel = m_travel;
+        } else {
+            // Decisions only flip when the distance crosses a threshold, and it
+            // can't change by more than the camera travels
+            f64 slack = std::min(std::abs(node->distance - node->width * TerrainPatch::DIST_MIN),
+                                 std::abs(node->distance - node->width * TerrainPatch::DIST_MAX));
+            node->validTravel = m_travel + slack;
+        }
+
+        if (node->children != TERRAIN_PATCH_NO_CHILDREN) {
+            m_stack.push_back(index | TERRAIN_PATCH_EXIT_BIT);
+            for (ui32 i = 0; i < 4; i++) {
+                m_stack.push_back(node->children + i);
+            }
+        }
+    }
+}
+
+void TerrainPatchTree::requestMesh(ui32 index) {
+    TerrainPatchNode& node = m_nodes[index];
+    f32v3 startPos(node.gridPos.x,
+                   m_terrainPatchData->radius,
+                   node.gridPos.y);
+    node.mesh = new TerrainPatchMesh(m_cubeFace, m_isSpherical);
+    TerrainPatchMeshTask* meshTask = new TerrainPatchMeshTask();
+    meshTask->init(m_terrainPatchData,
+                   node.mesh,
+                   startPos,
+                   (f32)node.width,
+                   m_cubeFace);
+    m_terrainPatchData->threadPool->addTask(meshTask);
+}
+
+void TerrainPatchTree::dispose() {
+    for (ui32 i = 0; i < m_numRoots; i++) {
+        freeChildren(i);
+        releaseMesh(m_nodes[i]);
+    }
+    std::vector<TerrainPatchNode>().swap(m_nodes);
+    std::vector<ui32>().swap(m_freeBlocks);
+    std::vector<TerrainPatchMeshRequest>().swap(m_meshRequests);
+    m_numRoots = 0;
+}
+
+void TerrainPatchTree::updateTrees(TerrainPatchTree* trees, ui32 numTrees,
+                                   const f64v3& cameraPos, VoxPool* threadPool) {
+    if (threadPool && numTrees > 1) {
+        std::shared_ptr<TerrainPatchTreeDispatch> dispatch(new TerrainPatchTreeDispatch);
+        dispatch->trees = trees;
+        dispatch->numTrees = numTrees;
+        dispatch->cameraPos = cameraPos;
+        dispatch->nextTree = 0;
+        dispatch->numDone = 0;
+        for (ui32 i = 1; i < numTrees; i++) {
+            threadPool->addTask(new TerrainPatchTreeTask(dispatch));
+        }
+        // Work alongside the pool so a busy pool can't stall us, then wait for trees in flight
+        dispatch->run();
+        while (dispatch->numDone < numTrees) {
+            std::this_thread::yield();
+        }
+    } else {
+        for (ui32 i = 0; i < numTrees; i++) {
+            trees[i].update(cameraPos);
+        }
+    }
+
+    // Fill the most visible holes first
+    std::priority_queue<TerrainPatchMeshRequest> requests;
+    for (ui32 i = 0; i < numTrees; i++) {
+        for (auto& r : trees[i].getMeshRequests()) {
+            requests.push(r);
+        }
+    }
+    for (int i = 0; i < TERRAIN_PATCH_MESHES_PER_UPDATE && requests.size(); i++) {
+        const TerrainPatchMeshRequest& r = requests.top();
+        r.tree->requestMesh(r.node);
+        requests.pop();
+    }
+}
+
+void TerrainPatchTree::initNode(ui32 index, const f64v2& gridPos, f64 width, i32 lod) {
+    TerrainPatchNode& node = m_nodes[index];
+    node = TerrainPatchNode();
+    node.gridPos = gridPos;
+    node.width = width;
+    node.lod = lod;
+
+    if (!m_isSpherical) {
+        node.aabbPos = f64v3(gridPos.x, 0, gridPos.y);
+        node.aabbDims = f64v3(width, 0, width);
+        return;
+    }
+
+    // Construct an approximate AABB
+    const i32v3& coordMapping = VoxelSpaceConversions::VOXEL_TO_WORLD[(int)m_cubeFace];
+    const i32v2& coordMults = VoxelSpaceConversions::FACE_TO_WORLD_MULTS[(int)m_cubeFace];
+    const f64v2 cornerOffsets[4] = { f64v2(0.0, 0.0), f64v2(0.0, width), f64v2(width, width), f64v2(width, 0.0) };
+    f64v3 minPos(DBL_MAX), maxPos(-DBL_MAX);
+    for (int i = 0; i < 4; i++) {
+        f64v3 c;
+        c[coordMapping.x] = (gridPos.x + cornerOffsets[i].x) * coordMults.x;
+        c[coordMapping.y] = m_terrainPatchData->radius * VoxelSpaceConversions::FACE_Y_MULTS[(int)m_cubeFace];
+        c[coordMapping.z] = (gridPos.y + cornerOffsets[i].y) * coordMults.y;
+        c = vmath::normalize(c) * m_terrainPatchData->radius;
+        for (int j = 0; j < 3; j++) {
+            if (c[j] < minPos[j]) minPos[j] = c[j];
+            if (c[j] > maxPos[j]) maxPos[j] = c[j];
+        }
+    }
+    node.aabbPos = minPos;
+    node.aabbDims = maxPos - minPos;
+}
+
+ui32 TerrainPatchTree::allocChildren() {
+    if (m_freeBlocks.size()) {
+        ui32 block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        return block;
+    }
+    ui32 block = (ui32)m_nodes.size();
+    m_nodes.resize(m_nodes.size() + 4);
+    return block;
+}
+
+void TerrainPatchTree::freeChildren(ui32 index) {
+    if (m_nodes[index].children == TERRAIN_PATCH_NO_CHILDREN) return;
+    m_scratch.clear();
+    m_scratch.push_back(m_nodes[index].children);
+    m_nodes[index].children = TERRAIN_PATCH_NO_CHILDREN;
+    while (m_scratch.size()) {
+        ui32 block = m_scratch.back();
+        m_scratch.pop_back();
+        for (ui32 i = 0; i < 4; i++) {
+            TerrainPatchNode& child = m_nodes[block + i];
+            releaseMesh(child);
+            if (child.children != TERRAIN_PATCH_NO_CHILDREN) {
+                m_scratch.push_back(child.children);
+                child.children = TERRAIN_PATCH_NO_CHILDREN;
+            }
+        }
+        m_freeBlocks.push_back(block);
+    }
+}
+
+void TerrainPatchTree::addMeshRequest(ui32 index) {
+    const TerrainPatchNode& node = m_nodes[index];
+    TerrainPatchMeshRequest request;
+    request.error = node.width / std::max(node.distance, 0.001);
+    request.tree = this;
+    request.node = index;
+    m_meshRequests.push_back(request);
+}
+
+void TerrainPatchTree::releaseMesh(TerrainPatchNode& node) {
+    if (node.mesh) {
+        node.mesh->m_shouldDelete = true;
+        node.mesh = nullptr;
+    }
+}
+
+bool TerrainPatchTree::isRenderable(ui32 index) {
+    m_scratch.clear();
+    m_scratch.push_back(index);
+    while (m_scratch.size()) {
+        const TerrainPatchNode& node = m_nodes[m_scratch.back()];
+        m_scratch.pop_back();
+        if (node.mesh && node.mesh->m_isRenderable) continue;
+        if (node.children == TERRAIN_PATCH_NO_CHILDREN) return false;
+        for (ui32 i = 0; i < 4; i++) {
+            m_scratch.push_back(node.children + i);
+        }
+    }
+    return true;
+}
+
+bool TerrainPatchTree::canSubdivide(const TerrainPatchNode& node) const {
+    return (node.lod < TerrainPatch::PATCH_MAX_LOD && node.distance < node.width * TerrainPatch::DIST_MIN &&
+            node.width > TerrainPatch::MIN_SIZE);
+}
@@ -0,0 +1,146 @@
+///
+/// TerrainPatchTree.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Flat quadtree of terrain patches for one cube face. Nodes live in
+/// a pool and are walked without recursion. Subtrees that the camera
+/// can't have changed yet are skipped.
+///
+
+#pragma once
+
+#ifndef TerrainPatchTree_h__
+#define TerrainPatchTree_h__
+
+#include <atomic>
+#include <memory>
+#include <Vorb/IThreadPoolTask.h>
+
+#include "VoxelCoordinateSpaces.h"
+#include "VoxPool.h"
+
+class TerrainPatchMesh;
+class TerrainPatchTree;
+struct TerrainPatchData;
+
+#define TERRAIN_PATCH_TREE_TASK_ID 9
+
+const ui32 TERRAIN_PATCH_NO_CHILDREN = 0xFFFFFFFF;
+
+/// A patch of terrain. Its children are four consecutive nodes.
+struct TerrainPatchNode {
+    f64v2 gridPos = f64v2(0.0); ///< Position on 2D grid
+    f64v3 aabbPos = f64v3(0.0); ///< Position relative to world
+    f64v3 aabbDims = f64v3(0.0);
+    f64 width = 0.0; ///< Width of the patch in KM
+    f64 distance = 1000000000.0; ///< Distance from camera
+    f64 validTravel = 0.0; ///< Nothing in the subtree changes before the camera travels this far
+    TerrainPatchMesh* mesh = nullptr;
+    ui32 children = TERRAIN_PATCH_NO_CHILDREN; ///< Index of the first child
+    i32 lod = 0; ///< Level of detail
+};
+
+/// A patch that has nothing to draw yet
+struct TerrainPatchMeshRequest {
+    bool operator<(const TerrainPatchMeshRequest& other) const { return error < other.error; }
+
+    f64 error; ///< Screen space error, width over distance
+    TerrainPatchTree* tree;
+    ui32 node;
+};
+
+/// Trees being updated by the thread pool. Trees are claimed by
+/// whoever gets to them first, so late tasks just find nothing to do.
+struct TerrainPatchTreeDispatch {
+    void run();
+
+    TerrainPatchTree* trees = nullptr;
+    ui32 numTrees = 0;
+    f64v3 cameraPos = f64v3(0.0);
+    std::atomic<ui32> nextTree;
+    std::atomic<ui32> numDone;
+};
+
+class TerrainPatchTreeTask : public vcore::IThreadPoolTask<WorkerData> {
+public:
+    TerrainPatchTreeTask(std::shared_ptr<TerrainPatchTreeDispatch> dispatch) :
+        vcore::IThreadPoolTask<WorkerData>(TERRAIN_PATCH_TREE_TASK_ID),
+        m_dispatch(dispatch) {
+        // Empty
+    }
+
+    void execute(WorkerData* workerData) override;
+
+    void cleanup() override;
+private:
+    std::shared_ptr<TerrainPatchTreeDispatch> m_dispatch;
+};
+
+class TerrainPatchTree {
+public:
+    ~TerrainPatchTree();
+
+    /// @param isSpherical: Spherical or far terrain patches
+    /// @param numRoots: Number of top level patches
+    void init(const TerrainPatchData* terrainPatchData, WorldCubeFace cubeFace,
+              bool isSpherical, ui32 numRoots);
+
+    /// Places a top level patch, freeing whatever it held before
+    /// @param gridPos: Position on the 2d face grid
+    /// @param width: Width of the patch in KM
+    void initRoot(ui32 root, const f64v2& gridPos, f64 width);
+
+    /// Splits and merges patches within a budget, and gathers the ones that
+    /// need meshes. Only touches this tree, so trees can update in parallel.
+    /// @param cameraPos: Position of the camera
+    void update(const f64v3& cameraPos);
+
+    /// Starts meshing a patch from the last update's requests
+    void requestMesh(ui32 node);
+
+    /// Frees every patch and its mesh
+    void dispose();
+
+    const std::vector<TerrainPatchMeshRequest>& getMeshRequests() const { return m_meshRequests; }
+
+    /// Updates the trees, in parallel when there is a pool, then requests
+    /// the meshes with the largest screen space error first.
+    static void updateTrees(TerrainPatchTree* trees, ui32 numTrees,
+                            const f64v3& cameraPos, VoxPool* threadPool);
+private:
+    void initNode(ui32 node, const f64v2& gridPos, f64 width, i32 lod);
+    /// @return Index of four free nodes
+    ui32 allocChildren();
+    /// Returns the node's descendants to the pool
+    void freeChildren(ui32 node);
+    void addMeshRequest(ui32 node);
+    void releaseMesh(TerrainPatchNode& node);
+    /// @return true if the patch has a mesh, or all of its children are renderable
+    bool isRenderable(ui32 node);
+    bool canSubdivide(const TerrainPatchNode& node) const;
+
+    std::vector<TerrainPatchNode> m_nodes; ///< Roots first, then blocks of four children
+    std::vector<ui32> m_freeBlocks; ///< Unused blocks of four
+    std::vector<ui32> m_stack; ///< Traversal scratch
+    std::vector<ui32> m_scratch; ///< Scratch for subtree walks during traversal
+    std::vector<TerrainPatchMeshRequest> m_meshRequests;
+    ui32 m_numRoots = 0;
+
+    const TerrainPatchData* m_terrainPatchData = nullptr;
+    WorldCubeFace m_cubeFace = FACE_NONE;
+    bool m_isSpherical = true;
+
+    f64v3 m_cameraPos = f64v3(0.0);
+    f64 m_travel = 0.0; ///< Total distance the camera moved
+    bool m_hasCamera = false;
+    // Settings the skipped subtrees were evaluated with
+    f32 m_distMin = 0.0f;
+    i32 m_maxLod = 0;
+};
+
+#endif // TerrainPatchTree_h__
@@ -6,8 +6,8 @@
 #include "VoxelRay.h"
 #include "VoxelSpaceConversions.h"
 
-bool solidVoxelPredBlock(const Block& block) {
-    return block.collide == true;
+bool solidVoxelPredBlock(const BlockHotTable& blocks, BlockID id) {
+    return blocks.isCollidable(id);
 }
 
 const VoxelRayQuery VRayHelper::getQuery(const f64v3& pos, const f32v3& dir, f64 maxDistance, ChunkGrid& cg, PredBlock f) {
@@ -69,7 +69,7 @@ const VoxelRayQuery VRayHelper::getQuery(const f64v3& pos, const f32v3& dir, f64
             query.id = chunk->blocks.get(query.voxelIndex);
 
             // Check For The Block ID
-            if (f(cg.blockPack->operator[](query.id))) {
+            if (f(cg.blockPack->getHotTable(), query.id)) {
                 if (locked) chunk->dataMutex.unlock();
                 chunk.release();
                 return query;
@@ -144,7 +144,7 @@ const VoxelRayFullQuery VRayHelper::getFullQuery(const f64v3& pos, const f32v3&
             query.inner.id = chunk->blocks.get(query.inner.voxelIndex);
 
             // Check For The Block ID
-            if (f(cg.blockPack->operator[](query.inner.id))) {
+            if (f(cg.blockPack->getHotTable(), query.inner.id)) {
                 if (locked) chunk->dataMutex.unlock();
                 chunk.release();
                 return query;
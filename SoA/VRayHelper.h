@@ -2,12 +2,12 @@
 class ChunkGrid;
 class Chunk;
 
-#include "BlockData.h"
+#include "BlockHotTable.h"
 
 // Returns True For Certain Block Type
-typedef bool(*PredBlock)(const Block& block);
+typedef bool(*PredBlock)(const BlockHotTable& blocks, BlockID id);
 
-extern bool solidVoxelPredBlock(const Block& block);
+extern bool solidVoxelPredBlock(const BlockHotTable& blocks, BlockID id);
 
 // Queryable Information
 class VoxelRayQuery {
@@ -80,6 +80,40 @@ struct BlockVertex {
 };
 static_assert(sizeof(BlockVertex) == 32, "Size of BlockVertex is not 32");
 
+// Everything in a BlockVertex that is the same for the whole quad.
+// Stored once in the ChunkMaterialTable and indexed by PackedBlockVertex.
+// Size: 24 Bytes
+struct BlockMaterial {
+    AtlasTexturePosition texturePosition;
+    AtlasTexturePosition normTexturePosition;
+    AtlasTexturePosition dispTexturePosition;
+
+    ui8v2 textureDims;
+    ui8v2 overlayTextureDims;
+
+    UNIONIZE(color3 color);
+    ui8 blendMode;
+
+    UNIONIZE(color3 overlayColor);
+    ui8 animationLength;
+
+    bool operator==(const BlockMaterial& rhs) const {
+        return memcmp(this, &rhs, sizeof(BlockMaterial)) == 0;
+    }
+};
+static_assert(sizeof(BlockMaterial) == 24, "Size of BlockMaterial is not 24");
+
+// Compact BlockVertex. The shader fetches the rest from the material table.
+// Size: 12 Bytes
+struct PackedBlockVertex {
+    ui8v3 position; ///< Same units as BlockVertex::position
+    ui8 face; ///< vvox::Cardinal of the face
+    ui8v2 tex; ///< Same as BlockVertex::tex
+    ui8 padding[2];
+    ui32 material; ///< Index into the ChunkMaterialTable
+};
+static_assert(sizeof(PackedBlockVertex) == 12, "Size of PackedBlockVertex is not 12");
+
 class LiquidVertex {
 public:
     // TODO: x and z can be bytes?
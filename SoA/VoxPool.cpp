@@ -3,9 +3,12 @@
 
 #include "CAEngine.h"
 #include "ChunkMesher.h"
+#include "RegionFileManager.h"
 #include "VoxelLightEngine.h"
 
 WorkerData::~WorkerData() {
     delete chunkMesher;
     delete voxelLightEngine;
+    delete caEngine;
+    delete regionBuffers;
 }
@@ -17,6 +17,8 @@
 
 #include <Vorb/ThreadPool.h>
 
+struct RegionIOBuffers;
+
 // Worker data for a threadPool
 class WorkerData {
 public:
@@ -29,6 +31,8 @@ class WorkerData {
     class TerrainPatchMesher* terrainMesher = nullptr;
     class FloraGenerator* floraGenerator = nullptr;
     class VoxelLightEngine* voxelLightEngine = nullptr;
+    class CAEngine* caEngine = nullptr;
+    RegionIOBuffers* regionBuffers = nullptr; ///< For loading saved chunks
 };
 
 typedef vcore::ThreadPool<WorkerData> VoxPool;
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "VoxelEditTransaction.h"
+
+#include "ChunkGrid.h"
+
+/// Floor divides a voxel coordinate into a chunk coordinate
+inline i32 getChunkCoord(i32 voxelCoord) {
+    return (voxelCoord >= 0) ? voxelCoord / CHUNK_WIDTH : (voxelCoord + 1) / CHUNK_WIDTH - 1;
+}
+
+void VoxelEditTransaction::setVoxel(const i32v3& voxelPos, BlockID id) {
+    addRow(voxelPos.x, voxelPos.x, voxelPos.y, voxelPos.z, id);
+}
+
+void VoxelEditTransaction::fillBox(const i32v3& corner1, const i32v3& corner2, BlockID id) {
+    i32v3 start(std::min(corner1.x, corner2.x), std::min(corner1.y, corner2.y), std::min(corner1.z, corner2.z));
+    i32v3 end(std::max(corner1.x, corner2.x), std::max(corner1.y, corner2.y), std::max(corner1.z, corner2.z));
+    // Rows in index order, so full rows merge into layers
+    for (i32 y = start.y; y <= end.y; y++) {
+        for (i32 z = start.z; z <= end.z; z++) {
+            addRow(start.x, end.x, y, z, id);
+        }
+    }
+}
+
+void VoxelEditTransaction::fillSphere(const f64v3& center, f64 radius, BlockID id) {
+    if (radius <= 0.0) return;
+    f64 radius2 = radius * radius;
+    i32 yStart = (i32)floor(center.y - radius - 0.5), yEnd = (i32)ceil(center.y + radius - 0.5);
+    i32 zStart = (i32)floor(center.z - radius - 0.5), zEnd = (i32)ceil(center.z + radius - 0.5);
+    for (i32 y = yStart; y <= yEnd; y++) {
+        f64 dy = y + 0.5 - center.y;
+        for (i32 z = zStart; z <= zEnd; z++) {
+            f64 dz = z + 0.5 - center.z;
+            f64 dx2 = radius2 - dy * dy - dz * dz;
+            if (dx2 < 0.0) continue;
+            f64 dx = sqrt(dx2);
+            i32 x0 = (i32)ceil(center.x - 0.5 - dx);
+            i32 x1 = (i32)floor(center.x - 0.5 + dx);
+            if (x0 <= x1) addRow(x0, x1, y, z, id);
+        }
+    }
+}
+
+void VoxelEditTransaction::stamp(const i32v3& voxelPos, const i32v3& dims, const ui8* mask, BlockID id) {
+    const ui8* row = mask;
+    for (i32 y = 0; y < dims.y; y++) {
+        for (i32 z = 0; z < dims.z; z++, row += dims.x) {
+            i32 x = 0;
+            while (x < dims.x) {
+                if (!row[x]) {
+                    x++;
+                    continue;
+                }
+                i32 runStart = x;
+                while (x < dims.x && row[x]) x++;
+                addRow(voxelPos.x + runStart, voxelPos.x + x - 1, voxelPos.y + y, voxelPos.z + z, id);
+            }
+        }
+    }
+}
+
+void VoxelEditTransaction::paste(const i32v3& voxelPos, const i32v3& dims, const BlockID* voxels, bool pasteAir /*= false*/) {
+    const BlockID* row = voxels;
+    for (i32 y = 0; y < dims.y; y++) {
+        for (i32 z = 0; z < dims.z; z++, row += dims.x) {
+            i32 x = 0;
+            while (x < dims.x) {
+                BlockID id = row[x];
+                i32 runStart = x;
+                while (x < dims.x && row[x] == id) x++;
+                if (id == 0 && !pasteAir) continue;
+                addRow(voxelPos.x + runStart, voxelPos.x + x - 1, voxelPos.y + y, voxelPos.z + z, id);
+            }
+        }
+    }
+}
+
+ui32 VoxelEditTransaction::commit() {
+    ui32 numApplied = 0;
+    for (auto& it : m_chunks) {
+        ChunkHandle chunk = m_grid.accessor.acquire(it.first);
+        if (chunk->genLevel != GEN_DONE) {
+            chunk.release();
+            continue;
+        }
+
+        bool isChanged = false;
+        {
+            std::lock_guard<std::mutex> l(chunk->dataMutex);
+            for (auto& run : it.second) {
+                numApplied += run.length;
+                // Only voxels that change need relighting
+                m_changedSpans.clear();
+                chunk->blocks.forEachRun(run.start, run.length, [&](size_t start, size_t length, BlockID oldID) {
+                    if (oldID == run.id) return;
+                    ChangedSpan span;
+                    span.start = (BlockIndex)start;
+                    span.length = (ui16)length;
+                    span.oldID = oldID;
+                    m_changedSpans.push_back(span);
+                });
+                if (m_changedSpans.empty()) continue;
+
+                chunk->blocks.fillRange(run.start, run.length, run.id);
+                for (auto& span : m_changedSpans) {
+                    if (span.oldID == 0) chunk->numBlocks += span.length;
+                    if (run.id == 0) chunk->numBlocks -= span.length;
+                    int end = span.start + span.length;
+                    for (int i = span.start; i < end; i++) {
+                        chunk->queueLightUpdate(i);
+                        chunk->queueCaUpdate(i);
+                    }
+                    for (int y = span.start / CHUNK_LAYER; y <= (end - 1) / CHUNK_LAYER; y++) {
+                        chunk->flagDirtyMeshRegion(y * CHUNK_LAYER);
+                    }
+                }
+                isChanged = true;
+            }
+            if (isChanged) {
+                chunk->flagDirty();
+                chunk->updateVersion++;
+            }
+        }
+        // One remesh for all of it
+        if (isChanged) Chunk::DataChange(chunk);
+        chunk.release();
+    }
+    m_chunks.clear();
+    return numApplied;
+}
+
+void VoxelEditTransaction::clear() {
+    m_chunks.clear();
+}
+
+void VoxelEditTransaction::addRow(i32 x0, i32 x1, i32 y, i32 z, BlockID id) {
+    i32 cy = getChunkCoord(y);
+    i32 cz = getChunkCoord(z);
+    BlockIndex rowIndex = (BlockIndex)((y - cy * CHUNK_WIDTH) * CHUNK_LAYER + (z - cz * CHUNK_WIDTH) * CHUNK_WIDTH);
+    i32 x = x0;
+    while (x <= x1) {
+        i32 cx = getChunkCoord(x);
+        i32 chunkEnd = std::min(x1, cx * CHUNK_WIDTH + CHUNK_WIDTH_M1);
+        addRun(m_chunks[ChunkID(cx, cy, cz)], (BlockIndex)(rowIndex + x - cx * CHUNK_WIDTH),
+               (ui16)(chunkEnd - x + 1), id);
+        x = chunkEnd + 1;
+    }
+}
+
+void VoxelEditTransaction::addRun(std::vector<VoxelEditRun>& runs, BlockIndex start, ui16 length, BlockID id) {
+    if (runs.size()) {
+        VoxelEditRun& last = runs.back();
+        if (last.id == id && last.start + last.length == start) {
+            last.length += length;
+            return;
+        }
+    }
+    VoxelEditRun run;
+    run.start = start;
+    run.length = length;
+    run.id = id;
+    runs.push_back(run);
+}
@@ -0,0 +1,76 @@
+///
+/// VoxelEditTransaction.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Collects bulk voxel edits as runs, grouped by chunk. Committing
+/// fills each chunk's runs under one lock, then remeshes it once.
+///
+
+#pragma once
+
+#ifndef VoxelEditTransaction_h__
+#define VoxelEditTransaction_h__
+
+#include <map>
+
+#include "BlockData.h"
+#include "Chunk.h"
+#include "ChunkID.h"
+
+class ChunkGrid;
+
+/// Voxels [start, start + length) of a chunk set to id
+struct VoxelEditRun {
+    BlockIndex start;
+    ui16 length;
+    BlockID id;
+};
+
+class VoxelEditTransaction {
+public:
+    VoxelEditTransaction(ChunkGrid& grid) : m_grid(grid) {}
+
+    void setVoxel(const i32v3& voxelPos, BlockID id);
+    /// Fills the box between two corners, inclusive
+    void fillBox(const i32v3& corner1, const i32v3& corner2, BlockID id);
+    /// Fills the voxels whose centers are within radius of center
+    void fillSphere(const f64v3& center, f64 radius, BlockID id);
+    /// Sets id where the brush is set
+    /// @param mask: dims.x * dims.y * dims.z values, x fastest then z then y
+    void stamp(const i32v3& voxelPos, const i32v3& dims, const ui8* mask, BlockID id);
+    /// Copies a structure
+    /// @param voxels: dims.x * dims.y * dims.z values, x fastest then z then y
+    /// @param pasteAir: When false, air in the structure leaves the world as is
+    void paste(const i32v3& voxelPos, const i32v3& dims, const BlockID* voxels, bool pasteAir = false);
+
+    /// Applies the edits with one lock and one DataChange per chunk.
+    /// Edits to chunks that aren't generated are dropped.
+    /// @return Number of voxels applied, voxels already set to their ID included
+    ui32 commit();
+    /// Drops the edits
+    void clear();
+
+    bool isEmpty() const { return m_chunks.empty(); }
+private:
+    /// Adds voxels [x0, x1] of a row, split at chunk borders
+    void addRow(i32 x0, i32 x1, i32 y, i32 z, BlockID id);
+    void addRun(std::vector<VoxelEditRun>& runs, BlockIndex start, ui16 length, BlockID id);
+
+    /// A span of voxels that a run changes
+    struct ChangedSpan {
+        BlockIndex start;
+        ui16 length;
+        BlockID oldID;
+    };
+
+    ChunkGrid& m_grid;
+    std::map<ChunkID, std::vector<VoxelEditRun>> m_chunks;
+    std::vector<ChangedSpan> m_changedSpans; ///< Scratch for commit
+};
+
+#endif // VoxelEditTransaction_h__
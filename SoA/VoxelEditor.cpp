@@ -1,13 +1,13 @@
 #include "stdafx.h"
 #include "VoxelEditor.h"
 
+#include <Vorb/utils.h>
+
 #include "BlockData.h"
 #include "Chunk.h"
 #include "ChunkGrid.h"
-#include "ChunkUpdater.h"
 #include "Item.h"
-#include "VoxelNavigation.inl"
-#include "VoxelSpaceConversions.h"
+#include "VoxelEditTransaction.h"
 
 void VoxelEditor::editVoxels(ChunkGrid& grid, ItemStack* block) {
     if (m_startPosition.x == INT_MAX || m_endPosition.x == INT_MAX) {
@@ -25,109 +25,32 @@ void VoxelEditor::editVoxels(ChunkGrid& grid, ItemStack* block) {
 }
 
 void VoxelEditor::placeAABox(ChunkGrid& grid, ItemStack* block) {
-    BlockID blockID;
-    int soundNum = 0;
-    int yStart, yEnd;
-    int zStart, zEnd;
-    int xStart, xEnd;
-
-    i32v3 start = m_startPosition;
-    i32v3 end = m_endPosition;
-
-    //Set up iteration bounds
-    if (start.y < end.y) {
-        yStart = start.y;
-        yEnd = end.y;
-    } else {
-        yEnd = start.y;
-        yStart = end.y;
-    }
-
-    if (start.z < end.z) {
-        zStart = start.z;
-        zEnd = end.z;
+    i32v3 start(vmath::min(m_startPosition.x, m_endPosition.x),
+                vmath::min(m_startPosition.y, m_endPosition.y),
+                vmath::min(m_startPosition.z, m_endPosition.z));
+    i32v3 end(vmath::max(m_startPosition.x, m_endPosition.x),
+              vmath::max(m_startPosition.y, m_endPosition.y),
+              vmath::max(m_startPosition.z, m_endPosition.z));
+
+    VoxelEditTransaction transaction(grid);
+    if (!block) {
+        // Breaking blocks
+        transaction.fillBox(start, end, 0);
     } else {
-        zEnd = start.z;
-        zStart = end.z;
-    }
-
-    if (start.x < end.x) {
-        xStart = start.x;
-        xEnd = end.x;
-    } else {
-        xEnd = start.x;
-        xStart = end.x;
-    }
-
-    // Keep track of which chunk is locked
-    Chunk* chunk = nullptr;
-    ChunkID currentID(0xffffffffffffffff);
-    bool locked = false;
-
-    std::map<ChunkID, ChunkHandle> modifiedChunks;
-
-    for (int y = yStart; y <= yEnd; y++) {
-        for (int z = zStart; z <= zEnd; z++) {
-            for (int x = xStart; x <= xEnd; x++) {
-                i32v3 chunkPos = VoxelSpaceConversions::voxelToChunk(i32v3(x, y, z));
-                ChunkID id(chunkPos);
-                if (id != currentID) {
-                    currentID = id;
-                    if (chunk) {
-                        if (locked) {
-                            chunk->dataMutex.unlock();
-                            locked = false;
-                        }
-                    }
-                    // Only need to aquire once
-                    auto& it = modifiedChunks.find(currentID);
-                    if (it == modifiedChunks.end()) {
-                        chunk = modifiedChunks.insert(std::make_pair(currentID, grid.accessor.acquire(id))).first->second;
-                    } else {
-                        chunk = it->second;
-                    }
-                    if (chunk->isAccessible) {
-                        chunk->dataMutex.lock();
-                        locked = true;
-                    }
-                }
-                if (locked) {
-                    i32v3 pos = i32v3(x, y, z) - chunkPos * CHUNK_WIDTH;
-                    int voxelIndex = pos.x + pos.y * CHUNK_LAYER + pos.z * CHUNK_WIDTH;
-                    blockID = chunk->blocks.get(voxelIndex);
-
-                    if (!block) {
-                        // Breaking blocks
-                    } else {
-                        // Placing blocks
-                        block->count--;
-
-                        // ChunkUpdater::placeBlock(chunk, )
-                        ChunkUpdater::placeBlockNoUpdate(chunk, voxelIndex, block->pack->operator[](block->id).blockID);
-                        if (block->count == 0) {
-                            if (locked) chunk->dataMutex.unlock();
-                            for (auto& it : modifiedChunks) {
-                                if (it.second->isAccessible) {
-                                    it.second->DataChange(it.second);
-                                }
-                                it.second.release();
-                            }
-                            stopDragging();
-                            return;
-                        }
-                        
-                    }
-                }
+        // Placing blocks, as many as the stack holds
+        BlockID blockID = block->pack->operator[](block->id).blockID;
+        ui32 numLeft = block->count;
+        for (int y = start.y; y <= end.y && numLeft > 0; y++) {
+            for (int z = start.z; z <= end.z && numLeft > 0; z++) {
+                int rowEnd = std::min(end.x, start.x + (int)numLeft - 1);
+                transaction.fillBox(i32v3(start.x, y, z), i32v3(rowEnd, y, z), blockID);
+                numLeft -= rowEnd - start.x + 1;
             }
         }
     }
-    if (locked) chunk->dataMutex.unlock();
-    for (auto& it : modifiedChunks) {
-        if (it.second->isAccessible) {
-            it.second->DataChange(it.second);
-        }
-        it.second.release();
-    }
+    // Voxels in chunks that aren't generated are dropped, so only charge for the rest
+    ui32 numApplied = transaction.commit();
+    if (block) block->count -= numApplied;
     stopDragging();
 }
 
@@ -138,7 +61,27 @@ void VoxelEditor::stopDragging() {
 }
 
 void VoxelEditor::placeLine(ChunkGrid& grid, ItemStack* block) {
-
+    BlockID blockID = 0;
+    if (block) blockID = block->pack->operator[](block->id).blockID;
+
+    // Steps along the longest axis, one voxel at a time
+    i32v3 delta = m_endPosition - m_startPosition;
+    int numSteps = std::max(std::abs(delta.x), std::max(std::abs(delta.y), std::abs(delta.z)));
+    f64v3 step(0.0);
+    if (numSteps) step = f64v3(delta) / (f64)numSteps;
+
+    VoxelEditTransaction transaction(grid);
+    f64v3 pos = f64v3(m_startPosition) + 0.5;
+    // As many as the stack holds
+    int lastStep = numSteps;
+    if (block) lastStep = std::min(lastStep, (int)block->count - 1);
+    for (int i = 0; i <= lastStep; i++, pos += step) {
+        transaction.setVoxel(i32v3(fastFloor(pos.x), fastFloor(pos.y), fastFloor(pos.z)), blockID);
+    }
+    // Voxels in chunks that aren't generated are dropped, so only charge for the rest
+    ui32 numApplied = transaction.commit();
+    if (block) block->count -= numApplied;
+    stopDragging();
 }
 
 bool VoxelEditor::isEditing() {
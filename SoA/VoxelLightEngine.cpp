@@ -1,632 +1,480 @@
 #include "stdafx.h"
 #include "VoxelLightEngine.h"
 
-#include "Errors.h"
-#include "VoxelNavigation.inl"
-
-void VoxelLightEngine::calculateLight(Chunk* chunk)
-{
-    ////Flush all edge queues
-    //_lockedChunk = nullptr;
-
-    ////Sunlight Calculation
-    //if (chunk->sunlightRemovalQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Removal
-    //    while (chunk->sunlightRemovalQueue.size()){
-    //        auto& node = chunk->sunlightRemovalQueue.front();
-    //        removeSunlightBFS(chunk, (int)node.blockIndex, node.oldLightVal);
-    //        chunk->sunlightRemovalQueue.pop();
-    //    }
-    //    std::queue<SunlightRemovalNode>().swap(chunk->sunlightRemovalQueue); //forces memory to be freed
-    //}
-
-    //if (chunk->sunlightUpdateQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Addition
-    //    while (chunk->sunlightUpdateQueue.size()){
-    //        auto& node = chunk->sunlightUpdateQueue.front();
-    //        placeSunlightBFS(chunk, (int)node.blockIndex, (int)node.lightVal);
-    //        chunk->sunlightUpdateQueue.pop();
-    //    }
-    //    std::queue<SunlightUpdateNode>().swap(chunk->sunlightUpdateQueue); //forces memory to be freed
-    //}
-
-    ////Voxel Light Calculation
-    //if (chunk->lampLightRemovalQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Removal
-    //    while (chunk->lampLightRemovalQueue.size()){
-    //        auto& node = chunk->lampLightRemovalQueue.front();
-    //        removeLampLightBFS(chunk, (int)node.blockIndex, node.oldLightColor);
-    //        chunk->lampLightRemovalQueue.pop();
-    //    }
-    //    std::queue<LampLightRemovalNode>().swap(chunk->lampLightRemovalQueue); //forces memory to be freed
-    //}
-
-    //if (chunk->lampLightUpdateQueue.size()) {
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //    //Addition
-    //    while (chunk->lampLightUpdateQueue.size()) {
-    //        auto& node = chunk->lampLightUpdateQueue.front();
-    //        placeLampLightBFS(chunk, (int)node.blockIndex, node.lightColor);
-    //        chunk->lampLightUpdateQueue.pop();
-    //    }
-    //    std::queue<LampLightUpdateNode>().swap(chunk->lampLightUpdateQueue); //forces memory to be freed
-    //}
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
+#include "BlockData.h"
+#include "BlockPack.h"
+#include "Chunk.h"
+#include "VoxelBits.h"
+#include "VoxelRunKernels.h"
+
+// Directions match the order of Chunk::neighbors
+enum LightDirection {
+    LIGHT_DIR_LEFT = 0,
+    LIGHT_DIR_RIGHT,
+    LIGHT_DIR_BOTTOM,
+    LIGHT_DIR_TOP,
+    LIGHT_DIR_BACK,
+    LIGHT_DIR_FRONT
+};
+const int OPPOSITE_DIR[6] = { LIGHT_DIR_RIGHT, LIGHT_DIR_LEFT, LIGHT_DIR_TOP, LIGHT_DIR_BOTTOM, LIGHT_DIR_FRONT, LIGHT_DIR_BACK };
+
+const ui16 LAMP_MASKS[3] = { LAMP_RED_MASK, LAMP_GREEN_MASK, LAMP_BLUE_MASK };
+
+/// Index of the i'th voxel on the chunk border facing dir.
+/// Opposite borders use the same ordering, so i lines up across chunks.
+inline int getBorderIndex(int dir, int i) {
+    switch (dir) {
+        case LIGHT_DIR_LEFT:
+            return (i & 0x1f) * CHUNK_WIDTH + (i >> 5) * CHUNK_LAYER;
+        case LIGHT_DIR_RIGHT:
+            return (i & 0x1f) * CHUNK_WIDTH + (i >> 5) * CHUNK_LAYER + CHUNK_WIDTH - 1;
+        case LIGHT_DIR_BOTTOM:
+            return i;
+        case LIGHT_DIR_TOP:
+            return i + CHUNK_SIZE - CHUNK_LAYER;
+        case LIGHT_DIR_BACK:
+            return (i & 0x1f) + (i >> 5) * CHUNK_LAYER;
+        default:
+            return (i & 0x1f) + (i >> 5) * CHUNK_LAYER + CHUNK_LAYER - CHUNK_WIDTH;
+    }
 }
 
-void VoxelLightEngine::calculateSunlightExtend(Chunk* chunk)
-{
-    //int blockIndex;
-    //int y;
-
-    //_lockedChunk = nullptr;
-    //vvox::swapLockedChunk(chunk, _lockedChunk);
-
-    //for (ui32 i = 0; i < chunk->sunExtendList.size(); i++){
-    //    blockIndex = chunk->sunExtendList[i];
-    //    if (chunk->getSunlight(blockIndex) == MAXLIGHT){
-    //        y = blockIndex / CHUNK_LAYER;
-    //        extendSunRay(chunk, blockIndex - y * CHUNK_LAYER, y);
-    //    }
-    //}
-    //std::vector<GLushort>().swap(chunk->sunExtendList); //forces memory to be freed
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
+/// Dims each lamp channel by one
+inline ui16 dimLampLight(ui16 light) {
+    ui16 r = light & LAMP_RED_MASK;
+    ui16 g = light & LAMP_GREEN_MASK;
+    ui16 b = light & LAMP_BLUE_MASK;
+    if (r) r -= 1 << LAMP_RED_SHIFT;
+    if (g) g -= 1 << LAMP_GREEN_SHIFT;
+    if (b) b -= 1;
+    return r | g | b;
 }
 
-void VoxelLightEngine::calculateSunlightRemoval(Chunk* chunk)
-{
-    //int blockIndex;
-    //int y;
-
-    //_lockedChunk = nullptr;
-    //vvox::swapLockedChunk(chunk, _lockedChunk);
-
-    //for (ui32 i = 0; i < chunk->sunRemovalList.size(); i++){
-    //    blockIndex = chunk->sunRemovalList[i];
-    //    if (chunk->getSunlight(blockIndex) == 0){
-    //        y = blockIndex / CHUNK_LAYER;
-    //        blockSunRay(chunk, blockIndex - y * CHUNK_LAYER, y - 1);
-    //    }
-    //}
-    //std::vector<GLushort>().swap(chunk->sunRemovalList); //forces memory to be freed
-    //if (_lockedChunk) {
-    //    _lockedChunk->unlock();
-    //    _lockedChunk = nullptr;
-    //}
+/// Per channel max of two lamp colors
+inline ui16 maxLampLight(ui16 a, ui16 b) {
+    return (ui16)(std::max(a & LAMP_RED_MASK, b & LAMP_RED_MASK) |
+                  std::max(a & LAMP_GREEN_MASK, b & LAMP_GREEN_MASK) |
+                  std::max(a & LAMP_BLUE_MASK, b & LAMP_BLUE_MASK));
 }
 
-//Check for sun rays from the top chunk
-void VoxelLightEngine::checkTopForSunlight(Chunk* chunk)
-{
-    //int blockIndex;
-    //ui16 topLight;
-
-    //static ui16 topSunlight[CHUNK_LAYER];
-
-    //if (chunk->top && chunk->top->isAccessible) {
-    //    // First grab the sunlight from the top
-    //    chunk->top->lock();
-    //    for (int i = 0; i < CHUNK_LAYER; i++) {
-    //        topSunlight[i] = chunk->top->getSunlight(i);
-    //    }
-    //    chunk->top->unlock();
-    //    // Now check for sun extend
-    //    chunk->lock();
-    //    for (int i = 0; i < CHUNK_LAYER; i++) {
-    //        blockIndex = i + 31 * CHUNK_LAYER;
-    //        topLight = topSunlight[i];
-
-    //        if ((chunk->getBlock(blockIndex).blockLight == 0) && topLight == MAXLIGHT) {
-    //            chunk->setSunlight(blockIndex, MAXLIGHT);
-    //            chunk->sunExtendList.push_back(blockIndex);
-    //        } else if (topLight == 0) { //if the top is blocking sunlight
-    //            if (chunk->getSunlight(blockIndex) == MAXLIGHT) {
-    //                chunk->setSunlight(blockIndex, 0);
-    //                chunk->sunRemovalList.push_back(blockIndex);
-    //            }
-    //        }
-    //    }
-    //    chunk->unlock();
-    //}
+void VoxelLightEngine::calculateChunkLight(ChunkHandle& chunk, const BlockPack* blockPack) {
+    m_blocks = &blockPack->getHotTable();
+    ChunkLightQueues& q = *getQueues(chunk);
+
+    bool wasLit;
+    { // Mark it lit first so neighbors that finish while we work send their light over
+        std::lock_guard<std::mutex> l(q.chunk->dataMutex);
+        wasLit = q.chunk->isLit;
+        q.chunk->isLit = true;
+    }
+    if (wasLit) {
+        resetQueues();
+        return;
+    }
+
+    // Pull in light from neighbors that were lit before us. Each one is locked on its own
+    // so two workers lighting neighbors can't deadlock.
+    bool hasTopSunlight = false;
+    bool hasBottomSunlight = false;
+    for (int dir = 0; dir < 6; dir++) {
+        bool isNeighborLit = pullNeighborLight(q, dir);
+        if (dir == LIGHT_DIR_TOP) hasTopSunlight = isNeighborLit;
+        if (dir == LIGHT_DIR_BOTTOM) hasBottomSunlight = isNeighborLit;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(q.chunk->dataMutex);
+        calculateSunlightColumns(q, hasTopSunlight);
+
+        size_t numRuns = vvox::encodeRuns(m_sunlight, CHUNK_SIZE, m_sunlightRuns);
+        q.chunk->sunlight.clear();
+        q.chunk->sunlight.initFromSortedArray(vvox::VoxelStorageState::INTERVAL_TREE, m_sunlightRuns, numRuns);
+
+        // The chunk below may have used the heightmap for columns that we shade.
+        // Its handle can be released since the pull, like any other neighbor's.
+        ChunkLightQueues* bottom = hasBottomSunlight ? getQueues(q.chunk->bottom) : nullptr;
+        if (bottom) {
+            for (int xz = 0; xz < CHUNK_LAYER; xz++) {
+                if (m_bottomSunlight[xz] == MAX_SUNLIGHT && m_sunlight[xz] != MAX_SUNLIGHT) {
+                    bottom->sunlightRemovals.emplace_back((ui16)getBorderIndex(LIGHT_DIR_TOP, xz), MAX_SUNLIGHT, true);
+                }
+            }
+        }
+
+        // Light sources
+        std::vector<LightNode>& lampAdditions = q.lampAdditions;
+        const BlockHotTable& blocks = *m_blocks;
+        q.chunk->blocks.forEachRun(0, CHUNK_SIZE, [&](size_t start, size_t length, ui16 id) {
+            ui16 color = blocks.getLightColor(id);
+            if (color == 0) return;
+            for (size_t i = start; i < start + length; i++) {
+                lampAdditions.emplace_back((ui16)i, color, false);
+            }
+        });
+    }
+
+    flushQueues();
+    resetQueues();
 }
 
-void VoxelLightEngine::blockSunRay(Chunk* chunk, int xz, int y)
-{
-    //int i = y; //start at the current block
-    //chunk->changeState(ChunkStates::MESH);
-   
-    //while (true){ //do the light removal iteration
-    //    if (i == -1){ //bottom chunk
-    //        if (chunk->bottom && chunk->bottom->isAccessible){
-    //            vvox::swapLockedChunk(chunk->bottom, _lockedChunk);
-    //            VoxelLightEngine::blockSunRay(chunk->bottom, xz, 31); //continue the algorithm
-    //            vvox::swapLockedChunk(chunk, _lockedChunk);
-    //        }
-    //        return;
-    //    } else{
-    //        if (chunk->getSunlight(xz + i*CHUNK_LAYER) == MAXLIGHT){
-    //            chunk->setSunlight(xz + i*CHUNK_LAYER, 0);
-    //            VoxelLightEngine::removeSunlightBFS(chunk, xz + i*CHUNK_LAYER, MAXLIGHT);
-    //        } else{
-    //            return;
-    //        }
-    //        i--;
-    //    }
-    //}
+void VoxelLightEngine::updateChunkLight(ChunkHandle& chunk, const BlockPack* blockPack) {
+    m_blocks = &blockPack->getHotTable();
+    ChunkLightQueues& q = *getQueues(chunk);
+
+    // Without a lit chunk above, sun rays come from the heightmap
+    bool hasTopSunlight = false;
+    ChunkLightQueues* top = getQueues(q.chunk->top);
+    if (top) {
+        std::lock_guard<std::mutex> l(top->chunk->dataMutex);
+        hasTopSunlight = top->chunk->isLit;
+    }
+    const int topY = q.chunk->getVoxelPosition().pos.y + CHUNK_WIDTH - 1;
+
+    {
+        std::lock_guard<std::mutex> l(q.chunk->dataMutex);
+        // All queued voxels go in one batch so overlapping removals are walked once
+        for (auto& blockIndex : q.chunk->lightUpdates) {
+            // Clear the voxel and let its neighbors sort out what goes dark and what fills back in
+            ui8 sunlight = q.chunk->sunlight.get(blockIndex);
+            ui16 lamp = q.chunk->lamp.get(blockIndex);
+            if (sunlight) q.chunk->sunlight.set(blockIndex, 0);
+            if (lamp) q.chunk->lamp.set(blockIndex, 0);
+            queueRemovalNeighbors(q, blockIndex, sunlight, &ChunkLightQueues::sunlightRemovals);
+            queueRemovalNeighbors(q, blockIndex, lamp, &ChunkLightQueues::lampRemovals);
+
+            ui16 color = m_blocks->getLightColor(q.chunk->blocks.get(blockIndex));
+            if (color) q.lampAdditions.emplace_back(blockIndex, color, false);
+
+            if (!hasTopSunlight && blockIndex >= CHUNK_SIZE - CHUNK_LAYER) {
+                int xz = blockIndex - (CHUNK_SIZE - CHUNK_LAYER);
+                if ((int)q.chunk->gridData->heightData[xz].height < topY) {
+                    q.sunlightAdditions.emplace_back(blockIndex, MAX_SUNLIGHT, true);
+                }
+            }
+        }
+        q.chunk->lightUpdates.clear();
+    }
 
+    flushQueues();
+    resetQueues();
 }
 
-void VoxelLightEngine::extendSunRay(Chunk* chunk, int xz, int y)
-{
-    //int i = y; //start at the current block, for extension to other chunks
-    //int blockIndex;
-    //chunk->changeState(ChunkStates::MESH);
-    //while (true){
-    //    if (i == -1){
-    //        if (chunk->bottom && chunk->bottom->isAccessible){
-    //            vvox::swapLockedChunk(chunk->bottom, _lockedChunk);
-    //            extendSunRay(chunk->bottom, xz, 31); //continue the algorithm
-    //            vvox::swapLockedChunk(chunk, _lockedChunk);
-    //        }
-    //        return;
-    //    } else{
-    //        blockIndex = xz + i*CHUNK_LAYER;
-    //        if (chunk->getBlock(blockIndex).blockLight == 0){
-
-    //            if (chunk->getSunlight(blockIndex) != MAXLIGHT){
-    //                chunk->sunlightUpdateQueue.emplace(blockIndex, MAXLIGHT);
-    //            }
-    //        
-    //        } else{
-    //            return;
-    //        }
-    //    }
-    //    i--;
-    //}
+ChunkLightQueues* VoxelLightEngine::getQueues(ChunkHandle& chunk) {
+    if (!chunk.isAquired()) return nullptr;
+    Chunk* c = chunk;
+    for (size_t i = 0; i < m_numQueues; i++) {
+        if (m_queues[i].chunk == c) return &m_queues[i];
+    }
+    if (m_numQueues == m_queues.size()) m_queues.emplace_back();
+    ChunkLightQueues& q = m_queues[m_numQueues++];
+    q.chunk = c;
+    // Hold on to it so it can't be freed until the flush is done
+    q.handle = chunk.acquire();
+    return &q;
 }
 
-inline void removeSunlightNeighborUpdate(Chunk* chunk, int blockIndex, ui16 light) {
-   /* ui8 lightVal = chunk->getSunlight(blockIndex);
-    if (lightVal > 0){
-        if (lightVal <= light){
-            chunk->setSunlight(blockIndex, 0);
-            chunk->sunlightRemovalQueue.emplace(blockIndex, light);
-        } else {
-            chunk->sunlightUpdateQueue.emplace(blockIndex, 0);
-        }
-    }*/
+ChunkLightQueues* VoxelLightEngine::getNeighborQueues(ChunkLightQueues& q, int dir, int blockIndex, int& nIndex) {
+    int x = blockIndex & 0x1f;
+    int z = (blockIndex >> 5) & 0x1f;
+    int y = blockIndex >> 10;
+    switch (dir) {
+        case LIGHT_DIR_LEFT:
+            if (x > 0) { nIndex = blockIndex - 1; return &q; }
+            nIndex = blockIndex + CHUNK_WIDTH - 1;
+            break;
+        case LIGHT_DIR_RIGHT:
+            if (x < CHUNK_WIDTH - 1) { nIndex = blockIndex + 1; return &q; }
+            nIndex = blockIndex - CHUNK_WIDTH + 1;
+            break;
+        case LIGHT_DIR_BOTTOM:
+            if (y > 0) { nIndex = blockIndex - CHUNK_LAYER; return &q; }
+            nIndex = blockIndex + CHUNK_SIZE - CHUNK_LAYER;
+            break;
+        case LIGHT_DIR_TOP:
+            if (y < CHUNK_WIDTH - 1) { nIndex = blockIndex + CHUNK_LAYER; return &q; }
+            nIndex = blockIndex - CHUNK_SIZE + CHUNK_LAYER;
+            break;
+        case LIGHT_DIR_BACK:
+            if (z > 0) { nIndex = blockIndex - CHUNK_WIDTH; return &q; }
+            nIndex = blockIndex + CHUNK_LAYER - CHUNK_WIDTH;
+            break;
+        default:
+            if (z < CHUNK_WIDTH - 1) { nIndex = blockIndex + CHUNK_WIDTH; return &q; }
+            nIndex = blockIndex - CHUNK_LAYER + CHUNK_WIDTH;
+            break;
+    }
+    return getQueues(q.chunk->neighbors[dir]);
 }
 
-void VoxelLightEngine::removeSunlightBFS(Chunk* chunk, int blockIndex, ui8 oldLightVal)
-{
-    //ui8 nextIntensity;
-    //if (oldLightVal > 0) {
-    //    nextIntensity = oldLightVal - 1;
-    //} else {
-    //    nextIntensity = 0;
-    //}
-
-    //int x = blockIndex % CHUNK_WIDTH;
-    //int y = blockIndex / CHUNK_LAYER;
-    //int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-
-    //Chunk*& left = chunk->left;
-    //Chunk*& right = chunk->right;
-    //Chunk*& back = chunk->back;
-    //Chunk*& front = chunk->front;
-    //Chunk*& top = chunk->top;
-    //Chunk*& bottom = chunk->bottom;
-
-    //if (x > 0){ //left
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - 1, nextIntensity);
-    //} else if (left && left->isAccessible){
-    //    vvox::swapLockedChunk(left, _lockedChunk);
-    //    removeSunlightNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, nextIntensity);
-    //    left->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (x < CHUNK_WIDTH - 1){ //right
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + 1, nextIntensity);
-    //} else if (right && right->isAccessible){
-    //    vvox::swapLockedChunk(right, _lockedChunk);
-    //    removeSunlightNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, nextIntensity);
-    //    right->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z > 0){ //back
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, nextIntensity);
-    //} else if (back && back->isAccessible){
-    //    vvox::swapLockedChunk(back, _lockedChunk);
-    //    removeSunlightNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, nextIntensity);
-    //    back->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z < CHUNK_WIDTH - 1){ //front
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, nextIntensity);
-    //} else if (front && front->isAccessible){
-    //    vvox::swapLockedChunk(front, _lockedChunk);
-    //    removeSunlightNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, nextIntensity);
-    //    front->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y > 0){ //bottom
-    //    removeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, nextIntensity);
-    //} else if (bottom && bottom->isAccessible){
-    //    vvox::swapLockedChunk(bottom, _lockedChunk);
-    //    removeSunlightNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, nextIntensity);
-    //    bottom->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y < CHUNK_WIDTH - 1){ //top
-    //    removeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, nextIntensity);
-    //} else if (top && top->isAccessible){
-    //    vvox::swapLockedChunk(top, _lockedChunk);
-    //    removeSunlightNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, nextIntensity);
-    //    top->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-    //chunk->changeState(ChunkStates::MESH);
-
+void VoxelLightEngine::queueRemovalNeighbors(ChunkLightQueues& q, int blockIndex, ui16 value, LightQueue queue) {
+    for (int dir = 0; dir < 6; dir++) {
+        int nIndex;
+        ChunkLightQueues* nq = getNeighborQueues(q, dir, blockIndex, nIndex);
+        if (nq) (nq->*queue).emplace_back((ui16)nIndex, value, dir == LIGHT_DIR_BOTTOM);
+    }
 }
 
-inline void placeSunlightNeighborUpdate(Chunk* chunk, int blockIndex, ui16 light) {
-    //if (chunk->getSunlight(blockIndex) < light){
-    //    if (chunk->getBlock(blockIndex).allowLight){
-    //        chunk->setSunlight(blockIndex, (ui8)light); // TODO(Ben) Wrong type?
-    //        chunk->sunlightUpdateQueue.emplace(blockIndex, light);
-    //    }
-    //}
-}
+bool VoxelLightEngine::pullNeighborLight(ChunkLightQueues& q, int dir) {
+    ChunkLightQueues* nq = getQueues(q.chunk->neighbors[dir]);
+    if (!nq) return false;
+
+    const int nDir = OPPOSITE_DIR[dir];
+    {
+        std::lock_guard<std::mutex> l(nq->chunk->dataMutex);
+        if (!nq->chunk->isLit) return false;
+        for (int i = 0; i < CHUNK_LAYER; i++) {
+            int nIndex = getBorderIndex(nDir, i);
+            m_borderSunlight[i] = nq->chunk->sunlight.get(nIndex);
+            m_borderLamp[i] = nq->chunk->lamp.get(nIndex);
+        }
+    }
+
+    // Spread from the neighbor's side rather than copying the values over. Our own
+    // removals can still darken its border, and zero nodes pick up whatever is left.
+    for (int i = 0; i < CHUNK_LAYER; i++) {
+        ui16 nIndex = (ui16)getBorderIndex(nDir, i);
+        if (m_borderSunlight[i] > 1 || (dir == LIGHT_DIR_TOP && m_borderSunlight[i])) {
+            nq->sunlightAdditions.emplace_back(nIndex, 0, false);
+        }
+        if (dimLampLight(m_borderLamp[i])) nq->lampAdditions.emplace_back(nIndex, 0, false);
+    }
 
-void VoxelLightEngine::placeSunlightBFS(Chunk* chunk, int blockIndex, ui8 intensity)
-{
-    //if (intensity > chunk->getSunlight(blockIndex)) {
-    //    //Set the light value
-    //    chunk->setSunlight(blockIndex, intensity);
-    //} else {
-    //    //If intensity is less that the actual light value, use the actual
-    //    intensity = chunk->getSunlight(blockIndex);
-    //}
-
-    //if (intensity <= 1) return;
-    ////Reduce by 1 to prevent a bunch of -1
-    //ui8 newIntensity = (intensity - 1);
-
-    //chunk->dirty = 1;
-
-    //int x = blockIndex % CHUNK_WIDTH;
-    //int y = blockIndex / CHUNK_LAYER;
-    //int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-
-    //Chunk*& left = chunk->left;
-    //Chunk*& right = chunk->right;
-    //Chunk*& back = chunk->back;
-    //Chunk*& front = chunk->front;
-    //Chunk*& top = chunk->top;
-    //Chunk*& bottom = chunk->bottom;
-
-    //if (x > 0){ //left
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - 1, newIntensity);
-    //} else if (left && left->isAccessible){
-    //    vvox::swapLockedChunk(left, _lockedChunk);
-    //    placeSunlightNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, newIntensity);
-    //    left->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (x < CHUNK_WIDTH - 1){ //right
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + 1, newIntensity);
-    //} else if (right && right->isAccessible){
-    //    vvox::swapLockedChunk(right, _lockedChunk);
-    //    placeSunlightNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, newIntensity);
-    //    right->changeState(ChunkStates::MESH); 
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z > 0){ //back
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, newIntensity);
-    //} else if (back && back->isAccessible){
-    //    vvox::swapLockedChunk(back, _lockedChunk);
-    //    placeSunlightNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, newIntensity);
-    //    back->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (z < CHUNK_WIDTH - 1){ //front
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, newIntensity);
-    //} else if (front && front->isAccessible){
-    //    vvox::swapLockedChunk(front, _lockedChunk);
-    //    placeSunlightNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, newIntensity);
-    //    front->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y > 0){ //bottom
-    //    placeSunlightNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, newIntensity);
-    //} else if (bottom && bottom->isAccessible){
-    //    vvox::swapLockedChunk(bottom, _lockedChunk);
-    //    placeSunlightNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, newIntensity);
-    //    bottom->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //if (y < CHUNK_WIDTH - 1){ //top
-    //    placeSunlightNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, newIntensity);
-    //} else if (top && top->isAccessible){
-    //    vvox::swapLockedChunk(top, _lockedChunk);
-    //    placeSunlightNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, newIntensity);
-    //    top->changeState(ChunkStates::MESH);
-    //    vvox::swapLockedChunk(chunk, _lockedChunk);
-    //}
-
-    //chunk->changeState(ChunkStates::MESH);
+    if (dir == LIGHT_DIR_TOP) memcpy(m_topSunlight, m_borderSunlight, sizeof(m_topSunlight));
+    if (dir == LIGHT_DIR_BOTTOM) memcpy(m_bottomSunlight, m_borderSunlight, sizeof(m_bottomSunlight));
+    return true;
 }
 
-inline ui16 getMaxLampColors(const ui16 redA, const ui16 greenA, const ui16 blueA, const ui16 b) {
-    /*   ui16 redB = b & LAMP_RED_MASK;
-       ui16 greenB = b & LAMP_GREEN_MASK;
-       ui16 blueB = b & LAMP_BLUE_MASK;
-       return MAX(redA, redB) | MAX(greenA, greenB) | MAX(blueA, blueB);*/
+void VoxelLightEngine::calculateSunlightColumns(ChunkLightQueues& q, bool hasTopSunlight) {
+    Chunk* chunk = q.chunk;
+    const BlockHotTable& blocks = *m_blocks;
+    chunk->blocks.uncompressIntoBuffer(m_blockIDs);
+    // Neighbors may have sent light over since the chunk was marked lit
+    chunk->sunlight.uncompressIntoBuffer(m_sunlight);
+
+    // Trace each column down until something scatters the rays. Without a lit chunk
+    // above us the heightmap tells us if the column is open to the sky.
+    const int topY = chunk->getVoxelPosition().pos.y + CHUNK_WIDTH - 1;
+    for (int xz = 0; xz < CHUNK_LAYER; xz++) {
+        bool isOpen;
+        if (hasTopSunlight) {
+            isOpen = m_topSunlight[xz] == MAX_SUNLIGHT;
+        } else {
+            isOpen = (int)chunk->gridData->heightData[xz].height < topY;
+        }
+        int y = CHUNK_WIDTH - 1;
+        if (isOpen) {
+            for (; y >= 0; y--) {
+                int blockIndex = y * CHUNK_LAYER + xz;
+                BlockID id = m_blockIDs[blockIndex];
+                if (blocks.isLightBlocking(id) || !blocks.allowsLight(id)) break;
+                m_sunlight[blockIndex] = MAX_SUNLIGHT;
+            }
+            // Carry the ray into whatever stopped it, or into the chunk below
+            q.sunlightAdditions.emplace_back((ui16)(std::max(y, 0) * CHUNK_LAYER + xz), MAX_SUNLIGHT, true);
+        }
+        m_litBottom[xz] = (ui8)(y + 1);
+    }
+
+    // Lit voxels next to shaded columns spread sideways. Border columns always spread
+    // since the neighbor chunk could be shaded.
+    for (int z = 0; z < CHUNK_WIDTH; z++) {
+        for (int x = 0; x < CHUNK_WIDTH; x++) {
+            int xz = z * CHUNK_WIDTH + x;
+            int shadedTop = CHUNK_WIDTH;
+            if (x > 0 && x < CHUNK_WIDTH - 1 && z > 0 && z < CHUNK_WIDTH - 1) {
+                shadedTop = std::max(std::max(m_litBottom[xz - 1], m_litBottom[xz + 1]),
+                                     std::max(m_litBottom[xz - CHUNK_WIDTH], m_litBottom[xz + CHUNK_WIDTH]));
+            }
+            for (int y = m_litBottom[xz]; y < shadedTop; y++) {
+                q.sunlightAdditions.emplace_back((ui16)(y * CHUNK_LAYER + xz), MAX_SUNLIGHT, false);
+            }
+        }
+    }
 }
 
-inline void getLampColors(const ui16 l, ui16 &r, ui16 &g, ui16 &b) {
-    /*  r = l & LAMP_RED_MASK;
-      g = l & LAMP_GREEN_MASK;
-      b = l & LAMP_BLUE_MASK;*/
+void VoxelLightEngine::flushQueues() {
+    // Removals all go first so additions never spread light that is about to be removed.
+    // Nodes that cross a border are queued on the neighbor and handled when the loop gets
+    // to it. Only one dataMutex is held at a time, so there is no lock order to get wrong.
+    bool hasWork = true;
+    while (hasWork) {
+        hasWork = false;
+        for (size_t i = 0; i < m_numQueues; i++) {
+            ChunkLightQueues& q = m_queues[i];
+            if (q.sunlightRemovals.empty() && q.lampRemovals.empty()) continue;
+            hasWork = true;
+            std::lock_guard<std::mutex> l(q.chunk->dataMutex);
+            if (q.chunk->isLit) {
+                removeSunlight(q);
+                removeLampLight(q);
+            } else {
+                // Unlit chunks pull the light in when they are lit
+                q.sunlightRemovals.clear();
+                q.lampRemovals.clear();
+            }
+        }
+    }
+
+    hasWork = true;
+    while (hasWork) {
+        hasWork = false;
+        for (size_t i = 0; i < m_numQueues; i++) {
+            ChunkLightQueues& q = m_queues[i];
+            if (q.sunlightAdditions.empty() && q.lampAdditions.empty()) continue;
+            hasWork = true;
+            std::lock_guard<std::mutex> l(q.chunk->dataMutex);
+            if (q.chunk->isLit) {
+                addSunlight(q);
+                addLampLight(q);
+            } else {
+                q.sunlightAdditions.clear();
+                q.lampAdditions.clear();
+            }
+        }
+    }
 }
 
-inline void removeLampNeighborUpdate(Chunk* chunk, int blockIndex, ui16 intensityRed, ui16 intensityGreen, ui16 intensityBlue, ui16 light) {
-   /* ui16 nextRed, nextGreen, nextBlue;
-    ui16 nextLight = chunk->getLampLight(blockIndex);
-    getLampColors(nextLight, nextRed, nextGreen, nextBlue);
-
-    if ((nextRed && nextRed <= intensityRed) || (nextGreen && nextGreen <= intensityGreen) || (nextBlue && nextBlue <= intensityBlue)){
-        chunk->setLampLight(blockIndex, 0);
-        chunk->lampLightRemovalQueue.emplace(blockIndex, light);
-
-        if (nextRed > intensityRed || nextGreen > intensityGreen || nextBlue > intensityBlue){
-            chunk->lampLightUpdateQueue.emplace(blockIndex, 0);
+void VoxelLightEngine::removeSunlight(ChunkLightQueues& q) {
+    Chunk* chunk = q.chunk;
+    std::vector<LightNode>& nodes = q.sunlightRemovals;
+    // Nodes get appended while we walk, so no iterators
+    for (size_t i = 0; i < nodes.size(); i++) {
+        LightNode node = nodes[i];
+        ui8 light = chunk->sunlight.get(node.blockIndex);
+        if (light == 0) continue;
+        // Full strength rays below a removed full strength voxel came from it
+        bool isRay = node.isDown && light == MAX_SUNLIGHT && node.value == MAX_SUNLIGHT;
+        if (light < node.value || isRay) {
+            chunk->sunlight.set(node.blockIndex, 0);
+            queueRemovalNeighbors(q, node.blockIndex, light, &ChunkLightQueues::sunlightRemovals);
+        } else {
+            // Light from somewhere else fills the hole back in. The voxel may still be
+            // removed by a later node, so spread whatever is left once removals are done.
+            q.sunlightAdditions.emplace_back(node.blockIndex, 0, false);
         }
-    } else if (nextLight > 0) {
-        chunk->lampLightUpdateQueue.emplace(blockIndex, 0);
-    }*/
+    }
+    nodes.clear();
 }
 
-void VoxelLightEngine::removeLampLightBFS(Chunk* chunk, int blockIndex, ui16 light)
-{
-//#define RED1 0x400
-//#define GREEN1 0x20
-//#define BLUE1 1
-//
-//    ui16 intensityRed = light & LAMP_RED_MASK;
-//    ui16 intensityGreen = light & LAMP_GREEN_MASK;
-//    ui16 intensityBlue = light & LAMP_BLUE_MASK;
-//
-//    //Reduce by 1
-//    if (intensityRed != 0) {
-//        intensityRed -= RED1;
-//        light -= RED1;
-//    }
-//    if (intensityGreen != 0) {
-//        intensityGreen -= GREEN1;
-//        light -= GREEN1;
-//    }
-//    if (intensityBlue != 0) {
-//        intensityBlue -= BLUE1;
-//        light -= BLUE1;
-//    }
-//
-//    int x = blockIndex % CHUNK_WIDTH;
-//    int y = blockIndex / CHUNK_LAYER;
-//    int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-//
-//    Chunk*& left = chunk->left;
-//    Chunk*& right = chunk->right;
-//    Chunk*& back = chunk->back;
-//    Chunk*& front = chunk->front;
-//    Chunk*& top = chunk->top;
-//    Chunk*& bottom = chunk->bottom;
-//
-//    if (x > 0){ //left
-//        removeLampNeighborUpdate(chunk, blockIndex - 1, intensityRed, intensityGreen, intensityBlue, light);    
-//    } else if (left && left->isAccessible){
-//        vvox::swapLockedChunk(left, _lockedChunk);
-//        removeLampNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, intensityRed, intensityGreen, intensityBlue, light);
-//        left->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (x < CHUNK_WIDTH - 1){ //right
-//        removeLampNeighborUpdate(chunk, blockIndex + 1, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (right && right->isAccessible){
-//        vvox::swapLockedChunk(right, _lockedChunk);
-//        removeLampNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, intensityRed, intensityGreen, intensityBlue, light);
-//        right->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z > 0){ //back
-//        removeLampNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (back && back->isAccessible){
-//        vvox::swapLockedChunk(back, _lockedChunk);
-//        removeLampNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//        back->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z < CHUNK_WIDTH - 1){ //front
-//        removeLampNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (front && front->isAccessible){
-//        vvox::swapLockedChunk(front, _lockedChunk);
-//        removeLampNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue, light);
-//        front->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y > 0){ //bottom
-//        removeLampNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (bottom && bottom->isAccessible){
-//        vvox::swapLockedChunk(bottom, _lockedChunk);
-//        removeLampNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, intensityRed, intensityGreen, intensityBlue, light);
-//        bottom->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y < CHUNK_WIDTH - 1){ //top
-//        removeLampNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//    } else if (top && top->isAccessible){
-//        vvox::swapLockedChunk(top, _lockedChunk);
-//        removeLampNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue, light);
-//        top->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//    chunk->changeState(ChunkStates::MESH);
-
+void VoxelLightEngine::addSunlight(ChunkLightQueues& q) {
+    Chunk* chunk = q.chunk;
+    const BlockHotTable& blocks = *m_blocks;
+    std::vector<LightNode>& nodes = q.sunlightAdditions;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        LightNode node = nodes[i];
+        BlockID id = chunk->blocks.get(node.blockIndex);
+        if (!blocks.allowsLight(id)) continue;
+        ui8 light = chunk->sunlight.get(node.blockIndex);
+        // Zero nodes spread the light that is already there
+        ui8 value = node.value ? (ui8)node.value : light;
+        if (value == 0) continue;
+        // Scattering blocks break up full strength rays
+        if (value == MAX_SUNLIGHT && blocks.isLightBlocking(id)) value--;
+        if (value < light) continue;
+        // Equal light is spread again. That covers voxels placed below and removals
+        // refilling holes.
+        if (value > light) chunk->sunlight.set(node.blockIndex, value);
+
+        for (int dir = 0; dir < 6; dir++) {
+            ui8 nValue = (dir == LIGHT_DIR_BOTTOM && value == MAX_SUNLIGHT) ? MAX_SUNLIGHT : (ui8)(value - 1);
+            if (nValue == 0) continue;
+            int nIndex;
+            ChunkLightQueues* nq = getNeighborQueues(q, dir, node.blockIndex, nIndex);
+            if (!nq) continue;
+            if (nq == &q) {
+                // Place it now so the voxel can't be queued twice
+                BlockID nID = chunk->blocks.get(nIndex);
+                if (!blocks.allowsLight(nID)) continue;
+                if (nValue == MAX_SUNLIGHT && blocks.isLightBlocking(nID)) nValue--;
+                if (chunk->sunlight.get(nIndex) >= nValue) continue;
+                chunk->sunlight.set(nIndex, nValue);
+            }
+            // Other chunks are placed when they are locked
+            nq->sunlightAdditions.emplace_back((ui16)nIndex, nValue, dir == LIGHT_DIR_BOTTOM);
+        }
+    }
+    nodes.clear();
 }
 
-inline void placeLampNeighborUpdate(Chunk* chunk, int blockIndex, ui16 intensityRed, ui16 intensityGreen, ui16 intensityBlue) {
-  /*  ui16 currentLight = chunk->getLampLight(blockIndex);
-    const Block& block = chunk->getBlock(blockIndex);
-
-    intensityRed = (ui16)((intensityRed >> LAMP_RED_SHIFT) * block.colorFilter.r) << LAMP_RED_SHIFT;
-    intensityGreen = (ui16)((intensityGreen >> LAMP_GREEN_SHIFT) * block.colorFilter.g) << LAMP_GREEN_SHIFT;
-    intensityBlue = (ui16)(intensityBlue * block.colorFilter.b);
+void VoxelLightEngine::removeLampLight(ChunkLightQueues& q) {
+    Chunk* chunk = q.chunk;
+    std::vector<LightNode>& nodes = q.lampRemovals;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        LightNode node = nodes[i];
+        ui16 light = chunk->lamp.get(node.blockIndex);
+        if (light == 0) continue;
+        // Each channel is removed on its own
+        ui16 removed = 0;
+        bool hasKept = false;
+        for (int c = 0; c < 3; c++) {
+            ui16 channel = light & LAMP_MASKS[c];
+            if (channel == 0) continue;
+            if (channel < (node.value & LAMP_MASKS[c])) {
+                removed |= channel;
+            } else {
+                hasKept = true;
+            }
+        }
+        if (removed) {
+            chunk->lamp.set(node.blockIndex, light ^ removed);
+            queueRemovalNeighbors(q, node.blockIndex, removed, &ChunkLightQueues::lampRemovals);
+            // Light sources relight themselves
+            ui16 color = m_blocks->getLightColor(chunk->blocks.get(node.blockIndex));
+            if (color) q.lampAdditions.emplace_back(node.blockIndex, color, false);
+        }
+        if (hasKept) q.lampAdditions.emplace_back(node.blockIndex, 0, false);
+    }
+    nodes.clear();
+}
 
-    ui16 nextLight = getMaxLampColors(intensityRed, intensityGreen, intensityBlue, currentLight);
-    if (nextLight != currentLight){
-        if (chunk->getBlock(blockIndex).allowLight){
-            chunk->setLampLight(blockIndex, nextLight);
-            chunk->lampLightUpdateQueue.emplace(blockIndex, nextLight);
+void VoxelLightEngine::addLampLight(ChunkLightQueues& q) {
+    Chunk* chunk = q.chunk;
+    const BlockHotTable& blocks = *m_blocks;
+    std::vector<LightNode>& nodes = q.lampAdditions;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        LightNode node = nodes[i];
+        BlockID id = chunk->blocks.get(node.blockIndex);
+        ui16 light = chunk->lamp.get(node.blockIndex);
+        // Zero nodes spread the light that is already there
+        ui16 value = node.value ? node.value : light;
+        if (value == 0) continue;
+        // Light sources hold their own color even if light can't pass through them
+        if (!blocks.allowsLight(id) && value != blocks.getLightColor(id)) continue;
+        ui16 newLight = maxLampLight(light, value);
+        if (newLight == light && value != light) continue;
+        if (newLight != light) chunk->lamp.set(node.blockIndex, newLight);
+
+        ui16 nValue = dimLampLight(value);
+        if (nValue == 0) continue;
+        for (int dir = 0; dir < 6; dir++) {
+            int nIndex;
+            ChunkLightQueues* nq = getNeighborQueues(q, dir, node.blockIndex, nIndex);
+            if (!nq) continue;
+            ui16 nNodeValue = nValue;
+            if (nq == &q) {
+                // Place it now so the voxel can't be queued twice
+                if (!blocks.allowsLight(chunk->blocks.get(nIndex))) continue;
+                ui16 nLight = chunk->lamp.get(nIndex);
+                nNodeValue = maxLampLight(nLight, nValue);
+                if (nNodeValue == nLight) continue;
+                chunk->lamp.set(nIndex, nNodeValue);
+            }
+            nq->lampAdditions.emplace_back((ui16)nIndex, nNodeValue, false);
         }
-    }*/
+    }
+    nodes.clear();
 }
 
-void VoxelLightEngine::placeLampLightBFS(Chunk* chunk, int blockIndex, ui16 intensity)
-{
-//#define RED1 0x400
-//#define GREEN1 0x20
-//#define BLUE1 1
-//
-//    ui16 currentLight = chunk->getLampLight(blockIndex);
-//
-//    ui16 currentRed = currentLight & LAMP_RED_MASK;
-//    ui16 currentGreen = currentLight & LAMP_GREEN_MASK;
-//    ui16 currentBlue = currentLight & LAMP_BLUE_MASK;
-//
-//    ui16 intensityRed = intensity & LAMP_RED_MASK;
-//    ui16 intensityGreen = intensity & LAMP_GREEN_MASK;
-//    ui16 intensityBlue = intensity & LAMP_BLUE_MASK;
-//
-//    intensityRed = MAX(currentRed, intensityRed);
-//    intensityGreen = MAX(currentGreen, intensityGreen);
-//    intensityBlue = MAX(currentBlue, intensityBlue);
-//
-//    const Block& currentBlock = chunk->getBlock(blockIndex);
-//
-//    intensityRed = (ui16)((intensityRed >> LAMP_RED_SHIFT) * currentBlock.colorFilter.r) << LAMP_RED_SHIFT;
-//    intensityGreen = (ui16)((intensityGreen >> LAMP_GREEN_SHIFT) * currentBlock.colorFilter.g) << LAMP_GREEN_SHIFT;
-//    intensityBlue = (ui16)(intensityBlue * currentBlock.colorFilter.b);
-//    intensity = intensityRed | intensityGreen | intensityBlue;
-//
-//    if (intensity != currentLight) { 
-//        //Set the light value
-//        chunk->setLampLight(blockIndex, intensity);
-//    }
-//
-//    if (intensityRed <= RED1 && intensityGreen <= GREEN1 && intensityBlue <= BLUE1) return;
-//    //Reduce by 1
-//    if (intensityRed != 0) {
-//        intensityRed -= RED1;
-//        intensity -= RED1;
-//    }
-//    if (intensityGreen != 0) {
-//        intensityGreen -= GREEN1;
-//        intensity -= GREEN1;
-//    }
-//    if (intensityBlue != 0) {
-//        intensityBlue -= BLUE1;
-//        intensity -= BLUE1;
-//    }
-//
-//    chunk->dirty = 1;
-//
-//    int x = blockIndex % CHUNK_WIDTH;
-//    int y = blockIndex / CHUNK_LAYER;
-//    int z = (blockIndex % CHUNK_LAYER) / CHUNK_WIDTH;
-//
-//    Chunk*& left = chunk->left;
-//    Chunk*& right = chunk->right;
-//    Chunk*& back = chunk->back;
-//    Chunk*& front = chunk->front;
-//    Chunk*& top = chunk->top;
-//    Chunk*& bottom = chunk->bottom;
-//
-//    if (x > 0){ //left
-//        placeLampNeighborUpdate(chunk, blockIndex - 1, intensityRed, intensityGreen, intensityBlue);
-//    } else if (left && left->isAccessible){
-//        vvox::swapLockedChunk(left, _lockedChunk);
-//        placeLampNeighborUpdate(left, blockIndex + CHUNK_WIDTH - 1, intensityRed, intensityGreen, intensityBlue);
-//        left->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (x < CHUNK_WIDTH - 1){ //right
-//        placeLampNeighborUpdate(chunk, blockIndex + 1, intensityRed, intensityGreen, intensityBlue);
-//    } else if (right && right->isAccessible){
-//        vvox::swapLockedChunk(right, _lockedChunk);
-//        placeLampNeighborUpdate(right, blockIndex - CHUNK_WIDTH + 1, intensityRed, intensityGreen, intensityBlue);
-//        right->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z > 0){ //back
-//        placeLampNeighborUpdate(chunk, blockIndex - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//    } else if (back && back->isAccessible){
-//        vvox::swapLockedChunk(back, _lockedChunk);
-//        placeLampNeighborUpdate(back, blockIndex + CHUNK_LAYER - CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//        back->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (z < CHUNK_WIDTH - 1){ //front
-//        placeLampNeighborUpdate(chunk, blockIndex + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//    } else if (front && front->isAccessible){
-//        vvox::swapLockedChunk(front, _lockedChunk);
-//        placeLampNeighborUpdate(front, blockIndex - CHUNK_LAYER + CHUNK_WIDTH, intensityRed, intensityGreen, intensityBlue);
-//        front->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    if (y > 0){ //bottom
-//        placeLampNeighborUpdate(chunk, blockIndex - CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//    } else if (bottom && bottom->isAccessible){
-//        vvox::swapLockedChunk(bottom, _lockedChunk);
-//        placeLampNeighborUpdate(bottom, CHUNK_SIZE - CHUNK_LAYER + blockIndex, intensityRed, intensityGreen, intensityBlue);
-//        bottom->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//    if (y < CHUNK_WIDTH - 1){ //top
-//        placeLampNeighborUpdate(chunk, blockIndex + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//    } else if (top && top->isAccessible){
-//        vvox::swapLockedChunk(top, _lockedChunk);
-//        placeLampNeighborUpdate(top, blockIndex - CHUNK_SIZE + CHUNK_LAYER, intensityRed, intensityGreen, intensityBlue);
-//        top->changeState(ChunkStates::MESH);
-//        vvox::swapLockedChunk(chunk, _lockedChunk);
-//    }
-//
-//    chunk->changeState(ChunkStates::MESH);
-}
\ No newline at end of file
+void VoxelLightEngine::resetQueues() {
+    for (size_t i = 0; i < m_numQueues; i++) {
+        ChunkLightQueues& q = m_queues[i];
+        q.handle.release();
+        q.chunk = nullptr;
+        // Keep the capacity around for the next update on this worker
+        q.sunlightRemovals.clear();
+        q.sunlightAdditions.clear();
+        q.lampRemovals.clear();
+        q.lampAdditions.clear();
+    }
+    m_numQueues = 0;
+}
@@ -1,63 +1,105 @@
+///
+/// VoxelLightEngine.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Flood fill sunlight and lamp light that crosses chunk borders.
+/// Each worker thread owns one engine.
+///
+
 #pragma once
 
-//Used to tell neighbors to update light
-//class LightMessage {
-//    LightMessage() {};
-//    LightMessage(ui16 BlockIndex, ui8 LightType, i8 LightValue) : blockIndex(BlockIndex), lightType(LightType), lightValue(LightValue) {}
-//    ui16 blockIndex;
-//    ui8 lightType;
-//    i8 lightValue;
-//};
-
-class SunlightRemovalNode
-{
-public:
-    SunlightRemovalNode(ui16 BlockIndex, ui8 OldLightVal) : blockIndex(BlockIndex), oldLightVal(OldLightVal){}
-    ui16 blockIndex;
-    ui8 oldLightVal;
-};
+#ifndef VoxelLightEngine_h__
+#define VoxelLightEngine_h__
 
-class SunlightUpdateNode
-{
-public:
-    SunlightUpdateNode(ui16 BlockIndex, ui8 LightVal) : blockIndex(BlockIndex), lightVal(LightVal){}
-    ui16 blockIndex;
-    ui8 lightVal;
-};
+#include <deque>
+#include <Vorb/Voxel/IntervalTree.h>
 
-class LampLightRemovalNode
-{
-public:
-    LampLightRemovalNode(ui16 BlockIndex, ui16 OldLightColor) : blockIndex(BlockIndex), oldLightColor(OldLightColor){}
-    ui16 blockIndex;
-    ui16 oldLightColor;
-};
+#include "ChunkHandle.h"
+#include "Constants.h"
+
+class BlockHotTable;
+class BlockPack;
+class Chunk;
 
-class LampLightUpdateNode
-{
+const ui8 MAX_SUNLIGHT = 31;
+
+/// A queued light update at a voxel.
+/// For removals, value is the light that was removed next to the voxel.
+/// For additions, value is the light to place at the voxel.
+class LightNode {
 public:
-    LampLightUpdateNode(ui16 BlockIndex, ui16 LightColor) : blockIndex(BlockIndex), lightColor(LightColor){}
+    LightNode() {};
+    LightNode(ui16 blockIndex, ui16 value, bool isDown) :
+        blockIndex(blockIndex), value(value), isDown(isDown) {};
     ui16 blockIndex;
-    ui16 lightColor;
+    ui16 value; ///< Sunlight level or packed lamp color
+    bool isDown; ///< Reached by moving down. Sunlight rays keep full strength going down.
 };
 
-class Chunk;
+/// Pending light updates for one chunk. Only processed with that chunk's dataMutex locked.
+struct ChunkLightQueues {
+    Chunk* chunk = nullptr;
+    ChunkHandle handle;
+    std::vector<LightNode> sunlightRemovals;
+    std::vector<LightNode> sunlightAdditions;
+    std::vector<LightNode> lampRemovals;
+    std::vector<LightNode> lampAdditions;
+};
 
 class VoxelLightEngine {
 public:
-    void calculateLight(Chunk* chunk);
-    void calculateSunlightExtend(Chunk* chunk);
-    void calculateSunlightRemoval(Chunk* chunk);
-
-    void checkTopForSunlight(Chunk* chunk);
+    /// Does the first light pass on a newly generated chunk. Sunlight columns come from
+    /// the heightmap and light is exchanged with any lit neighbors.
+    void calculateChunkLight(ChunkHandle& chunk, const BlockPack* blockPack);
+    /// Relights the voxels queued with Chunk::queueLightUpdate, in one batch.
+    void updateChunkLight(ChunkHandle& chunk, const BlockPack* blockPack);
 private:
-   
-    void blockSunRay(Chunk* chunk, int xz, int y);
-    void extendSunRay(Chunk* chunk, int xz, int y);
-    void removeSunlightBFS(Chunk* chunk, int blockIndex, ui8 oldLightVal);
-    void placeSunlightBFS(Chunk* chunk, int blockIndex, ui8 intensity);
-    void removeLampLightBFS(Chunk* chunk, int blockIndex, ui16 light);
-    void placeLampLightBFS(Chunk* chunk, int blockIndex, ui16 intensity);
-
-    Chunk* _lockedChunk = nullptr;
-};
\ No newline at end of file
+    typedef std::vector<LightNode> ChunkLightQueues::* LightQueue;
+
+    /// Gets the queues for a chunk, acquiring it for the rest of the flush.
+    /// @return nullptr if the handle isn't acquired
+    ChunkLightQueues* getQueues(ChunkHandle& chunk);
+    /// Gets the queues that own the voxel next to blockIndex in direction dir.
+    /// @param nIndex: Set to the neighbor voxel index in that chunk
+    /// @return nullptr if the neighbor chunk isn't loaded
+    ChunkLightQueues* getNeighborQueues(ChunkLightQueues& q, int dir, int blockIndex, int& nIndex);
+    /// Queues a removal check on each neighbor of blockIndex
+    void queueRemovalNeighbors(ChunkLightQueues& q, int blockIndex, ui16 value, LightQueue queue);
+
+    /// Queues the facing border of a lit neighbor to spread into the chunk
+    /// @return true if the neighbor was lit
+    bool pullNeighborLight(ChunkLightQueues& q, int dir);
+    /// Fills m_sunlight with the sunlight columns and queues the nodes that spread them
+    void calculateSunlightColumns(ChunkLightQueues& q, bool hasTopSunlight);
+
+    /// Runs all removals, then all additions, until no chunk has work left
+    void flushQueues();
+    void removeSunlight(ChunkLightQueues& q);
+    void addSunlight(ChunkLightQueues& q);
+    void removeLampLight(ChunkLightQueues& q);
+    void addLampLight(ChunkLightQueues& q);
+    /// Releases every chunk touched since the last reset
+    void resetQueues();
+
+    const BlockHotTable* m_blocks = nullptr; ///< Hot properties of the block pack being lit
+
+    std::deque<ChunkLightQueues> m_queues; ///< Deque so references survive growth
+    size_t m_numQueues = 0;
+
+    // Scratch space for the initial light pass
+    ui16 m_blockIDs[CHUNK_SIZE];
+    ui8 m_sunlight[CHUNK_SIZE];
+    IntervalTree<ui8>::LNode m_sunlightRuns[CHUNK_SIZE];
+    ui8 m_litBottom[CHUNK_LAYER]; ///< Lowest y in each column that gets full sunlight
+    ui8 m_borderSunlight[CHUNK_LAYER];
+    ui16 m_borderLamp[CHUNK_LAYER];
+    ui8 m_topSunlight[CHUNK_LAYER];
+    ui8 m_bottomSunlight[CHUNK_LAYER];
+};
+
+#endif // VoxelLightEngine_h__
@@ -0,0 +1,17 @@
+#include "stdafx.h"
+#include "VoxelLightTask.h"
+
+#include "VoxelLightEngine.h"
+
+void VoxelLightTask::execute(WorkerData* workerData) {
+    if (workerData->voxelLightEngine == nullptr) {
+        workerData->voxelLightEngine = new VoxelLightEngine();
+    }
+    workerData->voxelLightEngine->calculateChunkLight(chunk, blockPack);
+
+    chunk.release();
+}
+
+void VoxelLightTask::cleanup() {
+    delete this;
+}
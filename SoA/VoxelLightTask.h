@@ -0,0 +1,45 @@
+///
+/// VoxelLightTask.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Does the first light pass on a generated chunk using the threadpool.
+///
+
+#pragma once
+
+#ifndef VoxelLightTask_h__
+#define VoxelLightTask_h__
+
+#include <Vorb/IThreadPoolTask.h>
+
+#include "ChunkHandle.h"
+#include "VoxPool.h"
+
+class BlockPack;
+
+#define VOXEL_LIGHT_TASK_ID 7
+
+class VoxelLightTask : public vcore::IThreadPoolTask<WorkerData> {
+public:
+    VoxelLightTask() : vcore::IThreadPoolTask<WorkerData>(VOXEL_LIGHT_TASK_ID) {}
+
+    void init(ChunkHandle& h, const BlockPack* blockPack) {
+        chunk = h.acquire();
+        this->blockPack = blockPack;
+    }
+
+    // Executes the task
+    void execute(WorkerData* workerData) override;
+
+    void cleanup() override;
+
+    ChunkHandle chunk;
+    const BlockPack* blockPack = nullptr;
+};
+
+#endif // VoxelLightTask_h__
@@ -5,17 +5,29 @@
 #include "Chunk.h"
 
 void VoxelNodeSetterTask::execute(WorkerData* workerData) {
+    // Flora that spilled into a chunk loaded from a save is already in the save
+    if (h->isFromSave) {
+        h.release();
+        return;
+    }
     {
         std::lock_guard<std::mutex> l(h->dataMutex);
         for (auto& node : forcedNodes) {
             h->blocks.set(node.blockIndex, node.blockID);
+            h->flagDirtyMeshRegion(node.blockIndex);
+            h->queueLightUpdate(node.blockIndex);
+            h->queueCaUpdate(node.blockIndex);
         }
         for (auto& node : condNodes) {
             // TODO(Ben): Custom condition
             if (h->blocks.get(node.blockIndex) == 0) {
                 h->blocks.set(node.blockIndex, node.blockID);
+                h->flagDirtyMeshRegion(node.blockIndex);
+                h->queueLightUpdate(node.blockIndex);
+                h->queueCaUpdate(node.blockIndex);
             }
         }
+        h->updateVersion++;
     }
 
     if (h->genLevel >= GEN_DONE) h->DataChange(h);
@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "VoxelRunKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RUN_KERNELS_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RUN_KERNELS_SSE2
+#endif
+
+size_t vorb::voxel::findRunEnd(const ui16* data, size_t begin, size_t end) {
+    const ui16 value = data[begin];
+    size_t i = begin + 1;
+#if defined(RUN_KERNELS_AVX2)
+    const __m256i v = _mm256_set1_epi16((short)value);
+    for (; i + 16 <= end; i += 16) {
+        __m256i d = _mm256_loadu_si256((const __m256i*)(data + i));
+        ui32 mask = (ui32)_mm256_movemask_epi8(_mm256_cmpeq_epi16(d, v));
+        // Two mask bits per element
+        if (mask != 0xFFFFFFFF) return i + (countTrailingZeros(~mask) >> 1);
+    }
+#elif defined(RUN_KERNELS_SSE2)
+    const __m128i v = _mm_set1_epi16((short)value);
+    for (; i + 8 <= end; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(data + i));
+        ui32 mask = (ui32)_mm_movemask_epi8(_mm_cmpeq_epi16(d, v));
+        // Two mask bits per element
+        if (mask != 0xFFFF) return i + (countTrailingZeros(~mask & 0xFFFF) >> 1);
+    }
+#endif
+    for (; i < end; i++) {
+        if (data[i] != value) return i;
+    }
+    return end;
+}
+
+void vorb::voxel::fillRun(ui16* dst, size_t count, ui16 value) {
+    size_t i = 0;
+#if defined(RUN_KERNELS_AVX2)
+    const __m256i v = _mm256_set1_epi16((short)value);
+    for (; i + 16 <= count; i += 16) {
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+#elif defined(RUN_KERNELS_SSE2)
+    const __m128i v = _mm_set1_epi16((short)value);
+    for (; i + 8 <= count; i += 8) {
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = value;
+    }
+}
@@ -0,0 +1,72 @@
+///
+/// VoxelRunKernels.h
+/// Seed of Andromeda
+///
+/// Created on 16 Oct 2026
+/// Copyright 2014 Regrowth Studios
+/// All Rights Reserved
+///
+/// Summary:
+/// Run length encode and run expand kernels for voxel arrays.
+/// ui16 data uses SSE2 or AVX2 when the build targets them.
+///
+
+#pragma once
+
+#ifndef VoxelRunKernels_h__
+#define VoxelRunKernels_h__
+
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vorb {
+    namespace voxel {
+        /// @return Index of the lowest set bit. v must not be 0.
+        inline ui32 countTrailingZeros(ui32 v) {
+#ifdef _MSC_VER
+            unsigned long i;
+            _BitScanForward(&i, v);
+            return (ui32)i;
+#else
+            return (ui32)__builtin_ctz(v);
+#endif
+        }
+
+        /// @return First index in (begin, end) whose value differs from data[begin], or end
+        size_t findRunEnd(const ui16* data, size_t begin, size_t end);
+        template <typename T>
+        inline size_t findRunEnd(const T* data, size_t begin, size_t end) {
+            const T value = data[begin];
+            for (size_t i = begin + 1; i < end; i++) {
+                if (data[i] != value) return i;
+            }
+            return end;
+        }
+
+        /// Sets count elements of dst to value
+        void fillRun(ui16* dst, size_t count, ui16 value);
+        template <typename T>
+        inline void fillRun(T* dst, size_t count, T value) {
+            std::fill(dst, dst + count, value);
+        }
+
+        /// Run length encodes count elements of data into out, which must have room for count nodes.
+        /// LNode is IntervalTree<T>::LNode.
+        /// @return The number of runs written
+        template <typename T, typename LNode>
+        inline size_t encodeRuns(const T* data, size_t count, LNode* out) {
+            size_t numRuns = 0;
+            size_t i = 0;
+            while (i < count) {
+                size_t end = findRunEnd(data, i, count);
+                out[numRuns++].set((ui16)i, (ui16)(end - i), data[i]);
+                i = end;
+            }
+            return numRuns;
+        }
+    }
+}
+
+#endif // VoxelRunKernels_h__
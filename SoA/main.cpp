@@ -12,6 +12,7 @@
 #include "App.h"
 #include "Startup.h"
 #include "ConsoleMain.h"
+#include "ChunkGenBenchmark.h"
 
 // Entry
 int main(int argc, char **argv) {
@@ -24,7 +25,8 @@ int main(int argc, char **argv) {
 #endif
 
     // Get the startup mode
-    switch (startup(argc, argv)) {
+    ui32 benchmarkChunks = DEFAULT_BENCHMARK_CHUNKS;
+    switch (startup(argc, argv, &benchmarkChunks)) {
     case Startup::APP:
         // Run the game
         { App().run(); }
@@ -33,6 +35,10 @@ int main(int argc, char **argv) {
         // Run the console
         consoleMain();
         break;
+    case Startup::BENCHMARK:
+        // Run the chunk pipeline without a window
+        runChunkGenBenchmark(benchmarkChunks);
+        break;
     case Startup::HELP:
         // Pause on user input
         getchar();